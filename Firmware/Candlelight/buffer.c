@@ -31,12 +31,15 @@ buf_class  buf_inst[CHANNEL_COUNT] = {0};
 
 // ----- Private Methods
 void              buf_process_host (uint8_t channel, buf_class* usb_buf);
-void              buf_process_can  (uint8_t channel, buf_class* can_buf);
 void              buf_clear_buffers(uint8_t channel, bool clear_can, bool clear_host);
 kHostFrameObject* buf_peek_host_frame_locked(list_item* list_head);
 buf_class*        buf_get_inst_for_usb(uint8_t channel);
 bool              buf_store_can_frame(uint8_t channel, uint8_t* can_frame);
-void              buf_store_rx_packet_echo(uint8_t channel, FDCAN_RxHeaderTypeDef *rx_header, uint8_t *rx_data, uint32_t fake_echo);
+bool              buf_send_next_can_frame(uint8_t channel);
+bool              buf_store_tx_packet_ttl(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t ttl, bool forwarded, uint32_t rx_time);
+void              buf_add_can_frame_sorted_locked(kCanFrameObject* obj_to_can, list_item* list_head);
+void              buf_store_rx_packet_echo(uint8_t channel, FDCAN_RxHeaderTypeDef *rx_header, uint8_t *rx_data, uint16_t lost_count, bool priority, uint32_t fake_echo);
+int               buf_write_timestamp(uint8_t channel, uint8_t* dest, uint32_t timestamp);
 
 // public
 void buf_init()
@@ -60,6 +63,7 @@ void buf_clear_buffers(uint8_t channel, bool clear_can, bool clear_host)
     {
         list_init(&inst->list_can_pool);
         list_init(&inst->list_to_can);
+        inst->rx_sequence = 0;
 
         // add the 64 entries to the can pool ringbuffers
         for (int i=0; i < CAN_QUEUE_SIZE; i++)
@@ -71,6 +75,7 @@ void buf_clear_buffers(uint8_t channel, bool clear_can, bool clear_host)
     {
         list_init(&inst->list_host_pool);
         list_init(&inst->list_to_host);
+        inst->rx_prio_count = 0;
 
         // add the 70 entries to the host pool ringbuffers
         for (int i=0; i < HOST_QUEUE_SIZE; i++)
@@ -88,7 +93,11 @@ void buf_process(uint8_t channel, uint32_t tick_now)
     buf_class* can_buf = &buf_inst[channel];
     buf_class* usb_buf = buf_get_inst_for_usb(channel);
 
-    buf_process_can (channel, can_buf);
+    // With CAN_TX_INTERRUPT the Tx complete interrupt also calls buf_fill_tx_fifo()
+    can_block_tx_interrupt(channel, true);
+    buf_fill_tx_fifo(channel);
+    can_block_tx_interrupt(channel, false);
+
     buf_process_host(channel, usb_buf);
 
     // The APP_xxx errors are deleted after sending them to the host.
@@ -114,6 +123,9 @@ void buf_process_host(uint8_t channel, buf_class* usb_buf)
     if (!obj_to_host)
         return; // nothing to be sent
 
+    if (usb_buf->rx_prio_count > 0)
+        usb_buf->rx_prio_count --;
+
     uint16_t len;
     if (GLB_ProtoElmue) // new ElmSoft protocol
     {
@@ -154,6 +166,9 @@ void buf_process_host(uint8_t channel, buf_class* usb_buf)
 
                 obj_to_host = buf_get_host_frame_locked (&usb_buf->list_to_host);
                 next_obj    = buf_peek_host_frame_locked(&usb_buf->list_to_host);
+
+                if (usb_buf->rx_prio_count > 0)
+                    usb_buf->rx_prio_count --;
             }
         }
         else // only one frame to be sent
@@ -185,16 +200,54 @@ void buf_process_host(uint8_t channel, buf_class* usb_buf)
     USBD_SendInDataToHost(channel, usb_buf->to_host_buf, len);
 }
 
-// called from the main loop
-// send a host packet to CAN bus if list_to_can has data
-void buf_process_can(uint8_t channel, buf_class* can_buf)
+// public function
+// Called from buf_process() in the main loop and from the Tx complete interrupt (CAN_TX_INTERRUPT)
+// send host packets to CAN bus as long as list_to_can has data and the Tx FIFO has free space
+void buf_fill_tx_fifo(uint8_t channel)
+{
+    while (buf_send_next_can_frame(channel))
+    {
+    }
+}
+
+// public function
+// returns true if no packet is waiting to be moved into the CAN Tx FIFO
+bool buf_is_tx_buffer_empty(uint8_t channel)
 {
+    return list_is_empty(&buf_inst[channel].list_to_can);
+}
+
+// public function
+// returns true if no more packet can be stored in list_to_can
+bool buf_is_tx_buffer_full(uint8_t channel)
+{
+    return list_is_empty(&buf_inst[channel].list_can_pool);
+}
+
+// private function
+// send one host packet to CAN bus if list_to_can has data
+// returns false if nothing more can be sent
+bool buf_send_next_can_frame(uint8_t channel)
+{
+    buf_class* can_buf = &buf_inst[channel];
+
     if (!can_is_tx_fifo_free(channel))
-        return; // all 3 CAN Tx FIFO's are full
+        return false; // all 3 CAN Tx FIFO's are full
 
     kCanFrameObject* obj_to_can = buf_get_can_frame_locked(&can_buf->list_to_can);
     if (!obj_to_can)
-        return; // nothing to be sent
+        return false; // nothing to be sent
+
+    // MSG_TxTtl: the frame has waited too long in list_to_can (bus congestion, low priority) --> discard it, but continue with the next frame.
+    if (obj_to_can->has_ttl && (int32_t)(system_get_timestamp() - obj_to_can->expire_time) > 0)
+    {
+        if ((GLB_UserFlags[channel] & USR_TxEcho) && obj_to_can->header.MessageMarker > 0)
+            buf_store_tx_expired(channel, obj_to_can->header.MessageMarker);
+
+        // give the CAN frame back to where it came from.
+        list_add_tail_locked(&obj_to_can->list, &can_buf->list_can_pool);
+        return true;
+    }
 
     // ------------------------------
 
@@ -205,10 +258,16 @@ void buf_process_can(uint8_t channel, buf_class* can_buf)
 
         // give the CAN frame back to where it came from.
         list_add_tail_locked(&obj_to_can->list, &can_buf->list_can_pool);
-        return; // do not send the message
+        return false; // do not send the message
     }
 
-    can_send_packet(channel, &obj_to_can->header, obj_to_can->data);
+#if CHANNEL_COUNT > 1
+    // A forwarded packet passes its Rx timestamp for the latency measurement of the queued packets
+    if (obj_to_can->forwarded)
+        can_send_packet_rx_time(channel, &obj_to_can->header, obj_to_can->data, obj_to_can->rx_time, true);
+    else
+#endif
+        can_send_packet(channel, &obj_to_can->header, obj_to_can->data);
     // At this point the Tx packet is in the CAN Tx FIFO, but it has not yet been transmitted to CAN bus.
 
     if (GLB_ProtoElmue) // new ElmSoft protocol
@@ -238,11 +297,12 @@ void buf_process_can(uint8_t channel, buf_class* can_buf)
         rx_header.FDFormat            = obj_to_can->header.FDFormat;
         rx_header.RxTimestamp         = system_get_timestamp(); // 32 bit
 
-        buf_store_rx_packet_echo(channel, &rx_header, obj_to_can->data, obj_to_can->header.MessageMarker);
+        buf_store_rx_packet_echo(channel, &rx_header, obj_to_can->data, 0, false, obj_to_can->header.MessageMarker);
     }
 
     // give the CAN frame back to where it came from.
     list_add_tail_locked(&obj_to_can->list, &can_buf->list_can_pool);
+    return true;
 }
 
 // public function
@@ -275,29 +335,60 @@ void buf_store_can_frame_blob(uint8_t channel, uint8_t* can_frame)
 }
 
 // private function
-// Enqueue a Tx frame (kTxFrameElmue or kHostFrameLegacy) received from USB
+// Enqueue a Tx frame (kTxFrameElmue, kTxTimedElmue, kTxTtlElmue or kHostFrameLegacy) received from USB
 bool buf_store_can_frame(uint8_t channel, uint8_t* can_frame)
 {
     uint32_t can_id;
     uint8_t  flags;
-    uint8_t  can_dlc = 0;
-    uint8_t  marker  = 0;
+    uint8_t  can_dlc   = 0;
+    uint8_t  marker    = 0;
     uint8_t* frame_data;
+    bool     timed     = false;
+    uint32_t send_time = 0;
+    uint32_t ttl       = 0;
     if (GLB_ProtoElmue) // new ElmSoft protocol
     {
         kTxFrameElmue *tx_frame = (kTxFrameElmue*)can_frame;
-        if (tx_frame->header.msg_type != MSG_TxFrame)
+        int byte_count;
+        switch (tx_frame->header.msg_type)
         {
-            error_assert(channel, APP_CanTxFail, true); // both LED ON
-            return false; // host has sent an invalid frame
+            case MSG_TxFrame:
+                frame_data = tx_frame->data_start;
+                byte_count = tx_frame->header.size - sizeof(kTxFrameElmue);
+                break;
+
+            case MSG_TxTimed: // the first members are the same as in kTxFrameElmue
+            {
+                kTxTimedElmue *timed_frame = (kTxTimedElmue*)can_frame;
+                timed      = true;
+                send_time  = timed_frame->send_time;
+                frame_data = timed_frame->data_start;
+                byte_count = timed_frame->header.size - sizeof(kTxTimedElmue);
+                break;
+            }
+
+            case MSG_TxTtl: // the first members are the same as in kTxFrameElmue
+            {
+                kTxTtlElmue *ttl_frame = (kTxTtlElmue*)can_frame;
+                ttl        = ttl_frame->ttl;
+                frame_data = ttl_frame->data_start;
+                byte_count = ttl_frame->header.size - sizeof(kTxTtlElmue);
+                if (ttl > 0x7FFFFFFF) // the expiry is checked with a signed difference of timestamps
+                {
+                    error_assert(channel, APP_CanTxFail, true); // both LED ON
+                    return false;
+                }
+                break;
+            }
+
+            default:
+                error_assert(channel, APP_CanTxFail, true); // both LED ON
+                return false; // host has sent an invalid frame
         }
 
         can_id     = tx_frame->can_id;
         flags      = tx_frame->flags;
         marker     = tx_frame->marker;
-        frame_data = tx_frame->data_start;
-
-        int byte_count = tx_frame->header.size - sizeof(kTxFrameElmue);
 
         // Remote frames never send data bytes. The host can write the DLC value into the first data byte, otherwise DLC = 0 is sent.
         if (can_id & CAN_ID_RTR)
@@ -370,11 +461,38 @@ bool buf_store_can_frame(uint8_t channel, uint8_t* can_frame)
 
     tx_header.DataLength = can_dlc;
 
-    return buf_store_tx_packet(channel, &tx_header, frame_data);
+    if (timed)
+    {
+        switch (can_send_timed(channel, &tx_header, frame_data, send_time))
+        {
+            case FBK_Success:      return true;
+            case FBK_TxBufferFull: error_assert(channel, APP_CanTxOverflow, true); return false; // both LED ON
+            default:               error_assert(channel, APP_CanTxFail,     true); return false; // both LED ON
+        }
+    }
+
+    return buf_store_tx_packet_ttl(channel, &tx_header, frame_data, ttl, false, 0);
 }
 
+// public function
 // Enqueue a packet for CAN bus.
 bool buf_store_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
+    return buf_store_tx_packet_ttl(channel, tx_header, tx_data, 0, false, 0);
+}
+#if CHANNEL_COUNT > 1
+// public function
+// Enqueue a packet that the bridge forwards from another channel (see can_forward_bridge_packet())
+// rx_time = Rx timestamp on the source channel for the latency measurement
+bool buf_store_fwd_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time)
+{
+    return buf_store_tx_packet_ttl(channel, tx_header, tx_data, 0, true, rx_time);
+}
+#endif
+// private function
+// ttl = time-to-live in s after which the packet is discarded if it is still in list_to_can, 0 = no time-to-live
+// forwarded = true --> the packet may be overwritten by buf_replace_tx_packet()
+bool buf_store_tx_packet_ttl(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t ttl, bool forwarded, uint32_t rx_time)
 {
     buf_class* can_buf = &buf_inst[channel];
 
@@ -383,7 +501,17 @@ bool buf_store_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint
     {
         memcpy(&obj_to_can->header, tx_header, sizeof(obj_to_can->header));
         memcpy(&obj_to_can->data,   tx_data,   sizeof(obj_to_can->data));
-        list_add_tail_locked(&obj_to_can->list, &can_buf->list_to_can);
+        obj_to_can->has_ttl     = ttl > 0;
+        obj_to_can->expire_time = system_get_timestamp() + ttl;
+#if CHANNEL_COUNT > 1
+        obj_to_can->forwarded   = forwarded;
+        obj_to_can->rx_time     = rx_time;
+#endif
+
+        if (GLB_UserFlags[channel] & USR_TxPriority)
+            buf_add_can_frame_sorted_locked(obj_to_can, &can_buf->list_to_can);
+        else
+            list_add_tail_locked(&obj_to_can->list, &can_buf->list_to_can);
         return true;
     }
     else // CAN buffer overflow
@@ -394,22 +522,84 @@ bool buf_store_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint
     }
 }
 
+#if CHANNEL_COUNT > 1
+// public function
+// Bridge mode "latest value wins": overwrite a forwarded packet with the same CAN ID that is still waiting in list_to_can.
+// Only packets stored with buf_store_fwd_packet() are replaced, never packets from the host.
+// Returns false if no such packet is pending.
+// Called from can_process() in the main loop.
+bool buf_replace_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time)
+{
+    list_item* list_head = &buf_inst[channel].list_to_can;
+    bool replaced = false;
+
+    // The Tx complete interrupt must not remove frames from list_to_can while it is searched.
+    // The USB interrupt only inserts frames, which become visible with the last pointer write in list_insert().
+    // So the interrupts are not disabled globally, the FDCAN Rx interrupt must not be delayed by a search over 64 frames.
+    can_block_tx_interrupt(channel, true);
+    list_item* cur = list_head->next;
+    for (int i=0; i<CAN_QUEUE_SIZE && cur != list_head; i++, cur = cur->next)
+    {
+        kCanFrameObject* obj_to_can = list_entry(cur, kCanFrameObject, list);
+        if (obj_to_can->header.Identifier  == tx_header->Identifier && obj_to_can->header.IdType == tx_header->IdType &&
+            obj_to_can->header.TxFrameType == tx_header->TxFrameType && obj_to_can->forwarded)
+        {
+            memcpy(&obj_to_can->header, tx_header, sizeof(obj_to_can->header));
+            memcpy(&obj_to_can->data,   tx_data,   sizeof(obj_to_can->data));
+            obj_to_can->has_ttl = false; // the forwarded packet has no time-to-live
+            obj_to_can->rx_time = rx_time;
+            replaced = true;
+            break;
+        }
+    }
+    can_block_tx_interrupt(channel, false);
+    return replaced;
+}
+#endif
+
+// private function
+// USR_TxPriority: insert the frame into list_to_can behind the last frame that has the same or a higher priority.
+// So the frame with the lowest CAN ID is always sent first and frames with the same ID keep their order.
+// The search starts at the tail, because usually the host sends the frames in a similar order as they are sent to the CAN bus.
+void buf_add_can_frame_sorted_locked(kCanFrameObject* obj_to_can, list_item* list_head)
+{
+    uint32_t new_prio = can_arbitration_priority(&obj_to_can->header);
+
+    system_disable_irq();
+    list_item* prev = list_head->prev;
+    while (prev != list_head)
+    {
+        kCanFrameObject* obj_prev = list_entry(prev, kCanFrameObject, list);
+        if (can_arbitration_priority(&obj_prev->header) <= new_prio)
+            break;
+
+        prev = prev->prev;
+    }
+    list_insert(&obj_to_can->list, prev, prev->next);
+    system_enable_irq();
+}
+
 // ---------------------------------------------------------------------------------------------------
 
 // public function
 // Enqueue a CAN Rx packet for the host.
 // rx_data is a 64 byte buffer with the received / sent data bytes
 // append the frame to list_to_host
-void buf_store_rx_packet(uint8_t channel, FDCAN_RxHeaderTypeDef *rx_header, uint8_t *rx_data)
+void buf_store_rx_packet(uint8_t channel, FDCAN_RxHeaderTypeDef *rx_header, uint8_t *rx_data, uint16_t lost_count, bool priority)
 {
-    buf_store_rx_packet_echo(channel, rx_header, rx_data, ECHO_RxData);
+    buf_store_rx_packet_echo(channel, rx_header, rx_data, lost_count, priority, ECHO_RxData);
 }
 // private function
+// lost_count = packets lost in hardware before this packet (only used with ELM_DevFlagRxSequence)
+// priority   = the packet matched a priority filter (only used with ELM_DevFlagRxDualFifo)
 // fake_echo is only used for legacy mode
-void buf_store_rx_packet_echo(uint8_t channel, FDCAN_RxHeaderTypeDef *rx_header, uint8_t *rx_data, uint32_t fake_echo)
+void buf_store_rx_packet_echo(uint8_t channel, FDCAN_RxHeaderTypeDef *rx_header, uint8_t *rx_data, uint16_t lost_count, bool priority, uint32_t fake_echo)
 {
     buf_class* usb_buf = buf_get_inst_for_usb(channel);
 
+    // The sequence number is incremented before checking the pool, so the host sees a gap for each packet dropped here.
+    uint16_t sequence = buf_inst[channel].rx_sequence ++;
+
     kHostFrameObject* obj_to_host = buf_get_host_frame_locked(&usb_buf->list_host_pool);
     if (!obj_to_host)
         return; // buffer overflow! buf_process() will report this error to the host
@@ -447,21 +637,22 @@ void buf_store_rx_packet_echo(uint8_t channel, FDCAN_RxHeaderTypeDef *rx_header,
         else byte_count = utils_dlc_to_byte_count(can_dlc);
 
         kRxFrameElmue* frame   = (kRxFrameElmue*)obj_to_host->frame;
-        frame->header.size     = sizeof(kRxFrameElmue) + byte_count;
         frame->header.msg_type = MSG_RxFrame;
         frame->flags           = flags;
         frame->can_id          = can_id;
-        frame->timestamp       = rx_header->RxTimestamp; // 32 bit
 
-        if (GLB_UserFlags[channel] & USR_Timestamp)
-        {
-            memcpy(frame->data_use_stamp, rx_data, byte_count);
-        }
-        else
+        // The data bytes follow the optional 32 or 64 bit timestamp and the optional kRxSequence
+        int extra_len = buf_write_timestamp(channel, frame->data_no_stamp, rx_header->RxTimestamp);
+        if (GLB_UserFlags[channel] & USR_RxSequence)
         {
-            frame->header.size -= 4;
-            memcpy(frame->data_no_stamp, rx_data, byte_count);
+            kRxSequence rx_seq;
+            rx_seq.sequence   = sequence;
+            rx_seq.lost_count = lost_count;
+            memcpy(frame->data_no_stamp + extra_len, &rx_seq, sizeof(kRxSequence)); // may be unaligned
+            extra_len += sizeof(kRxSequence);
         }
+        frame->header.size = sizeof(kRxFrameElmue) - 4 + extra_len + byte_count;
+        memcpy(frame->data_no_stamp + extra_len, rx_data, byte_count);
     }
     else // legacy Geschwister Schneider protocol
     {
@@ -480,10 +671,43 @@ void buf_store_rx_packet_echo(uint8_t channel, FDCAN_RxHeaderTypeDef *rx_header,
             frame->pack_classic.timestamp_us = rx_header->RxTimestamp; // 32 bit
     }
 
+    if (priority)
+    {
+        // Priority frames are sent before all other frames, but in the order they have been received.
+        system_disable_irq();
+        list_item* prev = &usb_buf->list_to_host;
+        for (uint32_t i=0; i<usb_buf->rx_prio_count; i++)
+        {
+            prev = prev->next;
+        }
+        list_insert(&obj_to_host->list, prev, prev->next);
+        usb_buf->rx_prio_count ++;
+        system_enable_irq();
+        return;
+    }
+
     // add the frame to list_to_host with IRQs disabled
     list_add_tail_locked(&obj_to_host->list, &usb_buf->list_to_host);
 }
 
+// private function
+// Write the timestamp of a frame for the ElmSoft protocol: nothing, 32 bit, or 64 bit as low 32 bit followed by the high 32 bit.
+// The 32 bit timestamp was taken in the last 71 minutes, so the high 32 bit can be restored from the current time.
+// dest may be unaligned. Returns the count of bytes written.
+int buf_write_timestamp(uint8_t channel, uint8_t* dest, uint32_t timestamp)
+{
+    if ((GLB_UserFlags[channel] & USR_Timestamp) == 0)
+        return 0;
+
+    memcpy(dest, &timestamp, 4);
+    if ((GLB_UserFlags[channel] & USR_Timestamp64) == 0)
+        return 4;
+
+    uint32_t high = system_extend_timestamp32(timestamp) >> 32;
+    memcpy(dest + 4, &high, 4);
+    return 8;
+}
+
 // a CAN packet from the Tx FIFO has been sent and acknowledged on CAN bus --> send marker to host.
 // the legacy protocol never comes here. It sends a fake echo.
 void buf_store_tx_echo(uint8_t channel, FDCAN_TxEventFifoTypeDef* tx_event)
@@ -501,10 +725,29 @@ void buf_store_tx_echo(uint8_t channel, FDCAN_TxEventFifoTypeDef* tx_event)
     frame->header.size     = sizeof(kTxEchoElmue);
     frame->header.msg_type = MSG_TxEcho;
     frame->marker          = tx_event->MessageMarker;
-    frame->timestamp       = tx_event->TxTimestamp; // 32 bit
+    frame->header.size    += buf_write_timestamp(channel, (uint8_t*)&frame->timestamp, tx_event->TxTimestamp) - 4;
 
-    if ((GLB_UserFlags[channel] & USR_Timestamp) == 0)
-        frame->header.size -= 4;
+    // add the frame to list_to_host with IRQs disabled
+    list_add_tail_locked(&obj_to_host->list, &usb_buf->list_to_host);
+}
+
+// public function
+// A CAN packet with time-to-live has been discarded in buf_send_next_can_frame() or a timed packet could not be sent
+// in can_scheduler_interrupt() --> send marker to host.
+// Called from the main loop, from the Tx complete interrupt and from the scheduler interrupt.
+void buf_store_tx_expired(uint8_t channel, uint8_t marker)
+{
+    buf_class* usb_buf = buf_get_inst_for_usb(channel);
+
+    kHostFrameObject* obj_to_host = buf_get_host_frame_locked(&usb_buf->list_host_pool);
+    if (!obj_to_host)
+        return; // buffer overflow! buf_process() will report this error to the host
+
+    kTxExpiredElmue* frame = (kTxExpiredElmue*)obj_to_host->frame;
+    frame->header.size     = sizeof(kTxExpiredElmue);
+    frame->header.msg_type = MSG_TxExpired;
+    frame->marker          = marker;
+    frame->header.size    += buf_write_timestamp(channel, (uint8_t*)&frame->timestamp, system_get_timestamp()) - 4;
 
     // add the frame to list_to_host with IRQs disabled
     list_add_tail_locked(&obj_to_host->list, &usb_buf->list_to_host);
@@ -600,10 +843,7 @@ void buf_store_error(uint8_t channel)
         frame_elmue->header.size     = sizeof(kErrorElmue);
         frame_elmue->header.msg_type = MSG_Error;
         frame_elmue->err_id          = can_id; // the flag CAN_ID_Error is not needed as we have MSG_Error
-        frame_elmue->timestamp       = system_get_timestamp();
-
-        if ((GLB_UserFlags[channel] & USR_Timestamp) == 0)
-            frame_elmue->header.size -= 4;
+        frame_elmue->header.size    += buf_write_timestamp(channel, (uint8_t*)&frame_elmue->timestamp, system_get_timestamp()) - 4;
     }
     else // legacy Geschwister Schneider protocol
     {
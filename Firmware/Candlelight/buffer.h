@@ -107,7 +107,7 @@ static inline void list_add_tail_locked(list_item *entry, list_item *head)
 typedef struct 
 {
     list_item list;
-    // stores kHostFrameLegacy, kRxFrameElmue, kTxEchoElmue, kErrorElmue, kStringElmue, kBusloadElmue
+    // stores kHostFrameLegacy, kRxFrameElmue, kTxEchoElmue, kTxExpiredElmue, kErrorElmue, kStringElmue, kBusloadElmue, kBusloadStatsElmue, kBusOffStatsElmue
     uint8_t frame[sizeof(kHostFrameLegacy)]; 
 } kHostFrameObject;
 
@@ -117,6 +117,12 @@ typedef struct
     list_item             list;
     FDCAN_TxHeaderTypeDef header;  
     uint8_t               data[64];   
+    bool                  has_ttl;     // MSG_TxTtl: the frame is discarded when expire_time has been reached
+    uint32_t              expire_time; // MSG_TxTtl: timestamp in s
+#if CHANNEL_COUNT > 1
+    bool                  forwarded;   // bridge: the frame comes from another channel and may be replaced (latest value wins)
+    uint32_t              rx_time;     // bridge: Rx timestamp of the forwarded frame for the latency measurement
+#endif
 } kCanFrameObject;
 
 typedef struct 
@@ -152,6 +158,11 @@ typedef struct
     // The result was an adapter not sending anymore and even crashes when the buffer got full!
     // Nobody ever noticed that because of a complete lack of proper error handling.
     // The legacy firmware did not even set an error flag when a buffer overflow occurred.
+    // ELM_DevFlagRxSequence: incremented for each Rx packet that should be sent to the host, also if the host pool was empty
+    uint16_t   rx_sequence;
+    // ELM_DevFlagRxDualFifo: count of priority Rx frames at the begin of list_to_host, new priority frames are inserted behind them
+    uint32_t   rx_prio_count;
+
     uint8_t    to_host_buf  [MAX_BLOB_SIZE]; // stores USB IN  data during transmission (fixed by ElmSoft)
     uint8_t    from_host_buf[MAX_BLOB_SIZE]; // stores USB OUT data after reception     (fixed by ElmSoft)   
     
@@ -162,11 +173,19 @@ typedef struct
 void buf_init();
 void buf_process(uint8_t channel, uint32_t tick_now);
 void buf_clear_can_buffer(uint8_t channel);
+void buf_fill_tx_fifo(uint8_t channel);
+bool buf_is_tx_buffer_empty(uint8_t channel);
+bool buf_is_tx_buffer_full (uint8_t channel);
 void buf_store_error(uint8_t channel);
 void buf_store_can_frame_blob(uint8_t channel, uint8_t* can_frame);
 bool buf_store_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
-void buf_store_rx_packet(uint8_t channel, FDCAN_RxHeaderTypeDef* rx_header, uint8_t *rx_data);
+#if CHANNEL_COUNT > 1
+bool buf_store_fwd_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time);
+bool buf_replace_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time);
+#endif
+void buf_store_rx_packet(uint8_t channel, FDCAN_RxHeaderTypeDef* rx_header, uint8_t *rx_data, uint16_t lost_count, bool priority);
 void buf_store_tx_echo  (uint8_t channel, FDCAN_TxEventFifoTypeDef* tx_event);
+void buf_store_tx_expired(uint8_t channel, uint8_t marker);
 buf_class* buf_get_instance(uint8_t channel);
 kHostFrameObject* buf_get_host_frame_locked(list_item* list_head);
 kCanFrameObject*  buf_get_can_frame_locked (list_item* list_head);
@@ -14,6 +14,12 @@
 #include "control.h"
 #include "usb_ioreq.h"
 
+// ELM_DevFlagTimeSync: interval in ms for sending kTimeSyncElmue to the host
+#define TIME_SYNC_INTERVAL    100
+
+// private functions
+void control_report_time_sync(uint8_t channel);
+
 // ----- Globals
 extern eUserFlags     GLB_UserFlags[CHANNEL_COUNT];
 extern bool           GLB_ProtoElmue;
@@ -33,6 +39,14 @@ eFeedback             ELM_LastError    = FBK_Success;
 // This buffer contains OUT data from the host in the second stage of SETUP requests.
 uint8_t __aligned(4)  ep0_buf[MAX(USB_MAX_EP0_SIZE, MAX_FLASH_DATA_LEN + 8)];
 
+// ELM_ReqGetIdStats: the IN data must stay valid until it has been sent to the host
+kIdStatsPage          id_stats_page;
+
+// ELM_DevFlagTimeSync: MCU time and frame number of the last USB Start-Of-Frame, written in the USB interrupt
+volatile uint64_t     sof_time         = 0;
+volatile uint16_t     sof_frame        = 0;
+uint32_t              sync_last_tick[CHANNEL_COUNT] = {0};
+
 // SETUP requests with OUT data are executed in two stages,
 // the first stage uses this variable to pass the request to the second stage.
 USBD_SetupReqTypedef  last_setup = {0};
@@ -65,7 +79,13 @@ void control_init()
                                    GS_DevFlagBitTimingFD    |
                                    GS_DevFlagGetErrorState  |
                                    ELM_DevFlagProtocolElmue |
-                                   ELM_DevFlagSendUsbBlobs;
+                                   ELM_DevFlagSendUsbBlobs  |
+                                   ELM_DevFlagTxPriority    |
+                                   ELM_DevFlagTimestamp64   |
+                                   ELM_DevFlagTimeSync      |
+                                   ELM_DevFlagRxSequence    |
+                                   ELM_DevFlagRxDualFifo    |
+                                   ELM_DevFlagErrorLog;
     if (SET_TermPins[0] > 0)
         GS_CapabilityClassic.feature |= GS_DevFlagTermination;
 
@@ -112,6 +132,75 @@ void control_init()
 #endif
 }
 
+// Fill id_stats_page with one page of the per-ID statistics for ELM_ReqGetIdStats.
+// Called from the USB interrupt, returns false on error and sets ELM_LastError.
+bool control_get_id_stats_page(uint8_t channel, uint32_t page)
+{
+    uint32_t slot, total, lost;
+    ELM_LastError = can_get_id_stats(channel, page, &slot, &total, &lost);
+    if (ELM_LastError != FBK_Success)
+        return false;
+
+    memset(&id_stats_page, 0, sizeof(kIdStatsPage));
+    id_stats_page.TotalIDs   = total;
+    id_stats_page.Page       = page;
+    id_stats_page.LostFrames = lost;
+
+    id_stat_entry entry;
+    uint32_t count = 0;
+    while (count < ID_STATS_PAGE_SIZE && can_next_id_stat_entry(channel, &slot, &entry))
+    {
+        kIdStatsEntry* dest = &id_stats_page.Entries[count++];
+
+        dest->CanID      = entry.key & ~BRG_KEY_29BIT;
+        dest->Count      = entry.count;
+        dest->MaxPeriod  = entry.max_period;
+        dest->LastStamp  = entry.last_stamp;
+        dest->LastDLC    = entry.last_dlc;
+        if (entry.key & BRG_KEY_29BIT)
+            dest->CanID |= CAN_ID_29Bit;
+
+        if (entry.count > 1)
+        {
+            dest->MinPeriod  = entry.min_period;
+            dest->MeanPeriod = (uint32_t)(entry.sum_period / (entry.count - 1));
+        }
+    }
+    id_stats_page.EntryCount = count;
+    return true;
+}
+
+// Convert kCyclicEntry into a Tx header for ELM_ReqSetCyclic.
+// Called from the USB interrupt.
+eFeedback control_set_cyclic(uint8_t channel, kCyclicEntry* cyclic)
+{
+    if (cyclic->Period == 0)
+        return can_set_cyclic(channel, cyclic->Index, NULL, NULL, 0, 0, CYC_NONE, 0, CYC_NONE, false);
+
+    if (cyclic->DLC > 15 || (cyclic->DLC > 8 && !(cyclic->Flags & FRM_FDF)))
+        return FBK_InvalidParameter;
+
+    FDCAN_TxHeaderTypeDef tx_header;
+    tx_header.TxFrameType   = (cyclic->CanID & CAN_ID_RTR) ? FDCAN_REMOTE_FRAME : FDCAN_DATA_FRAME;
+    tx_header.FDFormat      = (cyclic->Flags & FRM_FDF)    ? FDCAN_FD_CAN       : FDCAN_CLASSIC_CAN;
+    tx_header.BitRateSwitch = (cyclic->Flags & FRM_FDF) && (cyclic->Flags & FRM_BRS) ? FDCAN_BRS_ON : FDCAN_BRS_OFF;
+    tx_header.DataLength    = cyclic->DLC;
+
+    if (cyclic->CanID & CAN_ID_29Bit)
+    {
+         tx_header.IdType     = FDCAN_EXTENDED_ID;
+         tx_header.Identifier = cyclic->CanID & CAN_MASK_29;
+    }
+    else
+    {
+         tx_header.IdType     = FDCAN_STANDARD_ID;
+         tx_header.Identifier = cyclic->CanID & CAN_MASK_11;
+    }
+
+    return can_set_cyclic(channel, cyclic->Index, &tx_header, cyclic->Data, cyclic->Period, cyclic->Phase,
+                          cyclic->CounterByte, cyclic->CounterMask, cyclic->ChecksumByte, cyclic->ChecksumXor > 0);
+}
+
 // A SETUP vendor request packet has been received (first stage).
 // For IN  data requests (to the host) send the response.
 // For OUT data requests (from the host) provide a buffer which will be filled and passed to control_vendor_OUT_data()
@@ -142,8 +231,20 @@ bool control_setup_request(USBD_SetupReqTypedef *req)
     int      channel    = 0;
     ePinID   pin_id     = 0; // invalid
     uint32_t flash_addr = 0; // invalid
+    uint32_t stats_page = 0;
     switch (req->bRequest)
     {
+        // the low byte of req->wValue is the channel, the high byte is the page
+        case ELM_ReqGetIdStats:
+            channel    = req->wValue & 0xFF;
+            stats_page = req->wValue >> 8;
+            if (channel >= CHANNEL_COUNT)
+            {
+                ELM_LastError = FBK_InvalidParameter;
+                return false; // stall endpoint 0
+            }
+            break;
+
         // req->wValue is the pin ID
         case ELM_ReqGetPinStatus:
             pin_id = req->wValue;
@@ -215,9 +316,24 @@ bool control_setup_request(USBD_SetupReqTypedef *req)
             case ELM_ReqSetFilter:
                 min_len = sizeof(kFilter);
                 break;
+            case ELM_ReqSetTranslation:
+                min_len = sizeof(kTranslation);
+                break;
+            case ELM_ReqSetIdStats:
+                min_len = sizeof(kIdStatsSetup);
+                break;
+            case ELM_ReqSetCyclic:
+                min_len = sizeof(kCyclicEntry);
+                break;
             case ELM_ReqSetBusLoadReport:
                 min_len = sizeof(uint8_t);
                 break;
+            case ELM_ReqSetTxTimeout:
+                min_len = sizeof(uint16_t);
+                break;
+            case ELM_ReqSetBusOffRecovery:
+                min_len = sizeof(kBusOffSetup);
+                break;
             case ELM_ReqSetPinStatus:
                 min_len = sizeof(kPinStatus);
                 break;
@@ -250,6 +366,7 @@ bool control_setup_request(USBD_SetupReqTypedef *req)
     {
         uint16_t    value16;
         uint32_t    value32;
+        uint64_t    value64;
         kErrorState err_state = {0};
         void*       src;
         uint16_t    len;
@@ -281,7 +398,7 @@ bool control_setup_request(USBD_SetupReqTypedef *req)
                 {
                     FDCAN_ProtocolStatusTypeDef status;
                     FDCAN_ErrorCountersTypeDef  counters;
-                    HAL_FDCAN_GetProtocolStatus(can_get_handle(channel), &status);
+                    can_get_protocol_status(channel, &status);
                     HAL_FDCAN_GetErrorCounters (can_get_handle(channel), &counters);
 
                     err_state.rx_err = counters.RxErrorCnt;
@@ -346,6 +463,19 @@ bool control_setup_request(USBD_SetupReqTypedef *req)
                 len = MIN(len, MAX_FLASH_DATA_LEN);
                 break;
 
+            case ELM_ReqGetIdStats:
+                if (!control_get_id_stats_page(channel, stats_page))
+                    return false; // stall endpoint 0
+                src = &id_stats_page;
+                len = sizeof(kIdStatsPage);
+                break;
+
+            case ELM_ReqGetTimestamp64:
+                value64 = system_get_timestamp64();
+                src = &value64;
+                len = sizeof(uint64_t);
+                break;
+
             default:
                 ELM_LastError = FBK_InvalidCommand;
                 return false; // stall endpoint 0
@@ -441,6 +571,12 @@ void control_setup_OUT_data()
             if (GLB_ProtoElmue)
             {
                 if (dev_Mode->flags & ELM_DevFlagSendUsbBlobs) GLB_UserFlags[channel] |= USR_SendBlobs;
+                if (dev_Mode->flags & ELM_DevFlagTxPriority)   GLB_UserFlags[channel] |= USR_TxPriority;
+                if (dev_Mode->flags & ELM_DevFlagTimestamp64)  GLB_UserFlags[channel] |= USR_Timestamp64;
+                if (dev_Mode->flags & ELM_DevFlagTimeSync)     GLB_UserFlags[channel] |= USR_TimeSync;
+                if (dev_Mode->flags & ELM_DevFlagRxSequence)   GLB_UserFlags[channel] |= USR_RxSequence;
+                if (dev_Mode->flags & ELM_DevFlagRxDualFifo)   GLB_UserFlags[channel] |= USR_RxDualFifo;
+                if (dev_Mode->flags & ELM_DevFlagErrorLog)     GLB_UserFlags[channel] |= USR_ErrorLog;
 
                 // When the ElmSoft protocol is enabled, also debug messages and error reports are enabled by default.
                 for (int C=0; C<CHANNEL_COUNT; C++)
@@ -497,10 +633,22 @@ void control_setup_OUT_data()
                     ELM_LastError = can_clear_host_filters(channel);
                     return;
                 case FIL_HostPass_11:
-                    ELM_LastError = can_add_host_filter(channel, false, filter->Filter, filter->Mask);
+                    ELM_LastError = can_add_host_filter(channel, false, filter->Filter, filter->Mask, false);
                     return;
                 case FIL_HostPass_29:
-                    ELM_LastError = can_add_host_filter(channel, true,  filter->Filter, filter->Mask);
+                    ELM_LastError = can_add_host_filter(channel, true,  filter->Filter, filter->Mask, false);
+                    return;
+                case FIL_HostPassID_11:
+                    ELM_LastError = can_add_host_id(channel, false, filter->Filter);
+                    return;
+                case FIL_HostPassID_29:
+                    ELM_LastError = can_add_host_id(channel, true,  filter->Filter);
+                    return;
+                case FIL_HostPrio_11:
+                    ELM_LastError = can_add_host_filter(channel, false, filter->Filter, filter->Mask, true);
+                    return;
+                case FIL_HostPrio_29:
+                    ELM_LastError = can_add_host_filter(channel, true,  filter->Filter, filter->Mask, true);
                     return;
                 // ---------------------
                 case FIL_BridgeClear:
@@ -518,6 +666,84 @@ void control_setup_OUT_data()
                 case FIL_BridgeBlock_29:
                     ELM_LastError = can_set_bridge_filter(channel, filter->DestChannel, filter->Index, true,  true,  true,  filter->Filter, filter->Mask);
                     return;
+                // ---------------------
+                case FIL_BridgeLimitDest:
+                    if (filter->DestChannel >= CHANNEL_COUNT)
+                    {
+                        ELM_LastError = FBK_InvalidParameter;
+                        return;
+                    }
+                    ELM_LastError = can_set_bridge_dest_limit(filter->DestChannel, filter->Mask, filter->Index, filter->Filter == 1);
+                    return;
+                case FIL_BridgeLimitID_11:
+                    ELM_LastError = can_set_bridge_id_limit(channel, false, filter->Filter, filter->Mask, filter->Index);
+                    return;
+                case FIL_BridgeLimitID_29:
+                    ELM_LastError = can_set_bridge_id_limit(channel, true,  filter->Filter, filter->Mask, filter->Index);
+                    return;
+                // ---------------------
+                case FIL_TunnelClear:
+                    ELM_LastError = can_set_tunnel(channel, false, false, 0, 0);
+                    return;
+                case FIL_TunnelSet_11:
+                    ELM_LastError = can_set_tunnel(channel, true,  false, filter->Filter, filter->Mask);
+                    return;
+                case FIL_TunnelSet_29:
+                    ELM_LastError = can_set_tunnel(channel, true,  true,  filter->Filter, filter->Mask);
+                    return;
+                default:
+                    ELM_LastError = FBK_InvalidParameter;
+                    return;
+            }
+        }
+        case ELM_ReqSetTranslation:
+        {
+            kTranslation* trans = (kTranslation*)ep0_buf;
+            switch (trans->Operation)
+            {
+                case 0:
+                    ELM_LastError = can_clear_bridge_translations(channel);
+                    return;
+                case 1:
+                    ELM_LastError = can_set_bridge_translation(channel, (trans->SourceID & CAN_ID_29Bit) > 0, trans->SourceID & ~CAN_ID_29Bit,
+                                                                        (trans->DestID   & CAN_ID_29Bit) > 0, trans->DestID   & ~CAN_ID_29Bit,
+                                                                        trans->KeepMask, trans->Replace, trans->Xor);
+                    return;
+                default:
+                    ELM_LastError = FBK_InvalidParameter;
+                    return;
+            }
+        }
+        case ELM_ReqSetIdStats:
+        {
+            kIdStatsSetup* setup = (kIdStatsSetup*)ep0_buf;
+            switch (setup->Operation)
+            {
+                case IDST_Disable:
+                    ELM_LastError = can_set_id_stats(channel, 0, true);
+                    return;
+                case IDST_Enable:
+                    ELM_LastError = can_set_id_stats(channel, setup->MaxEntries, setup->NoStream == 0);
+                    return;
+                case IDST_Clear:
+                    ELM_LastError = can_clear_id_stats(channel);
+                    return;
+                default:
+                    ELM_LastError = FBK_InvalidParameter;
+                    return;
+            }
+        }
+        case ELM_ReqSetCyclic:
+        {
+            kCyclicEntry* cyclic = (kCyclicEntry*)ep0_buf;
+            switch (cyclic->Operation)
+            {
+                case 0:
+                    ELM_LastError = can_clear_cyclic(channel);
+                    return;
+                case 1:
+                    ELM_LastError = control_set_cyclic(channel, cyclic);
+                    return;
                 default:
                     ELM_LastError = FBK_InvalidParameter;
                     return;
@@ -526,9 +752,32 @@ void control_setup_OUT_data()
         case ELM_ReqSetBusLoadReport:
         {
             uint8_t interval = ep0_buf[0];
-            ELM_LastError = can_enable_busload(channel, interval); // interval in 100 ms steps
+            uint8_t flags    = last_setup.wLength >= 2 ? ep0_buf[1] : 0; // optional second byte: eBusloadFlags
+            ELM_LastError = can_enable_busload(channel, interval, (flags & BUSLOAD_Exact) > 0, (flags & BUSLOAD_Statistics) > 0); // interval in 100 ms steps
+            return;
+        }
+        case ELM_ReqSetTxTimeout:
+        {
+            uint16_t* timeout_ms = (uint16_t*)ep0_buf;
+            ELM_LastError = can_set_tx_timeout(channel, *timeout_ms);
             return;
         }
+        case ELM_ReqSetBusOffRecovery:
+        {
+            kBusOffSetup* setup = (kBusOffSetup*)ep0_buf;
+            switch (setup->Operation)
+            {
+                case BOFF_SetPolicy:
+                    ELM_LastError = can_set_bus_off_policy(channel, (eBusOffPolicy)setup->Policy, setup->BaseDelay, setup->MaxAttempts);
+                    return;
+                case BOFF_Recover:
+                    ELM_LastError = can_restart_bus_off(channel);
+                    return;
+                default:
+                    ELM_LastError = FBK_InvalidParameter;
+                    return;
+            }
+        }
         case ELM_ReqSetPinStatus:
         {
             kPinStatus* pin_status = (kPinStatus*)ep0_buf;
@@ -561,6 +810,12 @@ void control_process(uint8_t channel, uint32_t tick_now)
     if (error_is_report_due(channel, tick_now))
         buf_store_error(channel);
 
+    if ((GLB_UserFlags[channel] & USR_TimeSync) && can_is_open(channel) && tick_now - sync_last_tick[channel] >= TIME_SYNC_INTERVAL)
+    {
+        sync_last_tick[channel] = tick_now;
+        control_report_time_sync(channel);
+    }
+
     // Revover BusOff AFTER printing error BusOff to the Trace output!
     can_recover_bus_off(channel);
 }
@@ -582,6 +837,137 @@ void control_report_busload(uint8_t channel, uint8_t busload_percent)
     list_add_tail_locked(&obj_to_host->list, &usb_buf->list_to_host);
 }
 
+// Called from the USB interrupt every millisecond when a Start-Of-Frame packet is received.
+// The SOF is sent by the host controller with a precision of 500 ns.
+// The interrupt latency (< 10 s, USB has a lower priority than FDCAN and Timer 3) is the only error on the MCU side.
+void control_latch_sof()
+{
+    sof_time  = system_get_timestamp64();
+    sof_frame = USB_Instance->FNR & USB_FNR_FN;
+}
+
+// ELM_DevFlagTimeSync: send the latched SOF time every TIME_SYNC_INTERVAL ms
+void control_report_time_sync(uint8_t channel)
+{
+    system_disable_irq();
+    uint64_t time  = sof_time;
+    uint16_t frame = sof_frame;
+    system_enable_irq();
+
+    if (time == 0)
+        return; // no SOF received yet
+
+    // only called for ElmSoft protocol
+    buf_class* usb_buf = buf_get_instance(channel);
+
+    kHostFrameObject* obj_to_host = buf_get_host_frame_locked(&usb_buf->list_host_pool);
+    if (!obj_to_host)
+        return; // buffer overflow! buf_process() will report this error to the host
+
+    kTimeSyncElmue* packet  = (kTimeSyncElmue*)obj_to_host->frame;
+    packet->header.size     = sizeof(kTimeSyncElmue);
+    packet->header.msg_type = MSG_TimeSync;
+    packet->frame_number    = frame;
+    packet->sof_time        = time;
+
+    list_add_tail_locked(&obj_to_host->list, &usb_buf->list_to_host);
+}
+
+void control_report_busload_stats(uint8_t channel, uint8_t busload_percent, uint8_t peak, uint8_t minimum, uint16_t* histogram)
+{
+    // only called for ElmSoft protocol
+    buf_class* usb_buf = buf_get_instance(channel);
+
+    kHostFrameObject* obj_to_host = buf_get_host_frame_locked(&usb_buf->list_host_pool);
+    if (!obj_to_host)
+        return; // buffer overflow! buf_process() will report this error to the host
+
+    kBusloadStatsElmue* packet = (kBusloadStatsElmue*)obj_to_host->frame;
+    packet->header.size        = sizeof(kBusloadStatsElmue);
+    packet->header.msg_type    = MSG_BusloadStats;
+    packet->bus_load           = busload_percent;
+    packet->peak               = peak;
+    packet->minimum            = minimum;
+    packet->reserved           = 0;
+    memcpy(packet->histogram, histogram, sizeof(packet->histogram));
+
+    list_add_tail_locked(&obj_to_host->list, &usb_buf->list_to_host);
+}
+
+// ELM_DevFlagErrorLog: send one protocol error that has been stored by the FDCAN interrupt
+void control_report_error_event(uint8_t channel, uint32_t timestamp, uint8_t code, uint8_t tx_err_count, uint8_t rx_err_count)
+{
+    // only called for ElmSoft protocol
+    buf_class* usb_buf = buf_get_instance(channel);
+
+    kHostFrameObject* obj_to_host = buf_get_host_frame_locked(&usb_buf->list_host_pool);
+    if (!obj_to_host)
+        return; // buffer overflow! buf_process() will report this error to the host
+
+    kErrorEventElmue* packet = (kErrorEventElmue*)obj_to_host->frame;
+    packet->header.size      = sizeof(kErrorEventElmue);
+    packet->header.msg_type  = MSG_ErrorEvent;
+    packet->code             = code;
+    packet->tx_err_count     = tx_err_count;
+    packet->rx_err_count     = rx_err_count;
+    packet->timestamp        = timestamp;
+
+    if (GLB_UserFlags[channel] & USR_Timestamp64)
+    {
+        // the frame buffer is larger than any message, the high 32 bit are appended after the struct
+        uint32_t high = system_extend_timestamp32(timestamp) >> 32;
+        memcpy(obj_to_host->frame + sizeof(kErrorEventElmue), &high, 4);
+        packet->header.size += 4;
+    }
+
+    list_add_tail_locked(&obj_to_host->list, &usb_buf->list_to_host);
+}
+
+// ELM_DevFlagErrorLog: send the count of protocol errors per type
+void control_report_error_counters(uint8_t channel, uint32_t* counts, uint32_t suppressed)
+{
+    // only called for ElmSoft protocol
+    buf_class* usb_buf = buf_get_instance(channel);
+
+    kHostFrameObject* obj_to_host = buf_get_host_frame_locked(&usb_buf->list_host_pool);
+    if (!obj_to_host)
+        return; // buffer overflow! buf_process() will report this error to the host
+
+    kErrorCountersElmue* packet = (kErrorCountersElmue*)obj_to_host->frame;
+    packet->header.size         = sizeof(kErrorCountersElmue);
+    packet->header.msg_type     = MSG_ErrorCounters;
+    packet->suppressed          = suppressed;
+    memcpy(packet->counts, counts, sizeof(packet->counts));
+
+    list_add_tail_locked(&obj_to_host->list, &usb_buf->list_to_host);
+}
+
+// Called from can_recover_bus_off() after each recovery from Bus Off and when the firmware starts waiting for the host.
+void control_report_bus_off_stats(uint8_t channel, bool waiting, uint32_t attempts, uint32_t bus_off_count, uint32_t last_ms, uint32_t min_ms, uint32_t max_ms)
+{
+    if (!GLB_ProtoElmue)
+        return; // the legacy protocol does not know this message
+
+    buf_class* usb_buf = buf_get_instance(channel);
+
+    kHostFrameObject* obj_to_host = buf_get_host_frame_locked(&usb_buf->list_host_pool);
+    if (!obj_to_host)
+        return; // buffer overflow! buf_process() will report this error to the host
+
+    kBusOffStatsElmue* packet = (kBusOffStatsElmue*)obj_to_host->frame;
+    packet->header.size       = sizeof(kBusOffStatsElmue);
+    packet->header.msg_type   = MSG_BusOffStats;
+    packet->waiting           = waiting ? 1 : 0;
+    packet->reserved          = 0;
+    packet->attempts          = (uint16_t)MIN(attempts, 0xFFFF);
+    packet->bus_off_count     = bus_off_count;
+    packet->last_ms           = last_ms;
+    packet->min_ms            = min_ms;
+    packet->max_ms            = max_ms;
+
+    list_add_tail_locked(&obj_to_host->list, &usb_buf->list_to_host);
+}
+
 // Send a debug message. Maximum length is 78 characters.
 // The message may contain "\n" for multi-line output.
 // To make sure that you see all debug output the first command that you execute on each channel
@@ -75,6 +75,7 @@ uint8_t  USB_IRQ_Setup      (USBD_SetupReqTypedef *req);
 uint8_t  USB_IRQ_EP0_RxReady();
 uint8_t  USB_IRQ_DataIn     (uint8_t epnum);
 uint8_t  USB_IRQ_DataOut    (uint8_t epnum);
+uint8_t  USB_IRQ_SOF        ();
 // -------------
 void     USB_IRQ_Vendor_Request(USBD_SetupReqTypedef *req);
 bool     USB_IRQ_DFU_Request   (USBD_SetupReqTypedef *req);
@@ -92,7 +93,7 @@ USBD_ClassTypeDef USBD_ClassCallbacks =
     .EP0_RxReady       = USB_IRQ_EP0_RxReady,
     .DataIn            = USB_IRQ_DataIn,
     .DataOut           = USB_IRQ_DataOut,
-    .SOF               = NULL,
+    .SOF               = USB_IRQ_SOF,
     .IsoINIncomplete   = NULL, // ISO endpoints not used
     .IsoOUTIncomplete  = NULL, // ISO endpoints not used
 };
@@ -699,3 +700,11 @@ uint8_t USB_IRQ_DataIn(uint8_t epnum)
     return USBD_OK;
 }
 
+// interrupt callback
+// A Start-Of-Frame packet has been received (every millisecond)
+uint8_t USB_IRQ_SOF()
+{
+    control_latch_sof();
+    return USBD_OK;
+}
+
@@ -24,6 +24,8 @@ uint8_t      slcan_str_index = 0;
 
 // ----- Private Methods
 int32_t buf_frame_to_ascii(uint8_t *buf, bool b_TX, FDCAN_RxHeaderTypeDef* rx_header, uint8_t* frame_data);
+void    buf_swap_tx_packets(can_tx_buf* txbuf, uint16_t index1, uint16_t index2);
+eFeedback buf_store_tx_entry(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t ttl, bool forwarded, uint32_t rx_time);
 
 void buf_init()
 {
@@ -37,6 +39,7 @@ void buf_clear_can_buffer(uint8_t channel)
     txbuf->tail = txbuf->head;
     txbuf->send = txbuf->head;
     txbuf->full = false;
+    txbuf->expired_tail = txbuf->expired_head;
 }
 
 // This function is called approx 100 times in one millisecond from the main loop
@@ -99,22 +102,73 @@ void buf_process(uint8_t channel, uint32_t tick_now)
     
     // ------ Process can transmit buffer
     
+    // With CAN_TX_INTERRUPT the Tx complete interrupt also calls buf_fill_tx_fifo()
+    can_block_tx_interrupt(channel, true);
+    buf_fill_tx_fifo(channel);
+    can_block_tx_interrupt(channel, false);
+    
+    // report buffer full always --> Rx + Tx LED are permanently ON
+    if (buf_can_tx[channel].full)
+        error_assert(channel, APP_CanTxOverflow, false);
+
+    // Send the markers of packets that have been discarded because their time-to-live expired or a timed packet could not be sent: "m3A\r"
+    can_tx_buf* txbuf = &buf_can_tx[channel];
+    while (txbuf->expired_tail != txbuf->expired_head)
+    {
+        char buf[10];
+        sprintf(buf, "m%02X\r", txbuf->expired_marker[txbuf->expired_tail % BUF_CAN_TXQUEUE_LEN]);
+        buf_enqueue_cdc(channel, buf, 4);
+        txbuf->expired_tail ++;
+    }
+}
+
+// Move packets from buf_can_tx into the CAN Tx FIFO as long as the FIFO has free space.
+// Called from buf_process() in the main loop and from the Tx complete interrupt (CAN_TX_INTERRUPT)
+void buf_fill_tx_fifo(uint8_t channel)
+{
     can_tx_buf* txbuf = &buf_can_tx[channel];
     while ((txbuf->send != txbuf->head || txbuf->full) && can_is_tx_fifo_free(channel))
     {
-        // Transmit can frame
-        can_send_packet(channel, &txbuf->header[txbuf->send], txbuf->data[txbuf->send]);
+        FDCAN_TxHeaderTypeDef* header = &txbuf->header[txbuf->send];
+
+        // "~" command: the packet has waited too long in the Tx queue (bus congestion, low priority) --> discard it.
+        // The echo marker is reported later in buf_process() because this may be the Tx complete interrupt.
+        if (txbuf->has_ttl[txbuf->send] && (int32_t)(system_get_timestamp() - txbuf->expire_time[txbuf->send]) > 0)
+        {
+            if ((GLB_UserFlags[channel] & USR_TxEcho) && header->MessageMarker > 0)
+                buf_store_tx_expired(channel, header->MessageMarker);
+        }
+        else
+        {
+            // Transmit can frame
+#if CHANNEL_COUNT > 1
+            // A forwarded packet passes its Rx timestamp for the latency measurement of the queued packets
+            if (txbuf->forwarded[txbuf->send])
+                can_send_packet_rx_time(channel, header, txbuf->data[txbuf->send], txbuf->rx_time[txbuf->send], true);
+            else
+#endif
+                can_send_packet(channel, header, txbuf->data[txbuf->send]);
         
-        // At this point the Tx packet is in the CAN Tx FIFO, but it has not yet been transmitted to CAN bus.
+            // At this point the Tx packet is in the CAN Tx FIFO, but it has not yet been transmitted to CAN bus.
+        }
 
         txbuf->send = (txbuf->send + 1) % BUF_CAN_TXQUEUE_LEN;
         txbuf->tail = (txbuf->tail + 1) % BUF_CAN_TXQUEUE_LEN;
         txbuf->full = false;
     }
-    
-    // report buffer full always --> Rx + Tx LED are permanently ON
-    if (txbuf->full)
-        error_assert(channel, APP_CanTxOverflow, false);
+}
+
+// returns true if no packet is waiting to be moved into the CAN Tx FIFO
+bool buf_is_tx_buffer_empty(uint8_t channel)
+{
+    can_tx_buf* txbuf = &buf_can_tx[channel];
+    return txbuf->send == txbuf->head && !txbuf->full;
+}
+
+// returns true if no more packet can be stored in the Tx queue
+bool buf_is_tx_buffer_full(uint8_t channel)
+{
+    return buf_can_tx[channel].full;
 }
 
 // Enqueue data for transmission over USB CDC to host 
@@ -147,34 +201,157 @@ void buf_enqueue_cdc(uint8_t channel, char* buf, uint16_t len)
 
 // Enqueue a Tx packet to be sent to CAN bus
 eFeedback buf_store_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
+    return buf_store_tx_packet_ttl(channel, tx_header, tx_data, 0);
+}
+
+// ttl = time-to-live in s after which the packet is discarded if it is still in the Tx queue, 0 = no time-to-live
+eFeedback buf_store_tx_packet_ttl(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t ttl)
+{
+    return buf_store_tx_entry(channel, tx_header, tx_data, ttl, false, 0);
+}
+
+#if CHANNEL_COUNT > 1
+// Enqueue a packet that the bridge forwards from another channel (see can_forward_bridge_packet())
+// rx_time = Rx timestamp on the source channel for the latency measurement
+eFeedback buf_store_fwd_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time)
+{
+    return buf_store_tx_entry(channel, tx_header, tx_data, 0, true, rx_time);
+}
+#endif
+
+// forwarded = true --> the packet may be overwritten by buf_replace_tx_packet()
+eFeedback buf_store_tx_entry(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t ttl, bool forwarded, uint32_t rx_time)
 {
     eFeedback e_Feedback = can_is_tx_allowed(channel);
     if (e_Feedback != FBK_Success)
         return e_Feedback;
     
+    // The Tx complete interrupt must not move the send pointer while the pending packets are re-ordered.
+    // The scheduler interrupt (can_scheduler_interrupt) must not store a packet at the same head position.
+    can_block_tx_interrupt(channel, true);
+
     can_tx_buf* txbuf = &buf_can_tx[channel];
     if (txbuf->full)
     {
+        can_block_tx_interrupt(channel, false);
         error_assert(channel, APP_CanTxOverflow, false);
         return FBK_TxBufferFull;
     }
     
     memcpy(&txbuf->header[txbuf->head], tx_header, sizeof(FDCAN_TxHeaderTypeDef));
     memcpy( txbuf->data  [txbuf->head], tx_data,   CAN_MAX_DATALEN);
+    txbuf->has_ttl    [txbuf->head] = ttl > 0;
+    txbuf->expire_time[txbuf->head] = system_get_timestamp() + ttl;
+#if CHANNEL_COUNT > 1
+    txbuf->forwarded  [txbuf->head] = forwarded;
+    txbuf->rx_time    [txbuf->head] = rx_time;
+#endif
+
+    // With USR_TxPriority move the new packet backwards before all pending packets with a lower priority.
+    // Packets with the same priority stay in the order they came from the host.
+    if (GLB_UserFlags[channel] & USR_TxPriority)
+    {
+        uint32_t new_prio = can_arbitration_priority(tx_header);
+        for (uint16_t cur = txbuf->head; cur != txbuf->send; )
+        {
+            uint16_t prev = (cur + BUF_CAN_TXQUEUE_LEN - 1) % BUF_CAN_TXQUEUE_LEN;
+            if (can_arbitration_priority(&txbuf->header[prev]) <= new_prio)
+                break;
+
+            buf_swap_tx_packets(txbuf, prev, cur);
+            cur = prev;
+        }
+    }
     
     // Increment the head pointer
+    // disable interrupts because tail and full are modified in the Tx complete interrupt (CAN_TX_INTERRUPT)
+    system_disable_irq();
     txbuf->head = (txbuf->head + 1) % BUF_CAN_TXQUEUE_LEN;
     if (txbuf->head == txbuf->tail) 
         txbuf->full = true;
+    system_enable_irq();
     
+    can_block_tx_interrupt(channel, false);
     return FBK_Success;
 }
 
+#if CHANNEL_COUNT > 1
+// Bridge mode "latest value wins": overwrite a forwarded packet with the same CAN ID that is still waiting in the Tx queue.
+// Only packets stored with buf_store_fwd_packet() are replaced, never packets from the host.
+// Returns false if no such packet is pending.
+bool buf_replace_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time)
+{
+    can_tx_buf* txbuf = &buf_can_tx[channel];
+    bool replaced = false;
+
+    // The Tx complete interrupt must not move the send pointer while the pending packets are searched
+    can_block_tx_interrupt(channel, true);
+
+    if (!buf_is_tx_buffer_empty(channel))
+    {
+        uint16_t cur = txbuf->send;
+        do
+        {
+            FDCAN_TxHeaderTypeDef* header = &txbuf->header[cur];
+            if (header->Identifier  == tx_header->Identifier && header->IdType == tx_header->IdType &&
+                header->TxFrameType == tx_header->TxFrameType && txbuf->forwarded[cur])
+            {
+                memcpy(header,           tx_header, sizeof(FDCAN_TxHeaderTypeDef));
+                memcpy(txbuf->data[cur], tx_data,   CAN_MAX_DATALEN);
+                txbuf->has_ttl[cur] = false; // the forwarded packet has no time-to-live
+                txbuf->rx_time[cur] = rx_time;
+                replaced = true;
+                break;
+            }
+            cur = (cur + 1) % BUF_CAN_TXQUEUE_LEN;
+        }
+        while (cur != txbuf->head);
+    }
+
+    can_block_tx_interrupt(channel, false);
+    return replaced;
+}
+#endif
+
+// exchange two entries in the Tx queue
+void buf_swap_tx_packets(can_tx_buf* txbuf, uint16_t index1, uint16_t index2)
+{
+    FDCAN_TxHeaderTypeDef tmp_header;
+    uint8_t               tmp_data[CAN_MAX_DATALEN];
+
+    memcpy(&tmp_header,            &txbuf->header[index1], sizeof(FDCAN_TxHeaderTypeDef));
+    memcpy(&txbuf->header[index1], &txbuf->header[index2], sizeof(FDCAN_TxHeaderTypeDef));
+    memcpy(&txbuf->header[index2], &tmp_header,            sizeof(FDCAN_TxHeaderTypeDef));
+
+    memcpy(tmp_data,              txbuf->data[index1], CAN_MAX_DATALEN);
+    memcpy(txbuf->data[index1],   txbuf->data[index2], CAN_MAX_DATALEN);
+    memcpy(txbuf->data[index2],   tmp_data,            CAN_MAX_DATALEN);
+
+    bool     tmp_ttl    = txbuf->has_ttl[index1];
+    uint32_t tmp_expire = txbuf->expire_time[index1];
+    txbuf->has_ttl    [index1] = txbuf->has_ttl    [index2];
+    txbuf->expire_time[index1] = txbuf->expire_time[index2];
+    txbuf->has_ttl    [index2] = tmp_ttl;
+    txbuf->expire_time[index2] = tmp_expire;
+
+#if CHANNEL_COUNT > 1
+    bool     tmp_fwd  = txbuf->forwarded[index1];
+    uint32_t tmp_time = txbuf->rx_time  [index1];
+    txbuf->forwarded[index1] = txbuf->forwarded[index2];
+    txbuf->rx_time  [index1] = txbuf->rx_time  [index2];
+    txbuf->forwarded[index2] = tmp_fwd;
+    txbuf->rx_time  [index2] = tmp_time;
+#endif
+}
+
 // ================================== To Host ======================================
 
 // a RX packet has been received from CAN bus or a Tx Packet has been successfully sent to CAN bus
 // rx_data is a 64 byte buffer with the received / sent data bytes
-void buf_store_rx_packet(uint8_t channel, FDCAN_RxHeaderTypeDef* rx_header, uint8_t* rx_data)
+// lost_count is only used by Candlelight (ELM_DevFlagRxSequence), Slcan reports lost packets with APP_CanRxFail.
+// priority is only used by Candlelight (ELM_DevFlagRxDualFifo), Slcan never enables priority filters.
+void buf_store_rx_packet(uint8_t channel, FDCAN_RxHeaderTypeDef* rx_header, uint8_t* rx_data, uint16_t lost_count, bool priority)
 {
     char buf[SLCAN_MTU];
     if (rx_header->FDFormat == FDCAN_CLASSIC_CAN)
@@ -230,6 +407,16 @@ void buf_store_rx_packet(uint8_t channel, FDCAN_RxHeaderTypeDef* rx_header, uint
     buf_enqueue_cdc(channel, buf, pos);
 }
 
+// A packet with time-to-live has been discarded in buf_fill_tx_fifo() or a timed packet could not be sent in can_scheduler_interrupt().
+// The marker is sent to the host later in buf_process() because this may be the Tx complete or the scheduler interrupt.
+// The ring cannot overflow because it has the same size as the Tx queue and buf_process() empties it in each loop.
+void buf_store_tx_expired(uint8_t channel, uint8_t marker)
+{
+    can_tx_buf* txbuf = &buf_can_tx[channel];
+    txbuf->expired_marker[txbuf->expired_head % BUF_CAN_TXQUEUE_LEN] = marker;
+    txbuf->expired_head ++;
+}
+
 // Send the same message marker to the host that has been sent4 with the Tx packet
 void buf_store_tx_echo(uint8_t channel, FDCAN_TxEventFifoTypeDef* tx_event)
 {
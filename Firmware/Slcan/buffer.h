@@ -50,17 +50,37 @@ typedef struct
 {
     FDCAN_TxHeaderTypeDef header[BUF_CAN_TXQUEUE_LEN];   // Header buffer
     uint8_t  data[BUF_CAN_TXQUEUE_LEN][CAN_MAX_DATALEN]; // Data buffer
+    bool     has_ttl    [BUF_CAN_TXQUEUE_LEN];           // "~" command: the packet is discarded when expire_time has been reached
+    uint32_t expire_time[BUF_CAN_TXQUEUE_LEN];           // "~" command: timestamp in s
+#if CHANNEL_COUNT > 1
+    bool     forwarded  [BUF_CAN_TXQUEUE_LEN];           // bridge: the packet comes from another channel and may be replaced (latest value wins)
+    uint32_t rx_time    [BUF_CAN_TXQUEUE_LEN];           // bridge: Rx timestamp of the forwarded packet for the latency measurement
+#endif
     uint16_t head;                                       // Head pointer
     uint16_t send;                                       // Send pointer
     uint16_t tail;                                       // Tail pointer
     bool     full;                                       // Set this when we are full, clear when the tail moves one.
+    // Markers of expired packets. They are discarded in buf_fill_tx_fifo(), which may run in the Tx complete interrupt,
+    // so they are sent to the host later in buf_process(). Single producer / single consumer, the counters roll over.
+    uint8_t       expired_marker[BUF_CAN_TXQUEUE_LEN];
+    __IO uint32_t expired_head;                          // incremented only by buf_fill_tx_fifo()
+    __IO uint32_t expired_tail;                          // incremented only by buf_process()
 } can_tx_buf;
 
 void      buf_init();
 void      buf_process(uint8_t channel, uint32_t tick_now);
 void      buf_enqueue_cdc(uint8_t channel, char* buf, uint16_t len);
 void      buf_clear_can_buffer(uint8_t channel);
+void      buf_fill_tx_fifo(uint8_t channel);
+bool      buf_is_tx_buffer_empty(uint8_t channel);
+bool      buf_is_tx_buffer_full (uint8_t channel);
 void      buf_store_tx_echo  (uint8_t channel, FDCAN_TxEventFifoTypeDef* tx_event);
+void      buf_store_tx_expired(uint8_t channel, uint8_t marker);
 eFeedback buf_store_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef*    tx_header, uint8_t* tx_data);
-void      buf_store_rx_packet(uint8_t channel, FDCAN_RxHeaderTypeDef*    rx_header, uint8_t* rx_data);
+eFeedback buf_store_tx_packet_ttl(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t ttl);
+void      buf_store_rx_packet(uint8_t channel, FDCAN_RxHeaderTypeDef*    rx_header, uint8_t* rx_data, uint16_t lost_count, bool priority);
+#if CHANNEL_COUNT > 1
+eFeedback buf_store_fwd_packet(uint8_t channel, FDCAN_TxHeaderTypeDef*   tx_header, uint8_t* tx_data, uint32_t rx_time);
+bool      buf_replace_tx_packet(uint8_t channel, FDCAN_TxHeaderTypeDef*  tx_header, uint8_t* tx_data, uint32_t rx_time);
+#endif
 
@@ -17,7 +17,7 @@
 // This version defines which Slcan commands are available.
 // The first version was 100. See manual for version history.
 // (Candlelight does not need a version number because it returns the supported features as bit flags)
-#define SLCAN_VERSION          105
+#define SLCAN_VERSION          106
 
 // If this is != 0 all baudrates will be printed to verify all CAN_NOM_BITTIMING_xxx and CAN_DATA_BITTIMING_xxx
 #define VERIFY_ALL_BAUDRATES   0
@@ -94,7 +94,18 @@ uint32_t  CanMode[CHANNEL_COUNT];
 // ----- Private Methods
 eFeedback control_parse_str    (uint8_t channel, char buf[], int len);
 eFeedback control_host_filter  (uint8_t channel, char buf[]);
+eFeedback control_host_id_list (uint8_t channel, char buf[]);
 eFeedback control_bridge_filter(uint8_t channel, char buf[], bool enable);
+eFeedback control_bridge_translation(uint8_t channel, char buf[]);
+eFeedback control_bridge_limit(uint8_t channel, char buf[]);
+eFeedback control_tunnel(uint8_t channel, char buf[]);
+eFeedback control_id_stats(uint8_t channel, char buf[]);
+eFeedback control_cyclic  (uint8_t channel, char buf[], int len);
+eFeedback control_timed   (uint8_t channel, char buf[], int len);
+eFeedback control_ttl     (uint8_t channel, char buf[], int len);
+eFeedback control_bus_off (uint8_t channel, char buf[]);
+void      control_report_error_state(uint8_t channel);
+eFeedback control_parse_frame(uint8_t channel, char buf[], int len, bool parse_marker, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
 eFeedback control_parse_flash  (uint8_t channel, char buf[]);
 eFeedback control_set_baudrate (uint8_t channel, bool set_data, char baud_chr);
 
@@ -208,6 +219,14 @@ eFeedback control_parse_str(uint8_t channel, char buf[], int len)
                         if (can_is_open(channel)) return FBK_AdapterMustBeClosed;
                         GLB_UserFlags[channel] &= ~USR_Retransmit;
                         break;
+                    case 'P':                                        // "MP"  Send Tx packets ordered by CAN ID (Priority)
+                        if (can_is_open(channel)) return FBK_AdapterMustBeClosed;
+                        GLB_UserFlags[channel] |=  USR_TxPriority;
+                        break;
+                    case 'p':                                        // "Mp"
+                        if (can_is_open(channel)) return FBK_AdapterMustBeClosed;
+                        GLB_UserFlags[channel] &= ~USR_TxPriority;
+                        break;
                     case 'D': GLB_UserFlags[channel] |=  USR_DebugReport; break; // "MD"  Enable string debug messages
                     case 'd': GLB_UserFlags[channel] &= ~USR_DebugReport; break; // "Md"
                     case 'E': GLB_UserFlags[channel] |=  USR_ErrorReport; break; // "ME"  Enable CAN bus error reports
@@ -218,6 +237,14 @@ eFeedback control_parse_str(uint8_t channel, char buf[], int len)
                     case 'm': GLB_UserFlags[channel] &= ~USR_TxEcho;      break; // "Mt"
                     case 'S': GLB_UserFlags[channel] |=  USR_ReportESI;   break; // "MS"  Enable ESI report
                     case 's': GLB_UserFlags[channel] &= ~USR_ReportESI;   break; // "Ms"
+                    case 'L':                                        // "ML"  Enable protocol error Log
+                        if (can_is_open(channel)) return FBK_AdapterMustBeClosed;
+                        GLB_UserFlags[channel] |=  USR_ErrorLog;
+                        break;
+                    case 'l':                                        // "Ml"
+                        if (can_is_open(channel)) return FBK_AdapterMustBeClosed;
+                        GLB_UserFlags[channel] &= ~USR_ErrorLog;
+                        break;
                     // -----------------------------------------------------
                     case 'I': led_blink_identify(channel, true);          break; // "MI"  Identify device by blinking the LEDs
                     case 'i': led_blink_identify(channel, false);         break; // "Mi"  stop blinking
@@ -392,13 +419,25 @@ eFeedback control_parse_str(uint8_t channel, char buf[], int len)
 
         // Set CAN filter:
         case 'F':
+            if (buf[1] == ':' && buf[2] == 'T')
+                return control_bridge_translation(channel, buf); // "F:T7E0=7E8"
+            if (buf[1] == ':' && buf[2] == 'R')
+                return control_bridge_limit(channel, buf); // "F:R7E0=100,5"
+            if (buf[1] == ':' && buf[2] == 'U')
+                return control_tunnel(channel, buf); // "F:U7FF=500"
             if (buf[1] == ':')
                 return control_bridge_filter(channel, buf, true); 
+            if (buf[1] == '=')
+                return control_host_id_list (channel, buf); // "F=7E8;18DAF110"
             else
                 return control_host_filter  (channel, buf); // "F7E0,7FF"
 
         // Clear CAN filter:
         case 'f':
+            if (buf[1] == ':' && buf[2] == 'T' && len == 3)
+                return can_clear_bridge_translations(channel); // "f:T"
+            if (buf[1] == ':' && buf[2] == 'U' && len == 3)
+                return can_set_tunnel(channel, false, false, 0, 0); // "f:U"
             if (buf[1] == ':')
                 return control_bridge_filter(channel, buf, false); // "f:07"
             if (len == 1) 
@@ -409,19 +448,98 @@ eFeedback control_parse_str(uint8_t channel, char buf[], int len)
 
         // Enable bus load report in percent (the precision is approx +/- 10%)
         // The firmware will send the current bus load in user defined intervals.
-        // Command "L7\r" --> send busload every 700 ms
+        // Command "L7\r"  --> send busload every 700 ms
+        // Command "L7X\r" --> send busload every 700 ms, count the exact stuff bits of each frame
+        // Command "L7S\r" --> send busload every 700 ms with peak, minimum and histogram of 1 ms windows
+        // The options can be combined: "L7XS\r"
         case 'L':
         {
+            // The interval ends at the first option character
+            int end = 1;
+            while (buf[end] >= '0' && buf[end] <= '9')
+            {
+                end ++;
+            }
+
+            bool exact = false;
+            bool stats = false;
+            for (int i=end; buf[i] != 0; i++)
+            {
+                if      (buf[i] == 'X') exact = true;
+                else if (buf[i] == 'S') stats = true;
+                else return FBK_InvalidParameter;
+            }
+
             uint32_t interval;
             int pos = 1;
-            if (!utils_parse_next_decimal(buf, &pos, 0, &interval)) // "L0", "L7", "L30"
+            if (end == 1 || !utils_parse_next_decimal(buf, &pos, buf[end], &interval)) // "L0", "L7", "L30", "L7XS"
+                return FBK_InvalidParameter;
+
+            return can_enable_busload(channel, interval, exact, stats); // interval in 100 ms steps
+        }
+
+        // ----------------------------
+
+        // Per-ID statistics of all received CAN IDs
+        // Command "I100\r"  --> enable statistics for 100 CAN IDs (adapter closed)
+        // Command "I100N\r" --> enable statistics for 100 CAN IDs, do not send received frames to the host
+        // Command "I0\r"    --> disable statistics
+        // Command "IC\r"    --> clear all entries (adapter open or closed)
+        // Command "I?0\r"   --> read page 0 of the table
+        case 'I':
+            return control_id_stats(channel, buf);
+
+        // ----------------------------
+
+        // Cyclic transmit scheduler (periods in s)
+        // Command "P0=10000,0,t12380102030405060708\r"      --> entry 0 sends the packet every 10 ms
+        // Command "P1=20000,5000,C0:0F,S7,t1238...\r"        --> rolling counter in byte 0 (bits 0F), 8 bit sum in byte 7
+        // Command "P0=0\r"                                   --> remove entry 0
+        // Command "PC\r"                                     --> remove all entries
+        case 'P':
+            return control_cyclic(channel, buf, len);
+
+        // ----------------------------
+
+        // Timed transmission at an absolute timestamp (decimal s, same time base as the Rx timestamps)
+        // Command "@?\r"                          --> return the current timestamp "+80512007\r"
+        // Command "@80600000,t12380102030405060708\r" --> send the packet when the timestamp reaches 80600000 s
+        case '@':
+            return control_timed(channel, buf, len);
+
+        // Transmission with time-to-live (decimal s)
+        // Command "~2000,t12380102030405060708\r" --> discard the packet if it could not be sent within 2 ms
+        // A discarded packet is reported with "m" + marker instead of "M" + marker if the Tx echo is enabled.
+        case '~':
+            return control_ttl(channel, buf, len);
+
+        // ----------------------------
+
+        // Set the transmit timeout in ms after which pending Tx packets that are not acknowledged are canceled.
+        // Command "W2000\r" --> cancel pending Tx packets after 2 seconds (default 500 ms, restored when the adapter is closed)
+        case 'W':
+        {
+            uint32_t timeout_ms;
+            int pos = 1;
+            if (!utils_parse_next_decimal(buf, &pos, 0, &timeout_ms)) // "W2000"
                 return FBK_InvalidParameter;
 
-            return can_enable_busload(channel, interval); // interval in 100 ms steps
+            return can_set_tx_timeout(channel, timeout_ms);
         }
 
         // ----------------------------
 
+        // Recovery from Bus Off (delays in ms). The default "K0" is restored when the adapter is closed.
+        // Command "K0\r"        --> restart the CAN controller immediately after Bus Off (default)
+        // Command "K1,100,8\r"  --> wait 100 ms before the first attempt, double the delay for each further attempt, maximum 8 attempts
+        // Command "K2\r"        --> do not recover alone, wait for "KR"
+        // Command "KR\r"        --> start the recovery now (required with "K2" or after the maximum attempts, adapter open)
+        // Each recovery is reported with "o" + statistics if the error report is enabled ("ME").
+        case 'K':
+            return control_bus_off(channel, buf);
+
+        // ----------------------------
+
         // Special ASCII commands.
         // These commands are by purpose somewhat longer than only 2 characters to avoid that they are executed accidentally.
         case '*':
@@ -464,50 +582,62 @@ eFeedback control_parse_str(uint8_t channel, char buf[], int len)
     FDCAN_TxHeaderTypeDef tx_header;
     uint8_t               tx_data[CAN_MAX_DATALEN];
 
+    e_Ret = control_parse_frame(channel, buf, len, (GLB_UserFlags[channel] & USR_TxEcho) > 0, &tx_header, tx_data);
+    if (e_Ret != FBK_Success)
+        return e_Ret;
+
+    return buf_store_tx_packet(channel, &tx_header, tx_data);
+}
+
+// Parse a transmit command ("t", "T", "r", "R", "d", "D", "b", "B") into tx_header and tx_data
+// parse_marker = true --> the command ends with the one-byte marker for the Tx echo
+eFeedback control_parse_frame(uint8_t channel, char buf[], int len, bool parse_marker, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
     // Set default header. All values overridden below as needed.
-    tx_header.TxFrameType         = FDCAN_DATA_FRAME;
-    tx_header.FDFormat            = FDCAN_CLASSIC_CAN;
-    tx_header.IdType              = FDCAN_STANDARD_ID;
-    tx_header.BitRateSwitch       = FDCAN_BRS_OFF;
-    tx_header.ErrorStateIndicator = can_is_passive(channel) ? FDCAN_ESI_PASSIVE : FDCAN_ESI_ACTIVE;
-    tx_header.TxEventFifoControl  = FDCAN_STORE_TX_EVENTS; // always! Tx Event flashes the Tx LED
+    tx_header->TxFrameType         = FDCAN_DATA_FRAME;
+    tx_header->FDFormat            = FDCAN_CLASSIC_CAN;
+    tx_header->IdType              = FDCAN_STANDARD_ID;
+    tx_header->BitRateSwitch       = FDCAN_BRS_OFF;
+    tx_header->ErrorStateIndicator = can_is_passive(channel) ? FDCAN_ESI_PASSIVE : FDCAN_ESI_ACTIVE;
+    tx_header->TxEventFifoControl  = FDCAN_STORE_TX_EVENTS; // always! Tx Event flashes the Tx LED
+    tx_header->MessageMarker       = 0;
 
     switch (buf[0])
     {
         // Transmit remote frame command
         case 'r':
-            tx_header.TxFrameType   = FDCAN_REMOTE_FRAME;
+            tx_header->TxFrameType   = FDCAN_REMOTE_FRAME;
             break;
         case 'R':
-            tx_header.IdType        = FDCAN_EXTENDED_ID;
-            tx_header.TxFrameType   = FDCAN_REMOTE_FRAME;
+            tx_header->IdType        = FDCAN_EXTENDED_ID;
+            tx_header->TxFrameType   = FDCAN_REMOTE_FRAME;
             break;
 
         // Transmit data frame command
         case 'T':
-            tx_header.IdType        = FDCAN_EXTENDED_ID;
+            tx_header->IdType        = FDCAN_EXTENDED_ID;
             break;
         case 't':
             break;
 
         // CANFD transmit - no BRS
         case 'd':
-            tx_header.FDFormat      = FDCAN_FD_CAN;
+            tx_header->FDFormat      = FDCAN_FD_CAN;
             break;
         case 'D':
-            tx_header.FDFormat      = FDCAN_FD_CAN;
-            tx_header.IdType        = FDCAN_EXTENDED_ID;
+            tx_header->FDFormat      = FDCAN_FD_CAN;
+            tx_header->IdType        = FDCAN_EXTENDED_ID;
             break;
 
         // CANFD transmit - with BRS
         case 'b':
-            tx_header.FDFormat      = FDCAN_FD_CAN;
-            tx_header.BitRateSwitch = FDCAN_BRS_ON;
+            tx_header->FDFormat      = FDCAN_FD_CAN;
+            tx_header->BitRateSwitch = FDCAN_BRS_ON;
             break;
         case 'B':
-            tx_header.FDFormat      = FDCAN_FD_CAN;
-            tx_header.BitRateSwitch = FDCAN_BRS_ON;
-            tx_header.IdType        = FDCAN_EXTENDED_ID;
+            tx_header->FDFormat      = FDCAN_FD_CAN;
+            tx_header->BitRateSwitch = FDCAN_BRS_ON;
+            tx_header->IdType        = FDCAN_EXTENDED_ID;
             break;
 
         // Invalid command
@@ -517,24 +647,24 @@ eFeedback control_parse_str(uint8_t channel, char buf[], int len)
 
     // Sending a message with FDF flag requires a data baudrate to be set.
     // It is allowed that the data baudrate is the same as the nominal baudrate to send messages up to 64 bytes without BRS.
-    if (tx_header.FDFormat == FDCAN_FD_CAN && !can_using_FD(channel))
+    if (tx_header->FDFormat == FDCAN_FD_CAN && !can_using_FD(channel))
         return FBK_BaudrateNotSet;
 
     // Start parsing at second byte (skip command byte)
     int parse_loc = 1;
 
     // standard ID / extended ID
-    uint8_t id_len = (tx_header.IdType == FDCAN_EXTENDED_ID) ? 8 : 3;
+    uint8_t id_len = (tx_header->IdType == FDCAN_EXTENDED_ID) ? 8 : 3;
 
     // parse CAN ID
-    if (!utils_parse_hex_value(buf, &parse_loc, id_len, &tx_header.Identifier))
+    if (!utils_parse_hex_value(buf, &parse_loc, id_len, &tx_header->Identifier))
         return FBK_InvalidParameter;
 
     // check CAN ID
-    if (tx_header.IdType == FDCAN_STANDARD_ID && tx_header.Identifier > 0x7FF)
+    if (tx_header->IdType == FDCAN_STANDARD_ID && tx_header->Identifier > 0x7FF)
         return FBK_ParamOutOfRange;
 
-    if (tx_header.IdType == FDCAN_EXTENDED_ID && tx_header.Identifier > 0x1FFFFFFF)
+    if (tx_header->IdType == FDCAN_EXTENDED_ID && tx_header->Identifier > 0x1FFFFFFF)
         return FBK_ParamOutOfRange;
 
     // parse DLC
@@ -543,13 +673,13 @@ eFeedback control_parse_str(uint8_t channel, char buf[], int len)
         return FBK_InvalidParameter;
 
     // classic frames allow a DLC of 0...8
-    if (tx_header.FDFormat == FDCAN_CLASSIC_CAN && dlc_code > 8)
+    if (tx_header->FDFormat == FDCAN_CLASSIC_CAN && dlc_code > 8)
         return FBK_InvalidParameter;
 
-    tx_header.DataLength = dlc_code;
+    tx_header->DataLength = dlc_code;
 
     // remote frames may have DLC > 0 but never send data bytes
-    if (tx_header.TxFrameType != FDCAN_REMOTE_FRAME)
+    if (tx_header->TxFrameType != FDCAN_REMOTE_FRAME)
     {
         int8_t byte_count = utils_dlc_to_byte_count(dlc_code);
         // Parse data bytes
@@ -566,9 +696,9 @@ eFeedback control_parse_str(uint8_t channel, char buf[], int len)
     // The host must generate a unique one-byte marker for each sent packet using a counter that increments with each Tx message.
     // The Tx FIFO can store 3 packets and the buffer can store 64 waiting messages.
     // So 3 + 64 different values are sufficient that each message that is waiting for an ACK has it's own unique marker.
-    if (GLB_UserFlags[channel] & USR_TxEcho)
+    if (parse_marker)
     {
-        if (!utils_parse_hex_value(buf, &parse_loc, 2, &tx_header.MessageMarker))
+        if (!utils_parse_hex_value(buf, &parse_loc, 2, &tx_header->MessageMarker))
             return FBK_InvalidParameter;
     }
 
@@ -576,7 +706,7 @@ eFeedback control_parse_str(uint8_t channel, char buf[], int len)
     if (parse_loc != len)
         return FBK_InvalidParameter;
 
-    return buf_store_tx_packet(channel, &tx_header, tx_data);
+    return FBK_Success;
 }
 
 // ================================================================================================================
@@ -673,7 +803,37 @@ eFeedback control_host_filter(uint8_t channel, char buf[])
         else if (digitsF == 8 && digitsM == 8) extended = true;
         else return FBK_InvalidParameter;
 
-        eFeedback error = can_add_host_filter(channel, extended, filter, mask);
+        eFeedback error = can_add_host_filter(channel, extended, filter, mask, false);
+        if (error != FBK_Success)
+            return error;
+    }
+    return FBK_Success;
+}
+
+// Command: "F=7E8;7E9;18DAF110\r" --> add the 11 bit IDs 0x7E8, 0x7E9 and the 29 bit ID 0x18DAF110 to the host ID list.
+// The command can be sent multiple times to add more IDs. "f\r" clears the list.
+// see comment for can_add_host_id()
+eFeedback control_host_id_list(uint8_t channel, char buf[])
+{
+    int pos = 2;
+    bool abort = false;
+    while (!abort)
+    {
+        uint32_t ID;
+        int digits;
+        if (!utils_parse_hex_delimiter(buf, &pos, ';', &digits, &ID))
+        {
+            if (buf[pos] != 0) return FBK_InvalidParameter; // invalid character
+            if (digits == 0) break; // string zero termination found after semicolon
+            abort = true;           // string zero termination found after ID
+        }
+
+        bool extended;
+             if (digits == 3) extended = false;
+        else if (digits == 8) extended = true;
+        else return FBK_InvalidParameter;
+
+        eFeedback error = can_add_host_id(channel, extended, ID);
         if (error != FBK_Success)
             return error;
     }
@@ -730,6 +890,332 @@ eFeedback control_bridge_filter(uint8_t channel, char buf[], bool enable)
     return can_set_bridge_filter(channel, dest_channel, filter_index, enable, extended, block, filter, mask);
 }
 
+// "F:T7E0=7E8\r"           forward CAN ID 7E0 with the ID 7E8 to the bridge channel(s)
+// "F:T7E0=18DAF110\r"      forward the 11 bit CAN ID 7E0 with the 29 bit ID 18DAF110
+// "F:T7E0=7E8:FF00FFFFFFFFFFFF,0012000000000000,0000000000000080\r"
+//                          additionally modify data bytes 0...7: data = ((data & keep) | (replace & ~keep)) ^ xor
+//                          --> replace byte 1 with 0x12 and invert the highest bit of byte 7
+// "f:T\r"                 clear all bridge translations
+eFeedback control_bridge_translation(uint8_t channel, char buf[])
+{
+    int pos = 3;
+    int digitsS, digitsD;
+    uint32_t src_id, dest_id;
+    if (!utils_parse_hex_delimiter(buf, &pos, '=', &digitsS, &src_id))
+        return FBK_InvalidParameter;
+
+    bool modify = utils_parse_hex_delimiter(buf, &pos, ':', &digitsD, &dest_id);
+    if (!modify && buf[pos] != 0)
+        return FBK_InvalidParameter; // invalid character
+
+    if ((digitsS != 3 && digitsS != 8) || (digitsD != 3 && digitsD != 8))
+        return FBK_InvalidParameter;
+
+    // keep, replace, xor
+    uint8_t masks[3][8];
+    if (modify)
+    {
+        for (int M=0; M<3; M++)
+        {
+            for (int B=0; B<8; B++)
+            {
+                uint32_t byte;
+                if (!utils_parse_hex_value(buf, &pos, 2, &byte))
+                    return FBK_InvalidParameter; // syntax error or invalid digit count
+
+                masks[M][B] = (uint8_t)byte;
+            }
+            if (buf[pos++] != (M < 2 ? ',' : 0))
+                return FBK_InvalidParameter;
+        }
+    }
+
+    return can_set_bridge_translation(channel, digitsS == 8, src_id, digitsD == 8, dest_id,
+                                      modify ? masks[0] : NULL, modify ? masks[1] : NULL, modify ? masks[2] : NULL);
+}
+
+// Rate limits of forwarded packets (decimal values): rate = packets per second (0 = unlimited), burst = max packets at once
+// "F:R7E0=100,5\r"   forward max 100 packets per second with CAN ID 7E0 from this channel, max 5 at once
+// "F:R>1=500,20\r"   forward max 500 packets per second from all other channels to channel 1, max 20 at once
+// "F:R>1=500,20,L\r" additionally a forwarded packet replaces a pending packet with the same CAN ID in the Tx buffer of channel 1
+// "F:R>1=0\r"        turn off the rate limit of channel 1
+eFeedback control_bridge_limit(uint8_t channel, char buf[])
+{
+    int pos = 3;
+    bool dest = buf[pos] == '>';
+    int  digits = 0;
+    uint32_t ID = 0;
+    if (dest)
+    {
+        pos ++;
+        if (!utils_parse_hex_value(buf, &pos, 1, &ID) || ID >= CHANNEL_COUNT || buf[pos++] != '=')
+            return FBK_InvalidParameter;
+    }
+    else
+    {
+        if (!utils_parse_hex_delimiter(buf, &pos, '=', &digits, &ID) || (digits != 3 && digits != 8))
+            return FBK_InvalidParameter;
+    }
+
+    uint32_t rate;
+    uint32_t burst = 0;
+    bool latest_wins = false;
+    if (!utils_parse_next_decimal(buf, &pos, 0, &rate))
+    {
+        if (!utils_parse_next_decimal(buf, &pos, ',', &rate))
+            return FBK_InvalidParameter;
+
+        if (!utils_parse_next_decimal(buf, &pos, 0, &burst))
+        {
+            if (!dest || !utils_parse_next_decimal(buf, &pos, ',', &burst) || buf[pos] != 'L' || buf[pos + 1] != 0)
+                return FBK_InvalidParameter;
+
+            latest_wins = true;
+        }
+    }
+
+    if (dest)
+        return can_set_bridge_dest_limit((uint8_t)ID, rate, burst, latest_wins);
+    else
+        return can_set_bridge_id_limit(channel, digits == 8, ID, rate, burst);
+}
+
+// "F:U7FF=500\r"      enable the tunnel on this channel with tunnel CAN ID 7FF and a latency window of 500 s (decimal)
+// "F:U18FFFF00=0\r"   enable the tunnel with a 29 bit tunnel CAN ID, each classic frame is sent immediately
+// "f:U\r"             disable the tunnel
+eFeedback control_tunnel(uint8_t channel, char buf[])
+{
+    int pos = 3;
+    int digits;
+    uint32_t tunnel_id, window;
+    if (!utils_parse_hex_delimiter(buf, &pos, '=', &digits, &tunnel_id) || (digits != 3 && digits != 8))
+        return FBK_InvalidParameter;
+
+    if (!utils_parse_next_decimal(buf, &pos, 0, &window))
+        return FBK_InvalidParameter;
+
+    return can_set_tunnel(channel, true, digits == 8, tunnel_id, window);
+}
+
+// "I?0\r" reads page 0 of the per-ID statistics (ID_STATS_PAGE_SIZE entries per page)
+// --> "+I2,0\t7E8,1502,8,9985,10000,10021,80512007\t18DAF110,3,8,0,0,0,80499351\r"
+// total count of IDs, frames lost because the table was full, then for each ID:
+// CAN ID (3 or 8 hex digits), frame count, last DLC, min / mean / max period in s, last timestamp in s
+eFeedback control_id_stats(uint8_t channel, char buf[])
+{
+    if (buf[1] == 'C' && buf[2] == 0)
+        return can_clear_id_stats(channel); // "IC"
+
+    int pos = 2;
+    uint32_t value;
+    if (buf[1] == '?') // "I?0"
+    {
+        if (!utils_parse_next_decimal(buf, &pos, 0, &value))
+            return FBK_InvalidParameter;
+
+        // static: the stack is small
+        // "+I" + 2 x 10 digits + 1 comma, each entry: tab + 8 hex digits + 6 commas + 5 x 10 digits + 2 digits DLC
+        static char resp[23 + ID_STATS_PAGE_SIZE * 67 + 1];
+
+        uint32_t slot, total, lost;
+        eFeedback e_Ret = can_get_id_stats(channel, value, &slot, &total, &lost);
+        if (e_Ret != FBK_Success)
+            return e_Ret;
+
+        int len = sprintf(resp, "+I%lu,%lu", total, lost);
+        id_stat_entry entry;
+        for (int i=0; i<ID_STATS_PAGE_SIZE && can_next_id_stat_entry(channel, &slot, &entry); i++)
+        {
+            uint32_t mean = (entry.count > 1) ? (uint32_t)(entry.sum_period / (entry.count - 1)) : 0;
+            uint32_t min  = (entry.count > 1) ? entry.min_period : 0;
+
+            if (entry.key & BRG_KEY_29BIT) len += sprintf(resp + len, "\t%08lX", entry.key & ~BRG_KEY_29BIT);
+            else                           len += sprintf(resp + len, "\t%03lX", entry.key);
+
+            len += sprintf(resp + len, ",%lu,%u,%lu,%lu,%lu,%lu", entry.count, entry.last_dlc, min, mean, entry.max_period, entry.last_stamp);
+        }
+        resp[len++] = '\r';
+
+        buf_enqueue_cdc(channel, resp, len);
+        return FBK_RetString;
+    }
+
+    if (buf[1] < '0' || buf[1] > '9')
+        return FBK_InvalidParameter;
+
+    pos = 1;
+    if (utils_parse_next_decimal(buf, &pos, 0, &value)) // "I100"
+        return can_set_id_stats(channel, value, true);
+
+    if (utils_parse_next_decimal(buf, &pos, 'N', &value) && buf[pos] == 0) // "I100N"
+        return can_set_id_stats(channel, value, false);
+
+    return FBK_InvalidParameter;
+}
+
+// "P0=10000,0,t12380102030405060708\r" sends the packet with CAN ID 123 every 10000 s, the first one immediately (decimal values)
+// "P1=20000,5000,C0:0F,S7,t1238...\r" period 20000 s, the first packet 5000 s after opening the adapter or setting the entry.
+//                                     The bits 0F of data byte 0 are a rolling counter, data byte 7 is the 8 bit sum of all other bytes.
+// "P1=20000,5000,X7,t1238...\r"       data byte 7 is the XOR of all other bytes
+// "P0=0\r"                            remove entry 0
+// "PC\r"                              remove all entries
+// The packet is any transmit command ("t", "T", "r", "R", "d", "D", "b", "B") without a Tx echo marker.
+eFeedback control_cyclic(uint8_t channel, char buf[], int len)
+{
+    if (buf[1] == 'C' && buf[2] == 0)
+        return can_clear_cyclic(channel); // "PC"
+
+    int pos = 1;
+    uint32_t index, period, phase;
+    if (!utils_parse_next_decimal(buf, &pos, '=', &index) || index > 0xFF)
+        return FBK_InvalidParameter;
+
+    if (utils_parse_next_decimal(buf, &pos, 0, &period)) // "P0=0"
+    {
+        if (period > 0)
+            return FBK_InvalidParameter;
+
+        return can_set_cyclic(channel, index, NULL, NULL, 0, 0, CYC_NONE, 0, CYC_NONE, false);
+    }
+
+    if (!utils_parse_next_decimal(buf, &pos, ',', &period) ||
+        !utils_parse_next_decimal(buf, &pos, ',', &phase))
+        return FBK_InvalidParameter;
+
+    uint32_t counter_byte  = CYC_NONE;
+    uint32_t counter_mask  = 0;
+    uint32_t checksum_byte = CYC_NONE;
+    bool     checksum_xor  = false;
+    while (true)
+    {
+        char option = buf[pos];
+        if (option == 'C') // "C0:0F,"
+        {
+            pos ++;
+            if (!utils_parse_next_decimal(buf, &pos, ':', &counter_byte) || counter_byte >= CAN_MAX_DATALEN ||
+                !utils_parse_hex_value(buf, &pos, 2, &counter_mask) || buf[pos++] != ',')
+                return FBK_InvalidParameter;
+        }
+        else if (option == 'S' || option == 'X') // "S7," or "X7,"
+        {
+            pos ++;
+            if (!utils_parse_next_decimal(buf, &pos, ',', &checksum_byte) || checksum_byte >= CAN_MAX_DATALEN)
+                return FBK_InvalidParameter;
+
+            checksum_xor = option == 'X';
+        }
+        else break;
+    }
+
+    FDCAN_TxHeaderTypeDef tx_header;
+    uint8_t               tx_data[CAN_MAX_DATALEN];
+
+    eFeedback e_Ret = control_parse_frame(channel, buf + pos, len - pos, false, &tx_header, tx_data);
+    if (e_Ret != FBK_Success)
+        return e_Ret;
+
+    return can_set_cyclic(channel, index, &tx_header, tx_data, period, phase, counter_byte, counter_mask, checksum_byte, checksum_xor);
+}
+
+// "@?" returns the current timestamp
+// "@<time>,<frame>" sends the frame at the timestamp <time> in s. The frame has the same syntax as the transmit commands.
+eFeedback control_timed(uint8_t channel, char buf[], int len)
+{
+    if (buf[1] == '?' && buf[2] == 0)
+    {
+        char resp[16];
+        int  resp_len = sprintf(resp, "+%lu\r", system_get_timestamp());
+        buf_enqueue_cdc(channel, resp, resp_len);
+        return FBK_RetString;
+    }
+
+    int pos = 1;
+    uint32_t send_time;
+    if (!utils_parse_next_decimal(buf, &pos, ',', &send_time))
+        return FBK_InvalidParameter;
+
+    FDCAN_TxHeaderTypeDef tx_header;
+    uint8_t               tx_data[CAN_MAX_DATALEN];
+
+    eFeedback e_Ret = control_parse_frame(channel, buf + pos, len - pos, (GLB_UserFlags[channel] & USR_TxEcho) > 0, &tx_header, tx_data);
+    if (e_Ret != FBK_Success)
+        return e_Ret;
+
+    return can_send_timed(channel, &tx_header, tx_data, send_time);
+}
+
+// "~<ttl>,<frame>" discards the frame if it is still in the Tx queue after <ttl> s. The frame has the same syntax as the transmit commands.
+eFeedback control_ttl(uint8_t channel, char buf[], int len)
+{
+    int pos = 1;
+    uint32_t ttl;
+    if (!utils_parse_next_decimal(buf, &pos, ',', &ttl) || ttl == 0)
+        return FBK_InvalidParameter;
+    if (ttl > 0x7FFFFFFF) // the expiry is checked with a signed difference of timestamps
+        return FBK_ParamOutOfRange;
+
+    FDCAN_TxHeaderTypeDef tx_header;
+    uint8_t               tx_data[CAN_MAX_DATALEN];
+
+    eFeedback e_Ret = control_parse_frame(channel, buf + pos, len - pos, (GLB_UserFlags[channel] & USR_TxEcho) > 0, &tx_header, tx_data);
+    if (e_Ret != FBK_Success)
+        return e_Ret;
+
+    return buf_store_tx_packet_ttl(channel, &tx_header, tx_data, ttl);
+}
+
+// "K1,100,8" --> policy BOFF_Backoff, base delay 100 ms, maximum 8 attempts
+// "K0,3"     --> policy BOFF_Immediate, maximum 3 attempts
+// "KR"       --> start the recovery now
+eFeedback control_bus_off(uint8_t channel, char buf[])
+{
+    if (buf[1] == 'R')
+    {
+        if (buf[2] != 0)
+            return FBK_InvalidParameter;
+
+        return can_restart_bus_off(channel);
+    }
+
+    if (buf[1] == 0)
+        return FBK_InvalidParameter;
+
+    // parse up to 3 comma separated values: "1,100,8"
+    uint32_t values[3] = { 0, 0, 0 };
+    int count = 0;
+    int pos   = 1;
+    while (true)
+    {
+        if (count >= 3)
+            return FBK_InvalidParameter;
+
+        if (utils_parse_next_decimal(buf, &pos, ',', &values[count]))
+        {
+            count ++;
+            continue;
+        }
+        if (!utils_parse_next_decimal(buf, &pos, 0, &values[count]))
+            return FBK_InvalidParameter;
+
+        count ++;
+        break;
+    }
+
+    eBusOffPolicy policy = (eBusOffPolicy)values[0];
+    if (policy == BOFF_Backoff)
+    {
+        if (count < 2) // the base delay is required
+            return FBK_InvalidParameter;
+
+        return can_set_bus_off_policy(channel, policy, values[1], values[2]);
+    }
+
+    if (count > 2) // no base delay for "K0" and "K2"
+        return FBK_InvalidParameter;
+
+    return can_set_bus_off_policy(channel, policy, 0, values[1]);
+}
+
 // "*Flash:1A=48656C6C6F\r" writes "Hello" to   flash segment 1A
 // "*Flash:1A?\r"           reads  "Hello" from flash segment 1A --> return "+48656C6C6F\r"
 eFeedback control_parse_flash(uint8_t channel, char buf[])
@@ -796,9 +1282,18 @@ eFeedback control_parse_flash(uint8_t channel, char buf[])
 // if the error state did not change, report the same state only every 3000 ms.
 void control_process(uint8_t channel, uint32_t tick_now)
 {
-    if (!error_is_report_due(channel, tick_now))
-        return;
+    if (error_is_report_due(channel, tick_now))
+        control_report_error_state(channel);
+
+    // Revover BusOff AFTER printing error BusOff to the Trace output!
+    // This must run in each pass for the back-off delay of BOFF_Backoff.
+    can_recover_bus_off(channel);
+}
 
+// send the error state to the host
+// "E21000000\r" = bus status + last protocol error, app flags, Tx error counter, Rx error counter (all hex)
+void control_report_error_state(uint8_t channel)
+{
     // get errors that are still present after the last error_clear()
     kCanErrorState* state = error_get_state(channel);
 
@@ -810,9 +1305,6 @@ void control_process(uint8_t channel, uint32_t tick_now)
                                             (uint8_t)state->rx_err_count);
     buf_enqueue_cdc(channel, tempbuf, 10);
     error_clear(channel);
-
-    // Revover BusOff AFTER printing error BusOff to the Trace output!
-    can_recover_bus_off(channel);
 }
 
 // send the busload in percet to the host in the user defined interval
@@ -823,6 +1315,52 @@ void control_report_busload(uint8_t channel, uint8_t busload_percent)
     buf_enqueue_cdc(channel, buf, strlen(buf));
 }
 
+// send the busload statistics of 1 ms windows in the user defined interval
+// "L31,92,4,120,311,250,130,70,50,40,20,6,3\r" = average, peak, minimum, count of windows with 0...9%, 10...19%,... 90...100%
+void control_report_busload_stats(uint8_t channel, uint8_t busload_percent, uint8_t peak, uint8_t minimum, uint16_t* histogram)
+{
+    char buf[80];
+    int len = sprintf(buf, "L%u,%u,%u", busload_percent, peak, minimum);
+    for (int i=0; i<BUSLOAD_HISTO_COUNT; i++)
+    {
+        len += sprintf(buf + len, ",%u", histogram[i]);
+    }
+    buf[len++] = '\r';
+    buf_enqueue_cdc(channel, buf, len);
+}
+
+// send one protocol error that has been stored by the FDCAN interrupt (USR_ErrorLog)
+// "e0012D687030800\r" = timestamp in s, code (0x03 = ACK error, + 0x80 in the data phase), Tx error counter, Rx error counter (all hex)
+void control_report_error_event(uint8_t channel, uint32_t timestamp, uint8_t code, uint8_t tx_err_count, uint8_t rx_err_count)
+{
+    char buf[20];
+    sprintf(buf, "e%08lX%02X%02X%02X\r", timestamp, code, tx_err_count, rx_err_count);
+    buf_enqueue_cdc(channel, buf, 16);
+}
+
+// send the count of protocol errors per type every second if they have changed (USR_ErrorLog)
+// "c0,0,8450,0,0,0,8280\r" = stuff, form, ACK, bit 1, bit 0, CRC errors, errors not sent because of the rate limit
+void control_report_error_counters(uint8_t channel, uint32_t* counts, uint32_t suppressed)
+{
+    char buf[90];
+    int len = sprintf(buf, "c%lu", counts[0]);
+    for (int i=1; i<ERR_LOG_TYPES; i++)
+    {
+        len += sprintf(buf + len, ",%lu", counts[i]);
+    }
+    len += sprintf(buf + len, ",%lu\r", suppressed);
+    buf_enqueue_cdc(channel, buf, len);
+}
+
+// send the statistics of the recovery from Bus Off after each recovery and when the firmware starts waiting for "KR"
+// "o0,2,5,215,12,430\r" = waiting for "KR", attempts, Bus Off count, last, minimum, maximum recovery time in ms
+void control_report_bus_off_stats(uint8_t channel, bool waiting, uint32_t attempts, uint32_t bus_off_count, uint32_t last_ms, uint32_t min_ms, uint32_t max_ms)
+{
+    char buf[70];
+    int len = sprintf(buf, "o%u,%lu,%lu,%lu,%lu,%lu\r", waiting ? 1 : 0, attempts, bus_off_count, last_ms, min_ms, max_ms);
+    buf_enqueue_cdc(channel, buf, len);
+}
+
 // Send a debug message. Maximum length is 80 characters.
 // The message may contain "\n" for multi-line output
 // You will see this message in the Trace pane of HUD ECU Hacker if USR_DebugReport is enabled.
@@ -43,6 +43,10 @@ void control_init();
 void control_parse_command(char* buf, int len);
 void control_process(uint8_t channel, uint32_t tick_now);
 void control_report_busload(uint8_t channel, uint8_t busload_percent);
+void control_report_busload_stats(uint8_t channel, uint8_t busload_percent, uint8_t peak, uint8_t minimum, uint16_t* histogram);
+void control_report_error_event(uint8_t channel, uint32_t timestamp, uint8_t code, uint8_t tx_err_count, uint8_t rx_err_count);
+void control_report_error_counters(uint8_t channel, uint32_t* counts, uint32_t suppressed);
+void control_report_bus_off_stats(uint8_t channel, bool waiting, uint32_t attempts, uint32_t bus_off_count, uint32_t last_ms, uint32_t min_ms, uint32_t max_ms);
 bool control_send_debug_mesg(uint8_t channel, const char* message);
 
 
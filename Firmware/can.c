@@ -14,7 +14,37 @@
 #include "system.h"
 
 #define SECOND_SAMPL_POINT_PERCENT     50  // Secondary Sample Point at 50% of data bit for TDC compensation
-#define CAN_TX_TIMEOUT                500  // after 500 ms cancel pending Tx requests --> clear FIFO and packet buffer
+#define CAN_TX_TIMEOUT                500  // default: after 500 ms cancel pending Tx requests --> clear FIFO and packet buffer (see can_set_tx_timeout())
+#define CAN_MAX_FRAMES_PER_PASS         8  // maximum count of packets read from each FIFO in one pass of can_process() so USB is not starved
+#define CAN_ELEMENT_SIZE          (18 * 4)  // Rx FIFO and Tx FIFO elements in the message RAM (SRAMCAN_RF0_SIZE is defined in a *c file by ST)
+#define STUFFING_FACTOR          1125  // estimated stuff bits for the bus load: +12.5% (see can_timer_100ms())
+#define CYC_MIN_PERIOD            100  // shortest period of a cyclic packet in s
+
+// Count of 32 bit words in the payload of a message RAM element for DLC 0 ... 15
+static const uint8_t DLC_TO_WORDS[16] = { 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 4, 5, 6, 8, 12, 16 };
+
+// Multiplicative hash (Knuth) of a CAN ID --> slot in a hash set with 2 ^ bits slots
+static inline uint32_t can_hash_id(uint32_t ID, int bits)
+{
+    return (ID * 2654435761u) >> (32 - bits);
+}
+
+// Exact bus load: bit stream of a frame between SOF and CRC (see can_calc_exact_bit_count())
+typedef struct
+{
+    uint32_t state;       // stuffing state: bit 3 = level of the last bit, bit 0...2 = count of consecutive bits with this level
+    uint32_t stuff_count; // count of dynamic stuff bits
+    uint32_t stuff_last;  // 1 if a stuff bit follows the last bit
+    uint32_t crc;         // CRC-15 of a classic frame
+} can_bit_stream;
+
+// Lookup tables that process 4 bits at once, filled in can_init_stuff_tables()
+// stuff_table entry: bits 0...3 = new state, bit 4 = a stuff bit was inserted, bit 5 = the stuff bit follows the 4th bit
+static uint8_t  stuff_table[16][16];
+static uint16_t crc15_table[16];
+
+// Sorted copy of the 29 bit IDs in id_list_ext, used only while compiling the host ID list in can_open()
+static uint32_t id_sort_buf[ID_LIST_EXT_MAX];
 
 // ----- Globals
 eUserFlags           GLB_UserFlags[CHANNEL_COUNT];
@@ -33,15 +63,62 @@ can_class            can_inst[CHANNEL_COUNT] = {0};
 // ----- Private Methods
 void      can_reset(uint8_t channel);
 void      can_print_info(uint8_t channel);
-bool      can_apply_host_filters(can_class* inst);
+bool      can_apply_host_filters(can_class* inst, bool apply);
+bool      can_add_filter_element(can_class* inst, FDCAN_FilterTypeDef* element, bool apply);
+void      can_select_rx_fifo_mode(can_class* inst, uint8_t channel);
+bool      can_needs_all_packets(can_class* inst);
+bool      can_has_pass_filters(can_class* inst);
+bool      can_is_accepted(can_class* inst, rx_packet* packet);
+bool      can_is_in_host_id_list(can_class* inst, FDCAN_RxHeaderTypeDef* header);
+void      can_compile_host_id_list(can_class* inst, bool extended);
+int       can_make_id_list_elements(can_class* inst, bool extended, uint32_t max_gap, bool apply, uint32_t* false_pos);
+bool      can_get_next_list_id(can_class* inst, bool extended, uint32_t* index, uint32_t* ID);
 uint32_t  can_calc_bit_count_in_frame(can_class* inst, uint32_t DataLength, uint32_t FrameType, uint32_t IdType, uint32_t FDFormat, uint32_t BitRateSwitch);
+uint32_t  can_calc_exact_bit_count(can_class* inst, uint32_t Identifier, uint32_t IdType, uint32_t FrameType, uint32_t DataLength, 
+                                   uint32_t FDFormat, uint32_t BitRateSwitch, uint32_t ErrorStateIndicator, uint8_t* data);
+uint32_t  can_convert_data_bits(can_class* inst, uint32_t data_bits, uint32_t BitRateSwitch);
+void      can_init_stuff_tables();
+void      can_stream_bits (can_bit_stream* stream, uint32_t value, int count);
+void      can_stream_bytes(can_bit_stream* stream, uint8_t* data, int count);
+void      can_close_load_window(can_class* inst);
+void      can_reset_load_stats(can_class* inst);
+void      can_update_id_stats(can_class* inst, FDCAN_RxHeaderTypeDef* header);
+void      can_erase_id_stats(can_class* inst);
+void      can_send_cyclic(uint8_t channel, cyc_entry* entry);
+bool      can_send_scheduled(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
 void      can_forward_bridge_packet(can_class* inst, FDCAN_RxHeaderTypeDef* rx_header, uint8_t* rx_data);
+void      can_compile_bridge_routes(can_class* inst);
+uint8_t   can_get_bridge_route(can_class* inst, bool extended, uint32_t ID);
+brg_translation* can_find_bridge_translation(can_class* inst, uint32_t key);
+brg_translation* can_add_bridge_translation (can_class* inst, uint32_t key);
+bool      can_take_bucket_token(brg_bucket* bucket, uint32_t tick_now);
+void      can_init_bucket(brg_bucket* bucket, uint32_t rate, uint32_t burst);
+bool      can_is_tunnel_frame(can_class* inst, FDCAN_RxHeaderTypeDef* rx_header);
+void      can_tunnel_receive(can_class* inst, FDCAN_RxHeaderTypeDef* rx_header, uint8_t* rx_data);
+void      can_tunnel_pack(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
+void      can_tunnel_flush(uint8_t channel);
+void      can_tunnel_split(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
+void      can_tunnel_send(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
+bool      can_forward_direct(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time);
+void      can_print_bridge_latency(uint8_t channel);
+void      can_reset_bridge_latency(can_class* inst);
+void      can_read_rx_fifos(can_class* inst);
+void      can_read_rx_fifo(can_class* inst, uint32_t rx_fifo);
+void      can_read_rx_merged(can_class* inst);
+bool      can_store_rx_element(can_class* inst, uint32_t rx_fifo);
+bool      can_check_fifo_lost(can_class* inst, uint32_t rx_fifo);
+void      can_latch_status(can_class* inst);
+void      can_log_proto_error(can_class* inst, uint8_t code, bool data_phase);
+void      can_report_bus_off_stats(uint8_t channel, bool waiting);
+bool      can_read_rx_element(can_class* inst, uint32_t rx_fifo, rx_packet* packet);
+bool      can_write_tx_element(can_class* inst, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
 
 // Initialize CAN peripheral settings, but don't actually start the peripheral
 // called from the main loop
 void can_init()
 {
     __HAL_RCC_FDCAN_CLK_ENABLE();
+    can_init_stuff_tables();
 
     GPIO_InitTypeDef GPIO_InitStruct;
     for (int C=0; C<CHANNEL_COUNT; C++)
@@ -68,6 +145,19 @@ void can_init()
         can_inst[C].handle.Instance = SET_CanInterfaces[C];
     }
 
+    // Interrupt line 0 of the FDCAN instances (Rx FIFO's and Tx complete)
+    // Timer 16 and FDCAN line 0 share the same interrupt on the STM32G0xx serie.
+    // G4 serie: FDCAN1_IT0_IRQn      -> FDCAN1_IT0_IRQHandler      -> HAL_FDCAN_IRQHandler
+    // G0 serie: TIM16_FDCAN_IT0_IRQn -> TIM16_FDCAN_IT0_IRQHandler -> HAL_FDCAN_IRQHandler
+    HAL_NVIC_SetPriority(FDCAN1_IT0_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ  (FDCAN1_IT0_IRQn);
+
+#if CHANNEL_COUNT > 1 && defined(STM32G4xx)
+    // On the G4 serie each FDCAN instance has it's own interrupt.
+    HAL_NVIC_SetPriority(FDCAN2_IT0_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ  (FDCAN2_IT0_IRQn);
+#endif
+
 #if defined(CAN_TRX_ENABLE_PIN)
     // Enable the CAN transceiver chip, if required by the board (WeActStudio v2)
     GPIO_InitStruct.Pin       = CAN_TRX_ENABLE_PIN;
@@ -89,14 +179,31 @@ void can_reset(uint8_t channel)
 
     inst->bitrate_nominal.Brp = 0; // invalid = baudrate not set
     inst->bitrate_data   .Brp = 0;
-    inst->std_filter_count    = 0;
-    inst->ext_filter_count    = 0;
     inst->busload_interval    = 0;
+    inst->busload_exact       = false;
+    inst->busload_windowed    = false;
+    inst->tx_timeout          = CAN_TX_TIMEOUT;
+    inst->boff_policy         = BOFF_Immediate;
+    inst->boff_base_delay     = BOFF_DEFAULT_DELAY;
+    inst->boff_max_attempts   = 0;
     inst->tx_pending          = 0;
     inst->is_open             = false;
 
-    // clear all bridge filters
+    // clear all host filters and the host ID list (is_open is false here)
+    can_clear_host_filters(channel);
+
+    // clear all bridge filters and translations
     can_set_bridge_filter(channel, 0, 0xFF, false, false, false, 0, 0);
+    can_clear_bridge_translations(channel);
+    can_set_bridge_dest_limit(channel, 0, 0, false);
+    can_set_tunnel(channel, false, false, 0, 0);
+    can_set_id_stats(channel, 0, true);
+    can_clear_cyclic(channel);
+
+    // discard timed packets that have not been sent yet
+    system_disable_irq();
+    can_inst[channel].timed_count = 0;
+    system_enable_irq();
     
     // this is indispensable here, otherwise Slcan is dead after a Tx buffer overlow and closing the adapter.
     buf_clear_can_buffer(channel);
@@ -140,9 +247,16 @@ eFeedback can_open(uint8_t channel, uint32_t mode)
     init->AutoRetransmission    = (GLB_UserFlags[channel] & USR_Retransmit) ? ENABLE : DISABLE;
     init->TransmitPause         = DISABLE;
     init->ProtocolException     = ENABLE;
-    init->TxFifoQueueMode       = FDCAN_TX_FIFO_OPERATION;
-    init->StdFiltersNbr         = inst->std_filter_count;
-    init->ExtFiltersNbr         = inst->ext_filter_count;
+    // In queue mode the FDCAN sends the pending Tx buffer with the lowest ID first instead of the oldest one.
+    init->TxFifoQueueMode       = (GLB_UserFlags[channel] & USR_TxPriority) ? FDCAN_TX_QUEUE_OPERATION : FDCAN_TX_FIFO_OPERATION;
+
+    // calculate the count of filter elements that are required for the host filters and the host ID list
+    can_select_rx_fifo_mode(inst, channel);
+    can_compile_host_id_list(inst, false);
+    can_compile_host_id_list(inst, true);
+
+    init->StdFiltersNbr         = inst->std_user_elements + inst->id_std_compiled.elements + inst->reject_elements;
+    init->ExtFiltersNbr         = inst->ext_user_elements + inst->id_ext_compiled.elements + inst->reject_elements;
 
     // ------------------- baudrate ------------------------
 
@@ -183,7 +297,45 @@ eFeedback can_open(uint8_t channel, uint32_t mode)
 
     inst->bitrate_printed_once = false;
     inst->delay_printed_once   = false;
+    inst->delay_measured       = false;
+    inst->status_changed       = false;
+    inst->proto_error          = FDCAN_PROTOCOL_ERROR_NONE;
+    inst->err_log_enabled      = (GLB_UserFlags[channel] & USR_ErrorLog) != 0;
+    inst->err_log_head         = 0;
+    inst->err_log_tail         = 0;
+    inst->err_log_window       = 0;
+    inst->err_suppressed       = 0;
+    inst->err_counts_sum       = 0;
+    inst->err_count_ticks      = 0;
+    memset((void*)inst->err_counts, 0, sizeof(inst->err_counts));
     inst->recover_bus_off      = false;
+    inst->boff_detected        = false;
+    inst->boff_host_request    = false;
+    inst->boff_host_informed   = false;
+    inst->boff_delay           = inst->boff_base_delay;
+    inst->boff_attempts        = 0;
+    inst->boff_active_tick     = HAL_GetTick() - BOFF_STABLE_TIME;
+    inst->boff_count           = 0;
+    inst->boff_last_ms         = 0;
+    inst->boff_min_ms          = 0xFFFFFFFF;
+    inst->boff_max_ms          = 0;
+    inst->rx_head              = 0;
+    inst->rx_tail              = 0;
+    inst->rx_packet_lost       = false;
+    inst->rx_lost_count        = 0;
+    inst->rx_reject_count      = 0;
+    inst->rx_reject_shown      = 0;
+#if CHANNEL_COUNT > 1
+    inst->tx_fifo_put          = 0;
+    inst->tx_fifo_get          = 0;
+    inst->fwd_direct_count     = 0;
+    inst->fwd_queued_count     = 0;
+    inst->fwd_replaced_count   = 0;
+    inst->fwd_dropped_count    = 0;
+    inst->tunnel_pack_len      = 0;
+    inst->tunnel_frag_next     = 0;
+    can_reset_bridge_latency(inst);
+#endif
 
     // ------------------ Init FDCAN ----------------------
 
@@ -193,11 +345,40 @@ eFeedback can_open(uint8_t channel, uint32_t mode)
 
     // ---------------- Rx/Tx Timestamps ------------------
 
+    // The wrap around of the timestamps is counted in the Timer 3 interrupt, the FDCAN wrap around interrupt is not used.
     if (HAL_FDCAN_ConfigTimestampCounter(&inst->handle, FDCAN_TIMESTAMP_PRESC_1)  != HAL_OK || // use no prescaler
-        HAL_FDCAN_EnableTimestampCounter(&inst->handle, FDCAN_TIMESTAMP_EXTERNAL) != HAL_OK || // use timer TIM3 (see system.c)
-        HAL_FDCAN_ConfigInterruptLines  (&inst->handle, FDCAN_IT_GROUP_MISC, FDCAN_INTERRUPT_LINE0) != HAL_OK ||
-        HAL_FDCAN_ActivateNotification  (&inst->handle, FDCAN_IT_LIST_MISC | FDCAN_IT_TIMESTAMP_WRAPAROUND, 0) != HAL_OK) // wrap callback
+        HAL_FDCAN_EnableTimestampCounter(&inst->handle, FDCAN_TIMESTAMP_EXTERNAL) != HAL_OK)   // use timer TIM3 (see system.c)
+        return FBK_ErrorFromHAL; // error detail in inst->handle.ErrorCode
+
+#if CAN_RX_INTERRUPT
+    // A new packet in Rx FIFO 0 or 1 calls HAL_FDCAN_RxFifo0Callback() or HAL_FDCAN_RxFifo1Callback()
+    if (HAL_FDCAN_ConfigInterruptLines(&inst->handle, FDCAN_IT_GROUP_RX_FIFO0 | FDCAN_IT_GROUP_RX_FIFO1, FDCAN_INTERRUPT_LINE0) != HAL_OK ||
+        HAL_FDCAN_ActivateNotification(&inst->handle, FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO1_NEW_MESSAGE, 0) != HAL_OK)
+        return FBK_ErrorFromHAL; // error detail in inst->handle.ErrorCode
+#endif
+
+    // The bus status is latched by interrupts instead of polling the status register in each pass of the main loop.
+    // A change of Error Warning, Error Passive or Bus Off calls HAL_FDCAN_ErrorStatusCallback().
+    // A protocol error calls HAL_FDCAN_ErrorCallback(). With USR_ErrorLog this interrupt is never disabled.
+    memset(&inst->cur_status, 0, sizeof(inst->cur_status));
+    if (HAL_FDCAN_ConfigInterruptLines(&inst->handle, FDCAN_IT_GROUP_BIT_LINE_ERROR | FDCAN_IT_GROUP_PROTOCOL_ERROR, FDCAN_INTERRUPT_LINE0) != HAL_OK ||
+        HAL_FDCAN_ActivateNotification(&inst->handle, FDCAN_IT_ERROR_WARNING | FDCAN_IT_ERROR_PASSIVE | FDCAN_IT_BUS_OFF |
+                                                      FDCAN_IT_ARB_PROTOCOL_ERROR | FDCAN_IT_DATA_PROTOCOL_ERROR, 0) != HAL_OK)
+        return FBK_ErrorFromHAL; // error detail in inst->handle.ErrorCode
+
+    // USR_RxDualFifo: a packet that has been rejected by the host filters calls HAL_FDCAN_HighPriorityMessageCallback()
+    if (inst->reject_elements > 0 &&
+        (HAL_FDCAN_ConfigInterruptLines(&inst->handle, FDCAN_IT_GROUP_SMSG, FDCAN_INTERRUPT_LINE0) != HAL_OK ||
+         HAL_FDCAN_ActivateNotification(&inst->handle, FDCAN_IT_RX_HIGH_PRIORITY_MSG, 0) != HAL_OK))
+        return FBK_ErrorFromHAL; // error detail in inst->handle.ErrorCode
+
+#if CAN_TX_INTERRUPT
+    // A packet that has been sent successfully calls HAL_FDCAN_TxBufferCompleteCallback().
+    // The Tx FIFO empty interrupt is not required: when the FIFO becomes empty, the last packet has also completed.
+    if (HAL_FDCAN_ConfigInterruptLines(&inst->handle, FDCAN_IT_GROUP_SMSG, FDCAN_INTERRUPT_LINE0) != HAL_OK ||
+        HAL_FDCAN_ActivateNotification(&inst->handle, FDCAN_IT_TX_COMPLETE, FDCAN_TX_BUFFER0 | FDCAN_TX_BUFFER1 | FDCAN_TX_BUFFER2) != HAL_OK)
         return FBK_ErrorFromHAL; // error detail in inst->handle.ErrorCode
+#endif
 
     // ---------------- TDC compensation ------------------
 
@@ -243,26 +424,71 @@ eFeedback can_open(uint8_t channel, uint32_t mode)
 
     // -------------------- filters --------------------------
 
-    // Store all user filters in can_filters into the processor's memory
-    if (!can_apply_host_filters(inst))
+    // Store all user filters in host_filters into the processor's memory
+    if (!can_apply_host_filters(inst, true))
         return FBK_ErrorFromHAL;
 
-    // the user can define up to 8 filters
-    bool has_filters = (inst->std_filter_count + inst->ext_filter_count) > 0;
+    // Store the compiled host ID list behind the user filters
+    uint32_t false_pos;
+    if ((inst->id_std_compiled.elements > 0 && can_make_id_list_elements(inst, false, inst->id_std_compiled.max_gap, true, &false_pos) < 0) ||
+        (inst->id_ext_compiled.elements > 0 && can_make_id_list_elements(inst, true,  inst->id_ext_compiled.max_gap, true, &false_pos) < 0))
+        return FBK_ErrorFromHAL;
+
+    // USR_RxDualFifo: The last element of each type matches all packets that have not been accepted by the elements before.
+    // It does not store them in a FIFO, it only sets the high priority message flag which counts them in the interrupt.
+    if (inst->reject_elements > 0)
+    {
+        FDCAN_FilterTypeDef element;
+        element.FilterType   = FDCAN_FILTER_MASK;
+        element.FilterConfig = FDCAN_FILTER_HP;
+        element.FilterID1    = 0;
+        element.FilterID2    = 0; // mask = 0 --> all CAN ID's match
+
+        element.IdType       = FDCAN_STANDARD_ID;
+        element.FilterIndex  = inst->std_user_elements + inst->id_std_compiled.elements;
+        if (HAL_FDCAN_ConfigFilter(&inst->handle, &element) != HAL_OK)
+            return FBK_ErrorFromHAL;
+
+        element.IdType       = FDCAN_EXTENDED_ID;
+        element.FilterIndex  = inst->ext_user_elements + inst->id_ext_compiled.elements;
+        if (HAL_FDCAN_ConfigFilter(&inst->handle, &element) != HAL_OK)
+            return FBK_ErrorFromHAL;
+    }
+
+    // the user can define up to 8 filters and the host ID list
+    bool has_filters = can_has_pass_filters(inst);
 
     // If no user filters are defined --> accept all packets in FIFO 0 where they are sent over USB to the host.
     // Otherwise all packets that do not pass the user filters go to FIFO 1 where they only flash the Rx LED.
+    // If the host ID list has been compiled into filter elements, all other packets are rejected by the hardware.
+    // USR_RxDualFifo: If filters are defined, the rejected packets never reach the global filter because the last element matches them.
     uint32_t non_matching = has_filters ? FDCAN_ACCEPT_IN_RX_FIFO1 : FDCAN_ACCEPT_IN_RX_FIFO0;
+    uint32_t non_match_std = (inst->id_std_compiled.elements > 0) ? FDCAN_REJECT : non_matching;
+    uint32_t non_match_ext = (inst->id_ext_compiled.elements > 0) ? FDCAN_REJECT : non_matching;
 
-    HAL_FDCAN_ConfigGlobalFilter(&inst->handle, non_matching, non_matching, FDCAN_FILTER_REMOTE, FDCAN_FILTER_REMOTE);
+    HAL_FDCAN_ConfigGlobalFilter(&inst->handle, non_match_std, non_match_ext, FDCAN_FILTER_REMOTE, FDCAN_FILTER_REMOTE);
 
     // ----------------------- start ---------------------------
 
     // sets inst->handle.State == HAL_FDCAN_STATE_BUSY
     if (HAL_FDCAN_Start(&inst->handle) != HAL_OK) return FBK_ErrorFromHAL; // error detail in inst->handle.ErrorCode
 
+    // The first window of the bus load statistics starts now
+    inst->window_start    = system_get_timestamp();
+    inst->window_bit_base = inst->bit_count_total;
+    can_reset_load_stats(inst);
+
+    // The cyclic packets start now with their phase offset
+    for (int i=0; i<CYC_MAX_ENTRIES; i++)
+    {
+        inst->cyclic[i].restart = true;
+    }
+
     led_turn_TX(channel, false);
     inst->is_open = true;
+
+    // trigger the scheduler interrupt that calculates the next transmission
+    TIM3->EGR = TIM_EGR_CC1G;
     return FBK_Success;
 }
 
@@ -295,6 +521,13 @@ void can_close(uint8_t channel)
 // Called from Buffer. Stores a packet in the Tx FIFO
 // Check HAL_FDCAN_GetTxFifoFreeLevel() and can_is_tx_allowed() before calling this function!
 void can_send_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
+    can_send_packet_rx_time(channel, tx_header, tx_data, 0, false);
+}
+
+// rx_time = Rx timestamp of a packet that is forwarded from another channel, otherwise 0
+// queued  = the forwarded packet has waited in the Tx buffer, false = it is forwarded directly (cut-through)
+void can_send_packet_rx_time(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time, bool queued)
 {
     can_class* inst = &can_inst[channel];
 
@@ -302,11 +535,9 @@ void can_send_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t*
     if (!can_using_BRS(channel))
         tx_header->BitRateSwitch = FDCAN_BRS_OFF;
 
-    HAL_StatusTypeDef status = HAL_FDCAN_AddMessageToTxFifoQ(&inst->handle, tx_header, tx_data);
-    if (status != HAL_OK) // may be busy (state = HAL_FDCAN_STATE_BUSY)
+    if (!can_write_tx_element(inst, tx_header, tx_data))
     {
-        // On error the HAL sets inst->handle.ErrorCode to HAL_FDCAN_ERROR_FIFO_FULL or HAL_FDCAN_ERROR_NOT_STARTED
-        // Both errors can never happen, because this function is only called when CAN has been initialized and the FIFO is not full.
+        // This error can never happen, because this function is only called when CAN has been initialized and the FIFO is not full.
         error_assert(channel, APP_CanTxFail, true);
         return;
     }
@@ -317,6 +548,21 @@ void can_send_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t*
         inst->tx_pending ++;
     }
 
+#if CHANNEL_COUNT > 1
+    if (inst->handle.Init.TxFifoQueueMode == FDCAN_TX_FIFO_OPERATION)
+    {
+        inst->tx_fifo_rx_time[inst->tx_fifo_put % 4] = rx_time;
+        inst->tx_fifo_queued [inst->tx_fifo_put % 4] = queued;
+        inst->tx_fifo_put ++;
+    }
+#endif
+
+    // The Tx event does not contain the data bytes that are needed to count the stuff bits.
+    // In loopback mode do not count the same packet twice (Tx == Rx at the same time without delay)
+    if (inst->busload_exact && inst->handle.Init.Mode == FDCAN_MODE_NORMAL)
+        inst->tx_bit_count += can_calc_exact_bit_count(inst, tx_header->Identifier, tx_header->IdType, tx_header->TxFrameType, tx_header->DataLength,
+                                                       tx_header->FDFormat, tx_header->BitRateSwitch, tx_header->ErrorStateIndicator, tx_data);
+
     // Do not flash the Tx LED here! This was wrong in the legacy Candlelight firmware.
     // The packet has not been sent yet. It is still in the Tx FIFO and will stay there until an ACK is received.
     // When an ACK is received HAL_FDCAN_GetTxEvent() will return the Tx Event and the Tx LED will be flashed.
@@ -327,20 +573,37 @@ void can_send_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t*
 void can_process(uint8_t channel, uint32_t tick_now)
 {
     can_class* inst = &can_inst[channel];
+
+#if CHANNEL_COUNT > 1
+    // can_set_bridge_filter() may run in the USB interrupt on Candlelight while a packet is being forwarded here.
+    // Therefore the routing table is compiled only in the main loop where no lookup can be interrupted.
+    // If a filter is changed while compiling, the flag is set again and the table is compiled once more.
+    if (inst->bridge_routes_dirty)
+    {
+        inst->bridge_routes_dirty = false;
+        can_compile_bridge_routes(inst);
+    }
+#endif
+
     if (!inst->is_open)
         return;
 
-    uint8_t can_data_buf[64] = {0};
-    char    dbg_msg_buf[100];
+    char dbg_msg_buf[100];
 
     // -------------------------- Tx Event ------------------------------------
 
     // This was competely wrong in the original Candlelight firmware (fixed by Elmsoft).
     // Instead of sending a Tx Event to the host in the moment when the processor has really sent the packet to the CAN bus
     // they have sent a fake event immediately after dispatching the packet, no matter if it really was sent or not.
+    // The Tx Event FIFO is drained down to its fill level (3 events), limited to CAN_MAX_FRAMES_PER_PASS.
+    // On multi-channel boards each channel is serviced only every second pass of the main loop.
     FDCAN_TxEventFifoTypeDef tx_event;
-    if (HAL_FDCAN_GetTxEvent(&inst->handle, &tx_event) == HAL_OK)
+    uint32_t fill_level = (inst->handle.Instance->TXEFS & FDCAN_TXEFS_EFFL) >> FDCAN_TXEFS_EFFL_Pos;
+    for (uint32_t i=0; i<MIN(fill_level, CAN_MAX_FRAMES_PER_PASS); i++)
     {
+        if (HAL_FDCAN_GetTxEvent(&inst->handle, &tx_event) != HAL_OK)
+            break;
+
         // Here tx_event.EventType is FDCAN_TX_EVENT if auto retransmission is enabled.
         // Here tx_event.EventType is FDCAN_TX_IN_SPITE_OF_ABORT if auto retransmission is disabled.
         // "In DAR mode (Disable Auto Retransmission) all transmissions are automatically canceled after
@@ -349,61 +612,128 @@ void can_process(uint8_t channel, uint32_t tick_now)
         if ((GLB_UserFlags[channel] & USR_TxEcho) && tx_event.MessageMarker > 0)
         {
             // convert 16 bit timestamp --> 32 bit
-            tx_event.TxTimestamp = (system_get_timewrap() << 16) | tx_event.TxTimestamp;
+            tx_event.TxTimestamp = (uint32_t)system_extend_timestamp16(tx_event.TxTimestamp);
             buf_store_tx_echo(channel, &tx_event);
         }
 
+        // The processor measures the transceiver delay while sending a CAN FD packet with BRS (see below)
+        if (tx_event.BitRateSwitch == FDCAN_BRS_ON)
+            inst->delay_measured = true;
+
         // In loopback mode do not count the same packet twice (Tx == Rx at the same time without delay)
         // In bus montoring mode and restricted mode sending packets is not possible.
-        if (inst->handle.Init.Mode == FDCAN_MODE_NORMAL)
+        // In exact mode the Tx packet has already been counted in can_send_packet().
+        if (inst->handle.Init.Mode == FDCAN_MODE_NORMAL && !inst->busload_exact)
         {
             // for bus load calculation
             inst->bit_count_total += can_calc_bit_count_in_frame(inst, tx_event.DataLength, tx_event.TxFrameType, tx_event.IdType, tx_event.FDFormat, tx_event.BitRateSwitch);
         }
 
+#if CHANNEL_COUNT > 1
+        // Forwarding latency: Rx timestamp (start of frame on the source channel) --> Tx timestamp (start of frame on this channel)
+        if (inst->handle.Init.TxFifoQueueMode == FDCAN_TX_FIFO_OPERATION && inst->tx_fifo_get != inst->tx_fifo_put)
+        {
+            uint32_t rx_time = inst->tx_fifo_rx_time[inst->tx_fifo_get % 4];
+            bool     queued  = inst->tx_fifo_queued [inst->tx_fifo_get % 4];
+            inst->tx_fifo_get ++;
+            if (rx_time > 0)
+            {
+                // A queued packet may wait longer than the 16 bit timer period --> compare 32 bit timestamps.
+                // The Tx event is extended here (if not already done for the Tx echo), it has just been read from the Tx event FIFO.
+                uint32_t tx_time = (uint32_t)system_extend_timestamp16((uint16_t)tx_event.TxTimestamp);
+                uint32_t latency = tx_time - rx_time;
+                brg_latency* stat = queued ? &inst->fwd_latency_queued : &inst->fwd_latency_direct;
+                stat->count ++;
+                stat->sum += latency;
+                stat->min  = MIN(stat->min, latency);
+                stat->max  = MAX(stat->max, latency);
+            }
+        }
+#endif
+
+        // tx_pending is incremented in can_send_packet() which may be called from the Tx complete interrupt.
+        system_disable_irq();
         if (inst->tx_pending > 0)
         {
             inst->last_tx_tick = tick_now;
             inst->tx_pending --;
         }
+        system_enable_irq();
         led_flash_TX(channel); // flash 15 ms
     }
 
     // -------------------------- Rx Packet ------------------------------------
 
-    // Rx FIFO 0 receives all packets that have been accepted by the filters -> write to the USB buffer
-    // Rx FIFO 0 and Rx FIFO 1 can store up to three packets each.
-    FDCAN_RxHeaderTypeDef rx_header;
-    if (HAL_FDCAN_GetRxMessage(&inst->handle, FDCAN_RX_FIFO0, &rx_header, can_data_buf) == HAL_OK)
+#if !CAN_RX_INTERRUPT
+    can_read_rx_fifos(inst);
+#endif
+
+    // Process the packets that have been copied into the ring buffer by can_read_rx_fifo()
+    for (uint32_t i=0; i<CAN_MAX_FRAMES_PER_PASS && inst->rx_tail != inst->rx_head; i++)
     {
-        // convert 16 bit timestamp --> 32 bit
-        rx_header.RxTimestamp = (system_get_timewrap() << 16) | rx_header.RxTimestamp;
-        buf_store_rx_packet(channel, &rx_header, can_data_buf);
+        rx_packet* packet = &inst->rx_ring[inst->rx_tail % CAN_RX_RING_SIZE];
+
+        // The per-ID statistics count all packets, also those rejected by the filters
+        if (inst->id_stats_bits > 0)
+            can_update_id_stats(inst, &packet->header);
+
+        // Accepted packets are written to the USB buffer, rejected packets only flash the Rx LED (see can_is_accepted())
+        // If id_stats_no_stream is set, the bus is monitored with the per-ID statistics only (no USB load).
+        if (!inst->id_stats_no_stream && can_is_accepted(inst, packet))
+            buf_store_rx_packet(channel, &packet->header, packet->data, packet->lost_count, packet->priority);
 
 #if CHANNEL_COUNT > 1
-        if (inst->bridge_active)
-            can_forward_bridge_packet(inst, &rx_header, can_data_buf);
+        // A tunnel frame is not forwarded itself, but the frames that it contains.
+        if (inst->tunnel_enabled && can_is_tunnel_frame(inst, &packet->header))
+        {
+            if (inst->bridge_active)
+                can_tunnel_receive(inst, &packet->header, packet->data);
+        }
+        else if (inst->bridge_active)
+        {
+            can_forward_bridge_packet(inst, &packet->header, packet->data);
+        }
 #endif
         // for bus load calculation
-        inst->bit_count_total += can_calc_bit_count_in_frame(inst, rx_header.DataLength, rx_header.RxFrameType, rx_header.IdType, rx_header.FDFormat, rx_header.BitRateSwitch);
+        if (inst->busload_exact)
+            inst->bit_count_total += can_calc_exact_bit_count(inst, packet->header.Identifier, packet->header.IdType, packet->header.RxFrameType, packet->header.DataLength,
+                                                              packet->header.FDFormat, packet->header.BitRateSwitch, packet->header.ErrorStateIndicator, packet->data);
+        else
+            inst->bit_count_total += can_calc_bit_count_in_frame(inst, packet->header.DataLength, packet->header.RxFrameType, packet->header.IdType, packet->header.FDFormat, packet->header.BitRateSwitch);
 
         led_flash_RX(channel); // flash 15 ms
+
+        // The slot is given back to can_read_rx_fifo() only after the packet has been processed completely.
+        inst->rx_tail ++;
     }
 
-    // Rx FIFO 1 receives all packets that have been rejected by the filters -> only flash the Rx LED
-    // Rx FIFO 0 and Rx FIFO 1 can store up to three packets each.
-    if (HAL_FDCAN_GetRxMessage(&inst->handle, FDCAN_RX_FIFO1, &rx_header, can_data_buf) == HAL_OK)
-    {
 #if CHANNEL_COUNT > 1
-        if (inst->bridge_active)
-            can_forward_bridge_packet(inst, &rx_header, can_data_buf);
+    // Send the classic frames collected for the tunnel when the latency window of the oldest frame has expired
+    if (inst->tunnel_pack_len > 0 && system_get_timestamp() - inst->tunnel_pack_time >= inst->tunnel_window)
+        can_tunnel_flush(channel);
 #endif
-        // for bus load calculation
-        inst->bit_count_total += can_calc_bit_count_in_frame(inst, rx_header.DataLength, rx_header.RxFrameType, rx_header.IdType, rx_header.FDFormat, rx_header.BitRateSwitch);
 
+    // USR_RxDualFifo: the packets rejected by the host filters are only counted in the interrupt
+    if (inst->rx_reject_shown != inst->rx_reject_count)
+    {
+        inst->rx_reject_shown = inst->rx_reject_count;
         led_flash_RX(channel); // flash 15 ms
     }
 
+    // USR_ErrorLog: send the protocol errors that have been stored by the FDCAN interrupt (see can_log_proto_error())
+    while (inst->err_log_tail != inst->err_log_head)
+    {
+        err_event* event = &inst->err_log[inst->err_log_tail % ERR_LOG_SIZE];
+        control_report_error_event(channel, event->timestamp, event->code, event->tx_err_count, event->rx_err_count);
+
+        // The slot is given back to can_log_proto_error() only after the event has been sent.
+        inst->err_log_tail ++;
+    }
+
+    // Bus load statistics: evaluate the bits of the last 1 ms window
+    if (inst->busload_windowed && inst->busload_interval > 0 && system_get_timestamp() - inst->window_start >= BUSLOAD_WINDOW_US)
+        can_close_load_window(inst);
+
     // -------------------------- Rx / Tx Errors ------------------------------------
 
     // Tx Event FIFO packet lost
@@ -413,35 +743,35 @@ void can_process(uint8_t channel, uint32_t tick_now)
         __HAL_FDCAN_CLEAR_FLAG(&inst->handle, FDCAN_FLAG_TX_EVT_FIFO_ELT_LOST);
     }
 
-    // Rx FIFO 0 packet lost
-    if (__HAL_FDCAN_GET_FLAG(&inst->handle, FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST))
-    {
-        error_assert(channel, APP_CanRxFail, false);
-        __HAL_FDCAN_CLEAR_FLAG(&inst->handle, FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST);
-    }
-
-    // Rx FIFO 1 packet lost
-    if (__HAL_FDCAN_GET_FLAG(&inst->handle, FDCAN_FLAG_RX_FIFO1_MESSAGE_LOST))
+    // Rx FIFO 0 / 1 or Rx ring buffer was full (the hardware flags are evaluated in can_read_rx_fifo())
+    if (inst->rx_packet_lost)
     {
+        inst->rx_packet_lost = false;
         error_assert(channel, APP_CanRxFail, false);
-        __HAL_FDCAN_CLEAR_FLAG(&inst->handle, FDCAN_FLAG_RX_FIFO1_MESSAGE_LOST);
     }
 
-    // ------------------------- Refresh Bus Status ---------------------------------
+    // ------------------------- Bus Status ---------------------------------
 
-    HAL_FDCAN_GetProtocolStatus(&inst->handle, &inst->cur_status);
+    // The bus status in cur_status is refreshed by the FDCAN status interrupts (see can_latch_status()).
+    // The main loop runs approx 100 times in one millisecond and does not read the status register anymore.
 
     // ----------------------------- Transmit Timeout -----------------------------
 
     // If a message hangs longer than a few milliseconds in the Tx FIFO this means that it was not acknowledged.
     // The processor continues to send the message !!ETERNALLY!! producing a bus load of 95%.
-    // Tx requests must be canceled by firmware to free CAN bus from the congestion.
+    // Tx requests must be canceled by firmware to free CAN bus from the congestion.
     // the processor will never stop alone sending the same packet over and over again.
-    if (inst->tx_pending > 0 && tick_now >= inst->last_tx_tick + CAN_TX_TIMEOUT)
+    // The timeout can be adapted to slow bitrates or long bursts with can_set_tx_timeout().
+    if (inst->tx_pending > 0 && tick_now >= inst->last_tx_tick + inst->tx_timeout)
     {
+        can_block_tx_interrupt(channel, true);
         inst->tx_pending = 0;
         HAL_FDCAN_AbortTxRequest(&inst->handle, FDCAN_TX_BUFFER0 | FDCAN_TX_BUFFER1 | FDCAN_TX_BUFFER2);
+#if CHANNEL_COUNT > 1
+        inst->tx_fifo_get = inst->tx_fifo_put; // the aborted packets will not generate a Tx event
+#endif
         buf_clear_can_buffer(channel);
+        can_block_tx_interrupt(channel, false);
         error_assert(channel, APP_CanTxTimeout, false);
     }
 
@@ -467,6 +797,14 @@ void can_process(uint8_t channel, uint32_t tick_now)
     // For the transceiver chip ADM3050E in the isolated CANable from MKS Makerbase the measured delay is 21 mtq = 131 ns.
     // The datasheet says maximum propagation delay TXD to RXD is 150 ns.
     // The ADM3050E supports up to 12 Mbit and works well even with 10 Mbit.
+    // The status register is read only after a packet with BRS has been sent, not in each pass of the main loop.
+    if (!inst->delay_printed_once && inst->delay_measured && inst->tdc_offset > 0)
+    {
+        inst->delay_measured = false;
+        system_disable_irq();
+        can_latch_status(inst);
+        system_enable_irq();
+    }
     if (!inst->delay_printed_once && inst->tdc_offset > 0 && inst->cur_status.TDCvalue > inst->tdc_offset && inst->cur_status.TDCvalue < 127)
     {
         inst->delay_printed_once = true;
@@ -482,196 +820,875 @@ void can_process(uint8_t channel, uint32_t tick_now)
     }
 }
 
-// ATTENTION:
-// The state BusOff (after 248 Tx errors) is a fatal situation where the CAN module is completely blocked.
-// No further transmit operations are possible.
-// And the FDCAN module will never recover alone from this situation.
-// If the adapter is once in Bus Off state it will hang there eternally.
-// The recovery process may take up to 200 ms for low baudrates (10 kBaud).
-// The adapter easily goes into bus off state if you try to communicate between 2 adapters with a different baudrate.
-// This function must be called after reporting BusOff to the host.
-void can_recover_bus_off(uint8_t channel)
+// Decide if a Rx packet is sent to the host.
+// RXFIFO_Single:
+// Rx FIFO 0 receives all packets that have been accepted by the filters -> write to the USB buffer
+// Rx FIFO 1 receives all packets that have been rejected by the filters -> only flash the Rx LED
+// unless they are in the host ID list.
+// RXFIFO_Split / RXFIFO_Priority:
+// Both FIFO's receive only accepted packets. But packets that do not match any filter element (no pass filters defined)
+// and the false positives of the compiled host ID list (FDCAN_FILTER_RANGE elements) must be checked here.
+bool can_is_accepted(can_class* inst, rx_packet* packet)
 {
-    can_class* inst = &can_inst[channel];
-    if (!inst->is_open)
-        return;
+    if (inst->rx_fifo_mode == RXFIFO_Single)
+        return packet->fifo == FDCAN_RX_FIFO0 || can_is_in_host_id_list(inst, &packet->header);
 
-    if (inst->cur_status.BusOff)
-    {
-        if (!inst->recover_bus_off)
-        {
-            inst->recover_bus_off = true;
-            control_send_debug_mesg(channel, ">> Start recovery from Bus Off");
+    if (packet->priority)
+        return true;
 
-            HAL_FDCAN_AbortTxRequest(&inst->handle, FDCAN_TX_BUFFER0 | FDCAN_TX_BUFFER1 | FDCAN_TX_BUFFER2);
-            HAL_FDCAN_Stop (&inst->handle);
-            HAL_FDCAN_Start(&inst->handle);
-        }
-    }
-    else
-    {
-        if (inst->recover_bus_off)
-        {
-            inst->recover_bus_off = false;
-            control_send_debug_mesg(channel, "<< Successfully recovered from Bus Off");
+    // IsFilterMatchingFrame == 1 means that the packet did NOT match any filter element and was accepted by the global filter.
+    uint32_t user_elements = (packet->header.IdType == FDCAN_EXTENDED_ID) ? inst->ext_user_elements : inst->std_user_elements;
+    if (packet->header.IsFilterMatchingFrame || packet->header.FilterIndex < user_elements)
+        return true;
 
-            // Clear errors that are still stored in the error handler, but that are outdated now.
-            error_clear(channel);
-        }
+    // The packet matched an element of the compiled host ID list
+    return can_is_in_host_id_list(inst, &packet->header);
+}
+
+// Copy all packets from both hardware Rx FIFO's into the Rx ring buffer.
+// CAN_RX_INTERRUPT = 1 --> called from the FDCAN interrupt when a new packet has arrived.
+// CAN_RX_INTERRUPT = 0 --> called from can_process() in the main loop.
+// RXFIFO_Single:   Rx FIFO 0 (accepted) is read before Rx FIFO 1 (rejected).
+// RXFIFO_Priority: Rx FIFO 1 (priority filters) is read first, so these packets are processed before the other packets.
+// RXFIFO_Split:    the packets are taken from both FIFO's in the order of their timestamps.
+void can_read_rx_fifos(can_class* inst)
+{
+    switch (inst->rx_fifo_mode)
+    {
+        case RXFIFO_Split:
+            can_read_rx_merged(inst);
+            break;
+        case RXFIFO_Priority:
+            can_read_rx_fifo(inst, FDCAN_RX_FIFO1);
+            can_read_rx_fifo(inst, FDCAN_RX_FIFO0);
+            break;
+        default:
+            can_read_rx_fifo(inst, FDCAN_RX_FIFO0);
+            can_read_rx_fifo(inst, FDCAN_RX_FIFO1);
+            break;
     }
 }
 
-// Called every 100 ms from the main loop
-// Calculate bus load, written (and hopefully tested well) by Nakanishi Kiyomaro.
-void can_timer_100ms()
+// Copy all packets from the hardware Rx FIFO 0 or 1 into the Rx ring buffer.
+// Rx FIFO 0 and Rx FIFO 1 can store up to three packets each.
+// At 1 Mbaud with short packets a FIFO is full after 150 s, so it must be drained completely.
+// Each packet stores rx_lost_count, so the host can locate the packets that have been lost before it (ELM_DevFlagRxSequence).
+void can_read_rx_fifo(can_class* inst, uint32_t rx_fifo)
 {
-    // The bus load calculation is not exact because dynamic bit stuffing is not calculated in can_calc_bit_count_in_frame().
-    // 1.) In a classic CAN frame one dynamic Stuff Bit (SB) is inserted after five equal payload bits.
-    // 2.) In the CRC phase of a CAN FD frame there are Fix Stuff Bits (FSB) after every 4 payload bits.
-    // Study the oscilloscope captures of https://netcult.ch/elmue/oszi-Waveform-Analyzer
-    // STUFFING_FACTOR adds 12.5% so the bus load is the same as on the oscilloscope.
-    const uint32_t STUFFING_FACTOR = 1125;
+    // In blocking mode the FIFO drops new packets while it is full.
+    // So the lost packets came after the packets that are in the FIFO now and rx_lost_count is incremented after draining it.
+    // The FDCAN does not count the lost packets, so one overflow is counted as one lost packet.
+    bool fifo_lost = can_check_fifo_lost(inst, rx_fifo);
 
-    for (int C=0; C<CHANNEL_COUNT; C++)
+    uint32_t fill_level = HAL_FDCAN_GetRxFifoFillLevel(&inst->handle, rx_fifo);
+    for (uint32_t i=0; i<fill_level; i++)
     {
-        can_class* inst = &can_inst[C];
-        if (!inst->is_open || inst->busload_interval == 0)
-            continue;
+        if (!can_store_rx_element(inst, rx_fifo))
+            break;
+    }
 
-        if (inst->busload_counter >= inst->busload_interval) // interval elapsed
-        {
-            // This function is called every 100 ms = 100 * 1000 s --> divide by 100000
-            uint32_t rate_us_ppm = inst->bit_count_total * inst->nom_bit_len_ns / 100000;
-            uint32_t busload_ppm = rate_us_ppm * STUFFING_FACTOR / inst->busload_interval;
+    if (fifo_lost)
+    {
+        inst->rx_packet_lost = true; // report APP_CanRxFail in can_process()
+        inst->rx_lost_count ++;
+    }
+}
 
-            // divide by 1000 to remove stuff factor, which is multiplied with 1000, and divide by 10 to convert 1000 into 100%
-            uint8_t  new_busload = MIN(99, busload_ppm / 10000);
+// RXFIFO_Split: Copy all packets from both hardware Rx FIFO's into the Rx ring buffer.
+// The oldest packet of both FIFO's is taken first, so the host receives the packets in the order they were on the bus.
+void can_read_rx_merged(can_class* inst)
+{
+    FDCAN_GlobalTypeDef* can = inst->handle.Instance;
 
-            // Suppress report of "Bus load = 0%" eternally
-            if (new_busload > 0 || inst->old_busload_pct > 0)
-                control_report_busload(C, new_busload); // send busload report to the host
+    bool lost0 = can_check_fifo_lost(inst, FDCAN_RX_FIFO0);
+    bool lost1 = can_check_fifo_lost(inst, FDCAN_RX_FIFO1);
 
-            inst->old_busload_pct = new_busload;
-            inst->bit_count_total = 0;
-            inst->busload_counter = 0;
+    // Packets that arrive while the FIFO's are drained trigger a new interrupt.
+    uint32_t fill_level = HAL_FDCAN_GetRxFifoFillLevel(&inst->handle, FDCAN_RX_FIFO0) +
+                          HAL_FDCAN_GetRxFifoFillLevel(&inst->handle, FDCAN_RX_FIFO1);
+    for (uint32_t i=0; i<fill_level; i++)
+    {
+        uint32_t rx_fifo = FDCAN_RX_FIFO0;
+        if ((can->RXF0S & FDCAN_RXF0S_F0FL) == 0)
+        {
+            rx_fifo = FDCAN_RX_FIFO1;
+        }
+        else if (can->RXF1S & FDCAN_RXF1S_F1FL)
+        {
+            // Compare the 16 bit timestamps (RXTS in R1) of the oldest element in both FIFO's.
+            // The signed difference is correct even if the timer wraps between both packets.
+            uint32_t get0 = (can->RXF0S & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+            uint32_t get1 = (can->RXF1S & FDCAN_RXF1S_F1GI) >> FDCAN_RXF1S_F1GI_Pos;
+            uint16_t ts0  = ((uint32_t*)(inst->handle.msgRam.RxFIFO0SA + get0 * CAN_ELEMENT_SIZE))[1];
+            uint16_t ts1  = ((uint32_t*)(inst->handle.msgRam.RxFIFO1SA + get1 * CAN_ELEMENT_SIZE))[1];
+            if ((int16_t)(ts1 - ts0) < 0)
+                rx_fifo = FDCAN_RX_FIFO1;
         }
 
-        inst->busload_counter ++;
+        if (!can_store_rx_element(inst, rx_fifo))
+            break;
     }
-}
 
-// ----------------------------------------------------------------------------------------------
+    if (lost0 || lost1)
+    {
+        inst->rx_packet_lost = true; // report APP_CanRxFail in can_process()
+        inst->rx_lost_count += (lost0 ? 1 : 0) + (lost1 ? 1 : 0);
+    }
+}
 
-// set_data = false -> Set the nominal bitrate configuration of the CAN peripheral
-// set_data = true  -> Set the data    bitrate configuration of the CAN peripheral
-// If all 4 nominal values are identical to the data values, CAN FD is enabled and packets up to 64 byte can be sent without BRS.
-// See "CiA - Recommendations for CAN Bit Timing.pdf" in subfolder "Documentation"
-eFeedback can_set_bit_timing(uint8_t channel, bool set_data, uint32_t BRP, uint32_t Seg1, uint32_t Seg2, uint32_t Sjw)
+// Returns true if the hardware Rx FIFO 0 or 1 has dropped a packet because it was full and clears the flag.
+bool can_check_fifo_lost(can_class* inst, uint32_t rx_fifo)
 {
-    can_class* inst = &can_inst[channel];
-    if (inst->is_open)
-        return FBK_AdapterMustBeClosed; // cannot set bitrate while on bus
+    uint32_t lost_flag = (rx_fifo == FDCAN_RX_FIFO0) ? FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST : FDCAN_FLAG_RX_FIFO1_MESSAGE_LOST;
+    if (!__HAL_FDCAN_GET_FLAG(&inst->handle, lost_flag))
+        return false;
 
-    if (set_data)
-    {
-        if (!IS_FDCAN_DATA_PRESCALER(BRP)  ||
-            !IS_FDCAN_DATA_TSEG1    (Seg1) ||
-            !IS_FDCAN_DATA_TSEG2    (Seg2) ||
-            !IS_FDCAN_DATA_SJW      (Sjw))
-                return FBK_ParamOutOfRange;
-    }
-    else // nominal
+    __HAL_FDCAN_CLEAR_FLAG(&inst->handle, lost_flag);
+    return true;
+}
+
+// Copy the oldest packet from the hardware Rx FIFO 0 or 1 into the Rx ring buffer.
+// If the ring buffer is full the packet is discarded. Returns false if the FIFO is empty.
+bool can_store_rx_element(can_class* inst, uint32_t rx_fifo)
+{
+    if (inst->rx_head - inst->rx_tail >= CAN_RX_RING_SIZE)
     {
-        if (!IS_FDCAN_NOMINAL_PRESCALER(BRP)  ||
-            !IS_FDCAN_NOMINAL_TSEG1    (Seg1) ||
-            !IS_FDCAN_NOMINAL_TSEG2    (Seg2) ||
-            !IS_FDCAN_NOMINAL_SJW      (Sjw))
-                return FBK_ParamOutOfRange;
+        // The ring buffer is full -> discard the oldest packet in the hardware FIFO.
+        // It must not stay in the FIFO, because there will be no new interrupt for it.
+        if (rx_fifo == FDCAN_RX_FIFO0) inst->handle.Instance->RXF0A = (inst->handle.Instance->RXF0S & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+        else                           inst->handle.Instance->RXF1A = (inst->handle.Instance->RXF1S & FDCAN_RXF1S_F1GI) >> FDCAN_RXF1S_F1GI_Pos;
+
+        inst->rx_packet_lost = true; // report APP_CanRxFail in can_process()
+        inst->rx_lost_count ++;
+        return true;
     }
 
-    can_bitrate_cfg* bitrate = set_data ? &inst->bitrate_data : &inst->bitrate_nominal;
-
-    bitrate->Brp  = BRP;
-    bitrate->Seg1 = Seg1;
-    bitrate->Seg2 = Seg2;
-    bitrate->Sjw  = Sjw;
+    rx_packet* packet = &inst->rx_ring[inst->rx_head % CAN_RX_RING_SIZE];
+    if (!can_read_rx_element(inst, rx_fifo, packet))
+        return false;
 
-    if (can_calc_baud(bitrate) > MAX_CAN_BAUDRATE * 1000000)
-        return FBK_ParamOutOfRange;
+    // convert 16 bit timestamp --> 32 bit
+    packet->header.RxTimestamp = (uint32_t)system_extend_timestamp16(packet->header.RxTimestamp);
+    packet->fifo       = rx_fifo;
+    packet->lost_count = inst->rx_lost_count;
+    packet->priority   = (inst->rx_fifo_mode == RXFIFO_Priority && rx_fifo == FDCAN_RX_FIFO1);
 
-    return FBK_Success;
+    // The packet becomes visible to can_process() only after it has been stored completely.
+    inst->rx_head ++;
+    return true;
 }
 
-// Prints a string containing the baudrate and samplepoint to the debug output.
-// Although this is very simple many application and firmware developers do this calculation wrong. (see sourcecode of Cangaroo)
-// It is very important to verify that baudrate and samplepoint have been set correctly by the user.
-// Therefore this firmware prints them as a debug message so the user can verify the settings.
-// Additionally this function can print the TDC configuration and if the pin BOOT0 is enabled.
-// This function is only called if CAN is opened.
-void can_print_info(uint8_t channel)
+// This replaces HAL_FDCAN_GetRxMessage() which is too slow, especially on the Cortex M0+ (STM32G0xx).
+// The HAL checks the state, handles the FIFO overwrite mode (not used here) and copies the payload byte by byte from the message RAM.
+// Here the two header words are decoded once and the payload is copied in 32 bit words.
+// The message RAM must be accessed with 32 bit words. packet->data is 4 byte aligned.
+// See "STM32G4 Series - Chapter FDCAN.pdf" in subfolder "Documentation", chapter "Rx FIFO element".
+bool can_read_rx_element(can_class* inst, uint32_t rx_fifo, rx_packet* packet)
 {
-    if ((GLB_UserFlags[channel] & USR_DebugReport) == 0)
-        return;
-
-    can_class* inst = &can_inst[channel];
+    FDCAN_GlobalTypeDef* can = inst->handle.Instance;
 
-    char buf[200];
-    if (inst->handle.Init.Mode != FDCAN_MODE_NORMAL)
+    uint32_t get_index;
+    uint32_t* element;
+    if (rx_fifo == FDCAN_RX_FIFO0)
     {
-        char* mode = "Invalid";
-        switch (inst->handle.Init.Mode)
-        {
-            case FDCAN_MODE_RESTRICTED_OPERATION: mode = "Restricted";        break;
-            case FDCAN_MODE_BUS_MONITORING:       mode = "Monitoring";        break;
-            case FDCAN_MODE_INTERNAL_LOOPBACK:    mode = "Internal Loopback"; break;
-            case FDCAN_MODE_EXTERNAL_LOOPBACK:    mode = "External Loopback"; break;
-        }
-        sprintf(buf, "Operation Mode: %s", mode);
-        control_send_debug_mesg(channel, buf);
+        if ((can->RXF0S & FDCAN_RXF0S_F0FL) == 0)
+            return false; // FIFO empty
+
+        get_index = (can->RXF0S & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+        element   = (uint32_t*)(inst->handle.msgRam.RxFIFO0SA + get_index * CAN_ELEMENT_SIZE);
     }
+    else
+    {
+        if ((can->RXF1S & FDCAN_RXF1S_F1FL) == 0)
+            return false; // FIFO empty
 
-    // print "Nominal: 500k baud, 87.5%; Data: 2M baud, 75.0%; Perfect match: Yes"
-    utils_format_bitrate(buf,               "Nominal", &inst->bitrate_nominal);
-    utils_format_bitrate(buf + strlen(buf), "; Data",  &inst->bitrate_data);
+        get_index = (can->RXF1S & FDCAN_RXF1S_F1GI) >> FDCAN_RXF1S_F1GI_Pos;
+        element   = (uint32_t*)(inst->handle.msgRam.RxFIFO1SA + get_index * CAN_ELEMENT_SIZE);
+    }
 
-    if (can_using_FD(channel))
+    // R0 = ESI, XTD, RTR, ID
+    // R1 = ANMF, FIDX, FDF, BRS, DLC, RXTS
+    uint32_t R0 = element[0];
+    uint32_t R1 = element[1];
+
+    FDCAN_RxHeaderTypeDef* header = &packet->header;
+    header->IdType                = R0 & FDCAN_EXTENDED_ID;
+    header->Identifier            = header->IdType == FDCAN_EXTENDED_ID ? (R0 & 0x1FFFFFFF) : ((R0 >> 18) & 0x7FF);
+    header->RxFrameType           = R0 & FDCAN_REMOTE_FRAME;
+    header->ErrorStateIndicator   = R0 & FDCAN_ESI_PASSIVE;
+    header->RxTimestamp           = R1 & 0xFFFF;
+    header->DataLength            = (R1 >> 16) & 0xF;
+    header->BitRateSwitch         = R1 & FDCAN_BRS_ON;
+    header->FDFormat              = R1 & FDCAN_FD_CAN;
+    header->FilterIndex           = (R1 >> 24) & 0x7F;
+    header->IsFilterMatchingFrame = R1 >> 31;
+
+    uint32_t* payload = (uint32_t*)packet->data;
+    uint32_t  words   = DLC_TO_WORDS[header->DataLength];
+    for (uint32_t W=0; W<words; W++)
     {
-        // See "CiA - Recommendations for CAN Bit Timing.pdf" in subfolder "Documentation"
-        strcat(buf, "; Perfect match: ");
-        strcat(buf, inst->bitrate_nominal.Brp == inst->bitrate_data.Brp ? "Yes" : "No");
+        payload[W] = element[2 + W];
     }
-    control_send_debug_mesg(channel, buf);
 
-    // ------------------- Debugging --------------------
-    // Optional additional information: pin BOOT0 and TDC offset
+    // Acknowledge the element -> the FDCAN increments the get index
+    if (rx_fifo == FDCAN_RX_FIFO0) can->RXF0A = get_index;
+    else                           can->RXF1A = get_index;
+    return true;
+}
 
-#if 0
-    // Print Transceiver Delay Compensation
-    if (inst->tdc_offset > 0)
-        sprintf(buf, "TDC offset: %lu mtq", inst->tdc_offset);
-    else
-        strcpy(buf, "TDC: not used");
+// This replaces HAL_FDCAN_AddMessageToTxFifoQ() which assembles each payload word from 4 single bytes.
+// tx_data must be 4 byte aligned (kCanFrameObject.data, can_tx_buf.data, rx_packet.data, tunnel buffers).
+// See "STM32G4 Series - Chapter FDCAN.pdf" in subfolder "Documentation", chapter "Tx buffer element".
+bool can_write_tx_element(can_class* inst, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
+    FDCAN_GlobalTypeDef* can = inst->handle.Instance;
 
-    // Print enable status of pin BOOT0
-    const char* pin_status;
-    switch (system_is_option_enabled(OPT_BOOT0_Enable))
+    if (inst->handle.State != HAL_FDCAN_STATE_BUSY || (can->TXFQS & FDCAN_TXFQS_TFQF) != 0)
+        return false; // not started or FIFO full
+
+    uint32_t put_index = (can->TXFQS & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos;
+    uint32_t* element  = (uint32_t*)(inst->handle.msgRam.TxFIFOQSA + put_index * CAN_ELEMENT_SIZE);
+
+    // T0 = ESI, XTD, RTR, ID
+    // T1 = MM, EFC, FDF, BRS, DLC
+    uint32_t ID = tx_header->IdType == FDCAN_EXTENDED_ID ? tx_header->Identifier : (tx_header->Identifier << 18);
+    element[0]  = tx_header->ErrorStateIndicator | tx_header->IdType | tx_header->TxFrameType | ID;
+    element[1]  = (tx_header->MessageMarker << 24) | tx_header->TxEventFifoControl | tx_header->FDFormat |
+                   tx_header->BitRateSwitch | (tx_header->DataLength << 16);
+
+    uint32_t* payload = (uint32_t*)tx_data;
+    uint32_t  words   = DLC_TO_WORDS[tx_header->DataLength & 0xF];
+    for (uint32_t W=0; W<words; W++)
     {
-        case Option_Active:   pin_status = "enabled";       break;
-        case Option_Inactive: pin_status = "disabled";      break;
-        default:              pin_status = "not supported"; break;
+        element[2 + W] = payload[W];
     }
 
-    strcat(buf, ", Pin BOOT0: ");
-    strcat(buf, pin_status);
+    // Request transmission
+    can->TXBAR = 1 << put_index;
+    inst->handle.LatestTxFifoQRequest = 1 << put_index;
+    return true;
+}
 
-    control_send_debug_mesg(channel, buf);
-#endif
+#if CAN_RX_INTERRUPT
+// Overwrite weak callback function
+// Called from HAL_FDCAN_IRQHandler() when a new packet has been stored in Rx FIFO 0
+// Both FIFO's are read, so the order of can_read_rx_fifos() is kept if both have new packets.
+void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs)
+{
+    // The handle is the first member of can_class
+    can_read_rx_fifos((can_class*)hfdcan);
 }
 
-// ------------------------------------- HOST FILTER -------------------------------------------
+// Overwrite weak callback function
+// Called from HAL_FDCAN_IRQHandler() when a new packet has been stored in Rx FIFO 1
+// If the FIFO 0 callback has already been called in the same interrupt, the FIFO's are empty now.
+void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo1ITs)
+{
+    can_read_rx_fifos((can_class*)hfdcan);
+}
+#endif
 
-// Set filters for Rx packets to be sent to the host over USB.
-// The G0 and G4 series allow up to 28 standard filters and up to 8 extended filters.
+// Overwrite weak callback function
+// Called from HAL_FDCAN_IRQHandler() when Error Warning, Error Passive or Bus Off has been set or reset.
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t ErrorStatusITs)
+{
+    can_latch_status((can_class*)hfdcan);
+}
+
+// Overwrite weak callback function
+// Called from HAL_FDCAN_IRQHandler() after each interrupt if hfdcan->ErrorCode is not zero.
+// A protocol error (e.g. no ACK) occurs for each retransmission of a packet, which can be thousands of times per second.
+// Only the first protocol error is reported, so the interrupt is disabled until can_get_bus_status() has fetched it.
+// USR_ErrorLog: the interrupt stays enabled, so each protocol error is counted and the rate limit is applied in can_log_proto_error().
+void HAL_FDCAN_ErrorCallback(FDCAN_HandleTypeDef *hfdcan)
+{
+    const uint32_t proto_bits = HAL_FDCAN_ERROR_PROTOCOL_ARBT | HAL_FDCAN_ERROR_PROTOCOL_DATA;
+    if ((hfdcan->ErrorCode & proto_bits) == 0)
+        return;
+
+    can_class* inst = (can_class*)hfdcan;
+    hfdcan->ErrorCode &= ~proto_bits;
+    can_latch_status(inst);
+
+    // USR_ErrorLog: can_latch_status() has logged the error codes, the interrupt stays enabled
+    if (inst->err_log_enabled)
+        return;
+
+    if (inst->proto_error != FDCAN_PROTOCOL_ERROR_NONE)
+        CLEAR_BIT(hfdcan->Instance->IE, FDCAN_IE_PEAE | FDCAN_IE_PEDE);
+}
+
+// USR_ErrorLog: store a protocol error with timestamp and the error counters in err_log.
+// All errors are counted per type, but only ERR_LOG_MAX_EVENTS per 100 ms are stored, the others are counted in err_suppressed.
+// Called from can_latch_status() in the FDCAN interrupt or with interrupts disabled.
+void can_log_proto_error(can_class* inst, uint8_t code, bool data_phase)
+{
+    if (code == FDCAN_PROTOCOL_ERROR_NONE || code == FDCAN_PROTOCOL_ERROR_NO_CHANGE)
+        return;
+
+    inst->err_counts[code - 1] ++;
+
+    if (inst->err_log_window >= ERR_LOG_MAX_EVENTS || inst->err_log_head - inst->err_log_tail >= ERR_LOG_SIZE)
+    {
+        inst->err_suppressed ++;
+        return;
+    }
+
+    uint32_t ecr = inst->handle.Instance->ECR;
+    err_event* event    = &inst->err_log[inst->err_log_head % ERR_LOG_SIZE];
+    event->timestamp    = system_get_timestamp();
+    event->code         = code | (data_phase ? ERR_LOG_DATA_PHASE : 0);
+    event->tx_err_count = (ecr & FDCAN_ECR_TEC) >> FDCAN_ECR_TEC_Pos;
+    event->rx_err_count = (ecr & FDCAN_ECR_REC) >> FDCAN_ECR_REC_Pos;
+
+    inst->err_log_window ++;
+    inst->err_log_head   ++;
+}
+
+// Overwrite weak callback function
+// Called from HAL_FDCAN_IRQHandler() when a packet has matched a FDCAN_FILTER_HP element (USR_RxDualFifo).
+// This element is only used to count the packets rejected by the host filters, they are not stored in a FIFO.
+// If multiple packets are rejected before the interrupt is executed, they are counted only once.
+void HAL_FDCAN_HighPriorityMessageCallback(FDCAN_HandleTypeDef *hfdcan)
+{
+    ((can_class*)hfdcan)->rx_reject_count ++;
+}
+
+#if CAN_TX_INTERRUPT
+// Overwrite weak callback function
+// Called from HAL_FDCAN_IRQHandler() when a packet has been sent to CAN bus --> a Tx FIFO element is free now.
+// Move the next packet from the software queue into the Tx FIFO without waiting for the main loop.
+void HAL_FDCAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndexes)
+{
+    uint8_t channel = (can_class*)hfdcan - can_inst;
+    buf_fill_tx_fifo(channel);
+}
+#endif
+
+// The main loop must block the Tx complete interrupt while it calls buf_fill_tx_fifo() or modifies the software Tx queue.
+// Only this one interrupt of this channel is blocked, the Rx interrupts continue.
+// A packet that completes while blocked sets the flag FDCAN_FLAG_TX_COMPLETE and the interrupt fires after unblocking.
+// The scheduler interrupt (can_scheduler_interrupt) also stores packets in the Tx FIFO and the Tx buffer. It serves all channels.
+// A compare match while blocked sets the flag TIM_SR_CC1IF and the interrupt fires after unblocking.
+void can_block_tx_interrupt(uint8_t channel, bool block)
+{
+    can_class* inst = &can_inst[channel];
+    if (!inst->is_open)
+        return;
+
+#if CAN_TX_INTERRUPT
+    if (block) __HAL_FDCAN_DISABLE_IT(&inst->handle, FDCAN_IT_TX_COMPLETE);
+    else       __HAL_FDCAN_ENABLE_IT (&inst->handle, FDCAN_IT_TX_COMPLETE);
+#endif
+
+    if (block) TIM3->DIER &= ~TIM_DIER_CC1IE;
+    else       TIM3->DIER |=  TIM_DIER_CC1IE;
+}
+
+// ATTENTION:
+// The state BusOff (after 248 Tx errors) is a fatal situation where the CAN module is completely blocked.
+// No further transmit operations are possible.
+// And the FDCAN module will never recover alone from this situation.
+// If the adapter is once in Bus Off state it will hang there eternally.
+// The recovery process may take up to 200 ms for low baudrates (10 kBaud).
+// The adapter easily goes into bus off state if you try to communicate between 2 adapters with a different baudrate.
+// This function must be called after reporting BusOff to the host.
+// But a node with a wrong baudrate drives the adapter into Bus Off again immediately after each recovery.
+// An immediate restart results in a tight loop of Bus Off and recovery which disturbs the bus and floods the host with errors.
+// So the host can select a policy (see can_set_bus_off_policy()):
+// BOFF_Immediate: restart immediately (default)
+// BOFF_Backoff:   wait boff_base_delay before the first attempt, the delay is doubled for each further attempt
+// BOFF_Manual:    wait until the host calls can_restart_bus_off()
+// After boff_max_attempts without BOFF_STABLE_TIME between them the firmware also waits for the host.
+// Each recovery and each wait for the host is reported with control_report_bus_off_stats().
+// Called from control_process() in each pass of the main loop.
+void can_recover_bus_off(uint8_t channel)
+{
+    can_class* inst = &can_inst[channel];
+    if (!inst->is_open)
+        return;
+
+    uint32_t tick_now = HAL_GetTick();
+    if (inst->cur_status.BusOff)
+    {
+        if (inst->recover_bus_off)
+            return; // the FDCAN has been restarted and waits for 128 x 11 recessive bits
+
+        if (!inst->boff_detected)
+        {
+            inst->boff_detected = true;
+            inst->boff_off_tick = tick_now;
+            inst->boff_count ++;
+
+            // The bus has been stable since the last recovery --> start again with the first attempt
+            if (tick_now - inst->boff_active_tick >= BOFF_STABLE_TIME)
+            {
+                inst->boff_attempts = 0;
+                inst->boff_delay    = inst->boff_base_delay;
+            }
+            // Bus Off again after a recent recovery --> double the delay before the next attempt: base, 2 x base, 4 x base,...
+            else if (inst->boff_policy == BOFF_Backoff && inst->boff_attempts > 0)
+            {
+                inst->boff_delay = MIN(inst->boff_delay * 2, BOFF_MAX_DELAY);
+            }
+        }
+
+        if (!inst->boff_host_request)
+        {
+            bool wait_for_host = inst->boff_policy == BOFF_Manual ||
+                                (inst->boff_max_attempts > 0 && inst->boff_attempts >= inst->boff_max_attempts);
+            if (wait_for_host)
+            {
+                if (!inst->boff_host_informed)
+                {
+                    inst->boff_host_informed = true;
+                    control_send_debug_mesg(channel, ">> Bus Off: Waiting for the host to start the recovery");
+                    can_report_bus_off_stats(channel, true);
+                }
+                return;
+            }
+
+            if (inst->boff_policy == BOFF_Backoff && tick_now - inst->boff_off_tick < inst->boff_delay)
+                return;
+        }
+        else // the host starts a new sequence of attempts
+        {
+            inst->boff_attempts = 0;
+            inst->boff_delay    = inst->boff_base_delay;
+        }
+
+        inst->boff_host_request  = false;
+        inst->boff_host_informed = false;
+        inst->boff_attempts ++;
+
+        inst->recover_bus_off = true;
+        control_send_debug_mesg(channel, ">> Start recovery from Bus Off");
+
+        HAL_FDCAN_AbortTxRequest(&inst->handle, FDCAN_TX_BUFFER0 | FDCAN_TX_BUFFER1 | FDCAN_TX_BUFFER2);
+        HAL_FDCAN_Stop (&inst->handle);
+        HAL_FDCAN_Start(&inst->handle);
+    }
+    else
+    {
+        if (inst->recover_bus_off)
+        {
+            inst->recover_bus_off  = false;
+            inst->boff_detected    = false;
+            inst->boff_active_tick = tick_now;
+            inst->boff_last_ms     = tick_now - inst->boff_off_tick;
+            inst->boff_min_ms      = MIN(inst->boff_min_ms, inst->boff_last_ms);
+            inst->boff_max_ms      = MAX(inst->boff_max_ms, inst->boff_last_ms);
+            control_send_debug_mesg(channel, "<< Successfully recovered from Bus Off");
+
+            // Clear errors that are still stored in the error handler, but that are outdated now.
+            error_clear(channel);
+            can_report_bus_off_stats(channel, false);
+        }
+    }
+}
+
+// private function
+// waiting = true --> the firmware does not recover alone anymore, the host must call can_restart_bus_off()
+void can_report_bus_off_stats(uint8_t channel, bool waiting)
+{
+    // the statistics are sent together with the error reports
+    if ((GLB_UserFlags[channel] & USR_ErrorReport) == 0)
+        return;
+
+    can_class* inst = &can_inst[channel];
+    uint32_t min_ms = (inst->boff_min_ms == 0xFFFFFFFF) ? 0 : inst->boff_min_ms;
+    control_report_bus_off_stats(channel, waiting, inst->boff_attempts, inst->boff_count, inst->boff_last_ms, min_ms, inst->boff_max_ms);
+}
+
+// Start the recovery from Bus Off now. This is required with BOFF_Manual or after boff_max_attempts.
+// With the other policies this skips the remaining back-off delay.
+// Does nothing if the bus is not off.
+eFeedback can_restart_bus_off(uint8_t channel)
+{
+    can_class* inst = &can_inst[channel];
+    if (!inst->is_open)
+        return FBK_AdapterMustBeOpen;
+
+    if (inst->cur_status.BusOff)
+        inst->boff_host_request = true; // executed in the next pass of the main loop
+    return FBK_Success;
+}
+
+// policy       = eBusOffPolicy
+// base_delay   = BOFF_Backoff: delay in ms before the first recovery attempt (1 ... BOFF_MAX_DELAY)
+// max_attempts = consecutive recovery attempts before the firmware waits for can_restart_bus_off() (0 = unlimited, max 65535)
+// The policy can be changed while the adapter is open. The default BOFF_Immediate is restored when the adapter is closed.
+eFeedback can_set_bus_off_policy(uint8_t channel, eBusOffPolicy policy, uint32_t base_delay, uint32_t max_attempts)
+{
+    if (policy > BOFF_Manual || max_attempts > 0xFFFF)
+        return FBK_InvalidParameter;
+
+    if (policy == BOFF_Backoff && (base_delay < 1 || base_delay > BOFF_MAX_DELAY))
+        return FBK_ParamOutOfRange;
+
+    can_class* inst = &can_inst[channel];
+    inst->boff_policy       = policy;
+    inst->boff_base_delay   = (policy == BOFF_Backoff) ? base_delay : BOFF_DEFAULT_DELAY;
+    inst->boff_max_attempts = max_attempts;
+    inst->boff_delay        = inst->boff_base_delay;
+    inst->boff_attempts     = 0;
+    return FBK_Success;
+}
+
+// Read the protocol status register into cur_status.
+// Reading the register resets the last error codes, so the first protocol error is latched in proto_error.
+// USR_ErrorLog: the error codes are logged here because they are lost for any later read of the register
+// (status interrupt, TDC measurement, GS_ReqGetErrorState).
+// This must be the only place where the register is read.
+// Called from the FDCAN interrupt or with interrupts disabled.
+void can_latch_status(can_class* inst)
+{
+    HAL_FDCAN_GetProtocolStatus(&inst->handle, &inst->cur_status);
+    inst->status_changed = true;
+
+    if (inst->err_log_enabled)
+    {
+        can_log_proto_error(inst, inst->cur_status.LastErrorCode,     false);
+        can_log_proto_error(inst, inst->cur_status.DataLastErrorCode, true);
+    }
+
+    if (inst->proto_error != FDCAN_PROTOCOL_ERROR_NONE)
+        return;
+
+    if (inst->cur_status.DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NONE &&
+        inst->cur_status.DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE)
+            inst->proto_error = inst->cur_status.DataLastErrorCode;
+
+    if (inst->cur_status.LastErrorCode != FDCAN_PROTOCOL_ERROR_NONE &&
+        inst->cur_status.LastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE)
+            inst->proto_error = inst->cur_status.LastErrorCode;
+}
+
+// Read the current protocol status register for the host.
+// This goes through can_latch_status() so the last error codes are not lost for the error report and the error log.
+void can_get_protocol_status(uint8_t channel, FDCAN_ProtocolStatusTypeDef* status)
+{
+    can_class* inst = &can_inst[channel];
+    system_disable_irq();
+    can_latch_status(inst);
+    *status = inst->cur_status;
+    system_enable_irq();
+}
+
+// Called from error_is_report_due() in each pass of the main loop --> no register access.
+// bus_status  receives the bus status latched by the FDCAN status interrupts.
+// proto_error receives the first protocol error since the last call (FDCAN_PROTOCOL_ERROR_NONE if none).
+// Returns true if the status has changed since the last call.
+bool can_get_bus_status(uint8_t channel, eErrorBusStatus* bus_status, uint8_t* proto_error)
+{
+    can_class* inst = &can_inst[channel];
+
+    *bus_status = BUS_StatusActive;
+    if (inst->cur_status.Warning)      *bus_status = BUS_StatusWarning; // MCU register FDCAN_PSR, flag EW (>  96 errors)
+    if (inst->cur_status.ErrorPassive) *bus_status = BUS_StatusPassive; // MCU register FDCAN_PSR, flag EP (> 128 errors)
+    if (inst->cur_status.BusOff)       *bus_status = BUS_StatusOff;     // MCU register FDCAN_PSR, flag BO (> 248 errors)
+
+    *proto_error = FDCAN_PROTOCOL_ERROR_NONE;
+    if (!inst->status_changed)
+        return false;
+
+    system_disable_irq();
+    inst->status_changed = false;
+    *proto_error = inst->proto_error;
+    if (inst->proto_error != FDCAN_PROTOCOL_ERROR_NONE)
+    {
+        // enable the protocol error interrupt again (see HAL_FDCAN_ErrorCallback()), discard the flags of the errors that were not reported
+        inst->proto_error = FDCAN_PROTOCOL_ERROR_NONE;
+        inst->handle.Instance->IR = FDCAN_IR_PEA | FDCAN_IR_PED;
+        SET_BIT(inst->handle.Instance->IE, FDCAN_IE_PEAE | FDCAN_IE_PEDE);
+    }
+    system_enable_irq();
+    return true;
+}
+
+// Called from can_process() when a 1 ms window has elapsed.
+// The bits of a frame are counted when it is processed, so a frame is assigned to the window in which it has been completed.
+// At low bitrates a frame is longer than one window, such a window is limited to 100%.
+// If the main loop was blocked for several milliseconds, all elapsed windows get the average of this time span.
+void can_close_load_window(can_class* inst)
+{
+    // tx_bit_count is modified in the Tx complete interrupt
+    system_disable_irq();
+    inst->bit_count_total += inst->tx_bit_count;
+    inst->tx_bit_count = 0;
+    system_enable_irq();
+
+    uint32_t now     = system_get_timestamp();
+    uint32_t elapsed = now - inst->window_start;
+    uint32_t bits    = inst->bit_count_total - inst->window_bit_base;
+    inst->window_start    = now;
+    inst->window_bit_base = inst->bit_count_total;
+
+    uint32_t stuff_factor = inst->busload_exact ? 1000 : STUFFING_FACTOR;
+    uint32_t busy_us      = bits * inst->nom_bit_len_ns / 1000;
+    uint8_t  percent      = MIN(100, busy_us * stuff_factor / (elapsed * 10));
+    uint32_t windows      = elapsed / BUSLOAD_WINDOW_US;
+
+    busload_stats* stats = &inst->load_stats;
+    stats->peak     = MAX(stats->peak,    percent);
+    stats->minimum  = MIN(stats->minimum, percent);
+    stats->windows += windows;
+
+    uint16_t* histo = &stats->histogram[MIN(BUSLOAD_HISTO_COUNT - 1, percent / 10)];
+    *histo = MIN(0xFFFF, *histo + windows);
+}
+
+// Start a new report interval for the bus load statistics
+void can_reset_load_stats(can_class* inst)
+{
+    memset(&inst->load_stats, 0, sizeof(busload_stats));
+    inst->load_stats.minimum = 100;
+}
+
+// Called every 100 ms from the main loop
+// Calculate bus load, written (and hopefully tested well) by Nakanishi Kiyomaro.
+void can_timer_100ms()
+{
+    // The default bus load calculation is not exact because dynamic bit stuffing is not calculated in can_calc_bit_count_in_frame().
+    // 1.) In a classic CAN frame one dynamic Stuff Bit (SB) is inserted after five equal payload bits.
+    // 2.) In the CRC phase of a CAN FD frame there are Fix Stuff Bits (FSB) after every 4 payload bits.
+    // Study the oscilloscope captures of https://netcult.ch/elmue/oszi-Waveform-Analyzer
+    // STUFFING_FACTOR adds 12.5% so the bus load is the same as on the oscilloscope.
+    // In exact mode can_calc_exact_bit_count() counts all stuff bits.
+    for (int C=0; C<CHANNEL_COUNT; C++)
+    {
+        can_class* inst = &can_inst[C];
+        if (!inst->is_open || inst->busload_interval == 0)
+            continue;
+
+        // tx_bit_count is modified in the Tx complete interrupt
+        system_disable_irq();
+        inst->bit_count_total += inst->tx_bit_count;
+        inst->tx_bit_count = 0;
+        system_enable_irq();
+
+        if (inst->busload_counter >= inst->busload_interval) // interval elapsed
+        {
+            uint32_t stuff_factor = inst->busload_exact ? 1000 : STUFFING_FACTOR;
+
+            // This function is called every 100 ms = 100 * 1000 s --> divide by 100000
+            uint32_t rate_us_ppm = inst->bit_count_total * inst->nom_bit_len_ns / 100000;
+            uint32_t busload_ppm = rate_us_ppm * stuff_factor / inst->busload_interval;
+
+            // divide by 1000 to remove stuff factor, which is multiplied with 1000, and divide by 10 to convert 1000 into 100%
+            uint8_t  new_busload = MIN(99, busload_ppm / 10000);
+
+            if (inst->busload_windowed)
+            {
+                busload_stats* stats = &inst->load_stats;
+                if (stats->windows == 0)
+                    stats->minimum = 0;
+
+                // Suppress report of "Bus load = 0%" eternally, but report short bursts
+                if (new_busload > 0 || inst->old_busload_pct > 0 || stats->peak > 0)
+                    control_report_busload_stats(C, new_busload, stats->peak, stats->minimum, stats->histogram);
+
+                can_reset_load_stats(inst);
+            }
+            else
+            {
+                // Suppress report of "Bus load = 0%" eternally
+                if (new_busload > 0 || inst->old_busload_pct > 0)
+                    control_report_busload(C, new_busload); // send busload report to the host
+            }
+
+            // The bits of the current window are kept: window_bit_base may become "negative" (modulo 2^32)
+            inst->window_bit_base -= inst->bit_count_total;
+            inst->old_busload_pct  = new_busload;
+            inst->bit_count_total  = 0;
+            inst->busload_counter  = 0;
+        }
+
+        inst->busload_counter ++;
+    }
+
+    // USR_ErrorLog: start a new rate limit interval and report the error counters if they have changed
+    for (int C=0; C<CHANNEL_COUNT; C++)
+    {
+        can_class* inst = &can_inst[C];
+        if (!inst->is_open || !inst->err_log_enabled)
+            continue;
+
+        inst->err_log_window = 0;
+        if (++ inst->err_count_ticks < ERR_LOG_COUNT_INTERVAL)
+            continue;
+
+        inst->err_count_ticks = 0;
+
+        // err_counts and err_suppressed are modified in the FDCAN interrupt
+        uint32_t counts[ERR_LOG_TYPES];
+        system_disable_irq();
+        memcpy(counts, (void*)inst->err_counts, sizeof(counts));
+        uint32_t suppressed = inst->err_suppressed;
+        system_enable_irq();
+
+        uint32_t sum = 0;
+        for (int i=0; i<ERR_LOG_TYPES; i++)
+        {
+            sum += counts[i];
+        }
+
+        if (sum != inst->err_counts_sum)
+        {
+            inst->err_counts_sum = sum;
+            control_report_error_counters(C, counts, suppressed);
+        }
+    }
+
+#if CHANNEL_COUNT > 1
+    // Print the bridge statistics every 3 seconds if packets have been forwarded
+    static uint32_t bridge_counter = 0;
+    if (++ bridge_counter >= 30)
+    {
+        bridge_counter = 0;
+        for (int C=0; C<CHANNEL_COUNT; C++)
+        {
+            can_class* inst = &can_inst[C];
+            if (!inst->is_open || (inst->fwd_direct_count + inst->fwd_queued_count + inst->fwd_replaced_count + inst->fwd_dropped_count +
+                                   inst->fwd_latency_direct.count + inst->fwd_latency_queued.count) == 0)
+                continue;
+
+            can_print_bridge_latency(C);
+            inst->fwd_direct_count   = 0;
+            inst->fwd_queued_count   = 0;
+            inst->fwd_replaced_count = 0;
+            inst->fwd_dropped_count  = 0;
+            can_reset_bridge_latency(inst);
+        }
+    }
+#endif
+}
+
+// ----------------------------------------------------------------------------------------------
+
+// set_data = false -> Set the nominal bitrate configuration of the CAN peripheral
+// set_data = true  -> Set the data    bitrate configuration of the CAN peripheral
+// If all 4 nominal values are identical to the data values, CAN FD is enabled and packets up to 64 byte can be sent without BRS.
+// See "CiA - Recommendations for CAN Bit Timing.pdf" in subfolder "Documentation"
+eFeedback can_set_bit_timing(uint8_t channel, bool set_data, uint32_t BRP, uint32_t Seg1, uint32_t Seg2, uint32_t Sjw)
+{
+    can_class* inst = &can_inst[channel];
+    if (inst->is_open)
+        return FBK_AdapterMustBeClosed; // cannot set bitrate while on bus
+
+    if (set_data)
+    {
+        if (!IS_FDCAN_DATA_PRESCALER(BRP)  ||
+            !IS_FDCAN_DATA_TSEG1    (Seg1) ||
+            !IS_FDCAN_DATA_TSEG2    (Seg2) ||
+            !IS_FDCAN_DATA_SJW      (Sjw))
+                return FBK_ParamOutOfRange;
+    }
+    else // nominal
+    {
+        if (!IS_FDCAN_NOMINAL_PRESCALER(BRP)  ||
+            !IS_FDCAN_NOMINAL_TSEG1    (Seg1) ||
+            !IS_FDCAN_NOMINAL_TSEG2    (Seg2) ||
+            !IS_FDCAN_NOMINAL_SJW      (Sjw))
+                return FBK_ParamOutOfRange;
+    }
+
+    can_bitrate_cfg* bitrate = set_data ? &inst->bitrate_data : &inst->bitrate_nominal;
+
+    bitrate->Brp  = BRP;
+    bitrate->Seg1 = Seg1;
+    bitrate->Seg2 = Seg2;
+    bitrate->Sjw  = Sjw;
+
+    if (can_calc_baud(bitrate) > MAX_CAN_BAUDRATE * 1000000)
+        return FBK_ParamOutOfRange;
+
+    return FBK_Success;
+}
+
+// Prints a string containing the baudrate and samplepoint to the debug output.
+// Although this is very simple many application and firmware developers do this calculation wrong. (see sourcecode of Cangaroo)
+// It is very important to verify that baudrate and samplepoint have been set correctly by the user.
+// Therefore this firmware prints them as a debug message so the user can verify the settings.
+// Additionally this function can print the TDC configuration and if the pin BOOT0 is enabled.
+// This function is only called if CAN is opened.
+void can_print_info(uint8_t channel)
+{
+    if ((GLB_UserFlags[channel] & USR_DebugReport) == 0)
+        return;
+
+    can_class* inst = &can_inst[channel];
+
+    char buf[200];
+    if (inst->handle.Init.Mode != FDCAN_MODE_NORMAL)
+    {
+        char* mode = "Invalid";
+        switch (inst->handle.Init.Mode)
+        {
+            case FDCAN_MODE_RESTRICTED_OPERATION: mode = "Restricted";        break;
+            case FDCAN_MODE_BUS_MONITORING:       mode = "Monitoring";        break;
+            case FDCAN_MODE_INTERNAL_LOOPBACK:    mode = "Internal Loopback"; break;
+            case FDCAN_MODE_EXTERNAL_LOOPBACK:    mode = "External Loopback"; break;
+        }
+        sprintf(buf, "Operation Mode: %s", mode);
+        control_send_debug_mesg(channel, buf);
+    }
+
+    // print "Nominal: 500k baud, 87.5%; Data: 2M baud, 75.0%; Perfect match: Yes"
+    utils_format_bitrate(buf,               "Nominal", &inst->bitrate_nominal);
+    utils_format_bitrate(buf + strlen(buf), "; Data",  &inst->bitrate_data);
+
+    if (can_using_FD(channel))
+    {
+        // See "CiA - Recommendations for CAN Bit Timing.pdf" in subfolder "Documentation"
+        strcat(buf, "; Perfect match: ");
+        strcat(buf, inst->bitrate_nominal.Brp == inst->bitrate_data.Brp ? "Yes" : "No");
+    }
+    control_send_debug_mesg(channel, buf);
+
+    // Print how exact the host ID list has been compiled into filter elements.
+    // "Host ID list 11 bit: 120 IDs in 20 filters, 35 false positives"
+    for (int E=0; E<2; E++)
+    {
+        can_id_elements* comp = E ? &inst->id_ext_compiled : &inst->id_std_compiled;
+        if (comp->elements > 0)
+        {
+            sprintf(buf, "Host ID list %s bit: %lu IDs in %lu filters, %lu false positives", E ? "29" : "11",
+                    E ? inst->id_list_ext_count : inst->id_list_std_count, comp->elements, comp->false_pos);
+            control_send_debug_mesg(channel, buf);
+        }
+    }
+
+    // ------------------- Debugging --------------------
+    // Optional additional information: pin BOOT0 and TDC offset
+
+#if 0
+    // Print Transceiver Delay Compensation
+    if (inst->tdc_offset > 0)
+        sprintf(buf, "TDC offset: %lu mtq", inst->tdc_offset);
+    else
+        strcpy(buf, "TDC: not used");
+
+    // Print enable status of pin BOOT0
+    const char* pin_status;
+    switch (system_is_option_enabled(OPT_BOOT0_Enable))
+    {
+        case Option_Active:   pin_status = "enabled";       break;
+        case Option_Inactive: pin_status = "disabled";      break;
+        default:              pin_status = "not supported"; break;
+    }
+
+    strcat(buf, ", Pin BOOT0: ");
+    strcat(buf, pin_status);
+
+    control_send_debug_mesg(channel, buf);
+#endif
+}
+
+// ------------------------------------- HOST FILTER -------------------------------------------
+
+// Set filters for Rx packets to be sent to the host over USB.
+// The G0 and G4 series allow up to 28 standard filters and up to 8 extended filters.
 // Nobody needs so many filters -> allow 8 user filters.
 // Rx FIFO 0 receives all packets that pass. They are sent to the host application over USB.
 // Rx FIFO 1 receives all packets that are rejected, they only flash the Rx LED.
@@ -682,77 +1699,822 @@ void can_print_info(uint8_t channel)
 // But HAL_FDCAN_ConfigFilter() can be called after opening the adapter.
 // So the only possible filter modification after opening the adapter is to modify ONE existing filter.
 // The filter type must be the same (11 bit or 29 bit).
-eFeedback can_add_host_filter(uint8_t channel, bool extended, uint32_t filter, uint32_t mask)
+// ---------------------------------------------------------
+// priority = true --> USR_RxDualFifo: packets that match this filter are stored in Rx FIFO 1 which is read first
+// and they are sent to the host before all other frames that are waiting in the USB buffer.
+// Priority filters do not reject other packets. Without USR_RxDualFifo they have no effect.
+eFeedback can_add_host_filter(uint8_t channel, bool extended, uint32_t filter, uint32_t mask, bool priority)
+{
+    can_class* inst = &can_inst[channel];
+
+    int tot_filters = inst->std_filter_count + inst->ext_filter_count;
+    if (tot_filters >= MAX_HOST_FILTERS)
+        return FBK_ParamOutOfRange;
+
+    uint32_t maximum = extended ? 0x1FFFFFFF : 0x7FF;
+    if (filter > maximum || mask > maximum)
+        return FBK_ParamOutOfRange;
+
+    if (inst->is_open)
+    {
+        // only one existing filter can be modified if the adapter is already open
+        if (tot_filters != 1)
+            return FBK_AdapterMustBeClosed;
+
+        // The count of filter elements and the global filter depend on the filters (see can_select_rx_fifo_mode())
+        if (priority || inst->prio_filter_count > 0 || inst->rx_fifo_mode != RXFIFO_Single)
+            return FBK_AdapterMustBeClosed;
+
+        // the filter to be modified must be from the same type
+        if (extended != (inst->ext_filter_count == 1))
+            return FBK_AdapterMustBeClosed;
+
+        // modify the one and only filter at index 0
+        inst->ext_filter_count = 0;
+        inst->std_filter_count = 0;
+        tot_filters = 0;
+    }
+
+    // The FilterIndex is assigned in can_apply_host_filters()
+    FDCAN_FilterTypeDef* last_filter = &inst->host_filters[tot_filters];
+    last_filter->IdType       = extended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+    last_filter->FilterType   = FDCAN_FILTER_MASK;
+    last_filter->FilterConfig = priority ? FDCAN_FILTER_TO_RXFIFO1 : FDCAN_FILTER_TO_RXFIFO0;
+    last_filter->FilterID1    = filter;
+    last_filter->FilterID2    = mask;
+
+    if (extended) inst->ext_filter_count ++;
+    else          inst->std_filter_count ++;
+
+    if (priority) inst->prio_filter_count ++;
+
+    if (inst->is_open && !can_apply_host_filters(inst, true))
+        return FBK_ErrorFromHAL;
+
+    return FBK_Success;
+}
+
+// Store all user filters in host_filters into the processor's memory (apply = true) or only count the filter elements (apply = false).
+// RXFIFO_Single:   all filters store the packets in Rx FIFO 0, priority filters are normal filters.
+// RXFIFO_Priority: priority filters store the packets in Rx FIFO 1, the other filters in Rx FIFO 0.
+// RXFIFO_Split:    packets with an odd CAN ID are stored in Rx FIFO 1, so both FIFO's are used for the accepted packets.
+//                  A filter that does not test bit 0 of the CAN ID (mask bit 0 = 0) needs 2 elements: even ID's and odd ID's.
+//                  Without pass filters one element of each type stores the odd CAN ID's in Rx FIFO 1,
+//                  all other packets are accepted by the global filter in Rx FIFO 0.
+bool can_apply_host_filters(can_class* inst, bool apply)
+{
+    inst->std_user_elements = 0;
+    inst->ext_user_elements = 0;
+
+    // the user can define up to 8 filters
+    int tot_filters = inst->std_filter_count + inst->ext_filter_count;
+    for (int i=0; i<tot_filters; i++)
+    {
+        FDCAN_FilterTypeDef element = inst->host_filters[i];
+        if (inst->rx_fifo_mode != RXFIFO_Priority)
+            element.FilterConfig = FDCAN_FILTER_TO_RXFIFO0;
+
+        if (inst->rx_fifo_mode == RXFIFO_Split)
+        {
+            if ((element.FilterID2 & 1) == 0)
+            {
+                // store the even ID's in an additional element
+                element.FilterID1 &= ~1;
+                element.FilterID2 |=  1;
+                if (!can_add_filter_element(inst, &element, apply))
+                    return false;
+
+                element.FilterID1 |= 1;
+            }
+            if (element.FilterID1 & 1)
+                element.FilterConfig = FDCAN_FILTER_TO_RXFIFO1;
+        }
+
+        if (!can_add_filter_element(inst, &element, apply))
+            return false; // error detail in inst->handle.ErrorCode
+    }
+
+    if (inst->rx_fifo_mode == RXFIFO_Split && !can_has_pass_filters(inst))
+    {
+        FDCAN_FilterTypeDef element;
+        element.FilterType   = FDCAN_FILTER_MASK;
+        element.FilterConfig = FDCAN_FILTER_TO_RXFIFO1;
+        element.FilterID1    = 1;
+        element.FilterID2    = 1; // test only bit 0
+
+        element.IdType = FDCAN_STANDARD_ID;
+        if (!can_add_filter_element(inst, &element, apply))
+            return false;
+
+        element.IdType = FDCAN_EXTENDED_ID;
+        if (!can_add_filter_element(inst, &element, apply))
+            return false;
+    }
+    return true;
+}
+
+// Store a filter element behind the filter elements of the same ID type that have already been stored.
+bool can_add_filter_element(can_class* inst, FDCAN_FilterTypeDef* element, bool apply)
+{
+    uint32_t* elements = (element->IdType == FDCAN_EXTENDED_ID) ? &inst->ext_user_elements : &inst->std_user_elements;
+    element->FilterIndex = (*elements) ++;
+
+    return !apply || HAL_FDCAN_ConfigFilter(&inst->handle, element) == HAL_OK;
+}
+
+// Select the usage of the two hardware Rx FIFO's and count the filter elements required for the host filters.
+// USR_RxDualFifo: both FIFO's store only accepted packets, so 6 packets are buffered instead of 3.
+// If pass filters are defined, the rejected packets are not stored anymore.
+// They are counted by a last filter element of each type that matches all CAN ID's (see HAL_FDCAN_HighPriorityMessageCallback()).
+// This mode is not possible if the bus load, the per-ID statistics or the bridge need all packets,
+// or if there are not enough filter elements in the processor. Then the single FIFO mode is used.
+void can_select_rx_fifo_mode(can_class* inst, uint8_t channel)
+{
+    if ((GLB_UserFlags[channel] & USR_RxDualFifo) && !can_needs_all_packets(inst))
+    {
+        inst->rx_fifo_mode    = (inst->prio_filter_count > 0) ? RXFIFO_Priority : RXFIFO_Split;
+        inst->reject_elements = can_has_pass_filters(inst) ? 1 : 0;
+        can_apply_host_filters(inst, false);
+
+        // The host ID list must get at least one element, otherwise its packets would be rejected.
+        uint32_t std_needed = inst->std_user_elements + inst->reject_elements + (inst->id_list_std_count > 0 ? 1 : 0);
+        uint32_t ext_needed = inst->ext_user_elements + inst->reject_elements + (inst->id_list_ext_count > 0 ? 1 : 0);
+        if (std_needed <= HW_STD_FILTERS && ext_needed <= HW_EXT_FILTERS)
+            return;
+    }
+
+    inst->rx_fifo_mode    = RXFIFO_Single;
+    inst->reject_elements = 0;
+    can_apply_host_filters(inst, false);
+}
+
+// The bus load, the per-ID statistics and the bridge need all packets, also those rejected by the host filters.
+bool can_needs_all_packets(can_class* inst)
+{
+#if CHANNEL_COUNT > 1
+    if (inst->bridge_active)
+        return true;
+#endif
+    return inst->busload_interval > 0 || inst->id_stats_bits > 0;
+}
+
+// Priority filters do not restrict the packets that are sent to the host, only pass filters and the host ID list do.
+bool can_has_pass_filters(can_class* inst)
+{
+    return (inst->std_filter_count + inst->ext_filter_count - inst->prio_filter_count + inst->id_list_std_count + inst->id_list_ext_count) > 0;
+}
+
+// clear all host filters and the host ID list (adapter must be closed)
+eFeedback can_clear_host_filters(uint8_t channel)
+{
+    can_class* inst = &can_inst[channel];
+
+    if (inst->is_open)
+        return FBK_AdapterMustBeClosed; // cannot clear filters while on bus
+
+    inst->ext_filter_count  = 0;
+    inst->std_filter_count  = 0;
+    inst->prio_filter_count = 0;
+    inst->id_list_std_count = 0;
+    inst->id_list_ext_count = 0;
+    memset(inst->id_list_std, 0,    sizeof(inst->id_list_std));
+    memset(inst->id_list_ext, 0xFF, sizeof(inst->id_list_ext)); // ID_LIST_EMPTY
+    return FBK_Success;
+}
+
+// Add a single CAN ID to the host ID list. Packets with this ID are sent to the host even if the host filters reject them.
+// This allows to pass several hundred specific CAN IDs, while the processor has only 8 host filters.
+// If only the host ID list is used without host filters, all other CAN IDs are rejected.
+// The adapter must be closed because the global filter is configured in can_open().
+eFeedback can_add_host_id(uint8_t channel, bool extended, uint32_t ID)
+{
+    can_class* inst = &can_inst[channel];
+
+    if (inst->is_open)
+        return FBK_AdapterMustBeClosed;
+
+    if (!extended)
+    {
+        if (ID > 0x7FF)
+            return FBK_ParamOutOfRange;
+
+        if ((inst->id_list_std[ID >> 3] & (1 << (ID & 7))) == 0)
+        {
+            inst->id_list_std[ID >> 3] |= 1 << (ID & 7);
+            inst->id_list_std_count ++;
+        }
+        return FBK_Success;
+    }
+
+    if (ID > 0x1FFFFFFF)
+        return FBK_ParamOutOfRange;
+
+    // linear probing starting at the hash slot
+    for (uint32_t slot = can_hash_id(ID, ID_LIST_EXT_BITS); true; slot = (slot + 1) & (ID_LIST_EXT_SIZE - 1))
+    {
+        if (inst->id_list_ext[slot] == ID)
+            return FBK_Success; // already in the list
+
+        if (inst->id_list_ext[slot] == ID_LIST_EMPTY)
+        {
+            if (inst->id_list_ext_count >= ID_LIST_EXT_MAX)
+                return FBK_ParamOutOfRange; // hash set is full
+
+            inst->id_list_ext[slot] = ID;
+            inst->id_list_ext_count ++;
+            return FBK_Success;
+        }
+    }
+}
+
+// The host ID list is compiled into the unused filter elements of the processor (28 standard, 8 extended)
+// so that packets which are not in the list are rejected by the hardware before the CPU sees them.
+// IDs with small gaps between them are combined into groups:
+// a group with 1 ID is stored together with another single ID in a FDCAN_FILTER_DUAL element,
+// a group with 2 IDs is stored exactly in a FDCAN_FILTER_DUAL element,
+// a group with more IDs is stored in a FDCAN_FILTER_RANGE element which also accepts the IDs in the gaps (false positives).
+// The smallest maximum gap is searched for which all groups fit into the available elements.
+// The filter elements send all matching packets to Rx FIFO 1, where can_process() removes the false positives with can_is_in_host_id_list().
+// USR_RxDualFifo: Rx FIFO 1 is used otherwise, the filter elements send the packets to Rx FIFO 0.
+// The hardware cannot reject packets if the bus load is calculated, per-ID statistics or bridge filters are used, because these need all packets.
+void can_compile_host_id_list(can_class* inst, bool extended)
+{
+    can_id_elements* comp = extended ? &inst->id_ext_compiled : &inst->id_std_compiled;
+    uint32_t list_count = extended ? inst->id_list_ext_count : inst->id_list_std_count;
+    uint32_t budget     = extended ? HW_EXT_FILTERS - inst->ext_user_elements - inst->reject_elements
+                                   : HW_STD_FILTERS - inst->std_user_elements - inst->reject_elements;
+    uint32_t max_gap    = extended ? 0x1FFFFFFF : 0x7FF;
+
+    comp->elements  = 0;
+    comp->false_pos = 0;
+    comp->max_gap   = 0;
+
+    bool hw_reject = (list_count > 0 && budget > 0 && !can_needs_all_packets(inst));
+
+    if (hw_reject)
+    {
+        if (extended)
+        {
+            // copy the hash set into id_sort_buf and sort it (insertion sort, max ID_LIST_EXT_MAX IDs, only in can_open())
+            uint32_t count = 0;
+            for (uint32_t S=0; S<ID_LIST_EXT_SIZE; S++)
+            {
+                uint32_t ID = inst->id_list_ext[S];
+                if (ID == ID_LIST_EMPTY)
+                    continue;
+
+                uint32_t pos = count++;
+                for (; pos > 0 && id_sort_buf[pos - 1] > ID; pos--)
+                {
+                    id_sort_buf[pos] = id_sort_buf[pos - 1];
+                }
+                id_sort_buf[pos] = ID;
+            }
+        }
+
+        // Binary search for the smallest gap where all groups fit into the budget.
+        // The count of elements decreases with a growing gap. With the maximum gap all IDs are in one element.
+        uint32_t low = 0;
+        while (low < max_gap)
+        {
+            uint32_t mid = low + (max_gap - low) / 2;
+            if ((uint32_t)can_make_id_list_elements(inst, extended, mid, false, &comp->false_pos) <= budget) max_gap = mid;
+            else                                                                                           low = mid + 1;
+        }
+        comp->max_gap  = max_gap;
+        comp->elements = can_make_id_list_elements(inst, extended, max_gap, false, &comp->false_pos);
+    }
+}
+
+// Walk through the sorted host ID list and combine IDs with a gap up to max_gap into one filter element.
+// If apply == true the elements are stored in the processor behind the user filters.
+// Returns the count of filter elements or -1 on HAL error. false_pos receives the count of IDs in the gaps.
+int can_make_id_list_elements(can_class* inst, bool extended, uint32_t max_gap, bool apply, uint32_t* false_pos)
+{
+    FDCAN_FilterTypeDef element;
+    element.IdType       = extended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+    element.FilterIndex  = extended ? inst->ext_user_elements : inst->std_user_elements;
+    element.FilterConfig = (inst->rx_fifo_mode == RXFIFO_Single) ? FDCAN_FILTER_TO_RXFIFO1 : FDCAN_FILTER_TO_RXFIFO0;
+
+    uint32_t index  = 0;
+    uint32_t single = ID_LIST_EMPTY; // a single ID that waits for a second one to fill a DUAL element
+    uint32_t ID;
+    *false_pos = 0;
+
+    bool more = can_get_next_list_id(inst, extended, &index, &ID);
+    while (more || single != ID_LIST_EMPTY)
+    {
+        if (!more) // the last single ID remains --> DUAL element with the same ID twice
+        {
+            element.FilterType = FDCAN_FILTER_DUAL;
+            element.FilterID1  = single;
+            element.FilterID2  = single;
+            single = ID_LIST_EMPTY;
+        }
+        else
+        {
+            uint32_t first = ID;
+            uint32_t last  = ID;
+            uint32_t count = 1;
+            while ((more = can_get_next_list_id(inst, extended, &index, &ID)) && ID - last - 1 <= max_gap)
+            {
+                last = ID;
+                count ++;
+            }
+
+            if (count == 1)
+            {
+                if (single == ID_LIST_EMPTY)
+                {
+                    single = first; // wait for the next single ID
+                    continue;
+                }
+                element.FilterType = FDCAN_FILTER_DUAL; // two single IDs in one element
+                element.FilterID1  = single;
+                element.FilterID2  = first;
+                single = ID_LIST_EMPTY;
+            }
+            else if (count == 2)
+            {
+                element.FilterType = FDCAN_FILTER_DUAL; // exact match of both IDs
+                element.FilterID1  = first;
+                element.FilterID2  = last;
+            }
+            else
+            {
+                element.FilterType = FDCAN_FILTER_RANGE;
+                element.FilterID1  = first;
+                element.FilterID2  = last;
+                *false_pos += last - first + 1 - count;
+            }
+        }
+
+        if (apply && HAL_FDCAN_ConfigFilter(&inst->handle, &element) != HAL_OK)
+            return -1; // error detail in inst->handle.ErrorCode
+
+        element.FilterIndex ++;
+    }
+    return element.FilterIndex - (extended ? inst->ext_user_elements : inst->std_user_elements);
+}
+
+// Get the next ID of the host ID list in ascending order.
+// index = 0 returns the first ID. Returns false if there are no more IDs.
+bool can_get_next_list_id(can_class* inst, bool extended, uint32_t* index, uint32_t* ID)
+{
+    if (extended) // id_sort_buf has been filled in can_compile_host_id_list()
+    {
+        if (*index >= inst->id_list_ext_count)
+            return false;
+
+        *ID = id_sort_buf[(*index)++];
+        return true;
+    }
+
+    for (uint32_t I = *index; I < 0x800; I++)
+    {
+        if (inst->id_list_std[I >> 3] == 0)
+        {
+            I |= 7; // skip 8 IDs
+            continue;
+        }
+        if (inst->id_list_std[I >> 3] & (1 << (I & 7)))
+        {
+            *ID    = I;
+            *index = I + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Check if the CAN ID of a Rx packet is in the host ID list.
+// This is called for each Rx packet --> must be fast.
+bool can_is_in_host_id_list(can_class* inst, FDCAN_RxHeaderTypeDef* header)
+{
+    uint32_t ID = header->Identifier;
+    if (header->IdType == FDCAN_STANDARD_ID)
+        return (inst->id_list_std[(ID >> 3) & 0xFF] & (1 << (ID & 7))) != 0;
+
+    if (inst->id_list_ext_count == 0)
+        return false;
+
+    // The hash set is never full, so there is always an empty slot that ends the search.
+    for (uint32_t slot = can_hash_id(ID, ID_LIST_EXT_BITS); true; slot = (slot + 1) & (ID_LIST_EXT_SIZE - 1))
+    {
+        uint32_t cur_ID = inst->id_list_ext[slot];
+        if (cur_ID == ID)            return true;
+        if (cur_ID == ID_LIST_EMPTY) return false;
+    }
+}
+
+// -------------------------------------- ID STATISTICS ------------------------------------------
+
+// Enable the per-ID statistics for max_entries CAN IDs (11 bit and 29 bit), max_entries = 0 disables them.
+// stream = false --> received frames are only counted, but not sent to the host (bus monitoring without USB load).
+// The adapter must be closed because the hardware must not reject any packets (see can_compile_host_id_list()).
+eFeedback can_set_id_stats(uint8_t channel, uint32_t max_entries, bool stream)
 {
     can_class* inst = &can_inst[channel];
 
-    int tot_filters = inst->std_filter_count + inst->ext_filter_count;
-    if (tot_filters >= MAX_HOST_FILTERS)
-        return FBK_ParamOutOfRange;
+    if (inst->is_open)
+        return FBK_AdapterMustBeClosed;
 
-    uint32_t maximum = extended ? 0x1FFFFFFF : 0x7FF;
-    if (filter > maximum || mask > maximum)
+    if (max_entries > ID_STATS_MAX)
         return FBK_ParamOutOfRange;
 
-    if (inst->is_open)
+    // the smallest hash set that is filled to 75% at maximum with max_entries
+    uint32_t bits = 0;
+    if (max_entries > 0)
     {
-        // only one existing filter can be modified if the adapter is already open
-        if (tot_filters != 1)
-            return FBK_AdapterMustBeClosed;
+        bits = 2;
+        while ((1u << bits) * 3 / 4 < max_entries)
+        {
+            bits ++;
+        }
+    }
 
-        // the filter to be modified must be from the same type
-        if (extended != (inst->ext_filter_count == 1))
-            return FBK_AdapterMustBeClosed;
+    inst->id_stats_bits      = bits;
+    inst->id_stats_no_stream = !stream && bits > 0;
+    can_erase_id_stats(inst);
+    return FBK_Success;
+}
 
-        // modify the one and only filter at index 0
-        inst->ext_filter_count = 0;
-        inst->std_filter_count = 0;
-        tot_filters = 0;
+// Clear all entries. This may be called while the adapter is open, also from the USB interrupt.
+eFeedback can_clear_id_stats(uint8_t channel)
+{
+    can_class* inst = &can_inst[channel];
+    if (inst->id_stats_bits == 0)
+        return FBK_InvalidCommand; // statistics not enabled
+
+    if (inst->is_open) inst->id_stats_clear = true; // executed in can_update_id_stats()
+    else               can_erase_id_stats(inst);
+    return FBK_Success;
+}
+
+// Set 'slot' to the first slot of one page, then read the entries with can_next_id_stat_entry().
+// Pages are counted over the used slots of the hash set. A page after the last entry has no entries.
+// The entries are read one by one because a static buffer for a whole page costs RAM that the STM32G431 does not have.
+eFeedback can_get_id_stats(uint8_t channel, uint32_t page, uint32_t* slot, uint32_t* total, uint32_t* lost)
+{
+    can_class* inst = &can_inst[channel];
+    if (inst->id_stats_bits == 0)
+        return FBK_InvalidCommand; // statistics not enabled
+
+    uint32_t skip = page * ID_STATS_PAGE_SIZE;
+    uint32_t S    = 0;
+    for (; S < (1u << inst->id_stats_bits); S++)
+    {
+        if (inst->id_stats[S].key == ID_LIST_EMPTY)
+            continue;
+
+        if (skip == 0)
+            break;
+        skip --;
     }
 
-    FDCAN_FilterTypeDef* last_filter = &inst->host_filters[tot_filters];
-    last_filter->IdType       = extended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
-    last_filter->FilterIndex  = extended ? inst->ext_filter_count : inst->std_filter_count;
-    last_filter->FilterType   = FDCAN_FILTER_MASK;
-    last_filter->FilterConfig = FDCAN_FILTER_TO_RXFIFO0;
-    last_filter->FilterID1    = filter;
-    last_filter->FilterID2    = mask;
+    *slot  = S;
+    *total = inst->id_stats_count;
+    *lost  = inst->id_stats_lost;
+    return FBK_Success;
+}
 
-    if (extended) inst->ext_filter_count ++;
-    else          inst->std_filter_count ++;
+// Copy the next used slot at or behind 'slot' into 'entry' and advance 'slot' behind it.
+// Returns false if there are no more entries.
+// While the adapter is open the entries are modified in can_process(), a single entry may be read while it is updated.
+bool can_next_id_stat_entry(uint8_t channel, uint32_t* slot, id_stat_entry* entry)
+{
+    can_class* inst = &can_inst[channel];
+    for (uint32_t S=*slot; S < (1u << inst->id_stats_bits); S++)
+    {
+        if (inst->id_stats[S].key == ID_LIST_EMPTY)
+            continue;
 
-    if (inst->is_open && !can_apply_host_filters(inst))
-        return FBK_ErrorFromHAL;
+        *entry = inst->id_stats[S];
+        *slot  = S + 1;
+        return true;
+    }
+    *slot = 1u << inst->id_stats_bits;
+    return false;
+}
+
+void can_erase_id_stats(can_class* inst)
+{
+    for (uint32_t S=0; S<ID_STATS_SIZE; S++)
+    {
+        inst->id_stats[S].key = ID_LIST_EMPTY;
+    }
+    inst->id_stats_count = 0;
+    inst->id_stats_lost  = 0;
+    inst->id_stats_clear = false;
+}
+
+// Count a received packet in the per-ID statistics.
+// This is called for each Rx packet --> must be fast.
+void can_update_id_stats(can_class* inst, FDCAN_RxHeaderTypeDef* header)
+{
+    if (inst->id_stats_clear)
+        can_erase_id_stats(inst);
+
+    uint32_t key  = header->Identifier;
+    uint32_t bits = inst->id_stats_bits;
+    if (header->IdType == FDCAN_EXTENDED_ID)
+        key |= BRG_KEY_29BIT;
+
+    // The hash set is never full, so there is always an empty slot that ends the search.
+    for (uint32_t slot = can_hash_id(key, bits); true; slot = (slot + 1) & ((1 << bits) - 1))
+    {
+        id_stat_entry* entry = &inst->id_stats[slot];
+        if (entry->key == key)
+        {
+            uint32_t period = header->RxTimestamp - entry->last_stamp;
+            entry->min_period  = (entry->count == 1) ? period : MIN(entry->min_period, period);
+            entry->max_period  = MAX(entry->max_period, period);
+            entry->sum_period += period;
+            entry->last_stamp  = header->RxTimestamp;
+            entry->last_dlc    = header->DataLength;
+            if (entry->count < 0xFFFFFFFF) entry->count ++;
+            return;
+        }
+
+        if (entry->key == ID_LIST_EMPTY)
+        {
+            if (inst->id_stats_count >= (1u << bits) * 3 / 4)
+            {
+                inst->id_stats_lost ++; // table full
+                return;
+            }
+
+            memset(entry, 0, sizeof(id_stat_entry));
+            entry->key        = key;
+            entry->count      = 1;
+            entry->last_stamp = header->RxTimestamp;
+            entry->last_dlc   = header->DataLength;
+            inst->id_stats_count ++;
+            return;
+        }
+    }
+}
+
+// ------------------------------------- CYCLIC TRANSMIT -----------------------------------------
+
+// Set a periodic Tx packet of the cyclic transmit scheduler, times in s. period = 0 removes the entry.
+// This may be called while the adapter is open, also from the USB interrupt.
+// phase = offset of the first transmission after opening the adapter or after setting the entry.
+// If the entry is in use with the same period and phase, only the packet is replaced and the cycle continues without a gap.
+// In this case also the rolling counter continues, the counter bits in tx_data are ignored.
+// counter_byte  = data byte with a rolling counter (the bits in counter_mask) that is incremented after each transmission.
+// checksum_byte = data byte that receives the 8 bit sum or XOR of all other data bytes before each transmission.
+eFeedback can_set_cyclic(uint8_t channel, uint8_t index, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t period, uint32_t phase,
+                         uint8_t counter_byte, uint8_t counter_mask, uint8_t checksum_byte, bool checksum_xor)
+{
+    can_class* inst = &can_inst[channel];
+    if (index >= CYC_MAX_ENTRIES)
+        return FBK_ParamOutOfRange;
+
+    cyc_entry* entry = &inst->cyclic[index];
+    if (period == 0)
+    {
+        // the scheduler interrupt must not send the entry while it is removed
+        system_disable_irq();
+        if (entry->period > 0) inst->cyclic_count --;
+        entry->period = 0;
+        system_enable_irq();
+        return FBK_Success;
+    }
+
+    // The scheduler compares timestamps as signed 32 bit values
+    if (period < CYC_MIN_PERIOD || period > 0x7FFFFFFF || phase > 0x7FFFFFFF)
+        return FBK_ParamOutOfRange;
 
+    if (tx_header->FDFormat == FDCAN_FD_CAN && !can_using_FD(channel))
+        return FBK_BaudrateNotSet;
+
+    // remote frames do not send data bytes
+    int byte_count = (tx_header->TxFrameType == FDCAN_REMOTE_FRAME) ? 0 : utils_dlc_to_byte_count(tx_header->DataLength);
+    if ((counter_byte  != CYC_NONE && (counter_byte  >= byte_count || counter_mask == 0)) ||
+        (checksum_byte != CYC_NONE && (checksum_byte >= byte_count || checksum_byte == counter_byte)))
+        return FBK_InvalidParameter;
+
+    // the scheduler interrupt must not send the entry while it is modified
+    system_disable_irq();
+
+    bool continue_cycle = entry->period == period && entry->phase == phase;
+    bool keep_counter   = continue_cycle && counter_byte != CYC_NONE && entry->counter_byte == counter_byte && entry->counter_mask == counter_mask;
+    uint8_t old_counter = keep_counter ? entry->data[counter_byte] : 0;
+
+    if (entry->period == 0)
+        inst->cyclic_count ++;
+
+    memcpy(&entry->header, tx_header, sizeof(FDCAN_TxHeaderTypeDef));
+    memcpy(entry->data, tx_data, byte_count);
+    if (keep_counter)
+        entry->data[counter_byte] = (entry->data[counter_byte] & ~counter_mask) | (old_counter & counter_mask);
+
+    entry->header.ErrorStateIndicator = FDCAN_ESI_ACTIVE;
+    entry->header.TxEventFifoControl  = FDCAN_STORE_TX_EVENTS; // always! Tx Event flashes the Tx LED
+    entry->header.MessageMarker       = 0;                     // no Tx echo for cyclic packets
+    entry->counter_byte  = counter_byte;
+    entry->counter_mask  = counter_mask;
+    entry->checksum_byte = checksum_byte;
+    entry->checksum_xor  = checksum_xor;
+    entry->phase         = phase;
+    entry->period        = period;
+    entry->restart      |= !continue_cycle;
+
+    system_enable_irq();
+
+    // trigger the scheduler interrupt that calculates the next transmission
+    TIM3->EGR = TIM_EGR_CC1G;
     return FBK_Success;
 }
 
-// Store all user filters in can_filters into the processor's memory
-bool can_apply_host_filters(can_class* inst)
+// Remove all cyclic packets. This may be called while the adapter is open, also from the USB interrupt.
+eFeedback can_clear_cyclic(uint8_t channel)
 {
-    // the user can define up to 8 filters
-    int tot_filters = inst->std_filter_count + inst->ext_filter_count;
-    for (int i=0; i<tot_filters; i++)
+    can_class* inst = &can_inst[channel];
+
+    system_disable_irq();
+    for (int i=0; i<CYC_MAX_ENTRIES; i++)
     {
-        if (HAL_FDCAN_ConfigFilter(&inst->handle, &inst->host_filters[i]) != HAL_OK)
-            return false; // error detail in inst->handle.ErrorCode
+        inst->cyclic[i].period = 0;
     }
-    return true;
+    inst->cyclic_count = 0;
+    system_enable_irq();
+    return FBK_Success;
 }
 
-// clear all host filters (adapter must be open)
-eFeedback can_clear_host_filters(uint8_t channel)
+// Send a single Tx packet at the absolute timestamp send_time in s. This is the same time base as the Rx timestamps and the Tx echo.
+// This may be called from the main loop (Slcan) and from the USB interrupt (Candlelight).
+// At send_time the scheduler interrupt puts the packet into the Tx FIFO if no other packets are waiting, otherwise into the Tx buffer.
+// Timestamps are compared as signed 32 bit values: a send_time in the past (up to 35 minutes) sends the packet immediately.
+eFeedback can_send_timed(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t send_time)
 {
+    eFeedback e_Ret = can_is_tx_allowed(channel);
+    if (e_Ret != FBK_Success)
+        return e_Ret;
+
     can_class* inst = &can_inst[channel];
 
-    if (inst->is_open)
-        return FBK_AdapterMustBeClosed; // cannot clear filters while on bus
+    // remote frames do not send data bytes
+    int byte_count = (tx_header->TxFrameType == FDCAN_REMOTE_FRAME) ? 0 : utils_dlc_to_byte_count(tx_header->DataLength);
+
+    // the scheduler interrupt must not send from the queue while a packet is added
+    system_disable_irq();
+    if (inst->timed_count >= TIMED_QUEUE_SIZE)
+    {
+        system_enable_irq();
+        return FBK_TxBufferFull;
+    }
+
+    timed_entry* entry = &inst->timed[inst->timed_count];
+    memcpy(&entry->header, tx_header, sizeof(FDCAN_TxHeaderTypeDef));
+    memcpy(entry->data, tx_data, byte_count);
+    entry->send_time = send_time;
+    inst->timed_count ++;
+    system_enable_irq();
 
-    inst->ext_filter_count = 0;
-    inst->std_filter_count = 0;
+    // trigger the scheduler interrupt that calculates the next transmission
+    TIM3->EGR = TIM_EGR_CC1G;
     return FBK_Success;
 }
 
+// Timer 3 compare interrupt: send all cyclic and timed packets that are due and set the compare register to the next due time.
+// The main loop blocks this interrupt in can_block_tx_interrupt() while it modifies the Tx FIFO or the Tx buffer.
+void can_scheduler_interrupt()
+{
+    // The flag is cleared by writing 0, writing 1 has no effect
+    TIM3->SR = ~TIM_SR_CC1IF;
+
+    uint32_t now  = system_get_timestamp();
+    uint32_t wait = 0x8000; // the compare register has only 16 bit --> check again after 32 ms at the latest
+    for (int C=0; C<CHANNEL_COUNT; C++)
+    {
+        can_class* inst = &can_inst[C];
+        if (!inst->is_open)
+            continue;
+
+        for (int i=0; inst->cyclic_count > 0 && i<CYC_MAX_ENTRIES; i++)
+        {
+            cyc_entry* entry = &inst->cyclic[i];
+            if (entry->period == 0)
+                continue;
+
+            if (entry->restart)
+            {
+                entry->restart  = false;
+                entry->next_due = now + entry->phase;
+            }
+
+            if ((int32_t)(now - entry->next_due) >= 0)
+            {
+                can_send_cyclic(C, entry);
+
+                // If the interrupt was blocked longer than one period, the missed cycles are skipped instead of sending a burst.
+                uint32_t late = now - entry->next_due;
+                entry->next_due += (late / entry->period + 1) * entry->period;
+            }
+            wait = MIN(wait, entry->next_due - now);
+        }
+
+        // The timed packets are not sorted. Send all packets that are due, the earliest first.
+        while (inst->timed_count > 0)
+        {
+            timed_entry* first = &inst->timed[0];
+            for (uint32_t i=1; i<inst->timed_count; i++)
+            {
+                if ((int32_t)(inst->timed[i].send_time - first->send_time) < 0)
+                    first = &inst->timed[i];
+            }
+
+            int32_t remain = first->send_time - now;
+            if (remain > 0)
+            {
+                wait = MIN(wait, (uint32_t)remain);
+                break;
+            }
+
+            // In silent mode, bus off or with a full Tx buffer the packet is discarded like a packet with an expired time-to-live.
+            // The host receives the marker, so it does not wait eternally for the Tx echo.
+            if (!can_send_scheduled(C, &first->header, first->data))
+            {
+                if ((GLB_UserFlags[C] & USR_TxEcho) && first->header.MessageMarker > 0)
+                    buf_store_tx_expired(C, first->header.MessageMarker);
+
+                error_assert(C, APP_CanTxFail, false);
+            }
+
+            // move the last packet into the free slot
+            inst->timed_count --;
+            if (first != &inst->timed[inst->timed_count])
+                memcpy(first, &inst->timed[inst->timed_count], sizeof(timed_entry));
+        }
+    }
+
+    uint32_t next = now + wait;
+    TIM3->CCR1 = (uint16_t)next;
+
+    // If the next packet became due while this interrupt was executed, the compare match is missed --> trigger it by software.
+    if ((int32_t)(system_get_timestamp() - next) >= 0)
+        TIM3->EGR = TIM_EGR_CC1G;
+}
+
+// Calculate the checksum of a cyclic packet, send it and increment the rolling counter.
+// Called from the scheduler interrupt.
+void can_send_cyclic(uint8_t channel, cyc_entry* entry)
+{
+    uint8_t* data = entry->data;
+    if (entry->checksum_byte != CYC_NONE)
+    {
+        uint8_t checksum   = 0;
+        int     byte_count = utils_dlc_to_byte_count(entry->header.DataLength);
+        for (int i=0; i<byte_count; i++)
+        {
+            if (i == entry->checksum_byte)
+                continue;
+
+            if (entry->checksum_xor) checksum ^= data[i];
+            else                     checksum += data[i];
+        }
+        data[entry->checksum_byte] = checksum;
+    }
+
+    // can_send_packet() may modify the header
+    FDCAN_TxHeaderTypeDef tx_header = entry->header;
+    if (!can_send_scheduled(channel, &tx_header, data))
+        return;
+
+    if (entry->counter_byte != CYC_NONE)
+    {
+        // Adding the lowest bit of the mask increments the counter, the carry out of the mask is cut off.
+        uint8_t mask = entry->counter_mask;
+        uint8_t cur  = data[entry->counter_byte];
+        data[entry->counter_byte] = (cur & ~mask) | ((cur + (mask & -mask)) & mask);
+    }
+}
+
+// Send a packet of the scheduler directly into the Tx FIFO if no other packets are waiting, otherwise store it in the Tx buffer.
+// Called from the scheduler interrupt. Returns false in silent mode, bus off or if the Tx buffer is full.
+bool can_send_scheduled(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
+    if (can_is_tx_allowed(channel) != FBK_Success)
+        return false;
+
+    if (buf_is_tx_buffer_empty(channel) && can_is_tx_fifo_free(channel))
+    {
+        can_send_packet(channel, tx_header, tx_data);
+        return true;
+    }
+
+    if (buf_is_tx_buffer_full(channel))
+    {
+        error_assert(channel, APP_CanTxOverflow, false);
+        return false;
+    }
+
+    buf_store_tx_packet(channel, tx_header, tx_data);
+    return true;
+}
+
 // -------------------------------------- BRIDGE FILTER ------------------------------------------
 
 // Set or remove a specific bridge filter for Rx packets to be forwarded from src_channel to dest_channel.
@@ -773,73 +2535,318 @@ eFeedback can_set_bridge_filter(uint8_t src_channel, uint8_t dest_channel, uint8
         uint32_t maximum = extended ? 0x1FFFFFFF : 0x7FF;
         if (filter > maximum || mask > maximum)
             return FBK_ParamOutOfRange;
+
+        // USR_RxDualFifo: the packets rejected by the host filters are not stored, so they cannot be forwarded (see can_select_rx_fifo_mode())
+        if (!block && inst->is_open && inst->reject_elements > 0)
+            return FBK_AdapterMustBeClosed;
     }
     else // clear filter
     {
         // Index == 0xFF --> clear all filters
         if (filter_index == 0xFF)
         {
-            inst->bridge_active = false;
-            memset(&inst->bridge_filters, 0, sizeof(inst->bridge_filters));
-            return FBK_Success;
+            inst->bridge_active = false;
+            memset(&inst->bridge_filters, 0, sizeof(inst->bridge_filters));
+            inst->bridge_routes_dirty = true;
+            return FBK_Success;
+        }
+    }
+
+    if (filter_index >= MAX_BRIDGE_FILTERS)
+        return FBK_ParamOutOfRange;
+
+    brg_filter* cur_filter = &inst->bridge_filters[filter_index];
+    cur_filter->enabled   = enable;
+    cur_filter->extended  = extended;
+    cur_filter->block     = block;
+    cur_filter->dest_chan = dest_channel;
+    cur_filter->filter    = filter & mask;
+    cur_filter->mask      = mask;
+
+    bool active = false;
+    for (int F=0; F<MAX_BRIDGE_FILTERS; F++)
+    {
+        if (inst->bridge_filters[F].enabled && !inst->bridge_filters[F].block)
+        {
+            active = true;
+            break;
+        }
+    }
+    
+    // The variable bridge_active is only for speed optimization if bridge mode is not used.    
+    // It is set immediately because can_select_rx_fifo_mode() needs it when the adapter is opened.
+    // Until can_process() has compiled the new routing table the packets are forwarded with the previous one.
+    inst->bridge_active       = active;
+    inst->bridge_routes_dirty = true;
+    return FBK_Success;
+#else
+    return FBK_UnsupportedFeature; // not a multi-channel adapter
+#endif
+}
+
+// Set a bridge translation (gateway mode) for packets that are forwarded from src_channel to other channels.
+// The CAN ID src_id is replaced with dest_id, a 11 bit ID may be translated into a 29 bit ID and vice versa.
+// keep, replace and xor_bits are optional (NULL) and modify the data bytes 0...7: data = ((data & keep) | (replace & ~keep)) ^ xor_bits
+// Translating an ID that already has a translation replaces it.
+// This function can also be called after the adapter has been opened.
+eFeedback can_set_bridge_translation(uint8_t src_channel, bool src_ext, uint32_t src_id, bool dest_ext, uint32_t dest_id,
+                                     uint8_t* keep, uint8_t* replace, uint8_t* xor_bits)
+{
+#if CHANNEL_COUNT > 1
+    can_class* inst = &can_inst[src_channel];
+
+    if (src_id  > (src_ext  ? 0x1FFFFFFF : 0x7FF) ||
+        dest_id > (dest_ext ? 0x1FFFFFFF : 0x7FF))
+        return FBK_ParamOutOfRange;
+
+    brg_translation* trans = can_add_bridge_translation(inst, src_ext ? (src_id | BRG_KEY_29BIT) : src_id);
+    if (!trans)
+        return FBK_ParamOutOfRange; // hash set is full
+
+    trans->dest_id     = dest_id;
+    trans->dest_ext    = dest_ext;
+    trans->modify_data = false;
+    for (int B=0; B<8; B++)
+    {
+        trans->keep    [B] = keep     ? keep    [B] : 0xFF;
+        trans->replace [B] = replace  ? replace [B] : 0;
+        trans->xor_bits[B] = xor_bits ? xor_bits[B] : 0;
+
+        if (trans->keep[B] != 0xFF || trans->xor_bits[B] != 0)
+            trans->modify_data = true;
+    }
+    return FBK_Success;
+#else
+    return FBK_UnsupportedFeature; // not a multi-channel adapter
+#endif
+}
+
+// Limit the count of packets with the CAN ID that are forwarded from src_channel to other channels.
+// rate = packets per second (0 = unlimited), burst = packets that may be forwarded at once after a pause.
+// Packets exceeding the limit are dropped. If the CAN ID has no translation, a translation is created that does not modify the packet.
+eFeedback can_set_bridge_id_limit(uint8_t src_channel, bool extended, uint32_t ID, uint32_t rate, uint32_t burst)
+{
+#if CHANNEL_COUNT > 1
+    if (ID > (extended ? 0x1FFFFFFF : 0x7FF) || (rate > 0 && burst == 0) || burst > 255)
+        return FBK_ParamOutOfRange;
+
+    brg_translation* trans = can_add_bridge_translation(&can_inst[src_channel], extended ? (ID | BRG_KEY_29BIT) : ID);
+    if (!trans)
+        return FBK_ParamOutOfRange; // hash set is full
+
+    can_init_bucket(&trans->bucket, rate, burst);
+    return FBK_Success;
+#else
+    return FBK_UnsupportedFeature; // not a multi-channel adapter
+#endif
+}
+
+// Limit the count of packets that other channels forward to dest_channel (all CAN IDs).
+// rate = packets per second (0 = unlimited), burst = packets that may be forwarded at once after a pause.
+// latest_wins = a forwarded packet overwrites a forwarded packet with the same CAN ID that is still waiting in the Tx buffer.
+// This avoids a Tx buffer overflow if a fast CAN FD bus is bridged to a slow classic CAN bus.
+eFeedback can_set_bridge_dest_limit(uint8_t dest_channel, uint32_t rate, uint32_t burst, bool latest_wins)
+{
+#if CHANNEL_COUNT > 1
+    if ((rate > 0 && burst == 0) || burst > 255)
+        return FBK_ParamOutOfRange;
+
+    can_class* inst = &can_inst[dest_channel];
+    can_init_bucket(&inst->fwd_bucket, rate, burst);
+    inst->fwd_latest_wins = latest_wins;
+    return FBK_Success;
+#else
+    return FBK_UnsupportedFeature; // not a multi-channel adapter
+#endif
+}
+
+// Enable the tunnel on a channel that connects two multi-channel adapters.
+// Classic frames that other channels forward to this channel are packed into CAN FD tunnel frames with the CAN ID tunnel_id,
+// if this channel uses CAN FD. A tunnel frame is sent when it is full or when its oldest frame has waited 'window' s.
+// CAN FD frames with more than 8 bytes that other channels forward to this channel are split into classic tunnel frames,
+// if this channel uses classic CAN.
+// Tunnel frames received on this channel are unpacked and forwarded with the bridge filters of this channel.
+// Both adapters must use the same tunnel ID.
+eFeedback can_set_tunnel(uint8_t channel, bool enable, bool extended, uint32_t tunnel_id, uint32_t window)
+{
+#if CHANNEL_COUNT > 1
+    if (can_is_open(channel))
+        return FBK_AdapterMustBeClosed;
+
+    if (tunnel_id > (extended ? 0x1FFFFFFF : 0x7FF) || window > 1000000)
+        return FBK_ParamOutOfRange;
+
+    can_class* inst = &can_inst[channel];
+    inst->tunnel_enabled = enable;
+    inst->tunnel_ext     = extended;
+    inst->tunnel_id      = tunnel_id;
+    inst->tunnel_window  = window;
+    return FBK_Success;
+#else
+    return FBK_UnsupportedFeature; // not a multi-channel adapter
+#endif
+}
+
+// Remove all bridge translations of the source channel
+eFeedback can_clear_bridge_translations(uint8_t src_channel)
+{
+#if CHANNEL_COUNT > 1
+    can_class* inst = &can_inst[src_channel];
+    inst->translation_count = 0;
+    for (int S=0; S<BRG_TRANSLATE_SIZE; S++)
+    {
+        inst->translations[S].src_key = ID_LIST_EMPTY;
+    }
+    return FBK_Success;
+#else
+    return FBK_UnsupportedFeature; // not a multi-channel adapter
+#endif
+}
+
+#if CHANNEL_COUNT > 1
+// Compile all bridge filters of a source channel into the routing table.
+// 11 bit filters: each filter sets the pass or block bit of its destination channel for all 2048 IDs that it matches.
+// 29 bit filters: filters with the same mask and filter are combined into one route, the routes are sorted by mask and filter.
+void can_compile_bridge_routes(can_class* inst)
+{
+    memset(inst->route_std, 0, sizeof(inst->route_std));
+    inst->route_ext_count   = 0;
+    inst->route_group_count = 0;
+
+    for (int F=0; F<MAX_BRIDGE_FILTERS; F++)
+    {
+        brg_filter* cur_filter = &inst->bridge_filters[F];
+        if (!cur_filter->enabled)
+            continue;
+
+        uint8_t chan_bit = 1 << cur_filter->dest_chan;
+        if (!cur_filter->extended)
+        {
+            // enumerate all IDs that match: filter | all combinations of the bits that are not in the mask
+            uint8_t  route_bit = cur_filter->block ? (chan_bit << 4) : chan_bit;
+            uint32_t free_bits = ~cur_filter->mask & 0x7FF;
+            uint32_t sub_bits  = 0;
+            do
+            {
+                inst->route_std[cur_filter->filter | sub_bits] |= route_bit;
+                sub_bits = (sub_bits - free_bits) & free_bits; // next combination of free_bits
+            }
+            while (sub_bits != 0);
+            continue;
+        }
+
+        // insertion sort into route_ext ordered by mask, then by filter
+        int pos = 0;
+        while (pos < inst->route_ext_count &&
+              (inst->route_ext[pos].mask < cur_filter->mask ||
+              (inst->route_ext[pos].mask == cur_filter->mask && inst->route_ext[pos].filter < cur_filter->filter)))
+        {
+            pos ++;
+        }
+
+        brg_route* route = &inst->route_ext[pos];
+        if (pos == inst->route_ext_count || route->mask != cur_filter->mask || route->filter != cur_filter->filter)
+        {
+            memmove(route + 1, route, (inst->route_ext_count - pos) * sizeof(brg_route));
+            inst->route_ext_count ++;
+            route->filter = cur_filter->filter;
+            route->mask   = cur_filter->mask;
+            route->pass   = 0;
+            route->block  = 0;
         }
+
+        if (cur_filter->block) route->block |= chan_bit;
+        else                   route->pass  |= chan_bit;
     }
 
-    if (filter_index >= MAX_BRIDGE_FILTERS)
-        return FBK_ParamOutOfRange;
+    // find the groups with the same mask
+    for (int R=0; R<inst->route_ext_count; R++)
+    {
+        if (R == 0 || inst->route_ext[R].mask != inst->route_ext[R - 1].mask)
+            inst->route_group_start[inst->route_group_count ++] = R;
+    }
+    inst->route_group_start[inst->route_group_count] = inst->route_ext_count;
+}
 
-    brg_filter* cur_filter = &inst->bridge_filters[filter_index];
-    cur_filter->enabled   = enable;
-    cur_filter->extended  = extended;
-    cur_filter->block     = block;
-    cur_filter->dest_chan = dest_channel;
-    cur_filter->filter    = filter & mask;
-    cur_filter->mask      = mask;
+// Returns a bit mask with the destination channels to which the packet must be forwarded.
+uint8_t can_get_bridge_route(can_class* inst, bool extended, uint32_t ID)
+{
+    if (!extended)
+    {
+        uint8_t route = inst->route_std[ID & 0x7FF];
+        return route & ~(route >> 4) & 0x0F;
+    }
 
-    bool active = false;
-    for (int F=0; F<MAX_BRIDGE_FILTERS; F++)
+    uint8_t pass  = 0;
+    uint8_t block = 0;
+    for (int G=0; G<inst->route_group_count; G++)
     {
-        if (inst->bridge_filters[F].enabled && !inst->bridge_filters[F].block)
+        int low  = inst->route_group_start[G];
+        int high = inst->route_group_start[G + 1] - 1;
+        uint32_t masked = ID & inst->route_ext[low].mask;
+
+        // binary search for the filter in the group
+        while (low <= high)
         {
-            active = true;
-            break;
+            int mid = (low + high) / 2;
+            brg_route* route = &inst->route_ext[mid];
+            if (route->filter == masked)
+            {
+                pass  |= route->pass;
+                block |= route->block;
+                break;
+            }
+            if (route->filter < masked) low  = mid + 1;
+            else                        high = mid - 1;
         }
     }
-    
-    // The variable bridge_active is only for speed optimization if bridge mode is not used.    
-    inst->bridge_active = active;
-    return FBK_Success;
-#else
-    return FBK_UnsupportedFeature; // not a multi-channel adapter
-#endif
+    return pass & ~block;
 }
 
-#if CHANNEL_COUNT > 1
 // Forward a Rx packet to the channel(s) that are defined in the bridge filter(s)
 void can_forward_bridge_packet(can_class* inst, FDCAN_RxHeaderTypeDef* rx_header, uint8_t* rx_data)
 {
     bool extended = rx_header->IdType == FDCAN_EXTENDED_ID;
-    uint32_t ID   = rx_header->Identifier;
-
-    bool pass_chan [CHANNEL_COUNT] = {0};
-    bool block_chan[CHANNEL_COUNT] = {0};
+    uint8_t dest_chans = can_get_bridge_route(inst, extended, rx_header->Identifier);
+    if (dest_chans == 0)
+        return;
 
-    for (int i=0; i<MAX_BRIDGE_FILTERS; i++)
+    uint32_t tick_now = HAL_GetTick();
+    uint32_t dest_id  = rx_header->Identifier;
+    uint32_t dest_ide = rx_header->IdType;
+    uint8_t* tx_data  = rx_data;
+    uint8_t  __aligned(4) mod_data[64]; // passed to can_write_tx_element()
+    if (inst->translation_count > 0)
     {
-        brg_filter* cur_filter = &inst->bridge_filters[i];
-
-        if (cur_filter->enabled &&
-            cur_filter->extended   == extended &&
-           (ID & cur_filter->mask) == cur_filter->filter)
+        brg_translation* trans = can_find_bridge_translation(inst, extended ? (dest_id | BRG_KEY_29BIT) : dest_id);
+        if (trans)
         {
-            if (cur_filter->block) block_chan[cur_filter->dest_chan] = true;
-            else                   pass_chan [cur_filter->dest_chan] = true;
+            if (!can_take_bucket_token(&trans->bucket, tick_now))
+            {
+                inst->fwd_dropped_count ++;
+                return;
+            }
+
+            dest_id  = trans->dest_id;
+            dest_ide = trans->dest_ext ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+
+            // The data is modified in a copy, because can_process() still needs the received data for the exact bus load.
+            if (trans->modify_data && rx_header->RxFrameType == FDCAN_DATA_FRAME)
+            {
+                int byte_count = utils_dlc_to_byte_count(rx_header->DataLength);
+                memcpy(mod_data, rx_data, byte_count);
+                for (int B=0; B<MIN(8, byte_count); B++)
+                {
+                    mod_data[B] = ((mod_data[B] & trans->keep[B]) | (trans->replace[B] & ~trans->keep[B])) ^ trans->xor_bits[B];
+                }
+                tx_data = mod_data;
+            }
         }
     }
 
     FDCAN_TxHeaderTypeDef tx_header;
-    tx_header.Identifier          = rx_header->Identifier;
-    tx_header.IdType              = rx_header->IdType;
+    tx_header.Identifier          = dest_id;
+    tx_header.IdType              = dest_ide;
     tx_header.TxFrameType         = rx_header->RxFrameType;
     tx_header.DataLength          = rx_header->DataLength;
     tx_header.ErrorStateIndicator = rx_header->ErrorStateIndicator;
@@ -848,9 +2855,10 @@ void can_forward_bridge_packet(can_class* inst, FDCAN_RxHeaderTypeDef* rx_header
 
     for (int C=0; C<CHANNEL_COUNT; C++)
     {
-        if (!pass_chan[C] || block_chan[C] || !can_is_open(C))
+        if ((dest_chans & (1 << C)) == 0 || !can_is_open(C))
             continue;
         
+        can_class* dest = &can_inst[C];
         if (can_using_FD(C))
         {
             tx_header.FDFormat      = rx_header->FDFormat;            
@@ -858,8 +2866,8 @@ void can_forward_bridge_packet(can_class* inst, FDCAN_RxHeaderTypeDef* rx_header
         }
         else
         {
-            // a packet with more than 8 data bytes cannot be forwarded to a classic CAN bus
-            if (tx_header.DataLength > 8)
+            // A packet with more than 8 data bytes cannot be forwarded to a classic CAN bus, except in fragments through a tunnel.
+            if (tx_header.DataLength > 8 && !dest->tunnel_enabled)
                 continue;
             
             // convert FD packet into classic packet
@@ -867,9 +2875,414 @@ void can_forward_bridge_packet(can_class* inst, FDCAN_RxHeaderTypeDef* rx_header
             tx_header.BitRateSwitch = FDCAN_BRS_OFF;
         }
         
-        buf_store_tx_packet(C, &tx_header, rx_data);
+        // Latest value wins: an outdated packet that is still waiting in the Tx buffer is overwritten.
+        // This does not increase the Tx buffer occupation, so it does not consume a token.
+        if (dest->fwd_latest_wins && buf_replace_tx_packet(C, &tx_header, tx_data, rx_header->RxTimestamp))
+        {
+            inst->fwd_replaced_count ++;
+            continue;
+        }
+
+        if (!can_take_bucket_token(&dest->fwd_bucket, tick_now))
+        {
+            inst->fwd_dropped_count ++;
+            continue;
+        }
+
+        if (dest->tunnel_enabled)
+        {
+            // Classic frames are collected and sent together in one CAN FD tunnel frame to an FD channel.
+            if (can_using_FD(C) && rx_header->FDFormat == FDCAN_CLASSIC_CAN)
+            {
+                can_tunnel_pack(C, &tx_header, tx_data);
+                inst->fwd_queued_count ++;
+                continue;
+            }
+            // CAN FD frames with more than 8 bytes are split into multiple classic tunnel frames to a classic channel.
+            if (!can_using_FD(C) && tx_header.DataLength > 8)
+            {
+                // The fragments are classic frames, but the reassembled frame must be sent with the bitrate switching of the received frame.
+                tx_header.BitRateSwitch = rx_header->BitRateSwitch;
+                can_tunnel_split(C, &tx_header, tx_data);
+                inst->fwd_queued_count ++;
+                continue;
+            }
+        }
+
+        // Cut-through: copy the packet directly into the Tx FIFO if nothing is waiting in the Tx buffer of the destination channel.
+        // Otherwise append it to the Tx buffer, so the packets are not re-ordered.
+        if (can_forward_direct(C, &tx_header, tx_data, rx_header->RxTimestamp))
+        {
+            inst->fwd_direct_count ++;
+        }
+        else
+        {
+            buf_store_fwd_packet(C, &tx_header, tx_data, rx_header->RxTimestamp);
+            inst->fwd_queued_count ++;
+        }
+    }
+}
+
+// Returns the translation for a source CAN ID or NULL if the ID is not translated.
+// key = CAN ID, 29 bit IDs with BRG_KEY_29BIT
+brg_translation* can_find_bridge_translation(can_class* inst, uint32_t key)
+{
+    // The hash set is never full, so there is always an empty slot that ends the search.
+    for (uint32_t slot = can_hash_id(key, BRG_TRANSLATE_BITS); true; slot = (slot + 1) & (BRG_TRANSLATE_SIZE - 1))
+    {
+        brg_translation* trans = &inst->translations[slot];
+        if (trans->src_key == key)           return trans;
+        if (trans->src_key == ID_LIST_EMPTY) return NULL;
+    }
+}
+
+// Returns the translation for a source CAN ID.
+// If it does not exist yet, a new translation is created that forwards the packet unchanged and without rate limit.
+// Returns NULL if the hash set is full.
+brg_translation* can_add_bridge_translation(can_class* inst, uint32_t key)
+{
+    brg_translation* trans = can_find_bridge_translation(inst, key);
+    if (trans)
+        return trans;
+
+    if (inst->translation_count >= BRG_TRANSLATE_MAX)
+        return NULL;
+
+    for (uint32_t slot = can_hash_id(key, BRG_TRANSLATE_BITS); true; slot = (slot + 1) & (BRG_TRANSLATE_SIZE - 1))
+    {
+        trans = &inst->translations[slot];
+        if (trans->src_key == ID_LIST_EMPTY)
+            break;
+    }
+
+    memset(trans, 0, sizeof(brg_translation));
+    memset(trans->keep, 0xFF, sizeof(trans->keep));
+    trans->dest_id  = key & ~BRG_KEY_29BIT;
+    trans->dest_ext = (key & BRG_KEY_29BIT) > 0;
+
+    // The slot is marked as used after it has been filled completely, because can_process() may be interrupted here.
+    trans->src_key = key;
+    inst->translation_count ++;
+    return trans;
+}
+
+// rate = packets per second (0 = unlimited). The bucket starts full.
+void can_init_bucket(brg_bucket* bucket, uint32_t rate, uint32_t burst)
+{
+    bucket->rate      = 0; // disable the bucket while it is modified
+    bucket->burst     = burst;
+    bucket->tokens    = burst * 1000;
+    bucket->last_tick = HAL_GetTick();
+    bucket->rate      = rate;
+}
+
+// Token bucket: returns false if the rate limit has been exceeded and the packet must be dropped.
+// One packet consumes 1000 tokens, so 'rate' tokens are added per millisecond.
+bool can_take_bucket_token(brg_bucket* bucket, uint32_t tick_now)
+{
+    if (bucket->rate == 0)
+        return true; // unlimited
+
+    uint32_t max_tokens = bucket->burst * 1000;
+    uint32_t elapsed    = tick_now - bucket->last_tick; // milliseconds
+    bucket->last_tick   = tick_now;
+
+    // avoid an overflow of the multiplication after a long pause
+    if (elapsed >= (max_tokens + bucket->rate - 1) / bucket->rate)
+        bucket->tokens = max_tokens;
+    else
+        bucket->tokens = MIN(max_tokens, bucket->tokens + elapsed * bucket->rate);
+
+    if (bucket->tokens < 1000)
+        return false;
+
+    bucket->tokens -= 1000;
+    return true;
+}
+
+// Store a forwarded packet directly in the Tx FIFO, bypassing the Tx buffer.
+// Returns false if the Tx buffer is not empty or the Tx FIFO is full.
+bool can_forward_direct(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time)
+{
+    // The Tx complete interrupt must not fill the Tx FIFO from the Tx buffer in the meantime.
+    can_block_tx_interrupt(channel, true);
+
+    bool direct = buf_is_tx_buffer_empty(channel) && can_is_tx_fifo_free(channel) && can_is_tx_allowed(channel) == FBK_Success;
+    if (direct)
+        can_send_packet_rx_time(channel, tx_header, tx_data, rx_time, false);
+
+    can_block_tx_interrupt(channel, false);
+    return direct;
+}
+
+// ----------------------------------------------------------------------------------------------
+
+// Returns true if the packet was received with the CAN ID of the tunnel
+bool can_is_tunnel_frame(can_class* inst, FDCAN_RxHeaderTypeDef* rx_header)
+{
+    return rx_header->Identifier == inst->tunnel_id && 
+          (rx_header->IdType == FDCAN_EXTENDED_ID) == inst->tunnel_ext &&
+           rx_header->RxFrameType == FDCAN_DATA_FRAME;
+}
+
+// Write one classic frame as tunnel record into buf.
+// Returns the length of the record or 0 if it does not fit into free_len bytes.
+int can_tunnel_pack_record(uint8_t* buf, int free_len, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
+    bool     extended   = tx_header->IdType == FDCAN_EXTENDED_ID;
+    bool     remote     = tx_header->TxFrameType == FDCAN_REMOTE_FRAME;
+    uint32_t byte_count = MIN(8, tx_header->DataLength); // DLC 0...8 = byte count
+    uint32_t id_len     = extended ? 4 : 2;
+    uint32_t data_len   = remote ? 0 : byte_count;
+
+    int rec_len = 1 + id_len + data_len;
+    if (rec_len > free_len)
+        return 0;
+
+    *buf++ = (extended ? TUN_REC_29BIT : 0) | (remote ? TUN_REC_RTR : 0) | byte_count;
+    for (int B=id_len-1; B>=0; B--)
+    {
+        *buf++ = (uint8_t)(tx_header->Identifier >> (B * 8));
+    }
+    memcpy(buf, tx_data, data_len);
+    return rec_len;
+}
+
+// Read one tunnel record from buf into a classic Rx header and data.
+// Returns the length of the record or 0 at the end of the tunnel frame or if the record is invalid.
+int can_tunnel_unpack_record(uint8_t* buf, int len, FDCAN_RxHeaderTypeDef* rx_header, uint8_t* rx_data)
+{
+    if (len < 3)
+        return 0;
+
+    uint8_t  flags      = buf[0];
+    bool     extended   = (flags & TUN_REC_29BIT) > 0;
+    bool     remote     = (flags & TUN_REC_RTR)   > 0;
+    uint32_t byte_count = flags & 0x0F;
+    uint32_t id_len     = extended ? 4 : 2;
+    uint32_t data_len   = remote ? 0 : byte_count;
+
+    if (byte_count > 8) // TUN_REC_PADDING
+        return 0;
+
+    int rec_len = 1 + id_len + data_len;
+    if (rec_len > len)
+        return 0;
+
+    uint32_t ID = 0;
+    for (uint32_t B=0; B<id_len; B++)
+    {
+        ID = (ID << 8) | buf[1 + B];
+    }
+
+    rx_header->Identifier          = ID & (extended ? 0x1FFFFFFF : 0x7FF);
+    rx_header->IdType              = extended ? FDCAN_EXTENDED_ID  : FDCAN_STANDARD_ID;
+    rx_header->RxFrameType         = remote   ? FDCAN_REMOTE_FRAME : FDCAN_DATA_FRAME;
+    rx_header->DataLength          = byte_count;
+    rx_header->FDFormat            = FDCAN_CLASSIC_CAN;
+    rx_header->BitRateSwitch       = FDCAN_BRS_OFF;
+    rx_header->ErrorStateIndicator = FDCAN_ESI_ACTIVE;
+    memcpy(rx_data, buf + 1 + id_len, data_len);
+    return rec_len;
+}
+
+// Append a classic frame to the tunnel frame of the destination channel.
+// The tunnel frame is sent when it is full or when the latency window has expired (see can_process()).
+void can_tunnel_pack(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
+    can_class* inst = &can_inst[channel];
+    int rec_len = can_tunnel_pack_record(inst->tunnel_pack + inst->tunnel_pack_len, sizeof(inst->tunnel_pack) - inst->tunnel_pack_len, tx_header, tx_data);
+    if (rec_len == 0)
+    {
+        can_tunnel_flush(channel);
+        rec_len = can_tunnel_pack_record(inst->tunnel_pack, sizeof(inst->tunnel_pack), tx_header, tx_data);
+    }
+
+    if (inst->tunnel_pack_len == 0)
+        inst->tunnel_pack_time = system_get_timestamp();
+
+    inst->tunnel_pack_len += rec_len;
+
+    // With a window of zero each frame is sent immediately, which only converts the frames into CAN FD.
+    if (inst->tunnel_window == 0)
+        can_tunnel_flush(channel);
+}
+
+// Send the collected classic frames in one CAN FD tunnel frame with bitrate switching
+void can_tunnel_flush(uint8_t channel)
+{
+    can_class* inst = &can_inst[channel];
+    if (inst->tunnel_pack_len == 0)
+        return;
+
+    // fill the unused bytes up to the next valid CAN FD length
+    uint32_t dlc = utils_byte_count_to_dlc(inst->tunnel_pack_len);
+    uint32_t len = utils_dlc_to_byte_count(dlc);
+    memset(inst->tunnel_pack + inst->tunnel_pack_len, TUN_REC_PADDING, len - inst->tunnel_pack_len);
+
+    FDCAN_TxHeaderTypeDef tx_header;
+    tx_header.Identifier          = inst->tunnel_id;
+    tx_header.IdType              = inst->tunnel_ext ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+    tx_header.TxFrameType         = FDCAN_DATA_FRAME;
+    tx_header.DataLength          = dlc;
+    tx_header.ErrorStateIndicator = FDCAN_ESI_ACTIVE;
+    tx_header.FDFormat            = FDCAN_FD_CAN;
+    tx_header.BitRateSwitch       = can_using_BRS(channel) ? FDCAN_BRS_ON : FDCAN_BRS_OFF;
+    tx_header.TxEventFifoControl  = FDCAN_STORE_TX_EVENTS;
+    tx_header.MessageMarker       = 0;
+
+    inst->tunnel_pack_len = 0;
+    can_tunnel_send(channel, &tx_header, inst->tunnel_pack);
+}
+
+// Split a CAN FD frame with more than 8 bytes into classic tunnel fragments of 8 bytes.
+// 64 bytes need 10 fragments.
+void can_tunnel_split(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
+    can_class* inst = &can_inst[channel];
+
+    FDCAN_TxHeaderTypeDef frg_header;
+    frg_header.Identifier          = inst->tunnel_id;
+    frg_header.IdType              = inst->tunnel_ext ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+    frg_header.TxFrameType         = FDCAN_DATA_FRAME;
+    frg_header.DataLength          = 8;
+    frg_header.ErrorStateIndicator = FDCAN_ESI_ACTIVE;
+    frg_header.FDFormat            = FDCAN_CLASSIC_CAN;
+    frg_header.BitRateSwitch       = FDCAN_BRS_OFF;
+    frg_header.TxEventFifoControl  = FDCAN_STORE_TX_EVENTS;
+    frg_header.MessageMarker       = 0;
+
+    uint8_t __aligned(4) frag[8]; // passed to can_write_tx_element()
+    frag[0] = 0;
+    frag[1] = (tx_header->IdType == FDCAN_EXTENDED_ID ? TUN_FRG_29BIT : 0) | 
+              (tx_header->BitRateSwitch == FDCAN_BRS_ON ? TUN_FRG_BRS : 0) | tx_header->DataLength;
+    frag[2] = (uint8_t)(tx_header->Identifier >> 24);
+    frag[3] = (uint8_t)(tx_header->Identifier >> 16);
+    frag[4] = (uint8_t)(tx_header->Identifier >> 8);
+    frag[5] = (uint8_t)(tx_header->Identifier);
+    frag[6] = tx_data[0];
+    frag[7] = tx_data[1];
+    can_tunnel_send(channel, &frg_header, frag);
+
+    int byte_count = utils_dlc_to_byte_count(tx_header->DataLength);
+    for (int pos=2, index=1; pos < byte_count; pos += 7, index ++)
+    {
+        frag[0] = index;
+        memset(frag + 1, 0, 7);
+        memcpy(frag + 1, tx_data + pos, MIN(7, byte_count - pos));
+        can_tunnel_send(channel, &frg_header, frag);
+    }
+}
+
+// A tunnel frame has been received: forward the frames that it contains with the bridge filters of this channel.
+void can_tunnel_receive(can_class* inst, FDCAN_RxHeaderTypeDef* rx_header, uint8_t* rx_data)
+{
+    int byte_count = utils_dlc_to_byte_count(rx_header->DataLength);
+    if (rx_header->FDFormat == FDCAN_FD_CAN)
+    {
+        // CAN FD tunnel frame with classic frames
+        FDCAN_RxHeaderTypeDef rec_header;
+        uint8_t __aligned(4) rec_data[8]; // passed to can_write_tx_element()
+        for (int pos=0; pos < byte_count; )
+        {
+            int rec_len = can_tunnel_unpack_record(rx_data + pos, byte_count - pos, &rec_header, rec_data);
+            if (rec_len == 0)
+                break;
+
+            rec_header.RxTimestamp = rx_header->RxTimestamp;
+            can_forward_bridge_packet(inst, &rec_header, rec_data);
+            pos += rec_len;
+        }
+        return;
+    }
+
+    // Classic tunnel fragment of a CAN FD frame
+    if (byte_count < 8)
+        return; // invalid fragment
+
+    if (rx_data[0] == 0)
+    {
+        FDCAN_RxHeaderTypeDef* frg_header = &inst->tunnel_frag_header;
+        frg_header->Identifier          = ((uint32_t)rx_data[2] << 24) | (rx_data[3] << 16) | (rx_data[4] << 8) | rx_data[5];
+        frg_header->IdType              = (rx_data[1] & TUN_FRG_29BIT) ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+        frg_header->Identifier         &= (rx_data[1] & TUN_FRG_29BIT) ? 0x1FFFFFFF : 0x7FF;
+        frg_header->RxFrameType         = FDCAN_DATA_FRAME;
+        frg_header->DataLength          = rx_data[1] & 0x0F;
+        frg_header->FDFormat            = FDCAN_FD_CAN;
+        frg_header->BitRateSwitch       = (rx_data[1] & TUN_FRG_BRS) ? FDCAN_BRS_ON : FDCAN_BRS_OFF;
+        frg_header->ErrorStateIndicator = FDCAN_ESI_ACTIVE;
+        frg_header->RxTimestamp         = rx_header->RxTimestamp;
+        memcpy(inst->tunnel_frag, rx_data + 6, 2);
+        inst->tunnel_frag_len  = 2;
+        inst->tunnel_frag_next = 1;
+    }
+    else if (rx_data[0] == inst->tunnel_frag_next && inst->tunnel_frag_len + 7 <= sizeof(inst->tunnel_frag))
+    {
+        memcpy(inst->tunnel_frag + inst->tunnel_frag_len, rx_data + 1, 7);
+        inst->tunnel_frag_len += 7;
+        inst->tunnel_frag_next ++;
+    }
+    else 
+    {
+        // a fragment has been lost --> discard the frame
+        inst->tunnel_frag_next = 0;
+        return;
+    }
+
+    if (inst->tunnel_frag_len >= utils_dlc_to_byte_count(inst->tunnel_frag_header.DataLength))
+    {
+        inst->tunnel_frag_next = 0;
+        can_forward_bridge_packet(inst, &inst->tunnel_frag_header, inst->tunnel_frag);
+    }
+}
+
+// Send a tunnel frame directly or through the Tx buffer
+void can_tunnel_send(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data)
+{
+    if (!can_forward_direct(channel, tx_header, tx_data, 0))
+        buf_store_tx_packet(channel, tx_header, tx_data);
+}
+
+// Print forwarding statistics of all channels: 
+// "Bridge: 1250 direct, 12 queued, 0 replaced, 0 dropped"
+// "Bridge direct latency: min 131 us, avg 180 us, max 412 us"
+// "Bridge queued latency: min 402 us, avg 655 us, max 1310 us"
+// The latency is measured on the destination channel from the Rx start of frame to the Tx start of frame.
+// Packets forwarded directly into the Tx FIFO (cut-through) and packets that have waited in the Tx buffer are measured separately.
+void can_print_bridge_latency(uint8_t channel)
+{
+    can_class* inst = &can_inst[channel];
+    if ((GLB_UserFlags[channel] & USR_DebugReport) == 0)
+        return;
+
+    char buf[80];
+    sprintf(buf, "Bridge: %lu direct, %lu queued, %lu replaced, %lu dropped", inst->fwd_direct_count, inst->fwd_queued_count,
+            inst->fwd_replaced_count, inst->fwd_dropped_count);
+    control_send_debug_mesg(channel, buf);
+
+    // The latency of the packets forwarded by the other channel(s) is measured on this channel
+    brg_latency* direct = &inst->fwd_latency_direct;
+    if (direct->count > 0)
+    {
+        sprintf(buf, "Bridge direct latency: min %lu us, avg %lu us, max %lu us", direct->min, direct->sum / direct->count, direct->max);
+        control_send_debug_mesg(channel, buf);
+    }
+
+    brg_latency* queued = &inst->fwd_latency_queued;
+    if (queued->count > 0)
+    {
+        sprintf(buf, "Bridge queued latency: min %lu us, avg %lu us, max %lu us", queued->min, queued->sum / queued->count, queued->max);
+        control_send_debug_mesg(channel, buf);
     }
 }
+
+void can_reset_bridge_latency(can_class* inst)
+{
+    memset(&inst->fwd_latency_direct, 0, sizeof(brg_latency));
+    memset(&inst->fwd_latency_queued, 0, sizeof(brg_latency));
+    inst->fwd_latency_direct.min = 0xFFFFFFFF;
+    inst->fwd_latency_queued.min = 0xFFFFFFFF;
+}
 #endif
 
 // ----------------------------------------------------------------------------------------------
@@ -901,12 +3314,38 @@ bool can_get_termination(uint8_t channel, bool* enabled)
 // interval =   1 --> report busload every 100 ms     (minimum)
 // interval =   7 --> report busload every 700 ms
 // interval = 100 --> report busload every 10 seconds (maximum)
-eFeedback can_enable_busload(uint8_t channel, uint32_t interval)
+// exact = false --> estimate the stuff bits (fast)
+// exact = true  --> count the real stuff bits of each frame (see can_calc_exact_bit_count())
+// statistics = true --> additionally report peak, minimum and histogram of 1 ms windows (see can_close_load_window())
+eFeedback can_enable_busload(uint8_t channel, uint32_t interval, bool exact, bool statistics)
 {
     if (interval > 100)
         return FBK_ParamOutOfRange;
 
-    can_inst[channel].busload_interval = interval;
+    can_class* inst = &can_inst[channel];
+
+    // USR_RxDualFifo: the packets rejected by the host filters are not stored, so they cannot be counted (see can_select_rx_fifo_mode())
+    if (interval > 0 && inst->is_open && inst->reject_elements > 0)
+        return FBK_AdapterMustBeClosed;
+
+    inst->busload_interval = 0; // stop counting while the mode is changed
+    inst->busload_exact    = exact;
+    inst->busload_windowed = statistics;
+    inst->window_start     = system_get_timestamp();
+    inst->window_bit_base  = inst->bit_count_total;
+    can_reset_load_stats(inst);
+    inst->busload_interval = interval;
+    return FBK_Success;
+}
+
+// timeout_ms = time in ms that a Tx packet may wait in the Tx FIFO for an ACK before all pending Tx packets are canceled (1 ... 65535)
+// The default is CAN_TX_TIMEOUT. It is restored when the adapter is closed.
+eFeedback can_set_tx_timeout(uint8_t channel, uint32_t timeout_ms)
+{
+    if (timeout_ms < 1 || timeout_ms > 0xFFFF)
+        return FBK_ParamOutOfRange;
+
+    can_inst[channel].tx_timeout = timeout_ms;
     return FBK_Success;
 }
 
@@ -940,7 +3379,7 @@ bool can_using_FD(uint8_t channel)
 {
     return can_inst[channel].bitrate_data.Brp > 0;
 }
-
+
 // true if data bitrate greater than nominal bitrate
 bool can_using_BRS(uint8_t channel)
 {
@@ -1033,23 +3472,173 @@ uint32_t can_calc_bit_count_in_frame(can_class* inst, uint32_t DataLength,
         else
             brs_bits += CAN_BIT_NBR_WOD_FXFF_DATA_L; // Long CRC
 
-        // Convert data bit time to nominal bit time
-        if (BitRateSwitch == FDCAN_BRS_ON)
+        bit_count += can_convert_data_bits(inst, brs_bits, BitRateSwitch);
+    }
+    return bit_count;
+}
+
+// Convert data bit time to nominal bit time
+uint32_t can_convert_data_bits(can_class* inst, uint32_t data_bits, uint32_t BitRateSwitch)
+{
+    if (BitRateSwitch != FDCAN_BRS_ON)
+        return data_bits;
+
+    // As double arithmetic is not available here --> calculate with integers multiplied with 1 million
+    uint32_t factor = 1 + inst->bitrate_data.Seg1 + inst->bitrate_data.Seg2; // Tq in one bit (data)
+    factor *= inst->bitrate_data.Brp;
+    factor *= 1000000;
+    factor /= 1 + inst->bitrate_nominal.Seg1 + inst->bitrate_nominal.Seg2;   // Tq in one bit (nominal)
+    factor /= inst->bitrate_nominal.Brp;
+
+    return (data_bits * factor) / 1000000;
+}
+
+// Exact bus load: reconstruct the bit stream of the frame and count the real stuff bits (ISO 11898-1:2015).
+// Classic CAN: Dynamic stuff bits are inserted from SOF until the end of the CRC, so they also depend on the CRC-15.
+// CAN FD:      Dynamic stuff bits are inserted from SOF until the end of the data field.
+//              The stuff count and the CRC-17 / CRC-21 have fixed stuff bits, so their count does not depend on the CRC value.
+// The bits in the data phase are converted to nominal bit time.
+uint32_t can_calc_exact_bit_count(can_class* inst, uint32_t Identifier, uint32_t IdType, uint32_t FrameType, uint32_t DataLength,
+                                  uint32_t FDFormat, uint32_t BitRateSwitch, uint32_t ErrorStateIndicator, uint8_t* data)
+{
+    if (inst->busload_interval == 0)
+        return 0;
+
+    // CRC delimiter + ACK slot + ACK delimiter + End Of Frame (7) + Inter Frame Space (3)
+    const uint32_t CAN_BIT_NBR_TRAILER = 13;
+
+    bool     extended   = IdType    == FDCAN_EXTENDED_ID;
+    bool     remote     = FrameType == FDCAN_REMOTE_FRAME;
+    uint32_t byte_count = utils_dlc_to_byte_count(DataLength);
+
+    can_bit_stream stream = {0};
+    can_stream_bits(&stream, 0, 1); // SOF
+    if (extended)
+    {
+        can_stream_bits(&stream, Identifier >> 18, 11);      // base ID
+        can_stream_bits(&stream, 3, 2);                      // SRR = 1, IDE = 1
+        can_stream_bits(&stream, Identifier & 0x3FFFF, 18);  // ID extension
+    }
+    else
+    {
+        can_stream_bits(&stream, Identifier & 0x7FF, 11);
+    }
+
+    if (FDFormat == FDCAN_CLASSIC_CAN)
+    {
+        byte_count = remote ? 0 : MIN(8, byte_count);
+
+        // RTR, IDE + r0 (11 bit) or r1 + r0 (29 bit), DLC, data
+        can_stream_bits (&stream, remote ? 1 : 0, 1);
+        can_stream_bits (&stream, 0, 2);
+        can_stream_bits (&stream, DataLength, 4);
+        can_stream_bytes(&stream, data, byte_count);
+
+        uint32_t crc = stream.crc;
+        can_stream_bits(&stream, crc, 15);
+
+        // SOF ... DLC = 19 bits (11 bit ID) or 39 bits (29 bit ID)
+        return (extended ? 39 : 19) + byte_count * 8 + 15 + stream.stuff_count + CAN_BIT_NBR_TRAILER;
+    }
+
+    // RRS = 0, IDE = 0 (11 bit only), FDF = 1, res = 0
+    if (extended) can_stream_bits(&stream, 2, 3);
+    else          can_stream_bits(&stream, 2, 4);
+
+    // The bitrate is switched in the BRS bit, a stuff bit following BRS belongs to the data phase.
+    uint32_t arbit_stuff = stream.stuff_count;
+    can_stream_bits(&stream, BitRateSwitch == FDCAN_BRS_ON ? 1 : 0, 1);
+
+    // ESI, DLC, data
+    can_stream_bits (&stream, ErrorStateIndicator == FDCAN_ESI_PASSIVE ? 1 : 0, 1);
+    can_stream_bits (&stream, DataLength, 4);
+    can_stream_bytes(&stream, data, byte_count);
+
+    // A dynamic stuff bit after the last data bit is not inserted, because the first fixed stuff bit follows.
+    uint32_t data_stuff = stream.stuff_count - arbit_stuff - stream.stuff_last;
+
+    // Stuff count (4) + CRC (17 or 21) + fixed stuff bits (6 or 7)
+    uint32_t crc_bits = (byte_count <= 16) ? 27 : 32;
+
+    // SOF ... BRS = 17 bits (11 bit ID) or 36 bits (29 bit ID)
+    uint32_t nominal_bits = (extended ? 36 : 17) + arbit_stuff + CAN_BIT_NBR_TRAILER;
+    uint32_t data_bits    = 5 + byte_count * 8 + data_stuff + crc_bits;
+    return nominal_bits + can_convert_data_bits(inst, data_bits, BitRateSwitch);
+}
+
+// Process one bit of the bit stream. Returns true if a stuff bit is inserted after 5 bits with the same level.
+static inline bool can_stuff_bit(uint32_t* state, uint32_t bit)
+{
+    uint32_t count = ((*state >> 3) == bit) ? (*state & 7) + 1 : 1;
+    if (count == 5)
+    {
+        *state = ((bit ^ 1) << 3) | 1; // the stuff bit has the opposite level and starts a new sequence
+        return true;
+    }
+    *state = (bit << 3) | count;
+    return false;
+}
+
+// Process one bit of the CRC-15 (polynomial 0x4599) of a classic frame
+static inline uint32_t can_crc15_bit(uint32_t crc, uint32_t bit)
+{
+    uint32_t crc_next = bit ^ ((crc >> 14) & 1);
+    crc = (crc << 1) & 0x7FFF;
+    return crc_next ? (crc ^ 0x4599) : crc;
+}
+
+// Fill the lookup tables that process 4 bits of the bit stream at once
+void can_init_stuff_tables()
+{
+    for (uint32_t N=0; N<16; N++)
+    {
+        for (uint32_t S=0; S<16; S++)
         {
-            // As double arithmetic is not available here --> calculate with integers multiplied with 1 million
-            uint32_t factor = 1 + inst->bitrate_data.Seg1 + inst->bitrate_data.Seg2; // Tq in one bit (data)
-            factor *= inst->bitrate_data.Brp;
-            factor *= 1000000;
-            factor /= 1 + inst->bitrate_nominal.Seg1 + inst->bitrate_nominal.Seg2;   // Tq in one bit (nominal)
-            factor /= inst->bitrate_nominal.Brp;
-
-            bit_count += ((uint32_t)brs_bits * factor) / 1000000;
+            uint32_t state = S;
+            uint32_t entry = 0;
+            for (int B=3; B>=0; B--)
+            {
+                if (can_stuff_bit(&state, (N >> B) & 1))
+                    entry = (B == 0) ? 0x30 : 0x10;
+            }
+            stuff_table[S][N] = entry | state;
         }
-        else // BRS = off
+
+        uint32_t crc = N << 11;
+        for (int B=0; B<4; B++)
         {
-            bit_count += brs_bits;
+            crc = can_crc15_bit(crc, 0);
+        }
+        crc15_table[N] = crc;
+    }
+}
+
+// Append 'count' bits of 'value' (MSB first) to the bit stream
+void can_stream_bits(can_bit_stream* stream, uint32_t value, int count)
+{
+    for (int B=count-1; B>=0; B--)
+    {
+        uint32_t bit = (value >> B) & 1;
+        stream->crc         = can_crc15_bit(stream->crc, bit);
+        stream->stuff_last  = can_stuff_bit(&stream->state, bit);
+        stream->stuff_count += stream->stuff_last;
+    }
+}
+
+// Append data bytes to the bit stream with one table lookup per 4 bits
+void can_stream_bytes(can_bit_stream* stream, uint8_t* data, int count)
+{
+    for (int i=0; i<count; i++)
+    {
+        for (int shift=4; shift>=0; shift-=4)
+        {
+            uint32_t nibble = (data[i] >> shift) & 0x0F;
+            uint32_t entry  = stuff_table[stream->state][nibble];
+            stream->state        = entry & 0x0F;
+            stream->stuff_count += (entry >> 4) & 1;
+            stream->stuff_last   = (entry >> 5) & 1;
+            stream->crc = ((stream->crc << 4) ^ crc15_table[((stream->crc >> 11) ^ nibble) & 0x0F]) & 0x7FFF;
         }
     }
-    return bit_count;
 }
 
@@ -13,9 +13,119 @@
 // The processor allows up to 28 standard filters and up to 8 extended filters.
 // SRAMCAN_FLE_NBR cannot be used here because STM is so STUPID to define it in a *c file instead of a *h file.
 #define MAX_HOST_FILTERS    8 
+#define HW_STD_FILTERS      28 // standard filter elements in the message RAM
+#define HW_EXT_FILTERS      8  // extended filter elements in the message RAM
 
-// Bridge filters are not handled in the processor --> no limitation 
-#define MAX_BRIDGE_FILTERS  20
+// Bridge filters are not handled in the processor. They are compiled into a routing table whenever they change.
+// Forwarding a packet needs one table lookup for 11 bit IDs and one binary search per distinct 29 bit mask,
+// independent of the count of filters. The filter index is transmitted as one byte, 0xFF means "all filters".
+#define MAX_BRIDGE_FILTERS  128
+
+// The host ID list is a second filter stage in software for packets that have been rejected by the host filters.
+// 11 bit IDs are stored in a bitmap with 2048 bits, 29 bit IDs in a hash set with open addressing.
+// The hash set is filled to 75% at maximum, so a lookup needs only very few comparisons (see Tests/test_id_list.c).
+// Each slot needs 4 bytes per channel. The STM32G431 has only 32 kB RAM, the STM32G0B1 only 36 kB, the STM32G473 has 128 kB.
+#if defined(STM32G431xx)
+    #define ID_LIST_EXT_BITS    6   // 64 slots --> max 48 IDs
+#elif defined(STM32G0B1xx)
+    #define ID_LIST_EXT_BITS    8   // 256 slots --> max 192 IDs
+#else
+    #define ID_LIST_EXT_BITS    9   // 512 slots --> max 384 IDs
+#endif
+#define ID_LIST_EXT_SIZE    (1 << ID_LIST_EXT_BITS)
+#define ID_LIST_EXT_MAX     (ID_LIST_EXT_SIZE * 3 / 4)
+#define ID_LIST_EMPTY       0xFFFFFFFF // invalid 29 bit ID marks an empty slot in the hash set
+
+// Per-ID statistics of all received CAN IDs in a hash set that is filled to 75% at maximum.
+// The host sets the count of entries (rounded up to a power of 2 slots) and reads the table in pages.
+// The STM32G431 has only 32 kB RAM, the STM32G0B1 only 36 kB.
+#if defined(STM32G431xx) || defined(STM32G0B1xx)
+    #define ID_STATS_BITS       5   // 32 slots --> max 24 IDs
+#else
+    #define ID_STATS_BITS       9   // 512 slots --> max 384 IDs
+#endif
+#define ID_STATS_SIZE       (1 << ID_STATS_BITS)
+#define ID_STATS_MAX        (ID_STATS_SIZE * 3 / 4)
+#define ID_STATS_PAGE_SIZE  8   // entries per page that the host reads at once
+
+// Bridge translations replace the CAN ID and optionally modify data bytes 0...7 of forwarded packets.
+// They are stored in a hash set per source channel that is filled to 75% at maximum.
+#define BRG_TRANSLATE_BITS  6   // 64 slots --> max 48 translations
+#define BRG_TRANSLATE_SIZE  (1 << BRG_TRANSLATE_BITS)
+#define BRG_TRANSLATE_MAX   (BRG_TRANSLATE_SIZE * 3 / 4)
+#define BRG_KEY_29BIT       0x80000000 // key of a 29 bit CAN ID in the hash set
+
+// Tunnel records in a CAN FD tunnel frame: [flags + byte count] [CAN ID, 2 or 4 bytes big endian] [0...8 data bytes]
+#define TUN_REC_29BIT       0x80 // the record has a 29 bit CAN ID
+#define TUN_REC_RTR         0x40 // the record is a remote frame
+#define TUN_REC_PADDING     0xFF // invalid byte count 15 --> unused bytes at the end of the tunnel frame
+// Tunnel fragments in classic tunnel frames: [fragment index] [7 bytes]
+// Fragment 0 contains [0] [flags + DLC] [CAN ID, 4 bytes big endian] [data bytes 0...1]
+#define TUN_FRG_29BIT       0x80 // the fragmented frame has a 29 bit CAN ID
+#define TUN_FRG_BRS         0x40 // the fragmented frame uses bitrate switching
+
+// Bus load statistics: the bus load of each 1 ms window is sorted into histogram classes of 10%
+#define BUSLOAD_WINDOW_US   1000
+#define BUSLOAD_HISTO_COUNT 10
+
+// Cyclic transmit scheduler: periodic Tx packets that are sent by the Timer 3 compare interrupt without the host.
+// The STM32G431 has only 32 kB RAM, the STM32G0B1 only 36 kB.
+#if defined(STM32G431xx) || defined(STM32G0B1xx)
+    #define CYC_MAX_ENTRIES     8
+#else
+    #define CYC_MAX_ENTRIES     16
+#endif
+#define CYC_NONE            0xFF // counter_byte or checksum_byte is not used
+
+// Timed transmission: single Tx packets that are held back until an absolute timestamp and then sent by the same scheduler interrupt.
+#if defined(STM32G431xx) || defined(STM32G0B1xx)
+    #define TIMED_QUEUE_SIZE    8
+#else
+    #define TIMED_QUEUE_SIZE    16
+#endif
+
+// Protocol error log (USR_ErrorLog): the FDCAN interrupt stores each protocol error with a timestamp in a ring buffer.
+// All errors are counted per type, but only ERR_LOG_MAX_EVENTS per 100 ms are stored, the others are counted as suppressed.
+// The counters are sent to the host every ERR_LOG_COUNT_INTERVAL * 100 ms if they have changed.
+// ERR_LOG_SIZE must be a power of 2.
+#define ERR_LOG_SIZE            16
+#define ERR_LOG_MAX_EVENTS      10
+#define ERR_LOG_COUNT_INTERVAL  10
+#define ERR_LOG_TYPES           6    // FDCAN_PROTOCOL_ERROR_STUFF (1) ... FDCAN_PROTOCOL_ERROR_CRC (6)
+#define ERR_LOG_DATA_PHASE      0x80 // flag in err_event.code: the error occurred in the data phase of a CAN FD frame with BRS
+
+// Bus Off recovery (see can_recover_bus_off())
+#define BOFF_DEFAULT_DELAY      100   // BOFF_Backoff: default delay in ms before the first recovery attempt
+#define BOFF_MAX_DELAY          60000 // BOFF_Backoff: the doubled delay is limited to 60 seconds
+#define BOFF_STABLE_TIME        5000  // the attempts and the delay start again if the bus was 5 seconds without Bus Off
+
+// CAN_RX_INTERRUPT = 1 --> The FDCAN interrupt copies each new Rx packet immediately from the hardware Rx FIFO into rx_ring.
+// CAN_RX_INTERRUPT = 0 --> The Rx FIFO's are polled in can_process() from the main loop.
+// The hardware Rx FIFO's store only 3 packets each, while the main loop may be blocked for 22 ms while writing to the flash.
+#define CAN_RX_INTERRUPT    1
+
+// CAN_TX_INTERRUPT = 1 --> When the FDCAN has sent a packet, the Tx complete interrupt immediately moves the next packet
+//                          from the software queue into the Tx FIFO. This allows back-to-back transmission at high data rates.
+// CAN_TX_INTERRUPT = 0 --> The Tx FIFO is refilled only by buf_process() in the main loop, which leaves gaps on the bus.
+#define CAN_TX_INTERRUPT    1
+
+// Usage of the two hardware Rx FIFO's (3 packets each), selected in can_open()
+typedef enum
+{
+    RXFIFO_Single,   // FIFO 0 = packets accepted by the host filters, FIFO 1 = rejected packets (only flash the Rx LED)
+    RXFIFO_Split,    // USR_RxDualFifo: accepted packets with an even CAN ID in FIFO 0, odd CAN ID in FIFO 1, rejected packets are only counted
+    RXFIFO_Priority, // USR_RxDualFifo: packets of the priority filters in FIFO 1, other accepted packets in FIFO 0, rejected packets are only counted
+} eRxFifoMode;
+
+// Rx packets waiting to be processed by can_process(). This must be a power of 2.
+// The STM32G431 has only 32 kB RAM, the STM32G0B1 only 36 kB.
+#if defined(STM32G431xx)
+    #define CAN_RX_RING_SIZE    16
+#elif defined(STM32G0B1xx)
+    #define CAN_RX_RING_SIZE    32
+#else
+    #define CAN_RX_RING_SIZE    64
+#endif
 
 // Structure for CAN/FD bitrate configuration
 typedef struct 
@@ -32,6 +142,33 @@ typedef struct
     uint8_t  data[64];
 } tx_packet;
 
+// Rx packet in the ring buffer
+typedef struct
+{
+    FDCAN_RxHeaderTypeDef header;
+    uint32_t              fifo;   // FDCAN_RX_FIFO0 (accepted by host filters) or FDCAN_RX_FIFO1 (rejected)
+    uint16_t              lost_count; // value of can_class.rx_lost_count when the packet was read from the hardware FIFO
+    bool                  priority;   // RXFIFO_Priority: the packet matched a priority filter
+    uint8_t               data[64];
+} rx_packet;
+
+// Protocol error in the error log
+typedef struct
+{
+    uint32_t timestamp;    // system_get_timestamp() in the FDCAN interrupt
+    uint8_t  code;         // FDCAN_PROTOCOL_ERROR_xxx (1...6) + ERR_LOG_DATA_PHASE
+    uint8_t  tx_err_count; // Tx error counter after the error
+    uint8_t  rx_err_count; // Rx error counter after the error
+} err_event;
+
+// The host ID list compiled into hardware filter elements
+typedef struct
+{
+    uint32_t elements;  // count of filter elements, 0 = not compiled
+    uint32_t max_gap;   // IDs with a gap up to max_gap are combined into one element
+    uint32_t false_pos; // count of IDs accepted by the filter elements that are not in the list
+} can_id_elements;
+
 typedef struct
 {
     bool     enabled;   // active / inactive
@@ -42,11 +179,96 @@ typedef struct
     uint32_t mask;     
 } brg_filter;
 
+// Compiled 29 bit bridge route: all bridge filters with the same mask and filter are combined.
+typedef struct
+{
+    uint32_t filter;
+    uint32_t mask;
+    uint8_t  pass;      // bit 0 = channel 0, bit 1 = channel 1,... forward to these channels
+    uint8_t  block;     // bit 0 = channel 0, bit 1 = channel 1,... do not forward to these channels
+} brg_route;
+
+// Token bucket that limits the count of forwarded packets per second
+typedef struct
+{
+    uint32_t rate;      // packets per second, 0 = unlimited
+    uint32_t burst;     // max count of packets that may be forwarded at once after a pause
+    uint32_t tokens;    // available tokens in 1/1000 packets
+    uint32_t last_tick; // HAL_GetTick() of the last refill
+} brg_bucket;
+
+// Forwarding latency from the Rx start of frame on the source channel to the Tx start of frame on the destination channel
+typedef struct
+{
+    uint32_t count; // count of latency measurements
+    uint32_t sum;   // sum of all latencies in s
+    uint32_t min;   // minimum latency in s
+    uint32_t max;   // maximum latency in s
+} brg_latency;
+
+// Statistics of one received CAN ID, periods in s
+typedef struct
+{
+    uint64_t sum_period;  // sum of all periods --> mean = sum_period / (count - 1)
+    uint32_t key;         // CAN ID, 29 bit IDs with BRG_KEY_29BIT, unused slots are ID_LIST_EMPTY
+    uint32_t count;       // count of received frames
+    uint32_t last_stamp;  // Rx timestamp of the last frame
+    uint32_t min_period;  // shortest time between two frames, valid if count > 1
+    uint32_t max_period;  // longest  time between two frames
+    uint8_t  last_dlc;    // DLC of the last frame
+} id_stat_entry;
+
+// Periodic Tx packet of the cyclic transmit scheduler, times in s
+typedef struct
+{
+    FDCAN_TxHeaderTypeDef header;
+    uint8_t  data[64];
+    uint32_t period;        // 0 = entry not used
+    uint32_t phase;         // offset of the first transmission after opening the adapter or setting the entry
+    uint32_t next_due;      // timestamp of the next transmission
+    bool     restart;       // next_due must be calculated from phase in the next scheduler interrupt
+    uint8_t  counter_byte;  // data byte with a rolling counter that is incremented in each cycle, CYC_NONE = no counter
+    uint8_t  counter_mask;  // contiguous bits of the rolling counter in counter_byte (e.g. 0x0F or 0xF0)
+    uint8_t  checksum_byte; // data byte with the checksum of all other data bytes, CYC_NONE = no checksum
+    bool     checksum_xor;  // false = 8 bit sum, true = XOR of all other data bytes
+} cyc_entry;
+
+// Single Tx packet that is sent at an absolute timestamp in s
+typedef struct
+{
+    FDCAN_TxHeaderTypeDef header;
+    uint8_t  data[64];
+    uint32_t send_time;     // system_get_timestamp() at which the packet is sent
+} timed_entry;
+
+// Bus load statistics of 1 ms windows during one report interval
+typedef struct
+{
+    uint8_t  peak;        // highest bus load of a window in percent
+    uint8_t  minimum;     // lowest  bus load of a window in percent
+    uint32_t windows;     // count of windows evaluated in this interval
+    uint16_t histogram[BUSLOAD_HISTO_COUNT]; // count of windows with 0...9%, 10...19%,... 90...100% bus load
+} busload_stats;
+
+// Bridge translation (rule) of one CAN ID
+// The data bytes are modified: data = ((data & keep) | (replace & ~keep)) ^ xor
+typedef struct
+{
+    uint32_t src_key;     // source CAN ID, 29 bit IDs with BRG_KEY_29BIT, unused slots are ID_LIST_EMPTY
+    uint32_t dest_id;     // destination CAN ID
+    bool     dest_ext;    // destination CAN ID has 29 bit
+    bool     modify_data; // false if keep = all bits and replace = xor = 0
+    uint8_t  keep   [8];  // bits of data bytes 0...7 that are kept
+    uint8_t  replace[8];  // bits that replace the bits that are not kept
+    uint8_t  xor_bits[8]; // bits that are inverted at the end
+    brg_bucket bucket;    // rate limit for this CAN ID
+} brg_translation;
+
 typedef struct
 {
     FDCAN_HandleTypeDef         handle;
     FDCAN_FilterTypeDef         host_filters[MAX_HOST_FILTERS];
-    FDCAN_ProtocolStatusTypeDef cur_status; // current bus status
+    FDCAN_ProtocolStatusTypeDef cur_status; // current bus status, refreshed by the FDCAN status interrupts (see can_latch_status())
     can_bitrate_cfg             bitrate_nominal;
     can_bitrate_cfg             bitrate_data;
 
@@ -55,22 +277,146 @@ typedef struct
     bool termination_on; 
     bool bitrate_printed_once;
     bool delay_printed_once;
+    bool delay_measured;          // a CAN FD packet with BRS has been sent --> the transceiver delay can be read
+    __IO bool    status_changed;  // set by can_latch_status(), reset by can_get_bus_status()
+    __IO uint8_t proto_error;     // first protocol error latched by can_latch_status(), FDCAN_PROTOCOL_ERROR_NONE = no error
+    bool err_log_enabled;         // USR_ErrorLog: each protocol error is stored in err_log, copied in can_open()
 
     uint32_t std_filter_count;    // standard host filters
     uint32_t ext_filter_count;    // extended host filters
+    uint32_t prio_filter_count;   // host filters of both types that are priority filters (USR_RxDualFifo)
+    eRxFifoMode rx_fifo_mode;     // usage of the hardware Rx FIFO's, selected in can_open()
+    uint32_t std_user_elements;   // standard filter elements used by the host filters (a split filter needs 2 elements)
+    uint32_t ext_user_elements;   // extended filter elements used by the host filters
+    uint32_t reject_elements;     // 1 = the last filter element of each type counts the rejected packets (USR_RxDualFifo)
     uint32_t bit_count_total;     // for calculation of bus load, total count of all bits of all Rx messages converted to nominal baudrate
     uint32_t nom_bit_len_ns;      // for calculation of bus load, length of one nominal bit in ns (constant)
     uint8_t  old_busload_pct;     // for calculation of bus load, last reported percent value
     uint32_t busload_interval;    // for calculation of bus load, report interval in 100 ms steps
     uint32_t busload_counter;     // for calculation of bus load, incremented every 100 ms until busload_interval is reached
+    bool     busload_exact;       // for calculation of bus load, reconstruct the bit stream of each frame to count the real stuff bits
+    uint32_t tx_bit_count;        // for calculation of bus load in exact mode, bits of Tx packets counted in can_send_packet()
+    bool     busload_windowed;    // for bus load statistics, evaluate 1 ms windows (peak, minimum, histogram)
+    uint32_t window_start;        // for bus load statistics, timestamp in s when the current window started
+    uint32_t window_bit_base;     // for bus load statistics, value of bit_count_total when the current window started
+    busload_stats load_stats;     // for bus load statistics, collected until the report interval has elapsed
     uint32_t tdc_offset;          // for Transceiver Delay Compensation
     uint32_t last_tx_tick;        // for Transmit Timeout
+    uint32_t tx_timeout;          // for Transmit Timeout, time in ms (see can_set_tx_timeout())
     int      tx_pending;          // for Transmit Timeout
+
+    // ----- Rx Ring Buffer
+    // Single producer (FDCAN interrupt) / single consumer (can_process) --> no locking required.
+    // rx_head and rx_tail are never reset to zero while the adapter is open, they simply roll over.
+    rx_packet     rx_ring[CAN_RX_RING_SIZE];
+    __IO uint32_t rx_head;          // incremented only by can_read_rx_fifo()
+    __IO uint32_t rx_tail;          // incremented only by can_process()
+    __IO bool     rx_packet_lost;   // set by can_read_rx_fifo(), reset by can_process()
+    __IO uint16_t rx_lost_count;    // packets lost in hardware (FIFO or ring buffer full), rolls over, incremented only by can_read_rx_fifo()
+    __IO uint32_t rx_reject_count;  // packets rejected by the host filters in USR_RxDualFifo mode, incremented only by the high priority message interrupt
+    uint32_t      rx_reject_shown;  // value of rx_reject_count when can_process() flashed the Rx LED
+
+    // ----- Protocol Error Log (USR_ErrorLog)
+    // Single producer (FDCAN interrupt) / single consumer (can_process) --> no locking required.
+    err_event     err_log[ERR_LOG_SIZE];
+    __IO uint32_t err_log_head;     // incremented only by can_log_proto_error()
+    __IO uint32_t err_log_tail;     // incremented only by can_process()
+    __IO uint32_t err_log_window;   // events stored in the current 100 ms, reset by can_timer_100ms()
+    __IO uint32_t err_counts[ERR_LOG_TYPES]; // all protocol errors per type since opening, including the suppressed ones
+    __IO uint32_t err_suppressed;   // errors not stored in err_log because of the rate limit or a full ring buffer
+    uint32_t      err_counts_sum;   // sum of err_counts when the counters have been reported the last time
+    uint32_t      err_count_ticks;  // incremented every 100 ms until ERR_LOG_COUNT_INTERVAL is reached
+
+    // ----- Bus Off Recovery
+    // The policy is set by can_set_bus_off_policy() and stays valid until can_reset(), all other values are reset in can_open().
+    eBusOffPolicy boff_policy;
+    uint32_t      boff_base_delay;    // BOFF_Backoff: delay in ms before the first recovery attempt
+    uint32_t      boff_max_attempts;  // consecutive recovery attempts before the firmware waits for the host, 0 = unlimited
+    bool          boff_detected;      // Bus Off has been detected and the bus is not yet error active again
+    bool          boff_host_request;  // the host has requested a recovery with can_restart_bus_off()
+    bool          boff_host_informed; // the host has been informed that the firmware waits for a recovery request
+    uint32_t      boff_delay;         // BOFF_Backoff: current delay in ms, doubled after each attempt
+    uint32_t      boff_attempts;      // recovery attempts since the bus was stable the last time
+    uint32_t      boff_off_tick;      // HAL tick when Bus Off has been detected
+    uint32_t      boff_active_tick;   // HAL tick when the bus has been recovered the last time
+    uint32_t      boff_count;         // statistics: Bus Off events since opening
+    uint32_t      boff_last_ms;       // statistics: time from Bus Off until the bus was error active again
+    uint32_t      boff_min_ms;        // statistics: shortest recovery time, 0xFFFFFFFF = no recovery yet
+    uint32_t      boff_max_ms;        // statistics: longest  recovery time
     
+    // ----- Host ID List
+    // Written only while the adapter is closed, read in can_process()
+    uint8_t  id_list_std[0x800 / 8];           // one bit for each 11 bit ID
+    uint32_t id_list_ext[ID_LIST_EXT_SIZE];    // hash set of 29 bit ID's, unused slots are ID_LIST_EMPTY
+    uint32_t id_list_std_count;                // count of 11 bit ID's in id_list_std
+    uint32_t id_list_ext_count;                // count of 29 bit ID's in id_list_ext
+    can_id_elements id_std_compiled;           // 11 bit host ID list compiled into filter elements in can_open()
+    can_id_elements id_ext_compiled;           // 29 bit host ID list compiled into filter elements in can_open()
+
+    // ----- Per-ID Statistics
+    // Written in can_process(), configured only while the adapter is closed
+    id_stat_entry id_stats[ID_STATS_SIZE];
+    uint32_t id_stats_bits;                    // the hash set uses 2 ^ id_stats_bits slots, 0 = disabled
+    uint32_t id_stats_count;                   // count of CAN IDs in id_stats
+    uint32_t id_stats_lost;                    // count of frames not counted because the table was full
+    bool     id_stats_no_stream;               // do not send received frames to the host
+    __IO bool id_stats_clear;                  // clear request from the USB interrupt, executed in can_process()
+
+    // ----- Cyclic Transmit Scheduler
+    // Executed in the Timer 3 compare interrupt (can_scheduler_interrupt), modified with interrupts disabled
+    cyc_entry cyclic[CYC_MAX_ENTRIES];
+    uint32_t  cyclic_count;                    // count of used entries
+
+    // ----- Timed Transmission
+    // Not sorted, the earliest send_time is sent first. Executed in the scheduler interrupt, modified with interrupts disabled
+    timed_entry timed[TIMED_QUEUE_SIZE];
+    uint32_t    timed_count;                   // count of waiting packets
+
     // ----- Bridge Filters
 #if CHANNEL_COUNT > 1
     brg_filter bridge_filters[MAX_BRIDGE_FILTERS];
     bool       bridge_active;    
+    __IO bool  bridge_routes_dirty; // set by can_set_bridge_filter(), the routing table is recompiled in can_process()
+    uint32_t   fwd_direct_count;  // packets forwarded directly into the Tx FIFO of another channel
+    uint32_t   fwd_queued_count;  // packets forwarded into the Tx buffer of another channel because the Tx FIFO was full
+    uint32_t   fwd_replaced_count;// packets that replaced a pending packet with the same CAN ID (latest value wins)
+    uint32_t   fwd_dropped_count; // packets not forwarded because a rate limit was exceeded
+    // ----- Rate limit of the packets that other channels forward to this channel
+    brg_bucket fwd_bucket;
+    bool       fwd_latest_wins;   // a forwarded packet replaces a pending forwarded packet with the same CAN ID in the Tx buffer
+    // ----- Bridge Latency (measured on the destination channel)
+    // Rx timestamp of the source packet for each packet in the Tx FIFO in the order they were stored, 0 = not forwarded.
+    // Only in FIFO mode the Tx events come in the same order as the packets were stored.
+    uint32_t   tx_fifo_rx_time[4];
+    bool       tx_fifo_queued [4]; // the forwarded packet has waited in the Tx buffer
+    uint8_t    tx_fifo_put;        // incremented by can_send_packet()
+    uint8_t    tx_fifo_get;        // incremented by can_process() for each Tx event
+    brg_latency fwd_latency_direct; // packets copied directly into the Tx FIFO (cut-through)
+    brg_latency fwd_latency_queued; // packets that have waited in the Tx buffer
+    // ----- Bridge Routing Table (compiled from bridge_filters in can_compile_bridge_routes(), read and written only in the main loop)
+    // 11 bit: low  nibble = pass  bits of the destination channels,
+    //         high nibble = block bits of the destination channels. (max 4 channels)
+    uint8_t    route_std[0x800];
+    // 29 bit: sorted by mask, then by filter. Routes with the same mask form a group that is searched binary.
+    brg_route  route_ext[MAX_BRIDGE_FILTERS];
+    uint8_t    route_ext_count;
+    uint8_t    route_group_start[MAX_BRIDGE_FILTERS + 1]; // index of the first route of each group + end of the last group
+    uint8_t    route_group_count;
+    // ----- Bridge Translations (gateway mode)
+    brg_translation translations[BRG_TRANSLATE_SIZE];
+    uint32_t        translation_count;
+    // ----- Tunnel (classic CAN frames packed into CAN FD frames and CAN FD frames split into classic frames)
+    bool       tunnel_enabled;
+    bool       tunnel_ext;         // tunnel_id has 29 bit
+    uint32_t   tunnel_id;          // CAN ID of the tunnel frames on this channel
+    uint32_t   tunnel_window;      // max s that a classic frame waits in tunnel_pack before the tunnel frame is sent
+    uint8_t    __aligned(4) tunnel_pack[64];    // records of classic frames collected for the next CAN FD tunnel frame
+    uint8_t    tunnel_pack_len;
+    uint32_t   tunnel_pack_time;   // system_get_timestamp() when the first record was stored in tunnel_pack
+    uint8_t    __aligned(4) tunnel_frag[2 + 9 * 7]; // data of a CAN FD frame that is reassembled from classic tunnel fragments (64 + 1 byte)
+    uint8_t    tunnel_frag_len;    // count of data bytes received
+    uint8_t    tunnel_frag_next;   // index of the next expected fragment, 0 = no reassembly in progress
+    FDCAN_RxHeaderTypeDef tunnel_frag_header;
 #endif
 } can_class;
 
@@ -84,6 +430,18 @@ static inline uint32_t can_calc_sample(can_bitrate_cfg* bitrate)
     return 1000 * (1 + bitrate->Seg1) / (1 + bitrate->Seg1 + bitrate->Seg2);
 }
 
+// Returns the arbitration priority of a Tx packet. The lower the value, the higher the priority on the CAN bus.
+// A 29 bit ID competes with its upper 11 bits against an 11 bit ID and loses if they are equal (SRR / IDE bit are recessive).
+// A remote frame loses against a data frame with the same ID (RTR bit is recessive).
+static inline uint32_t can_arbitration_priority(FDCAN_TxHeaderTypeDef* header)
+{
+    uint32_t rtr = (header->TxFrameType == FDCAN_REMOTE_FRAME) ? 1 : 0;
+    if (header->IdType == FDCAN_EXTENDED_ID)
+        return ((header->Identifier >> 18) << 20) | (1 << 19) | ((header->Identifier & 0x3FFFF) << 1) | rtr;
+    else
+        return (header->Identifier << 20) | rtr;
+}
+
 void can_init();
 eFeedback  can_open(uint8_t channel, uint32_t mode);
 void       can_close_all();
@@ -91,8 +449,10 @@ void       can_close(uint8_t channel);
 void       can_process(uint8_t channel, uint32_t tick_now);
 void       can_timer_100ms();
 void       can_send_packet(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
+void       can_send_packet_rx_time(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t rx_time, bool queued);
 eFeedback  can_set_bit_timing(uint8_t channel, bool set_data, uint32_t BRP, uint32_t Seg1, uint32_t Seg2, uint32_t Sjw);
-eFeedback  can_enable_busload(uint8_t channel, uint32_t interval);
+eFeedback  can_enable_busload(uint8_t channel, uint32_t interval, bool exact, bool statistics);
+eFeedback  can_set_tx_timeout(uint8_t channel, uint32_t timeout_ms);
 bool       can_set_termination(uint8_t channel, bool enable);
 bool       can_get_termination(uint8_t channel, bool* enabled);
 bool       can_is_any_open();
@@ -102,10 +462,32 @@ bool       can_using_FD(uint8_t channel);
 bool       can_using_BRS(uint8_t channel);
 bool       can_is_tx_fifo_free(uint8_t channel);
 eFeedback  can_is_tx_allowed(uint8_t channel);
-eFeedback  can_add_host_filter(uint8_t channel, bool extended, uint32_t filter, uint32_t mask);
+eFeedback  can_add_host_filter(uint8_t channel, bool extended, uint32_t filter, uint32_t mask, bool priority);
+eFeedback  can_add_host_id(uint8_t channel, bool extended, uint32_t ID);
 eFeedback  can_clear_host_filters(uint8_t channel);
 eFeedback  can_set_bridge_filter(uint8_t src_channel, uint8_t dest_channel, uint8_t filter_index, bool enable, bool extended, bool block, uint32_t filter, uint32_t mask);
+eFeedback  can_set_bridge_translation(uint8_t src_channel, bool src_ext, uint32_t src_id, bool dest_ext, uint32_t dest_id, uint8_t* keep, uint8_t* replace, uint8_t* xor_bits);
+eFeedback  can_clear_bridge_translations(uint8_t src_channel);
+eFeedback  can_set_bridge_id_limit(uint8_t src_channel, bool extended, uint32_t ID, uint32_t rate, uint32_t burst);
+eFeedback  can_set_bridge_dest_limit(uint8_t dest_channel, uint32_t rate, uint32_t burst, bool latest_wins);
+eFeedback  can_set_tunnel(uint8_t channel, bool enable, bool extended, uint32_t tunnel_id, uint32_t window);
+eFeedback  can_set_id_stats(uint8_t channel, uint32_t max_entries, bool stream);
+eFeedback  can_clear_id_stats(uint8_t channel);
+eFeedback  can_get_id_stats(uint8_t channel, uint32_t page, uint32_t* slot, uint32_t* total, uint32_t* lost);
+bool       can_next_id_stat_entry(uint8_t channel, uint32_t* slot, id_stat_entry* entry);
+eFeedback  can_set_cyclic(uint8_t channel, uint8_t index, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t period, uint32_t phase,
+                          uint8_t counter_byte, uint8_t counter_mask, uint8_t checksum_byte, bool checksum_xor);
+eFeedback  can_clear_cyclic(uint8_t channel);
+eFeedback  can_send_timed(uint8_t channel, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data, uint32_t send_time);
+void       can_scheduler_interrupt();
+int        can_tunnel_pack_record  (uint8_t* buf, int free_len, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
+int        can_tunnel_unpack_record(uint8_t* buf, int len,      FDCAN_RxHeaderTypeDef* rx_header, uint8_t* rx_data);
 void       can_recover_bus_off(uint8_t channel);
+eFeedback  can_restart_bus_off(uint8_t channel);
+eFeedback  can_set_bus_off_policy(uint8_t channel, eBusOffPolicy policy, uint32_t base_delay, uint32_t max_attempts);
+bool       can_get_bus_status(uint8_t channel, eErrorBusStatus* bus_status, uint8_t* proto_error);
+void       can_get_protocol_status(uint8_t channel, FDCAN_ProtocolStatusTypeDef* status);
+void       can_block_tx_interrupt(uint8_t channel, bool block);
 
 can_bitrate_cfg*     can_getBitrate(uint8_t channel, bool get_data);
 FDCAN_HandleTypeDef* can_get_handle(uint8_t channel);
@@ -29,6 +29,7 @@ void error_assert(uint8_t channel, eErrorAppFlags flag, bool report_immediately)
     err_class* inst = &err_inst[channel];
     
     inst->cur_state.app_flags |= flag;
+    inst->flags_changed = true;
     if (report_immediately)
         inst->report_now = true;
 }
@@ -49,37 +50,35 @@ bool error_is_report_due(uint8_t channel, uint32_t tick_now)
     
     // ----------------
     
-    // Refresh bus status and error counters
-    FDCAN_ProtocolStatusTypeDef status;
-    FDCAN_ErrorCountersTypeDef  counters;
-    HAL_FDCAN_GetProtocolStatus(can_get_handle(channel), &status);
-    HAL_FDCAN_GetErrorCounters (can_get_handle(channel), &counters);
+    // The bus status and the first protocol error are latched by the FDCAN status interrupts (see can_get_bus_status()).
+    // No peripheral register is read here unless the error counters must be polled.
+    eErrorBusStatus bus_status;
+    uint8_t         proto_error;
+    bool status_changed = can_get_bus_status(channel, &bus_status, &proto_error);
 
     // error passive or bus off --> turn Rx + Tx LED on permanently
-    if (status.Warning)      inst->cur_state.bus_status = BUS_StatusWarning; // MCU register FDCAN_PSR, flag EW (>  96 errors)
-    if (status.ErrorPassive) inst->cur_state.bus_status = BUS_StatusPassive; // MCU register FDCAN_PSR, flag EP (> 128 errors)
-    if (status.BusOff)       inst->cur_state.bus_status = BUS_StatusOff;     // MCU register FDCAN_PSR, flag BO (> 248 errors)
+    if (bus_status != BUS_StatusActive)
+        inst->cur_state.bus_status = bus_status;
 
     // the bus has returned from a previous Warning, Passive or Off state to Active
     if (inst->cur_state.bus_status == BUS_StatusActive && inst->last_state.bus_status != BUS_StatusActive)
         inst->cur_state.back_to_active = true;
 
-    inst->cur_state.tx_err_count = (uint8_t)counters.TxErrorCnt; // MCU register FDCAN_ECR, counter TEC
-    inst->cur_state.rx_err_count = (uint8_t)counters.RxErrorCnt; // MCU register FDCAN_ECR, counter REC
-    
-    // ----------------
-
     // Set last_proto_err to the very first error that occurred (e.g. No ACK received).
     // This error will be reported once to the host and then cleared. Otherwise it would repeat eternally.
     if (inst->cur_state.last_proto_err == FDCAN_PROTOCOL_ERROR_NONE)
+        inst->cur_state.last_proto_err = proto_error;
+
+    // The error counters change with each error, there is no interrupt for them.
+    // They are polled only at the reporting cadence of 100 ms or when the state has changed.
+    bool poll_due = (tick_now - inst->poll_tick >= 100);
+    if (status_changed || poll_due || inst->report_now)
     {
-        if (status.DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NONE &&
-            status.DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE)
-                inst->cur_state.last_proto_err = status.DataLastErrorCode;               
-        
-        if (status.LastErrorCode != FDCAN_PROTOCOL_ERROR_NONE &&
-            status.LastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE)
-                inst->cur_state.last_proto_err = status.LastErrorCode;               
+        FDCAN_ErrorCountersTypeDef counters;
+        HAL_FDCAN_GetErrorCounters(can_get_handle(channel), &counters);
+        inst->cur_state.tx_err_count = (uint8_t)counters.TxErrorCnt; // MCU register FDCAN_ECR, counter TEC
+        inst->cur_state.rx_err_count = (uint8_t)counters.RxErrorCnt; // MCU register FDCAN_ECR, counter REC
+        inst->poll_tick = tick_now;
     }
    
     // ----------------
@@ -92,22 +91,27 @@ bool error_is_report_due(uint8_t channel, uint32_t tick_now)
         goto _ReportNow;
     }
 
-    // utils_mem_is_empty(&cur_state) if not a single error is reported
-    if (utils_mem_is_empty(&inst->cur_state, sizeof(kCanErrorState)) && !inst->cur_state.back_to_active) 
-        return false; // no errors present
-
     // If the error state changed right now to Bus Off, report this immediately.
     // This error must be reported before debug message "Start recovery from Bus Off"
     if (inst->cur_state .bus_status == BUS_StatusOff &&
         inst->last_state.bus_status != BUS_StatusOff)
         goto _ReportNow;
-       
+
+    // Nothing has changed since the last pass of the main loop
+    if (!status_changed && !poll_due && !inst->flags_changed)
+        return false;
+
     // Do not flood the user with thousands of errors as the legacy Candlelight firmware did.
     // We do not want to occupy the USB transfer with unnecesaay error messages.
     // Errors are reported at a rate of 100 ms, but only if the error state has changed.
     uint32_t elapsed = tick_now - inst->last_tick;
     if (elapsed < 100)
         return false;
+
+    // utils_mem_is_empty(&cur_state) if not a single error is reported
+    inst->flags_changed = false;
+    if (utils_mem_is_empty(&inst->cur_state, sizeof(kCanErrorState)) && !inst->cur_state.back_to_active) 
+        return false; // no errors present
     
     // report a change of error state after 100 ms
     // report also if only the error counters have changed.
@@ -120,8 +124,10 @@ bool error_is_report_due(uint8_t channel, uint32_t tick_now)
         return false;
 
 _ReportNow:
-    inst->last_tick  = tick_now;
-    inst->last_state = inst->cur_state;
+    inst->last_tick     = tick_now;
+    inst->poll_tick     = tick_now;
+    inst->flags_changed = false;
+    inst->last_state    = inst->cur_state;
     return true;
 }
 
@@ -21,7 +21,9 @@ typedef struct
 typedef struct
 {
     bool           report_now;
+    bool           flags_changed;  // set by error_assert() --> evaluate the state in the next pass of the main loop
     uint32_t       last_tick;
+    uint32_t       poll_tick;      // the error counters are read only every 100 ms
     kCanErrorState cur_state;
     kCanErrorState last_state;
 } err_class;
@@ -95,14 +95,49 @@ void USB_UCPD1_2_IRQHandler()
 // Handle FDCAN interrupts for STM32G4xx
 void FDCAN1_IT0_IRQHandler(void)
 {
-    // This calls HAL_FDCAN_TimestampWraparoundCallback()
+    // This calls HAL_FDCAN_RxFifo0Callback(), HAL_FDCAN_RxFifo1Callback() and HAL_FDCAN_TxBufferCompleteCallback()
     HAL_FDCAN_IRQHandler(can_get_handle(0));
 }
 
+#if CHANNEL_COUNT > 1
+// Handle FDCAN2 interrupts for STM32G4xx (Rx FIFO's of the second channel)
+void FDCAN2_IT0_IRQHandler(void)
+{
+    // This calls HAL_FDCAN_RxFifo0Callback() and HAL_FDCAN_RxFifo1Callback()
+    HAL_FDCAN_IRQHandler(can_get_handle(1));
+}
+#endif
+
 // Handle FDCAN interrupts for STM32G0xx
 void TIM16_FDCAN_IT0_IRQHandler(void)
 {
-    // This calls HAL_FDCAN_TimestampWraparoundCallback()
+    // This calls HAL_FDCAN_RxFifo0Callback(), HAL_FDCAN_RxFifo1Callback() and HAL_FDCAN_TxBufferCompleteCallback()
     HAL_FDCAN_IRQHandler(can_get_handle(0));
 }
 
+// ---------------------------------------------------------------------
+
+// Timer 3 update = wrap around of the 16 bit timestamp counter, compare channel 1 = cyclic and timed transmission.
+// The update must be counted first, so the scheduler gets the new timestamp.
+// While the main loop blocks the scheduler in can_block_tx_interrupt() (CC1IE = 0) the compare flag stays pending.
+static inline void timer3_handler()
+{
+    if (TIM3->SR & TIM_SR_UIF)
+        system_count_timewrap();
+
+    if ((TIM3->SR & TIM_SR_CC1IF) && (TIM3->DIER & TIM_DIER_CC1IE))
+        can_scheduler_interrupt();
+}
+
+// Handle Timer 3 interrupts for STM32G4xx
+void TIM3_IRQHandler(void)
+{
+    timer3_handler();
+}
+
+// Handle Timer 3 interrupts for STM32G0xx (Timer 4 is not used)
+void TIM3_TIM4_IRQHandler(void)
+{
+    timer3_handler();
+}
+
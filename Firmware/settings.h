@@ -68,6 +68,15 @@ typedef enum // sent as 8 bit
     APP_CanTxTimeout    = 0x10, // a packet in the transmit FIFO was not acknowledged during 500 ms --> abort Tx and clear Tx buffer.
 } eErrorAppFlags;
 
+// Recovery from the Bus Off state, see can_recover_bus_off()
+// Slcan sets this with command "K", Candlelight with ELM_ReqSetBusOffRecovery
+typedef enum // sent as 8 bit
+{
+    BOFF_Immediate = 0, // restart the FDCAN immediately after Bus Off has been reported (default)
+    BOFF_Backoff,       // wait before restarting, the delay is doubled for each further Bus Off
+    BOFF_Manual,        // do not restart automatically, wait until the host requests the recovery
+} eBusOffPolicy;
+
 // ============================================================================================
 // MCU_SERIE is defined in the Makefile
 
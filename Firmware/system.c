@@ -13,7 +13,7 @@
 extern uint32_t _etext;
 
 uint32_t canfd_clock;
-uint32_t timestamp_wrap = 0;
+volatile uint32_t timestamp_wrap = 0; // incremented in the Timer 3 update interrupt
 
 // private functions
 bool system_init_timestamp();
@@ -185,7 +185,8 @@ bool system_init(void)
 
 // Configure Timer 3 as 1 s timer (1 MHz). Timer 3 uses PCLK1 input.
 // The FDCAN Rx and Tx Echo timestamps are based on this timer.
-// HAL_FDCAN_TimestampWraparoundCallback is required to extend this 16 bit timer to 32 bit when it wraps around every 65 ms.
+// The update interrupt counts the wrap arounds every 65 ms in timestamp_wrap to extend this 16 bit timer to 64 bit.
+// The compare interrupt of channel 1 drives the cyclic and timed transmission (see can_scheduler_interrupt()).
 bool system_init_timestamp()
 {
     __HAL_RCC_TIM3_CLK_ENABLE();
@@ -196,32 +197,43 @@ bool system_init_timestamp()
     Timer3.Init.Period        = 0xFFFFFFFF;
     Timer3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
 
-    if (HAL_TIM_Base_Init    (&Timer3) != HAL_OK ||
-        HAL_TIM_Base_Start_IT(&Timer3) != HAL_OK)
+    if (HAL_TIM_Base_Init (&Timer3) != HAL_OK ||
+        HAL_TIM_Base_Start(&Timer3) != HAL_OK)
         return false;
 
-    // Enable the FDCAN interrupts that increment the Timer 3 wrap around counter.
-    // Timer 16 and FDCAN line 0 share the same interrupt on the STM32G0xx serie.
-    // G4 serie: FDCAN1_IT0_IRQn      -> FDCAN1_IT0_IRQHandler      -> HAL_FDCAN_IRQHandler -> HAL_FDCAN_TimestampWraparoundCallback
-    // G0 serie: TIM16_FDCAN_IT0_IRQn -> TIM16_FDCAN_IT0_IRQHandler -> HAL_FDCAN_IRQHandler -> HAL_FDCAN_TimestampWraparoundCallback
-    HAL_NVIC_SetPriority(FDCAN1_IT0_IRQn, 0, 0);
-    HAL_NVIC_EnableIRQ  (FDCAN1_IT0_IRQn);
+    // Bugfix: The wrap around was counted in the FDCAN interrupt of each open channel.
+    // This did not count while all channels were closed and counted twice when 2 FDCAN instances were open.
+    // The Timer 3 interrupt must have the same priority as the FDCAN interrupts, so they never interrupt each other.
+    // The compare register CCR1 is set in can_scheduler_interrupt(). While no packet is scheduled it fires once every 65 ms.
+    // G4 serie: TIM3_IRQn      -> TIM3_IRQHandler      -> system_count_timewrap + can_scheduler_interrupt
+    // G0 serie: TIM3_TIM4_IRQn -> TIM3_TIM4_IRQHandler -> system_count_timewrap + can_scheduler_interrupt
+    __HAL_TIM_ENABLE_IT(&Timer3, TIM_IT_UPDATE | TIM_IT_CC1);
+#if defined(STM32G0xx)
+    HAL_NVIC_SetPriority(TIM3_TIM4_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ  (TIM3_TIM4_IRQn);
+#else
+    HAL_NVIC_SetPriority(TIM3_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ  (TIM3_IRQn);
+#endif
     return true;
 }
 
-// Overwrite weak callback function
-// This callback is called by interrupt every 65.536 ms from HAL_FDCAN_IRQHandler()
-// It extends Timer 3 from 16 bit to 32 bit.
-void HAL_FDCAN_TimestampWraparoundCallback(FDCAN_HandleTypeDef *hfdcan)
+// Called from the Timer 3 interrupt every 65.536 ms when the 16 bit counter wraps around.
+void system_count_timewrap()
 {
+    // The flag is cleared by writing 0, writing 1 has no effect
+    TIM3->SR = ~TIM_SR_UIF;
     timestamp_wrap ++;
 }
 
 // Reset timer 3 (CAN packet timestamps) to zero
 void system_reset_timestamps()
 {
+    system_disable_irq();
     TIM3->CNT = 0;
+    TIM3->SR  = ~TIM_SR_UIF;
     timestamp_wrap = 0;
+    system_enable_irq();
 }
 
 // ===================================================================================================
@@ -266,19 +278,50 @@ uint32_t system_get_can_clock()
     return canfd_clock;
 }
 
-// get timestamp with 1 s precision
-// Timer3 must be used because this is written into FDCAN_TxEventFifoTypeDef.TxTimestamp and FDCAN_RxHeaderTypeDef.RxTimestamp
-// Timer3 provides only the low 16 bit. The high 16 bit come from the wrap around callback.
+// get timestamp with 1 s precision (the low 32 bit of system_get_timestamp64(), rolls over after 71 minutes)
 uint32_t system_get_timestamp()
 {
+    return (uint32_t)system_get_timestamp64();
+}
+
+// get timestamp with 1 s precision that never rolls over
+// Timer3 must be used because this is written into FDCAN_TxEventFifoTypeDef.TxTimestamp and FDCAN_RxHeaderTypeDef.RxTimestamp
+// Timer3 provides only the low 16 bit. The high bits come from the wrap around counter.
+// Bugfix: (timestamp_wrap << 16) | TIM3->CNT jumped back 65 ms when the timer wrapped around between reading both values.
+// This may be called from the main loop and from any interrupt.
+uint64_t system_get_timestamp64()
+{
+    uint32_t wrap, timer, pending;
+    do
+    {
+        wrap    = timestamp_wrap;
+        timer   = TIM3->CNT;
+        pending = TIM3->SR & TIM_SR_UIF;
+    }
+    while (wrap != timestamp_wrap); // the update interrupt has executed in between --> read again
+
+    // The timer has wrapped around, but the update interrupt has not yet executed (it is blocked or has a lower priority than the caller).
+    // If the flag is set and the timer is high, the wrap around happened after reading the timer.
+    if (pending && timer < 0x8000)
+        wrap ++;
+
     // timer_3 has the same value as HAL_FDCAN_GetTimestampCounter()
-    return (timestamp_wrap << 16) | TIM3->CNT;
+    return ((uint64_t)wrap << 16) | timer;
+}
+
+// Extend a 16 bit timestamp that the FDCAN peripheral has captured in the last 65 ms to 64 bit.
+// The high bits are taken from the current time, minus one wrap around if the timer has wrapped since the capture.
+uint64_t system_extend_timestamp16(uint16_t stamp)
+{
+    uint64_t now = system_get_timestamp64();
+    return now - (uint16_t)((uint16_t)now - stamp);
 }
 
-// get only the high 16 bit of the timestamp counter
-uint32_t system_get_timewrap()
+// Extend a 32 bit timestamp that was taken in the last 71 minutes to 64 bit.
+uint64_t system_extend_timestamp32(uint32_t stamp)
 {
-    return timestamp_wrap;
+    uint64_t now = system_get_timestamp64();
+    return now - (uint32_t)((uint32_t)now - stamp);
 }
 
 // ----------------------------- Option Bytes ----------------------------------
@@ -42,7 +42,10 @@ eFeedback     system_set_option_bytes (eOptionBytes e_Option);
 uint32_t      system_get_can_clock();
 eMcuSerie     system_get_mcu_serie();
 uint32_t      system_get_timestamp();
-uint32_t      system_get_timewrap();
+uint64_t      system_get_timestamp64();
+uint64_t      system_extend_timestamp16(uint16_t stamp);
+uint64_t      system_extend_timestamp32(uint32_t stamp);
+void          system_count_timewrap();
 uint32_t      system_get_flash_addr(uint32_t segment);
 eFeedback     system_write_flash(uint32_t segment, uint8_t* buffer, uint16_t data_len);
 void          system_reset_timestamps();
@@ -20,6 +20,12 @@ typedef enum // 32 bit
     USR_Feedback    = 0x20, // enable feedback mode (return execution status of a command with enum eFeedback) (Candlelight uses ELM_ReqGetLastError instead)
     USR_Timestamp   = 0x40, // send timestamps to the host
     USR_SendBlobs   = 0x80, // allow to send multiple CAN frames packed together in blobs over USB
+    USR_TxPriority  = 0x100, // send pending Tx packets ordered by CAN ID (lowest ID first) instead of the order they came from the host
+    USR_Timestamp64 = 0x200, // send 64 bit timestamps to the host (only Candlelight, requires USR_Timestamp)
+    USR_TimeSync    = 0x400, // send the MCU time of the USB Start-Of-Frame periodically to the host (only Candlelight)
+    USR_RxSequence  = 0x800, // send a sequence number and a lost packet counter with each Rx packet (only Candlelight)
+    USR_RxDualFifo  = 0x1000, // use both hardware Rx FIFOs for accepted packets, count rejected packets only (only Candlelight)
+    USR_ErrorLog    = 0x2000, // send each protocol error with timestamp and the error counters per type to the host
     // --------------------
     // IMPORTANT:
     // Never *EVER* modify these defaults!!! You will break all applications that have been written for CANable adapters!
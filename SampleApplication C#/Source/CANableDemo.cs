@@ -51,10 +51,16 @@ using eMessageType        = CANable.Candlelight.eMessageType;
 using eBusStatus          = CANable.Candlelight.eBusStatus;
 using eErrorLevel         = CANable.Candlelight.eErrorLevel;
 using cTxEchoElmue        = CANable.Candlelight.cTxEchoElmue;
+using cTxExpiredElmue     = CANable.Candlelight.cTxExpiredElmue;
 using cRxFrameElmue       = CANable.Candlelight.cRxFrameElmue;
 using cErrorElmue         = CANable.Candlelight.cErrorElmue;
 using cStringElmue        = CANable.Candlelight.cStringElmue;
 using cBusloadElmue       = CANable.Candlelight.cBusloadElmue;
+using cBusloadStatsElmue  = CANable.Candlelight.cBusloadStatsElmue;
+using cErrorEventElmue    = CANable.Candlelight.cErrorEventElmue;
+using cErrorCountersElmue = CANable.Candlelight.cErrorCountersElmue;
+using cBusOffStatsElmue   = CANable.Candlelight.cBusOffStatsElmue;
+using eBusOffPolicy       = CANable.Candlelight.eBusOffPolicy;
 using cDetail             = CANable.Candlelight.cDetail;
 using Utils               = CANable.Utils;
 using INPUT_KEY_RECORD    = CANable.Utils.INPUT_KEY_RECORD;
@@ -164,6 +170,12 @@ class Program
             
             mi_Candle.EnableTxEcho(true);           
 
+            // Optionally cancel unacknowledged Tx packets after 2 seconds instead of 500 ms (requires firmware 17.Oct.2026)
+            // mi_Candle.SetTxTimeout(2000);
+
+            // Optionally wait 100 ms before recovering from Bus Off, double the delay for each attempt, stop after 8 attempts (requires firmware 17.Oct.2026)
+            // mi_Candle.SetBusOffRecovery(eBusOffPolicy.Backoff, 100, 8);
+
             // -----------------------------------------
 
             // Optionally you can set a CAN FD data bitrate here.
@@ -219,6 +231,7 @@ class Program
             // e_DevFlags |= eDeviceFlags.OneShot;    // turn off automatic re-transmission
             // e_DevFlags |= eDeviceFlags.ListenOnly; // silent mode
             // e_DevFlags |= eDeviceFlags.Loopback;   // loopback mode
+            // e_DevFlags |= eDeviceFlags.ErrorLog;   // report each protocol error with timestamp (requires firmware 17.Oct.2026)
 
             // If you turn off eDeviceFlags.Timestamp, Windows timestamps will be used.
             // Firmware timestamps produce more USB traffic and are not available for sent packets.
@@ -357,6 +370,11 @@ class Program
                         CanPacket i_Packet = mi_Candle.RxFrameToCanPacket((cRxFrameElmue)i_Header);
                         Print(ConsoleColor.White, " Recv");
                         Print(ConsoleColor.Cyan,  " {0}", i_Packet);
+
+                        // Show the frames that have been lost before this frame (requires firmware 16.Oct.2026)
+                        int s32_Dropped, s32_Lost;
+                        if (mi_Candle.GetRxLoss((cRxFrameElmue)i_Header, out s32_Dropped, out s32_Lost) && (s32_Dropped > 0 || s32_Lost > 0))
+                            Print(ConsoleColor.Red, "  ({0} dropped in firmware, {1} lost in hardware)", s32_Dropped, s32_Lost);
                         break;
                     }
                     case eMessageType.TxEcho:
@@ -367,6 +385,14 @@ class Program
                         else                      Print(ConsoleColor.DarkGreen, " {0}", i_EchoPacket);
                         break;
                     }
+                    case eMessageType.TxExpired: // a packet sent with SendPacketTtl() has been discarded (requires firmware 17.Oct.2026)
+                    {
+                        CanPacket i_ExpiredPacket = mi_Candle.GetTxExpiredPacket((cTxExpiredElmue)i_Header);
+                        Print(ConsoleColor.White, " Expd");
+                        if (i_ExpiredPacket == null) Print(ConsoleColor.Red, " Invalid echo marker received");
+                        else                         Print(ConsoleColor.Red, " {0}", i_ExpiredPacket);
+                        break;
+                    }
                     case eMessageType.Error:
                     {
                         eBusStatus  e_BusStatus;
@@ -393,6 +419,32 @@ class Program
                         Print(ConsoleColor.Gray,  " Busload: {0}%", i_Busload.mu8_BusLoad);
                         break;
                     }
+                    case eMessageType.BusloadStats:
+                    {
+                        cBusloadStatsElmue i_Stats = (cBusloadStatsElmue)i_Header;
+                        Print(ConsoleColor.White, " Load");
+                        Print(ConsoleColor.Gray,  " Busload: {0}%, Peak: {1}%, Min: {2}%, Histogram: {3}", i_Stats.mu8_BusLoad, i_Stats.mu8_Peak, 
+                                                  i_Stats.mu8_Minimum, String.Join(" ", i_Stats.mu16_Histogram));
+                        break;
+                    }
+                    case eMessageType.ErrorEvent:
+                    {
+                        Print(ConsoleColor.White,  " Err ");
+                        Print(ConsoleColor.Yellow, " {0}", mi_Candle.FormatErrorEvent((cErrorEventElmue)i_Header));
+                        break;
+                    }
+                    case eMessageType.ErrorCounters:
+                    {
+                        Print(ConsoleColor.White, " Err ");
+                        Print(ConsoleColor.Gray,  " {0}", mi_Candle.FormatErrorCounters((cErrorCountersElmue)i_Header));
+                        break;
+                    }
+                    case eMessageType.BusOffStats: // requires firmware 17.Oct.2026
+                    {
+                        Print(ConsoleColor.White,  " BOff");
+                        Print(ConsoleColor.Yellow, " {0}", mi_Candle.FormatBusOffStats((cBusOffStatsElmue)i_Header));
+                        break;
+                    }
                     default:
                     {
                         Print(ConsoleColor.White, " Err ");
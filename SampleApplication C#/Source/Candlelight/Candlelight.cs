@@ -81,11 +81,18 @@ public class Candlelight : IDisposable
         GetBoardInfo = 20, // kBoardInfo: get name about target board and processor
         SetFilter,         // kFilter: set up to 8 acceptance mask filters
         GetLastError,      // Byte: get the eFeedback error of the last SETUP request. This works also in legacy mode!
-        SetBusLoadReport,  // Byte: enable busload report in percent to be sent in a user defined interval
+        SetBusLoadReport,  // Byte interval + optional eBusloadFlags: enable busload report in percent to be sent in a user defined interval
         SetPinStatus,      // kPinStatus: set, reset, enable, disable,... processor pins
         GetPinStatus,      // Receive: SETUP.wValue = ePinID, Send: ePinStatus in 2 data bytes
         ReadFlash,         // Read  user data from a segment in flash memory
         WriteFlash,        // Write user data to   a segment in flash memory
+        SetTranslation,    // kTranslation: set the CAN ID translation and data modification of bridge packets
+        SetIdStats,        // kIdStatsSetup: enable / disable / clear the per-ID statistics of received CAN IDs
+        GetIdStats,        // Receive: SETUP.wValue = channel + (page << 8), Send: kIdStatsPage
+        SetCyclic,         // kCyclicEntry: set / remove a periodic Tx packet of the cyclic transmit scheduler
+        GetTimestamp64,    // UInt64: get firmware 1 µs timestamp that never rolls over
+        SetTxTimeout,      // UInt16: time in ms after which pending Tx packets that are not acknowledged are canceled (default 500 ms)
+        SetBusOffRecovery, // kBusOffSetup: set the recovery policy for Bus Off or start the recovery now
     }
 
     enum eDevMode : int
@@ -116,6 +123,12 @@ public class Candlelight : IDisposable
         ProtocolElmue       = 0x04000, // ElmüSoft protocol
         SendUsbBlobs        = 0x08000, // send blobs over USB
         LegacyFilters       = 0x10000, // not implemented
+        TxPriority          = 0x20000, // send pending Tx packets ordered by CAN ID
+        Timestamp64         = 0x40000, // send 64 bit timestamps that never roll over (requires HwTimestamp)
+        TimeSync            = 0x80000, // send the MCU time of the USB Start-Of-Frame every 100 ms (cTimeSyncElmue)
+        RxSequence          = 0x100000, // send a sequence number and a lost frame counter with each Rx frame
+        RxDualFifo          = 0x200000, // use both hardware Rx FIFOs for accepted frames, frames of priority filters are sent first
+        ErrorLog            = 0x400000, // send each protocol error with timestamp (cErrorEventElmue) and the error counters (cErrorCountersElmue)
     }
 
     enum eTermination : int
@@ -287,9 +300,13 @@ public class Candlelight : IDisposable
 
     enum eFilterOperation : byte
     {
-        HostClear = 0,    // remove all host filters (adapter must be closed)
+        HostClear = 0,    // remove all host filters and the host ID list (adapter must be closed)
         HostPass_11,      // add a new host pass mask filter for 11 bit CAN IDs to be sent to the host over USB
         HostPass_29,      // add a new host pass mask filter for 29 bit CAN IDs to be sent to the host over USB
+        HostPassID_11,    // add the 11 bit CAN ID in kFilter.Filter to the host ID list (kFilter.Mask is ignored)
+        HostPassID_29,    // add the 29 bit CAN ID in kFilter.Filter to the host ID list (kFilter.Mask is ignored)
+        HostPrio_11,      // add a new host priority mask filter for 11 bit CAN IDs (only with eDeviceFlags.RxDualFifo)
+        HostPrio_29,      // add a new host priority mask filter for 29 bit CAN IDs (only with eDeviceFlags.RxDualFifo)
         // ------------------
         // Bridge Mode (only for multi-channel adapters):
         BridgeClear = 10, // remove one of the bridge filters. If kFilter.Index = 0xFF --> clear all bridge filters.
@@ -297,6 +314,16 @@ public class Candlelight : IDisposable
         BridgePass_29,    // set a bridge pass  mask filter for 29 bit CAN IDs to be forwarded to kFilter.DestChannel 
         BridgeBlock_11,   // set a bridge block mask filter for 11 bit CAN IDs to be blocked (not forwarded to kFilter.DestChannel)
         BridgeBlock_29,   // set a bridge block mask filter for 29 bit CAN IDs to be blocked (not forwarded to kFilter.DestChannel)
+        // ------------------
+        // Bridge rate limits: kFilter.Mask = packets per second (0 = unlimited), kFilter.Index = max packets at once (burst)
+        BridgeLimitDest = 20, // limit all packets forwarded to kFilter.DestChannel. kFilter.Filter = 1 --> latest value wins
+        BridgeLimitID_11,     // limit the packets with the 11 bit CAN ID in kFilter.Filter forwarded from this channel
+        BridgeLimitID_29,     // limit the packets with the 29 bit CAN ID in kFilter.Filter forwarded from this channel
+        // ------------------
+        // Tunnel between two adapters (adapter must be closed): kFilter.Filter = tunnel CAN ID, kFilter.Mask = latency window in µs
+        TunnelClear = 30,     // disable the tunnel on this channel
+        TunnelSet_11,         // enable the tunnel on this channel with an 11 bit tunnel CAN ID
+        TunnelSet_29,         // enable the tunnel on this channel with a  29 bit tunnel CAN ID
     } 
 
     enum ePinOperation : ushort
@@ -325,6 +352,14 @@ public class Candlelight : IDisposable
         Enabled  = 0x0002,  // the pin is currently Enabled. If this bit is not set it is Disabled.
     }
 
+    // Optional second byte of SetBusLoadReport
+    [FlagsAttribute]
+    public enum eBusloadFlags : byte
+    {
+        Exact      = 0x01,  // count the real stuff bits of each frame instead of an average
+        Statistics = 0x02,  // send cBusloadStatsElmue with peak, minimum and histogram of 1 ms windows instead of cBusloadElmue
+    }
+
     public enum eMessageType : byte
     {
         // received from host
@@ -337,6 +372,18 @@ public class Candlelight : IDisposable
         Busload,      // the message contains one byte which is the bus load in percent
         TxBlob,       // the message contains a blob (cBlob) with multiple cTxFrameElmue
         RxBlob,       // the message contains a blob (cBlob) with multiple cRxFrameElmue
+        BusloadStats, // the message contains the bus load statistics of 1 ms windows
+        // received from host
+        TxTimed,      // the message contains a CAN frame to be sent to CAN bus at an absolute MCU timestamp
+        // sent to host
+        TimeSync,     // the message contains the MCU time of the last USB Start-Of-Frame
+        ErrorEvent,   // the message contains one protocol error with timestamp
+        ErrorCounters,// the message contains the count of protocol errors per type
+        // received from host
+        TxTtl,        // the message contains a CAN frame to be sent to CAN bus that is discarded when its time-to-live expires
+        // sent to host
+        TxExpired,    // the message contains the marker of a CAN Tx frame that has been discarded because its time-to-live expired or a timed frame could not be sent
+        BusOffStats,  // the message contains the statistics of the Bus Off recovery
     } 
 
     // If any of these flags is set, both LED's (Rx + Tx) are permanently ON
@@ -502,6 +549,105 @@ public class Candlelight : IDisposable
         public Byte[]           mu8_Reserved;
     }
 
+    // The data bytes 0...7 of bridge packets are modified: data = ((data & KeepMask) | (Replace & ~KeepMask)) ^ Xor
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    struct kTranslation
+    {
+        public Byte   mu8_Operation;  // 0 = clear all translations, 1 = set the translation of SourceID
+        public UInt32 mu32_SourceID;  // OR'ed with 0x80000000 for 29 bit IDs
+        public UInt32 mu32_DestID;    // OR'ed with 0x80000000 for 29 bit IDs
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 8)]
+        public Byte[] mu8_KeepMask;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 8)]
+        public Byte[] mu8_Replace;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 8)]
+        public Byte[] mu8_Xor;
+    }
+
+    public enum eIdStatsOperation : byte
+    {
+        Disable = 0, // disable the per-ID statistics (adapter closed)
+        Enable,      // enable the per-ID statistics for MaxEntries CAN IDs (adapter closed)
+        Clear,       // clear all entries (adapter open or closed)
+    }
+
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    struct kIdStatsSetup
+    {
+        public eIdStatsOperation me_Operation;
+        public Byte              mu8_NoStream;    // 1 = received frames are only counted, but not sent to the host
+        public UInt16            mu16_MaxEntries; // max 24 on STM32G431 and STM32G0B1, max 384 on STM32G473
+    }
+
+    public enum eBusOffOperation : byte
+    {
+        SetPolicy = 0, // set Policy, BaseDelay and MaxAttempts (adapter open or closed)
+        Recover,       // start the recovery from Bus Off now (adapter open), required with Manual or after MaxAttempts
+    }
+
+    public enum eBusOffPolicy : byte
+    {
+        Immediate = 0, // restart the CAN controller immediately after Bus Off (default)
+        Backoff,       // wait BaseDelay before the first attempt, the delay is doubled for each further attempt
+        Manual,        // do not recover alone, wait for RecoverBusOff()
+    }
+
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    struct kBusOffSetup
+    {
+        public eBusOffOperation me_Operation;
+        public eBusOffPolicy    me_Policy;
+        public UInt16           mu16_MaxAttempts; // consecutive recovery attempts before the firmware waits for RecoverBusOff() (0 = unlimited)
+        public UInt16           mu16_BaseDelay;   // Backoff: delay in ms before the first attempt, doubled for each further attempt (1 ... 60000)
+        public UInt16           mu16_Reserved;
+    }
+
+    // Statistics of one CAN ID, all times in µs
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct kIdStatsEntry
+    {
+        public UInt32 mu32_CanID;      // OR'ed with 0x80000000 for 29 bit IDs
+        public UInt32 mu32_Count;      // count of received frames
+        public UInt32 mu32_MinPeriod;  // shortest time between two frames (0 if only one frame has been received)
+        public UInt32 mu32_MeanPeriod; // average  time between two frames
+        public UInt32 mu32_MaxPeriod;  // longest  time between two frames
+        public UInt32 mu32_LastStamp;  // timestamp of the last frame
+        public Byte   mu8_LastDLC;     // DLC of the last frame (0...15)
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+        public Byte[] mu8_Reserved;
+    }
+
+    // One page of the per-ID statistics. Request page 0, 1, 2,... until mu8_EntryCount < 8.
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct kIdStatsPage
+    {
+        public UInt16 mu16_TotalIDs;   // count of CAN IDs in the table
+        public Byte   mu8_Page;        // the requested page
+        public Byte   mu8_EntryCount;  // valid entries in this page (0...8)
+        public UInt32 mu32_LostFrames; // count of frames that were not counted because the table was full
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 8)]
+        public kIdStatsEntry[] mk_Entries;
+    }
+
+    // Periodic Tx packet that the firmware sends without the host, all times in µs
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    struct kCyclicEntry
+    {
+        public Byte        mu8_Operation;    // 0 = remove all entries, 1 = set the entry mu8_Index (mu32_Period = 0 removes the entry)
+        public Byte        mu8_Index;        // entry 0...15 (0...7 on STM32G431 and STM32G0B1)
+        public eFrameFlags me_Flags;         // FDF, BRS
+        public Byte        mu8_DLC;          // 0...15
+        public UInt32      mu32_CanID;       // OR'ed with 0x80000000 for 29 bit IDs and 0x40000000 for remote frames
+        public UInt32      mu32_Period;      // time between two transmissions (min 100 µs)
+        public UInt32      mu32_Phase;       // time of the first transmission after opening the adapter or setting the entry
+        public Byte        mu8_CounterByte;  // data byte with a rolling counter, 0xFF = no counter
+        public Byte        mu8_CounterMask;  // contiguous bits of the rolling counter (e.g. 0x0F or 0xF0)
+        public Byte        mu8_ChecksumByte; // data byte with the checksum of all other data bytes, 0xFF = no checksum
+        public Byte        mu8_ChecksumXor;  // 0 = 8 bit sum, 1 = XOR
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 64)]
+        public Byte[]      mu8_Data;
+    }
+
     [StructLayout(LayoutKind.Sequential, Pack = 1)]
     struct kPinStatus
     {
@@ -530,7 +676,7 @@ public class Candlelight : IDisposable
         /// Get the size of the fix fields in the struct before the variable fields begin
         /// If the firmware sends less bytes than this minimum size an exception is thrown
         /// </summary>
-        public virtual int GetMinSize(bool b_McuTimestamp)
+        public virtual int GetMinSize(int s32_StampLen)
         {
             return 2;
         }
@@ -552,14 +698,14 @@ public class Candlelight : IDisposable
         /// <summary>
         /// Get the size of the fix fields in the struct before the variable fields begin
         /// </summary>
-        public override int GetMinSize(bool b_McuTimestamp)
+        public override int GetMinSize(int s32_StampLen)
         {
             return (int)Marshal.OffsetOf(GetType(), "mu8_Data");
         }
 
         public cTxFrameElmue(CanPacket i_Packet)
         {
-            mu8_Size    = (Byte)(GetMinSize(false) + i_Packet.mi_Data.Count);
+            mu8_Size    = (Byte)(GetMinSize(0) + i_Packet.mi_Data.Count);
             me_MesgType = eMessageType.TxFrame;
             mu32_CanID  = (UInt32)i_Packet.ms32_ID;
             if (i_Packet.mb_29bit) mu32_CanID |= (UInt32)eCanIdFlags.Extended;
@@ -572,6 +718,80 @@ public class Candlelight : IDisposable
         }
     }
 
+    // this struct is received on endpoint 02 (OUT) from the host (firmware 16.Oct.2026)
+    // The same as cTxFrameElmue, but the firmware holds the frame back until the MCU timestamp reaches mu32_SendTime.
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    private class cTxTimedElmue : cHeader
+    {
+        public eFrameFlags  me_Flags;      // eFrameFlags    
+        public UInt32       mu32_CanID;    // CAN ID + eCanIdFlags
+        public Byte         mu8_Marker;    // one-byte marker that is sent back to the host with MSG_TxEcho when the packet has been ACKnowledged    
+        public UInt32       mu32_SendTime; // MCU timestamp in µs at which the frame is sent
+        // ----- variable start ------
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 64)]
+        public Byte[]       mu8_Data;      // max. 64 data bytes
+
+        /// <summary>
+        /// Get the size of the fix fields in the struct before the variable fields begin
+        /// </summary>
+        public override int GetMinSize(int s32_StampLen)
+        {
+            return (int)Marshal.OffsetOf(GetType(), "mu8_Data");
+        }
+
+        public cTxTimedElmue(CanPacket i_Packet, UInt32 u32_SendTime)
+        {
+            mu8_Size      = (Byte)(GetMinSize(0) + i_Packet.mi_Data.Count);
+            me_MesgType   = eMessageType.TxTimed;
+            mu32_SendTime = u32_SendTime;
+            mu32_CanID    = (UInt32)i_Packet.ms32_ID;
+            if (i_Packet.mb_29bit) mu32_CanID |= (UInt32)eCanIdFlags.Extended;
+            if (i_Packet.mb_RTR)   mu32_CanID |= (UInt32)eCanIdFlags.RTR;
+            if (i_Packet.mb_FDF)   me_Flags   |= eFrameFlags.FDF;
+            if (i_Packet.mb_BRS)   me_Flags   |= eFrameFlags.BRS;
+
+            mu8_Data = new Byte[64]; // required for Utils.StructureToBytesVar()
+            Array.Copy(i_Packet.mi_Data.ToArray(), mu8_Data, i_Packet.mi_Data.Count);
+        }
+    }
+
+    // this struct is received on endpoint 02 (OUT) from the host (firmware 17.Oct.2026)
+    // The same as cTxFrameElmue, but the firmware discards the frame if it is still in the Tx buffer when mu32_TimeToLive has elapsed.
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    private class cTxTtlElmue : cHeader
+    {
+        public eFrameFlags  me_Flags;        // eFrameFlags    
+        public UInt32       mu32_CanID;      // CAN ID + eCanIdFlags
+        public Byte         mu8_Marker;      // one-byte marker that is sent back to the host with MSG_TxEcho or MSG_TxExpired
+        public UInt32       mu32_TimeToLive; // time-to-live in µs (max 0x7FFFFFFF)
+        // ----- variable start ------
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 64)]
+        public Byte[]       mu8_Data;        // max. 64 data bytes
+
+        /// <summary>
+        /// Get the size of the fix fields in the struct before the variable fields begin
+        /// </summary>
+        public override int GetMinSize(int s32_StampLen)
+        {
+            return (int)Marshal.OffsetOf(GetType(), "mu8_Data");
+        }
+
+        public cTxTtlElmue(CanPacket i_Packet, UInt32 u32_TimeToLive)
+        {
+            mu8_Size        = (Byte)(GetMinSize(0) + i_Packet.mi_Data.Count);
+            me_MesgType     = eMessageType.TxTtl;
+            mu32_TimeToLive = u32_TimeToLive;
+            mu32_CanID      = (UInt32)i_Packet.ms32_ID;
+            if (i_Packet.mb_29bit) mu32_CanID |= (UInt32)eCanIdFlags.Extended;
+            if (i_Packet.mb_RTR)   mu32_CanID |= (UInt32)eCanIdFlags.RTR;
+            if (i_Packet.mb_FDF)   me_Flags   |= eFrameFlags.FDF;
+            if (i_Packet.mb_BRS)   me_Flags   |= eFrameFlags.BRS;
+
+            mu8_Data = new Byte[64]; // required for Utils.StructureToBytesVar()
+            Array.Copy(i_Packet.mi_Data.ToArray(), mu8_Data, i_Packet.mi_Data.Count);
+        }
+    }
+
     // this struct is transmitted on endpoint 81 (IN) to the host
     // A DLC byte is not required. The count of transferred data bytes is calculated as: size - sizeof(kRxFrameElmue)
     // For remote frames the DLC from the Rx packet is transmitted in the first data byte to the host.
@@ -582,18 +802,18 @@ public class Candlelight : IDisposable
         public eFrameFlags  me_Flags;       // eFrameFlags    
         public UInt32       mu32_CanID;     // CAN ID + eCanIdFlags or error flags
         // ----- variable start ------
-        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 4 + 64)]
-        public Byte[]       mu8_TimeStampAndData; // optional 32 bit timestamp + max. 64 data bytes
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 8 + 4 + 64)]
+        public Byte[]       mu8_TimeStampAndData; // optional 32 or 64 bit timestamp + optional sequence + max. 64 data bytes
 
         /// <summary>
         /// Get the size of the fix fields in the struct before the variable fields begin
         /// If the firmware sends less bytes than this minimum size an exception is thrown
         /// </summary>
-        public override int GetMinSize(bool b_McuTimestamp)
+        public override int GetMinSize(int s32_StampLen)
         {
             // It is allowed that a remote frame has zero data bytes
             int s32_MinSize = (int)Marshal.OffsetOf(GetType(), "mu8_TimeStampAndData");
-            if (b_McuTimestamp) s32_MinSize += 4;
+            s32_MinSize += s32_StampLen;
             return s32_MinSize;
         }
 
@@ -604,6 +824,32 @@ public class Candlelight : IDisposable
         {
             get { return BitConverter.ToUInt32(mu8_TimeStampAndData, 0); }
         }
+
+        /// <summary>
+        /// Call this only if transfer of 64 bit timestamps is enabled (mb_McuTimestamp64 = true), otherwise garbage will be returned.
+        /// </summary>
+        public UInt64 Timestamp64
+        {
+            get { return BitConverter.ToUInt64(mu8_TimeStampAndData, 0); }
+        }
+
+        /// <summary>
+        /// Call this only if eDeviceFlags.RxSequence is enabled, otherwise garbage will be returned.
+        /// The sequence number follows the timestamp. It is incremented for each frame, also if it was dropped in the firmware.
+        /// </summary>
+        public UInt16 GetSequence(int s32_StampLen)
+        {
+            return BitConverter.ToUInt16(mu8_TimeStampAndData, s32_StampLen);
+        }
+
+        /// <summary>
+        /// Call this only if eDeviceFlags.RxSequence is enabled, otherwise garbage will be returned.
+        /// This counter is incremented for each frame that has been lost in the hardware.
+        /// </summary>
+        public UInt16 GetLostCount(int s32_StampLen)
+        {
+            return BitConverter.ToUInt16(mu8_TimeStampAndData, s32_StampLen + 2);
+        }
     }
 
     [StructLayout(LayoutKind.Sequential, Pack = 1)]
@@ -612,15 +858,37 @@ public class Candlelight : IDisposable
         public Byte    mu8_Marker;     // the same marker that was sent in kTxFrameElmue sent back to the host when the packet was ACKnowledged on CAN bus.
         // ----- variable start ------
         public UInt32  mu32_Timestamp; // only sent to host if GS_DevFlagTimestamp has been set
+        public UInt32  mu32_TimestampHigh; // only sent to host if ELM_DevFlagTimestamp64 has been set
 
         /// <summary>
         /// Get the size of the fix fields in the struct before the variable fields begin
         /// If the firmware sends less bytes than this minimum size an exception is thrown
         /// </summary>
-        public override int GetMinSize(bool b_McuTimestamp)
+        public override int GetMinSize(int s32_StampLen)
         {
             int s32_MinSize = (int)Marshal.OffsetOf(GetType(), "mu32_Timestamp");
-            if (b_McuTimestamp) s32_MinSize += 4;
+            s32_MinSize += s32_StampLen;
+            return s32_MinSize;
+        }
+    };
+
+    // sent when a packet from SendPacketTtl() has been discarded (firmware 17.Oct.2026)
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public class cTxExpiredElmue : cHeader
+    {
+        public Byte    mu8_Marker;     // the same marker that was sent in cTxTtlElmue sent back to the host when the packet was discarded.
+        // ----- variable start ------
+        public UInt32  mu32_Timestamp; // only sent to host if GS_DevFlagTimestamp has been set
+        public UInt32  mu32_TimestampHigh; // only sent to host if ELM_DevFlagTimestamp64 has been set
+
+        /// <summary>
+        /// Get the size of the fix fields in the struct before the variable fields begin
+        /// If the firmware sends less bytes than this minimum size an exception is thrown
+        /// </summary>
+        public override int GetMinSize(int s32_StampLen)
+        {
+            int s32_MinSize = (int)Marshal.OffsetOf(GetType(), "mu32_Timestamp");
+            s32_MinSize += s32_StampLen;
             return s32_MinSize;
         }
     };
@@ -633,15 +901,16 @@ public class Candlelight : IDisposable
         public  Byte[]          mu8_ErrData;    // several error flags and error counters
         // ----- variable start ------
         public  UInt32          mu32_Timestamp; // only sent to host if GS_DevFlagTimestamp has been set
+        public  UInt32          mu32_TimestampHigh; // only sent to host if ELM_DevFlagTimestamp64 has been set
 
         /// <summary>
         /// Get the size of the fix fields in the struct before the variable fields begin
         /// If the firmware sends less bytes than this minimum size an exception is thrown
         /// </summary>
-        public override int GetMinSize(bool b_McuTimestamp)
+        public override int GetMinSize(int s32_StampLen)
         {
             int s32_MinSize = (int)Marshal.OffsetOf(GetType(), "mu32_Timestamp");
-            if (b_McuTimestamp) s32_MinSize += 4;
+            s32_MinSize += s32_StampLen;
             return s32_MinSize;
         }
     };
@@ -657,7 +926,7 @@ public class Candlelight : IDisposable
         /// The size of the fix fields in the struct before the variable fields begin
         /// If the firmware sends less bytes than this minimum size an exception is thrown
         /// </summary>
-        public override int GetMinSize(bool b_McuTimestamp)
+        public override int GetMinSize(int s32_StampLen)
     {
             return (int)Marshal.OffsetOf(GetType(), "mu8_AsciiMsg"); 
         }
@@ -667,7 +936,7 @@ public class Candlelight : IDisposable
         /// </summary>
         public String Message
         {
-            get { return Encoding.ASCII.GetString(mu8_AsciiMsg, 0, mu8_Size - GetMinSize(false)); }
+            get { return Encoding.ASCII.GetString(mu8_AsciiMsg, 0, mu8_Size - GetMinSize(0)); }
         }
     };
 
@@ -682,7 +951,119 @@ public class Candlelight : IDisposable
         /// Get the size of the fix fields in the struct before the variable fields begin
         /// If the firmware sends less bytes than this minimum size an exception is thrown
         /// </summary>
-        public override int GetMinSize(bool b_McuTimestamp)
+        public override int GetMinSize(int s32_StampLen)
+        {
+            return Marshal.SizeOf(GetType());
+        }
+    };
+
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public class cBusloadStatsElmue : cHeader
+    {
+        public Byte   mu8_BusLoad;  // average bus load of the interval in percent
+        public Byte   mu8_Peak;     // highest bus load of a 1 ms window in percent
+        public Byte   mu8_Minimum;  // lowest  bus load of a 1 ms window in percent
+        public Byte   mu8_Reserved;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 10)]
+        public UInt16[] mu16_Histogram; // count of windows with 0...9%, 10...19%,... 90...100% bus load
+        // ----- variable start ------
+        // No variable fields here.
+
+        /// <summary>
+        /// Get the size of the fix fields in the struct before the variable fields begin
+        /// If the firmware sends less bytes than this minimum size an exception is thrown
+        /// </summary>
+        public override int GetMinSize(int s32_StampLen)
+        {
+            return Marshal.SizeOf(GetType());
+        }
+    };
+
+    // All adapters on the same USB host controller receive the same SOF at the same time.
+    // Two adapters can be aligned exactly by comparing the SOF time of messages with the same frame number.
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public class cTimeSyncElmue : cHeader
+    {
+        public UInt16 mu16_FrameNumber; // 11 bit USB frame number of the SOF (counts milliseconds)
+        public UInt64 mu64_SofTime;     // 64 bit MCU timestamp in µs when the SOF was received
+        // ----- variable start ------
+        // No variable fields here.
+
+        /// <summary>
+        /// Get the size of the fix fields in the struct before the variable fields begin
+        /// If the firmware sends less bytes than this minimum size an exception is thrown
+        /// </summary>
+        public override int GetMinSize(int s32_StampLen)
+        {
+            return Marshal.SizeOf(GetType());
+        }
+    };
+
+    // Code = 1: stuff error, 2: form error, 3: ACK error, 4: bit 1 error, 5: bit 0 error, 6: CRC error
+    // Bit 7 of the code is set if the error occurred in the data phase of a CAN FD frame with BRS.
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public class cErrorEventElmue : cHeader
+    {
+        public Byte   mu8_Code;         // protocol error + 0x80 for the data phase
+        public Byte   mu8_TxErrCount;   // Tx error counter after the error
+        public Byte   mu8_RxErrCount;   // Rx error counter after the error
+        // ----- variable start ------
+        public UInt32 mu32_Timestamp;     // always sent, also without eDeviceFlags.HwTimestamp
+        public UInt32 mu32_TimestampHigh; // only sent to host if ELM_DevFlagTimestamp64 has been set
+
+        /// <summary>
+        /// Get the size of the fix fields in the struct before the variable fields begin
+        /// If the firmware sends less bytes than this minimum size an exception is thrown
+        /// </summary>
+        public override int GetMinSize(int s32_StampLen)
+        {
+            int s32_MinSize = (int)Marshal.OffsetOf(GetType(), "mu32_Timestamp");
+            s32_MinSize += Math.Max(4, s32_StampLen);
+            return s32_MinSize;
+        }
+    };
+
+    // The counters start at zero when the channel is started.
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public class cErrorCountersElmue : cHeader
+    {
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 6)]
+        public UInt32[] mu32_Counts;    // count of stuff, form, ACK, bit 1, bit 0 and CRC errors (index = code - 1)
+        public UInt32   mu32_Suppressed;// count of errors that have not been sent as cErrorEventElmue because of the rate limit
+        // ----- variable start ------
+        // No variable fields here.
+
+        /// <summary>
+        /// Get the size of the fix fields in the struct before the variable fields begin
+        /// If the firmware sends less bytes than this minimum size an exception is thrown
+        /// </summary>
+        public override int GetMinSize(int s32_StampLen)
+        {
+            return Marshal.SizeOf(GetType());
+        }
+    };
+
+    // Sent after each recovery from Bus Off and when the firmware waits for RecoverBusOff().
+    // All times are measured from the detection of Bus Off until the bus is error active again, including the back-off delay.
+    // The statistics start at zero when the channel is started.
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public class cBusOffStatsElmue : cHeader
+    {
+        public Byte     mu8_Waiting;     // 1 = the firmware does not recover alone, the host must call RecoverBusOff()
+        public Byte     mu8_Reserved;
+        public UInt16   mu16_Attempts;   // recovery attempts since the bus was stable the last time
+        public UInt32   mu32_BusOffCount;// count of Bus Off events
+        public UInt32   mu32_LastMs;     // recovery time of the last recovery in ms
+        public UInt32   mu32_MinMs;      // shortest recovery time in ms (0 = no recovery yet)
+        public UInt32   mu32_MaxMs;      // longest  recovery time in ms
+        // ----- variable start ------
+        // No variable fields here.
+
+        /// <summary>
+        /// Get the size of the fix fields in the struct before the variable fields begin
+        /// If the firmware sends less bytes than this minimum size an exception is thrown
+        /// </summary>
+        public override int GetMinSize(int s32_StampLen)
         {
             return Marshal.SizeOf(GetType());
         }
@@ -847,6 +1228,149 @@ public class Candlelight : IDisposable
 
     #endregion
 
+    #region class cClockSync
+
+    /// <summary>
+    /// Estimates the offset and the drift between the MCU clock and the Windows clock (eDeviceFlags.TimeSync).
+    /// Each cTimeSyncElmue contains the MCU time of a USB Start-Of-Frame. It arrives with a variable USB latency which is never negative.
+    /// The sample with the lowest latency of each second is stored and a straight line is fitted through the last 60 of them.
+    /// Then the line is moved down to the lowest sample, so it follows the minimum USB latency and not the average.
+    /// </summary>
+    public class cClockSync
+    {
+        const int BLOCK_SAMPLES = 10; // 10 sync messages of 100 ms --> one point per second
+        const int MAX_POINTS    = 60; // fit over the last 60 seconds
+
+        Int64[] ms64_McuPoints  = new Int64[MAX_POINTS]; // ring buffer
+        Int64[] ms64_DiffPoints = new Int64[MAX_POINTS]; // host time - MCU time
+        int     ms32_Count;       // count of valid points
+        int     ms32_WriteIdx;    // next write position in the ring buffer
+        int     ms32_BlockCount;  // samples in the current block
+        Int64   ms64_BlockMcu;    // MCU time of the best sample in the current block
+        Int64   ms64_BlockDiff;   // lowest (host time - MCU time) in the current block
+        Int64   ms64_LastMcu;     // detects a reset of the MCU timestamps
+        Int64   ms64_BaseMcu;     // MCU time where md_Offset is valid
+        double  md_Offset;        // host time - MCU time at ms64_BaseMcu
+        double  md_Drift;         // host clock runs (1 + md_Drift) times faster than the MCU clock
+
+        public cClockSync()
+        {
+            Reset();
+        }
+
+        public bool IsValid
+        {
+            get { return ms32_Count > 0; }
+        }
+
+        /// <summary>
+        /// The drift between the clocks in ppm
+        /// </summary>
+        public double Drift
+        {
+            get { return md_Drift * 1000000.0; }
+        }
+
+        public void Reset()
+        {
+            ms32_Count      = 0;
+            ms32_WriteIdx   = 0;
+            ms32_BlockCount = 0;
+            ms64_BlockMcu   = 0;
+            ms64_BlockDiff  = 0;
+            ms64_LastMcu    = -1;
+            ms64_BaseMcu    = 0;
+            md_Offset       = 0.0;
+            md_Drift        = 0.0;
+        }
+
+        /// <summary>
+        /// s64_McuTime  = SOF time from cTimeSyncElmue
+        /// s64_HostTime = Windows timestamp when the USB IN packet with the sync message was received
+        /// </summary>
+        public void AddSample(Int64 s64_McuTime, Int64 s64_HostTime)
+        {
+            // The MCU timestamps start at zero when the first channel is opened
+            if (s64_McuTime <= ms64_LastMcu)
+                Reset();
+
+            ms64_LastMcu = s64_McuTime;
+
+            // The USB latency is always positive --> the sample with the lowest difference has the lowest latency.
+            Int64 s64_Diff = s64_HostTime - s64_McuTime;
+            if (ms32_BlockCount == 0 || s64_Diff < ms64_BlockDiff)
+            {
+                ms64_BlockMcu  = s64_McuTime;
+                ms64_BlockDiff = s64_Diff;
+            }
+
+            if (++ms32_BlockCount < BLOCK_SAMPLES)
+                return;
+
+            ms64_McuPoints [ms32_WriteIdx] = ms64_BlockMcu;
+            ms64_DiffPoints[ms32_WriteIdx] = ms64_BlockDiff;
+            ms32_WriteIdx   = (ms32_WriteIdx + 1) % MAX_POINTS;
+            ms32_Count      = Math.Min(ms32_Count + 1, MAX_POINTS);
+            ms32_BlockCount = 0;
+            Fit();
+        }
+
+        /// <summary>
+        /// Least squares fit of: Diff = Offset + Drift * (Mcu - BaseMcu)
+        /// </summary>
+        void Fit()
+        {
+            // Use the newest point as base to avoid a loss of precision in the double variables.
+            ms64_BaseMcu = ms64_BlockMcu;
+
+            double d_SumX = 0.0, d_SumY = 0.0;
+            for (int i=0; i<ms32_Count; i++)
+            {
+                d_SumX += ms64_McuPoints[i] - ms64_BaseMcu;
+                d_SumY += ms64_DiffPoints[i];
+            }
+            double d_MeanX = d_SumX / ms32_Count;
+            double d_MeanY = d_SumY / ms32_Count;
+
+            double d_Sxx = 0.0, d_Sxy = 0.0;
+            for (int i=0; i<ms32_Count; i++)
+            {
+                double d_X = ms64_McuPoints[i] - ms64_BaseMcu - d_MeanX;
+                double d_Y = ms64_DiffPoints[i] - d_MeanY;
+                d_Sxx += d_X * d_X;
+                d_Sxy += d_X * d_Y;
+            }
+
+            // With only one point the drift cannot be calculated yet
+            md_Drift  = (d_Sxx > 0.0) ? d_Sxy / d_Sxx : 0.0;
+            md_Offset = d_MeanY - md_Drift * d_MeanX;
+
+            // Move the line down to the point with the lowest latency
+            double d_MinResidual = 0.0;
+            for (int i=0; i<ms32_Count; i++)
+            {
+                double d_Residual = ms64_DiffPoints[i] - (md_Offset + md_Drift * (ms64_McuPoints[i] - ms64_BaseMcu));
+                if (i == 0 || d_Residual < d_MinResidual)
+                    d_MinResidual = d_Residual;
+            }
+            md_Offset += d_MinResidual;
+        }
+
+        /// <summary>
+        /// returns the Windows timestamp of s64_McuTime or -1 if not enough sync messages have been received
+        /// </summary>
+        public Int64 McuToHost(Int64 s64_McuTime)
+        {
+            if (!IsValid || s64_McuTime < 0)
+                return -1;
+
+            double d_Diff = md_Offset + md_Drift * (s64_McuTime - ms64_BaseMcu);
+            return s64_McuTime + (Int64)Math.Round(d_Diff);
+        }
+    }
+
+    #endregion
+
     // must be equal to FIRMW_UPDATE_INTERFACE in usb_class.h in the firmware
     public const Byte FIRMW_UPDATE_INTERFACE = 1;
 
@@ -875,6 +1399,14 @@ public class Candlelight : IDisposable
     CanPacket[]      mi_TxEcho;         // Tx packets 1...255
     bool             mb_EnableTxEcho;
     bool             mb_McuTimestamp;
+    bool             mb_McuTimestamp64; // the 32 bit timestamp is followed by the high 32 bit
+    bool             mb_TimeSync;       // the firmware sends cTimeSyncElmue
+    bool             mb_RxSequence;     // the timestamp is followed by the sequence number and the lost counter
+    UInt16           mu16_NextSequence; // the expected sequence number of the next Rx frame
+    UInt16           mu16_LostCount;    // the last lost counter received
+    UInt64           mu64_RxDropped;
+    UInt64           mu64_RxLost;
+    cClockSync       mi_ClockSync;
     Int64            ms64_LastMcuStamp;
     Int64            ms64_McuRollOver;
     int              ms32_BlobOffset;   // current read position in kRxFifo.mu8_Buffer
@@ -943,6 +1475,9 @@ public class Candlelight : IDisposable
         mb_EnableTxEcho   = true;
         ms64_LastMcuStamp = 0;
         ms64_McuRollOver  = 0;
+        mb_TimeSync       = false;
+        mb_RxSequence     = false;
+        mi_ClockSync      = new cClockSync();
         ms32_BlobOffset   = 0;
         ms32_BlobFrames   = 0;
 
@@ -1143,8 +1678,10 @@ public class Candlelight : IDisposable
     /// STEP 5)  (optional)
     /// Add one to eight host filters
     /// ATTENTION: If you set only an 11 bit filter, no 29 bit ID's will pass and vice versa.
+    /// b_Priority = true --> the frames are sent to the host before all other frames, other ID's are not rejected.
+    /// Priority filters require eDeviceFlags.RxDualFifo in Start(), otherwise they have no effect.
     /// </summary>
-    public void AddHostFilter(bool b_29bit, int s32_Filter, int s32_Mask)
+    public void AddHostFilter(bool b_29bit, int s32_Filter, int s32_Mask, bool b_Priority = false)
     {
         if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
             throw new Exception("The device must be opened for the Candlelight interface.");
@@ -1152,7 +1689,8 @@ public class Candlelight : IDisposable
         kFilter k_Filter;
         k_Filter.ms32_Filter     = s32_Filter;
         k_Filter.ms32_Mask       = s32_Mask;
-        k_Filter.me_Operation    = b_29bit ? eFilterOperation.HostPass_29 : eFilterOperation.HostPass_11;
+        if (b_Priority) k_Filter.me_Operation = b_29bit ? eFilterOperation.HostPrio_29 : eFilterOperation.HostPrio_11;
+        else            k_Filter.me_Operation = b_29bit ? eFilterOperation.HostPass_29 : eFilterOperation.HostPass_11;
         k_Filter.mu8_DestChannel = 0;
         k_Filter.mu8_Index       = 0;
         k_Filter.mu8_Reserved    = new Byte[6];
@@ -1162,7 +1700,7 @@ public class Candlelight : IDisposable
 
     /// <summary>
     /// STEP 6)  (optional)
-    /// set / clear one of 20 bridge filters
+    /// set / clear one of 128 bridge filters
     /// b_Enable = false and u8_Index == 0x13 --> clear only bridge filter Nº 0x13
     /// b_Enable = false and u8_Index == 0xFF --> clear all bridge filters
     /// b_Enable = true and b_Block = true    --> set block filter
@@ -1210,10 +1748,30 @@ public class Candlelight : IDisposable
         if ((mk_Info.mk_Capability.me_Feature & eDeviceFlags.SendUsbBlobs) > 0)
             e_Flags |= eDeviceFlags.SendUsbBlobs;
 
+        // Newer firmware sends 64 bit timestamps that do not need a roll over detection
+        if ((e_Flags & eDeviceFlags.HwTimestamp) > 0 && (mk_Info.mk_Capability.me_Feature & eDeviceFlags.Timestamp64) > 0)
+            e_Flags |= eDeviceFlags.Timestamp64;
+
+        // Map the 64 bit MCU timestamps into the time base of Utils.GetWinTimestamp()
+        if ((e_Flags & eDeviceFlags.Timestamp64) > 0 && (mk_Info.mk_Capability.me_Feature & eDeviceFlags.TimeSync) > 0)
+            e_Flags |= eDeviceFlags.TimeSync;
+
+        // Count the frames that have been lost in the firmware or in the hardware
+        if ((mk_Info.mk_Capability.me_Feature & eDeviceFlags.RxSequence) > 0)
+            e_Flags |= eDeviceFlags.RxSequence;
+
         CtrlTransfer((Byte)eUsbRequest.SetDeviceMode, eDirection.Out, mu8_Channel, new kDeviceMode(eDevMode.Start, e_Flags));
 
-        mb_McuTimestamp = (e_Flags & eDeviceFlags.HwTimestamp) > 0;
-        mb_Started = true;
+        mb_McuTimestamp   = (e_Flags & eDeviceFlags.HwTimestamp) > 0;
+        mb_McuTimestamp64 = (e_Flags & eDeviceFlags.Timestamp64) > 0;
+        mb_TimeSync       = (e_Flags & eDeviceFlags.TimeSync)    > 0;
+        mb_RxSequence     = (e_Flags & eDeviceFlags.RxSequence)  > 0;
+        mb_Started        = true;
+        mu16_NextSequence = 0; // the firmware restarts the counters at zero
+        mu16_LostCount    = 0;
+        mu64_RxDropped    = 0;
+        mu64_RxLost       = 0;
+        mi_ClockSync.Reset(); // the firmware restarts the timestamps at zero
     }
 
     /// <summary>
@@ -1243,14 +1801,62 @@ public class Candlelight : IDisposable
 
     /// <summary>
     /// Interval = 7 --> report busload in percent every 700 ms.
+    /// e_Flags = Exact      --> the firmware counts the real stuff bits of each frame instead of an average (firmware 16.Oct.2026)
+    /// e_Flags = Statistics --> the firmware sends cBusloadStatsElmue with peak, minimum and histogram of 1 ms windows (firmware 16.Oct.2026)
     /// NOTE: The firmware does not report the busload if bus load is permanently 0%.
     /// </summary>
-    public void EnableBusLoadReport(Byte u8_Interval)
+    public void EnableBusLoadReport(Byte u8_Interval, eBusloadFlags e_Flags = 0)
+    {
+        if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
+            throw new Exception("The device must be opened for the Candlelight interface.");
+
+        Byte[] u8_Data = new Byte[] { u8_Interval, (Byte)e_Flags };
+        CtrlTransfer((Byte)eUsbRequest.SetBusLoadReport, eDirection.Out, mu8_Channel, u8_Data);
+    }
+
+    /// <summary>
+    /// Packets that are not acknowledged within u16_Timeout ms are canceled and the error APP_CanTxTimeout is reported.
+    /// The default is 500 ms. It is restored when the adapter is closed. (firmware 17.Oct.2026)
+    /// </summary>
+    public void SetTxTimeout(UInt16 u16_Timeout)
+    {
+        if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
+            throw new Exception("The device must be opened for the Candlelight interface.");
+
+        CtrlTransfer((Byte)eUsbRequest.SetTxTimeout, eDirection.Out, mu8_Channel, BitConverter.GetBytes(u16_Timeout));
+    }
+
+    /// <summary>
+    /// Immediate: restart the CAN controller immediately after Bus Off (default)
+    /// Backoff:   wait u16_BaseDelay ms before the first attempt, the delay is doubled for each further attempt (max 60 seconds)
+    /// Manual:    the firmware does not recover alone, call RecoverBusOff()
+    /// u16_MaxAttempts = consecutive attempts before the firmware waits for RecoverBusOff() (0 = unlimited)
+    /// Each recovery is reported with cBusOffStatsElmue. The default is restored when the adapter is closed. (firmware 17.Oct.2026)
+    /// </summary>
+    public void SetBusOffRecovery(eBusOffPolicy e_Policy, UInt16 u16_BaseDelay = 0, UInt16 u16_MaxAttempts = 0)
+    {
+        if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
+            throw new Exception("The device must be opened for the Candlelight interface.");
+
+        kBusOffSetup k_Setup = new kBusOffSetup();
+        k_Setup.me_Operation     = eBusOffOperation.SetPolicy;
+        k_Setup.me_Policy        = e_Policy;
+        k_Setup.mu16_BaseDelay   = u16_BaseDelay;
+        k_Setup.mu16_MaxAttempts = u16_MaxAttempts;
+        CtrlTransfer((Byte)eUsbRequest.SetBusOffRecovery, eDirection.Out, mu8_Channel, k_Setup);
+    }
+
+    /// <summary>
+    /// Start the recovery from Bus Off now. Required with Manual or after the maximum attempts. (firmware 17.Oct.2026)
+    /// </summary>
+    public void RecoverBusOff()
     {
         if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
             throw new Exception("The device must be opened for the Candlelight interface.");
 
-        CtrlTransfer((Byte)eUsbRequest.SetBusLoadReport, eDirection.Out, mu8_Channel, u8_Interval);
+        kBusOffSetup k_Setup = new kBusOffSetup();
+        k_Setup.me_Operation = eBusOffOperation.Recover;
+        CtrlTransfer((Byte)eUsbRequest.SetBusOffRecovery, eDirection.Out, mu8_Channel, k_Setup);
     }
 
     /// <summary>
@@ -1304,6 +1910,148 @@ public class Candlelight : IDisposable
         return CtrlTransfer<Byte[]>((Byte)eUsbRequest.ReadFlash, eDirection.In, u8_Segment);
     }
 
+    /// <summary>
+    /// Enable, disable or clear the per-ID statistics of all received CAN IDs (firmware 16.Oct.2026)
+    /// Enable and Disable require the adapter to be closed.
+    /// b_NoStream = true --> received frames are only counted, but not sent to the host (bus monitoring without USB load)
+    /// </summary>
+    public void SetIdStats(eIdStatsOperation e_Operation, UInt16 u16_MaxEntries = 0, bool b_NoStream = false)
+    {
+        if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
+            throw new Exception("The device must be opened for the Candlelight interface.");
+
+        kIdStatsSetup k_Setup = new kIdStatsSetup();
+        k_Setup.me_Operation    = e_Operation;
+        k_Setup.mu8_NoStream    = (Byte)(b_NoStream ? 1 : 0);
+        k_Setup.mu16_MaxEntries = u16_MaxEntries;
+        CtrlTransfer((Byte)eUsbRequest.SetIdStats, eDirection.Out, mu8_Channel, k_Setup);
+    }
+
+    /// <summary>
+    /// Read one page with max 8 entries of the per-ID statistics. Request page 0, 1, 2,... until mu8_EntryCount < 8.
+    /// </summary>
+    public kIdStatsPage GetIdStats(Byte u8_Page)
+    {
+        if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
+            throw new Exception("The device must be opened for the Candlelight interface.");
+
+        // The page is transmitted in the high byte of wValue because IN requests cannot send data to the device.
+        return CtrlTransfer<kIdStatsPage>((Byte)eUsbRequest.GetIdStats, eDirection.In, (UInt16)(mu8_Channel | (u8_Page << 8)));
+    }
+
+    /// <summary>
+    /// Set a periodic Tx packet that the firmware sends with µs precision without the host (firmware 16.Oct.2026)
+    /// i_Packet = null removes the entry. Setting an entry with the same period and phase only replaces the packet.
+    /// The count of data bytes must be a valid DLC length (0...8, 12, 16, 20, 24, 32, 48, 64).
+    /// u8_CounterByte  = data byte with a rolling counter (the bits in u8_CounterMask) that is incremented after each transmission.
+    /// u8_ChecksumByte = data byte that receives the 8 bit sum or XOR of all other data bytes.
+    /// </summary>
+    public void SetCyclic(Byte u8_Index, CanPacket i_Packet, UInt32 u32_Period, UInt32 u32_Phase, Byte u8_CounterByte = 0xFF, 
+                          Byte u8_CounterMask = 0, Byte u8_ChecksumByte = 0xFF, bool b_ChecksumXor = false)
+    {
+        if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
+            throw new Exception("The device must be opened for the Candlelight interface.");
+
+        kCyclicEntry k_Entry = new kCyclicEntry();
+        k_Entry.mu8_Operation    = 1;
+        k_Entry.mu8_Index        = u8_Index;
+        k_Entry.mu8_CounterByte  = u8_CounterByte;
+        k_Entry.mu8_CounterMask  = u8_CounterMask;
+        k_Entry.mu8_ChecksumByte = u8_ChecksumByte;
+        k_Entry.mu8_ChecksumXor  = (Byte)(b_ChecksumXor ? 1 : 0);
+        k_Entry.mu8_Data         = new Byte[64];
+
+        if (i_Packet != null)
+        {
+            int s32_DLC = Array.IndexOf(new int[] { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 }, i_Packet.mi_Data.Count);
+            if (i_Packet.mb_RTR) // remote frames store the DLC value in the first data byte
+                s32_DLC = (i_Packet.mi_Data.Count > 0) ? i_Packet.mi_Data[0] : 0;
+
+            if (s32_DLC < 0)
+                throw new Exception("The count of data bytes is not a valid DLC length.");
+
+            if (!i_Packet.mb_RTR)
+                i_Packet.mi_Data.CopyTo(k_Entry.mu8_Data);
+
+            k_Entry.mu8_DLC     = (Byte)s32_DLC;
+            k_Entry.mu32_CanID  = (UInt32)i_Packet.ms32_ID;
+            k_Entry.mu32_Period = u32_Period;
+            k_Entry.mu32_Phase  = u32_Phase;
+            if (i_Packet.mb_29bit) k_Entry.mu32_CanID |= (UInt32)eCanIdFlags.Extended;
+            if (i_Packet.mb_RTR)   k_Entry.mu32_CanID |= (UInt32)eCanIdFlags.RTR;
+            if (i_Packet.mb_FDF)   k_Entry.me_Flags   |= eFrameFlags.FDF;
+            if (i_Packet.mb_BRS)   k_Entry.me_Flags   |= eFrameFlags.BRS;
+        }
+        CtrlTransfer((Byte)eUsbRequest.SetCyclic, eDirection.Out, mu8_Channel, k_Entry);
+    }
+
+    /// <summary>
+    /// Remove all periodic Tx packets. They are also removed when the adapter is closed.
+    /// </summary>
+    public void ClearCyclic()
+    {
+        if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
+            throw new Exception("The device must be opened for the Candlelight interface.");
+
+        kCyclicEntry k_Entry = new kCyclicEntry();
+        k_Entry.mu8_Data = new Byte[64];
+        CtrlTransfer((Byte)eUsbRequest.SetCyclic, eDirection.Out, mu8_Channel, k_Entry);
+    }
+
+    /// <summary>
+    /// Get the current MCU timestamp in µs. This is the time base of the Rx timestamps and of SendPacketTimed().
+    /// </summary>
+    public UInt32 GetMcuTimestamp()
+    {
+        if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
+            throw new Exception("The device must be opened for the Candlelight interface.");
+
+        return CtrlTransfer<UInt32>((Byte)eUsbRequest.GetTimestamp, eDirection.In, mu8_Channel);
+    }
+
+    /// <summary>
+    /// The clocks are synchronized about one second after Start() if the firmware supports eDeviceFlags.TimeSync
+    /// </summary>
+    public bool IsClockSynced
+    {
+        get { return mb_TimeSync && mi_ClockSync.IsValid; }
+    }
+
+    /// <summary>
+    /// The drift between the MCU clock and the Windows clock in ppm
+    /// </summary>
+    public double ClockDrift
+    {
+        get { return mi_ClockSync.Drift; }
+    }
+
+    /// <summary>
+    /// Convert a 64 bit MCU timestamp into the time base of Utils.GetWinTimestamp() (eDeviceFlags.TimeSync)
+    /// This time base is the same for all adapters, so the frames of multiple adapters can be displayed on one timeline.
+    /// returns -1 if the clocks are not yet synchronized (during the first second after Start())
+    /// </summary>
+    public Int64 McuToWinTimestamp(Int64 s64_McuStamp)
+    {
+        if (!mb_TimeSync)
+            return -1;
+
+        return mi_ClockSync.McuToHost(s64_McuStamp);
+    }
+
+    /// <summary>
+    /// Get the current MCU timestamp in µs as 64 bit value which never rolls over (firmware 16.Oct.2026)
+    /// </summary>
+    public UInt64 GetMcuTimestamp64()
+    {
+        if (!mb_InitDone || mi_WinUSB.Interface.Number == FIRMW_UPDATE_INTERFACE)
+            throw new Exception("The device must be opened for the Candlelight interface.");
+
+        if ((mk_Info.mk_Capability.me_Feature & eDeviceFlags.Timestamp64) == 0)
+            throw new Exception("The firmware does not support 64 bit timestamps. Please update the firmware.");
+
+        return CtrlTransfer<UInt64>((Byte)eUsbRequest.GetTimestamp64, eDirection.In, mu8_Channel);
+    }
+
     // -------------------------------------------------------------------------------------
 
     /// <summary>
@@ -1449,10 +2197,36 @@ public class Candlelight : IDisposable
         mi_PipeOut.Send(u8_Transmit);
     }
 
+    /// <summary>
+    /// Send a CAN packet at the absolute MCU timestamp u32_SendTime in µs (firmware 16.Oct.2026)
+    /// The firmware stores max 16 timed packets (8 on the STM32G431 and STM32G0B1). A send time in the past sends the packet immediately.
+    /// Get the current MCU time with GetMcuTimestamp(). The Tx echo contains the timestamp when the packet was really sent.
+    /// </summary>
+    public void SendPacketTimed(CanPacket i_Packet, UInt32 u32_SendTime)
+    {
+        if (!mb_InitDone || !mb_Started)
+            throw new Exception("The device must be open and started.");
+
+        mi_PipeOut.Send(TxPacketToTxBytes(i_Packet, eMessageType.TxTimed, u32_SendTime));
+    }
+
+    /// <summary>
+    /// Send a CAN packet that the firmware discards if it could not be sent within u32_TimeToLive µs (firmware 17.Oct.2026)
+    /// This avoids that outdated packets are sent after a bus congestion.
+    /// A discarded packet is reported with cTxExpiredElmue instead of cTxEchoElmue (only if the Tx echo is enabled).
+    /// </summary>
+    public void SendPacketTtl(CanPacket i_Packet, UInt32 u32_TimeToLive)
+    {
+        if (!mb_InitDone || !mb_Started)
+            throw new Exception("The device must be open and started.");
+
+        mi_PipeOut.Send(TxPacketToTxBytes(i_Packet, eMessageType.TxTtl, u32_TimeToLive));
+    }
+
     /// <summary>
     /// If the packet has insufficient bytes to match one of the CAN FD DLC values, it will be padded with PAD_BYTE.
     /// </summary>
-    private Byte[] TxPacketToTxBytes(CanPacket i_Packet)
+    private Byte[] TxPacketToTxBytes(CanPacket i_Packet, eMessageType e_MsgType = eMessageType.TxFrame, UInt32 u32_Param = 0)
     {
         // Pad missing bytes with zeroe's
         const Byte PAD_BYTE = 0;
@@ -1505,23 +2279,38 @@ public class Candlelight : IDisposable
         // original packet must not be stored in mi_TxEcho --> cloning required
         i_Packet = i_Packet.Clone();
 
-        cTxFrameElmue i_TxFrame = new cTxFrameElmue(i_Packet);
-
         // The STM32G431 supports to store a unique 8 bit marker for each sent frame which is returned when the frame has been acknowledged.
         // The firmware sends the marker back in kTxEchoElmue and we get the sent frame from mk_EchoFrames to display it to the user.
         // 255 markers are far more than enough because the processor has a Tx FIFO for 3 CAN packtes and the firmware can store
         // additionally 64 waiting frames in the queue. When a Tx buffer overflow is reported any further SendPacket() is blocked.
+        Byte u8_Marker = 0;
         if (mb_EnableTxEcho)
         {
             mu8_EchoMarker ++;
             if (mu8_EchoMarker == 0) 
                 mu8_EchoMarker = 1;  // a marker value of zero does not send an echo
 
-            i_TxFrame.mu8_Marker = mu8_EchoMarker;
+            u8_Marker = mu8_EchoMarker;
+        }
+
+        mi_TxEcho[u8_Marker] = i_Packet;
+
+        if (e_MsgType == eMessageType.TxTimed)
+        {
+            cTxTimedElmue i_TxTimed = new cTxTimedElmue(i_Packet, u32_Param);
+            i_TxTimed.mu8_Marker = u8_Marker;
+            return Utils.StructureToBytesVar(i_TxTimed, i_TxTimed.mu8_Size);
         }
 
-        mi_TxEcho[i_TxFrame.mu8_Marker] = i_Packet;
+        if (e_MsgType == eMessageType.TxTtl)
+        {
+            cTxTtlElmue i_TxTtl = new cTxTtlElmue(i_Packet, u32_Param);
+            i_TxTtl.mu8_Marker = u8_Marker;
+            return Utils.StructureToBytesVar(i_TxTtl, i_TxTtl.mu8_Size);
+        }
 
+        cTxFrameElmue i_TxFrame = new cTxFrameElmue(i_Packet);
+        i_TxFrame.mu8_Marker = u8_Marker;
         return Utils.StructureToBytesVar(i_TxFrame, i_TxFrame.mu8_Size);
     }
 
@@ -1573,19 +2362,48 @@ public class Candlelight : IDisposable
 
         Byte[] u8_Frame = Utils.ExtractByteArr(mi_UsbInPacket.mu8_Buffer, ms32_BlobOffset, i_Header.mu8_Size);
 
+        // The time sync messages are consumed here and not passed to the application.
+        // The Windows timestamp of the USB IN packet is the reception time of the sync message.
+        if (i_Header.me_MesgType == eMessageType.TimeSync)
+        {
+            if (u8_Frame.Length < Marshal.SizeOf(typeof(cTimeSyncElmue)))
+                throw new Exception("Received incomplete USB data from device");
+
+            cTimeSyncElmue i_Sync = Utils.BytesToStructureVar<cTimeSyncElmue>(u8_Frame, 0);
+            mi_ClockSync.AddSample((Int64)i_Sync.mu64_SofTime, mi_UsbInPacket.ms64_WinTimestamp);
+
+            ms32_BlobFrames --;
+            ms32_BlobOffset += i_Header.mu8_Size;
+
+            // If the sync message was the only data, return a timeout, so the caller does not block longer than s32_Timeout.
+            if (ms32_BlobFrames <= 0)
+                return null;
+
+            return ReceiveData(s32_Timeout, out s64_RxTimestamp, out b_Blob); // the next frame in the blob
+        }
+
         cHeader i_Struct;
         switch (i_Header.me_MesgType)
         {
             case eMessageType.TxEcho:  i_Struct = Utils.BytesToStructureVar<cTxEchoElmue> (u8_Frame, 0); break;
+            case eMessageType.TxExpired: i_Struct = Utils.BytesToStructureVar<cTxExpiredElmue>(u8_Frame, 0); break;
             case eMessageType.RxFrame: i_Struct = Utils.BytesToStructureVar<cRxFrameElmue>(u8_Frame, 0); break;
             case eMessageType.Error:   i_Struct = Utils.BytesToStructureVar<cErrorElmue>  (u8_Frame, 0); break;
             case eMessageType.String:  i_Struct = Utils.BytesToStructureVar<cStringElmue> (u8_Frame, 0); break;
             case eMessageType.Busload: i_Struct = Utils.BytesToStructureVar<cBusloadElmue>(u8_Frame, 0); break;
+            case eMessageType.BusloadStats: i_Struct = Utils.BytesToStructureVar<cBusloadStatsElmue>(u8_Frame, 0); break;
+            case eMessageType.ErrorEvent:    i_Struct = Utils.BytesToStructureVar<cErrorEventElmue>   (u8_Frame, 0); break;
+            case eMessageType.ErrorCounters: i_Struct = Utils.BytesToStructureVar<cErrorCountersElmue>(u8_Frame, 0); break;
+            case eMessageType.BusOffStats:   i_Struct = Utils.BytesToStructureVar<cBusOffStatsElmue>  (u8_Frame, 0); break;
             default:
                 throw new Exception("Received invalid USB message device (MessageType = " + u8_Frame[1] + ")");
         }
 
-        if (u8_Frame.Length < i_Struct.GetMinSize(mb_McuTimestamp))          
+        int s32_StampLen = McuStampLen;
+        if (i_Header.me_MesgType == eMessageType.RxFrame && mb_RxSequence)
+            s32_StampLen += 4; // the sequence number and the lost counter follow the timestamp
+
+        if (u8_Frame.Length < i_Struct.GetMinSize(s32_StampLen))          
             throw new Exception("Received incomplete USB data from device");
 
         s64_RxTimestamp = mi_UsbInPacket.ms64_WinTimestamp;
@@ -1596,6 +2414,14 @@ public class Candlelight : IDisposable
         return i_Struct;
     }
 
+    /// <summary>
+    /// The count of timestamp bytes in cRxFrameElmue, cTxEchoElmue and cErrorElmue: 0, 4 or 8
+    /// </summary>
+    private int McuStampLen
+    {
+        get { return mb_McuTimestamp ? (mb_McuTimestamp64 ? 8 : 4) : 0; }
+    }
+
     public CanPacket RxFrameToCanPacket(cRxFrameElmue i_Frame)
     {
         if (i_Frame == null)
@@ -1609,14 +2435,60 @@ public class Candlelight : IDisposable
         i_Packet.mb_BRS    = i_Packet.mb_FDF && (i_Frame.me_Flags & eFrameFlags.BRS) != 0;
         i_Packet.mb_ESI    = i_Packet.mb_FDF && (i_Frame.me_Flags & eFrameFlags.ESI) != 0;
 
-        int s32_Offset  = mb_McuTimestamp ? 4 : 0;
-        int s32_DataLen = i_Frame.mu8_Size - i_Frame.GetMinSize(mb_McuTimestamp);
+        int s32_Offset  = McuStampLen;
+        if (mb_RxSequence) s32_Offset += 4; // sequence number and lost counter
+
+        int s32_DataLen = i_Frame.mu8_Size - i_Frame.GetMinSize(s32_Offset);
         Byte[] u8_Data  = Utils.ExtractByteArr(i_Frame.mu8_TimeStampAndData, s32_Offset, s32_DataLen);
 
         i_Packet.mi_Data.AddRange(u8_Data);
         return i_Packet;
     }
 
+    /// <summary>
+    /// Get the count of frames that have been lost directly before this frame (eDeviceFlags.RxSequence, firmware 16.Oct.2026)
+    /// s32_Dropped = frames dropped in the firmware because the USB buffer was full (gap in the sequence number)
+    /// s32_Lost    = frames lost in the hardware because the Rx FIFO or the Rx ring buffer was full
+    /// This must be called exactly once for each received frame in the order of reception.
+    /// returns false if the firmware does not support this feature.
+    /// </summary>
+    public bool GetRxLoss(cRxFrameElmue i_Frame, out int s32_Dropped, out int s32_Lost)
+    {
+        s32_Dropped = 0;
+        s32_Lost    = 0;
+        if (!mb_RxSequence)
+            return false;
+
+        UInt16 u16_Sequence  = i_Frame.GetSequence (McuStampLen);
+        UInt16 u16_LostCount = i_Frame.GetLostCount(McuStampLen);
+
+        // The 16 bit counters roll over. The subtraction must be done in 16 bit.
+        s32_Dropped = (UInt16)(u16_Sequence  - mu16_NextSequence);
+        s32_Lost    = (UInt16)(u16_LostCount - mu16_LostCount);
+
+        mu16_NextSequence = (UInt16)(u16_Sequence + 1);
+        mu16_LostCount    = u16_LostCount;
+        mu64_RxDropped   += (UInt64)s32_Dropped;
+        mu64_RxLost      += (UInt64)s32_Lost;
+        return true;
+    }
+
+    /// <summary>
+    /// The total count of frames dropped in the firmware since Start() (eDeviceFlags.RxSequence)
+    /// </summary>
+    public UInt64 RxDropped
+    {
+        get { return mu64_RxDropped; }
+    }
+
+    /// <summary>
+    /// The total count of frames lost in the hardware since Start() (eDeviceFlags.RxSequence)
+    /// </summary>
+    public UInt64 RxLost
+    {
+        get { return mu64_RxLost; }
+    }
+
     // ======================================= Tx Echo ========================================
 
     /// <summary>
@@ -1632,12 +2504,25 @@ public class Candlelight : IDisposable
         return mi_TxEcho[i_Echo.mu8_Marker];
     }
 
+    /// <summary>
+    /// Returns the packet that has been discarded by the firmware because its time-to-live expired (SendPacketTtl)
+    /// </summary>
+    public CanPacket GetTxExpiredPacket(cTxExpiredElmue i_Expired)
+    {
+        if (!mb_InitDone || !mb_Started)
+            throw new Exception("The device must be open and started.");
+
+        return mi_TxEcho[i_Expired.mu8_Marker];
+    }
+
     // ======================================= Timestamp ========================================
 
     /// <summary>
     /// Formats a timestamp with 1 µs precision
     /// returns "HH:MM:SS.mmm.µµµ"
     /// i_Header may contain a timestamp if GS_DevFlagTimestamp is set --> mb_McuTimestamp = true
+    /// If ELM_DevFlagTimestamp64 is set the timestamp has 64 bit --> mb_McuTimestamp64 = true
+    /// If ELM_DevFlagTimeSync is set the firmware timestamps are converted into the time base of s64_WinTimestamp
     /// otherwise use s64_WinTimestamp which comes from GetWinTimestamp() at packet reception
     /// </summary>
     public String FormatTimestamp(cHeader i_Header, Int64 s64_WinTimestamp)
@@ -1647,7 +2532,22 @@ public class Candlelight : IDisposable
             throw new Exception("The device must be open and started.");
 
         Int64 s64_Stamp = -1;
-        if (mb_McuTimestamp)
+        if (mb_McuTimestamp64)
+        {
+            // The firmware has already extended the timestamp to 64 bit, no roll over detection required.
+            if (i_Header != null)
+            {
+                switch (i_Header.me_MesgType)
+                {
+                    case eMessageType.TxEcho:  s64_Stamp = ((cTxEchoElmue) i_Header).mu32_Timestamp | ((Int64)((cTxEchoElmue)i_Header).mu32_TimestampHigh << 32); break;
+                    case eMessageType.TxExpired: s64_Stamp = ((cTxExpiredElmue)i_Header).mu32_Timestamp | ((Int64)((cTxExpiredElmue)i_Header).mu32_TimestampHigh << 32); break;
+                    case eMessageType.RxFrame: s64_Stamp = (Int64)((cRxFrameElmue)i_Header).Timestamp64; break;
+                    case eMessageType.Error:   s64_Stamp = ((cErrorElmue)  i_Header).mu32_Timestamp | ((Int64)((cErrorElmue)i_Header).mu32_TimestampHigh << 32); break;
+                    case eMessageType.ErrorEvent: s64_Stamp = ((cErrorEventElmue)i_Header).mu32_Timestamp | ((Int64)((cErrorEventElmue)i_Header).mu32_TimestampHigh << 32); break;
+                }
+            }
+        }
+        else if (mb_McuTimestamp)
         {
             if (i_Header != null)
             {
@@ -1655,8 +2555,10 @@ public class Candlelight : IDisposable
                 {
                     // These 3 messages send firmware timestamps
                     case eMessageType.TxEcho:  s64_Stamp = ((cTxEchoElmue) i_Header).mu32_Timestamp; break;
+                    case eMessageType.TxExpired: s64_Stamp = ((cTxExpiredElmue)i_Header).mu32_Timestamp; break;
                     case eMessageType.RxFrame: s64_Stamp = ((cRxFrameElmue)i_Header).Timestamp;      break;
                     case eMessageType.Error:   s64_Stamp = ((cErrorElmue)  i_Header).mu32_Timestamp; break;
+                    case eMessageType.ErrorEvent: s64_Stamp = ((cErrorEventElmue)i_Header).mu32_Timestamp; break;
                 }
             }
 
@@ -1675,7 +2577,14 @@ public class Candlelight : IDisposable
                 s64_Stamp += ms64_McuRollOver;
             }
         }
-        else // Windows performance counter timestamps are used
+
+        // If the clocks are synchronized, all timestamps are displayed in the time base of Windows.
+        // Then also the messages without a firmware timestamp can be displayed on the same timeline.
+        if (mb_McuTimestamp && IsClockSynced)
+        {
+            s64_Stamp = (s64_Stamp >= 0) ? mi_ClockSync.McuToHost(s64_Stamp) : s64_WinTimestamp;
+        }
+        else if (!mb_McuTimestamp) // Windows performance counter timestamps are used
         {
             s64_Stamp = s64_WinTimestamp;
         }
@@ -1768,6 +2677,43 @@ public class Candlelight : IDisposable
         return s_Mesg.TrimEnd(',', ' ');
     }
 
+    /// <summary>
+    /// Protocol error sent by the firmware if eDeviceFlags.ErrorLog has been set (firmware 17.Oct.2026)
+    /// </summary>
+    public String FormatErrorEvent(cErrorEventElmue i_Event)
+    {
+        String[] s_Types = { "Stuff Error", "Form Error", "No ACK received", "Recessive Bit Error", "Dominant Bit Error", "CRC Error" };
+
+        int s32_Code  = i_Event.mu8_Code & 0x7F;
+        String s_Mesg = (s32_Code >= 1 && s32_Code <= 6) ? s_Types[s32_Code - 1] : "Unknown Error";
+        if ((i_Event.mu8_Code & 0x80) > 0)
+            s_Mesg += " in data phase";
+
+        return s_Mesg + String.Format(", Tx Errors: {0}, Rx Errors: {1}", i_Event.mu8_TxErrCount, i_Event.mu8_RxErrCount);
+    }
+
+    /// <summary>
+    /// Count of protocol errors per type sent by the firmware every second if eDeviceFlags.ErrorLog has been set
+    /// </summary>
+    public String FormatErrorCounters(cErrorCountersElmue i_Counters)
+    {
+        UInt32[] u32_Counts = i_Counters.mu32_Counts;
+        return String.Format("Stuff: {0}, Form: {1}, ACK: {2}, Bit1: {3}, Bit0: {4}, CRC: {5}, not logged: {6}", u32_Counts[0], u32_Counts[1], 
+                             u32_Counts[2], u32_Counts[3], u32_Counts[4], u32_Counts[5], i_Counters.mu32_Suppressed);
+    }
+
+    /// <summary>
+    /// Statistics sent by the firmware after each recovery from Bus Off (firmware 17.Oct.2026)
+    /// </summary>
+    public String FormatBusOffStats(cBusOffStatsElmue i_Stats)
+    {
+        String s_Mesg = String.Format("Bus Off count: {0}, Attempts: {1}, Recovery time: {2} ms (min: {3} ms, max: {4} ms)", i_Stats.mu32_BusOffCount, 
+                                      i_Stats.mu16_Attempts, i_Stats.mu32_LastMs, i_Stats.mu32_MinMs, i_Stats.mu32_MaxMs);
+        if (i_Stats.mu8_Waiting != 0)
+            s_Mesg += ", waiting for RecoverBusOff()";
+        return s_Mesg;
+    }
+
     // ================================== DFU ========================================
 
     /// <summary>
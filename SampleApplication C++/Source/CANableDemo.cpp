@@ -148,6 +148,12 @@ void CandlelightDemo()
     
     gi_Candle.EnableTxEcho(true);
 
+    // Optionally cancel unacknowledged Tx packets after 2 seconds instead of 500 ms (requires firmware 17.Oct.2026)
+    // gi_Candle.SetTxTimeout(2000);
+
+    // Optionally wait 100 ms before recovering from Bus Off, double the delay for each attempt, stop after 8 attempts (requires firmware 17.Oct.2026)
+    // gi_Candle.SetBusOffRecovery(BOFF_Backoff, 100, 8);
+
     // -----------------------------------------
 
     // Optionally you can set a CAN FD data bitrate here.
@@ -204,6 +210,7 @@ void CandlelightDemo()
     // u32_DevFlags |= GS_DevFlagOneShot;        // turn off automatic re-transmission
     // u32_DevFlags |= GS_DevFlagListenOnly;     // silent mode
     // u32_DevFlags |= GS_DevFlagLoopback;       // loopback mode
+    // u32_DevFlags |= ELM_DevFlagErrorLog;      // report each protocol error with timestamp (requires firmware 17.Oct.2026)
 
     // If you turn off GS_DevFlagTimestamp, Windows timestamps will be used.
     // Firmware timestamps produce more USB traffic and are not available for sent packets.
@@ -341,6 +348,11 @@ void CandlelightDemo()
                     kCanPacket k_RxPacket = gi_Candle.RxFrameToCanPacket((kRxFrameElmue*)pk_Header);
                     OsLibrary::PrintConsole(WHITE, " Recv");
                     OsLibrary::PrintConsole(CYAN,  " %s", gi_Candle.FormatCanPacket(&k_RxPacket).c_str());
+
+                    // Show the frames that have been lost before this frame (requires firmware 16.Oct.2026)
+                    int s32_Dropped, s32_Lost;
+                    if (gi_Candle.GetRxLoss((kRxFrameElmue*)pk_Header, &s32_Dropped, &s32_Lost) && (s32_Dropped > 0 || s32_Lost > 0))
+                        OsLibrary::PrintConsole(RED, "  (%d dropped in firmware, %d lost in hardware)", s32_Dropped, s32_Lost);
                     break;
                 }
                 case MSG_TxEcho:
@@ -350,6 +362,13 @@ void CandlelightDemo()
                     OsLibrary::PrintConsole(GREEN, " %s", gi_Candle.FormatCanPacket(&k_EchoPacket).c_str());
                     break;
                 }
+                case MSG_TxExpired: // a packet sent with SendPacketTtl() has been discarded (requires firmware 17.Oct.2026)
+                {
+                    kCanPacket k_ExpiredPacket = gi_Candle.GetTxExpiredPacket((kTxExpiredElmue*)pk_Header);
+                    OsLibrary::PrintConsole(WHITE, " Expd");
+                    OsLibrary::PrintConsole(RED,   " %s", gi_Candle.FormatCanPacket(&k_ExpiredPacket).c_str());
+                    break;
+                }
                 case MSG_Error:
                 {
                     eErrorBusStatus e_BusStatus;
@@ -376,6 +395,35 @@ void CandlelightDemo()
                     OsLibrary::PrintConsole(GREY,  " Busload: %u%%", pk_Busload->bus_load);
                     break;
                 }
+                case MSG_BusloadStats:
+                {
+                    kBusloadStatsElmue* pk_Stats = (kBusloadStatsElmue*)pk_Header;
+                    OsLibrary::PrintConsole(WHITE, " Load");
+                    OsLibrary::PrintConsole(GREY,  " Busload: %u%%, Peak: %u%%, Min: %u%%, Histogram:", pk_Stats->bus_load, pk_Stats->peak, pk_Stats->minimum);
+                    for (int i=0; i<10; i++)
+                    {
+                        OsLibrary::PrintConsole(GREY, " %u", pk_Stats->histogram[i]);
+                    }
+                    break;
+                }
+                case MSG_ErrorEvent:
+                {
+                    OsLibrary::PrintConsole(WHITE,  " Err ");
+                    OsLibrary::PrintConsole(YELLOW, " %s", gi_Candle.FormatErrorEvent((kErrorEventElmue*)pk_Header).c_str());
+                    break;
+                }
+                case MSG_ErrorCounters:
+                {
+                    OsLibrary::PrintConsole(WHITE, " Err ");
+                    OsLibrary::PrintConsole(GREY,  " %s", gi_Candle.FormatErrorCounters((kErrorCountersElmue*)pk_Header).c_str());
+                    break;
+                }
+                case MSG_BusOffStats: // requires firmware 17.Oct.2026
+                {
+                    OsLibrary::PrintConsole(WHITE,  " BOff");
+                    OsLibrary::PrintConsole(YELLOW, " %s", gi_Candle.FormatBusOffStats((kBusOffStatsElmue*)pk_Header).c_str());
+                    break;
+                }
                 default:
                 {
                     OsLibrary::PrintConsole(WHITE, " Err ");
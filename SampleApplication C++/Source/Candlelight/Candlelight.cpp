@@ -87,6 +87,8 @@ uint32_t Candlelight::Open(kUsbDevice* pk_Device)
     mb_BaudFDSet      = false;
     mb_InitDone       = false;
     mb_Started        = false;
+    mb_TimeSync       = false;
+    mb_RxSequence     = false;
     mb_EnableTxEcho   = true;
     me_LastError      = FBK_Success;
     
@@ -283,13 +285,16 @@ uint32_t Candlelight::SetBitrate(bool b_FD, int s32_BRP, int s32_Seg1, int s32_S
 // STEP 4)  (optional)
 // Add one to eight host filters
 // ATTENTION: If you set only an 11 bit filter, no 29 bit ID's will pass and vice versa.
-uint32_t Candlelight::AddHostFilter(bool b_29bit, uint32_t u32_Filter, uint32_t u32_Mask)
+// b_Priority = true --> the frames are sent to the host before all other frames, other ID's are not rejected.
+// Priority filters require ELM_DevFlagRxDualFifo in Start(), otherwise they have no effect.
+uint32_t Candlelight::AddHostFilter(bool b_29bit, uint32_t u32_Filter, uint32_t u32_Mask, bool b_Priority)
 {
     if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
         return ERR_OPERATION_INVALID;
 
     kFilter k_Filter = {0};
-    k_Filter.Operation = b_29bit ? FIL_HostPass_29 : FIL_HostPass_11;
+    if (b_Priority) k_Filter.Operation = b_29bit ? FIL_HostPrio_29 : FIL_HostPrio_11;
+    else            k_Filter.Operation = b_29bit ? FIL_HostPass_29 : FIL_HostPass_11;
     k_Filter.Filter    = u32_Filter;
     k_Filter.Mask      = u32_Mask;
 
@@ -297,7 +302,7 @@ uint32_t Candlelight::AddHostFilter(bool b_29bit, uint32_t u32_Filter, uint32_t
 }
 
 // STEP 5)  (optional)
-// set / clear one of 20 bridge filters
+// set / clear one of 128 bridge filters
 // b_Enable = false and Index == 0x13  --> clear only bridge filter N 0x13
 // b_Enable = false and Index == 0xFF  --> clear all bridge filters
 // b_Enable = true and b_Block = true  --> set block filter
@@ -345,12 +350,32 @@ uint32_t Candlelight::Start(eDeviceFlags e_Flags)
     if (mpk_Info->mk_Capability.feature & ELM_DevFlagSendUsbBlobs)
         k_Mode.flags |= ELM_DevFlagSendUsbBlobs;
 
+    // Newer firmware sends 64 bit timestamps that do not need a roll over detection
+    if ((e_Flags & GS_DevFlagTimestamp) && (mpk_Info->mk_Capability.feature & ELM_DevFlagTimestamp64))
+        k_Mode.flags |= ELM_DevFlagTimestamp64;
+
+    // Map the 64 bit MCU timestamps into the time base of GetOsTimestamp()
+    if ((k_Mode.flags & ELM_DevFlagTimestamp64) && (mpk_Info->mk_Capability.feature & ELM_DevFlagTimeSync))
+        k_Mode.flags |= ELM_DevFlagTimeSync;
+
+    // Count the frames that have been lost in the firmware or in the hardware
+    if (mpk_Info->mk_Capability.feature & ELM_DevFlagRxSequence)
+        k_Mode.flags |= ELM_DevFlagRxSequence;
+
     uint32_t u32_Error = CtrlTransfer(DIR_Out, GS_ReqSetDeviceMode, mu8_Channel, &k_Mode, sizeof(k_Mode)); // turn off Tx LED
     if (u32_Error)
         return u32_Error;
 
-    mb_McuTimestamp = (e_Flags & GS_DevFlagTimestamp) > 0;
-    mb_Started      = true;
+    mb_McuTimestamp   = (e_Flags & GS_DevFlagTimestamp) > 0;
+    mb_McuTimestamp64 = (k_Mode.flags & ELM_DevFlagTimestamp64) > 0;
+    mb_TimeSync       = (k_Mode.flags & ELM_DevFlagTimeSync)    > 0;
+    mb_RxSequence     = (k_Mode.flags & ELM_DevFlagRxSequence)  > 0;
+    mb_Started        = true;
+    mu16_NextSequence = 0; // the firmware restarts the counters at zero
+    mu16_LostCount    = 0;
+    mu64_RxDropped    = 0;
+    mu64_RxLost       = 0;
+    mi_ClockSync.Reset(); // the firmware restarts the timestamps at zero
     return u32_Error;
 }
 
@@ -429,8 +454,44 @@ uint32_t Candlelight::SendPacket(kCanPacket* pk_Packet, int64_t* ps64_OsTimestam
     return mi_OsLibrary.WritePipeOut(u8_Transmit, s32_Offset);
 }
 
+// Send a CAN packet at the absolute MCU timestamp u32_SendTime in s (firmware 16.Oct.2026)
+// The firmware stores max 16 timed packets (8 on the STM32G431 and STM32G0B1). A send time in the past sends the packet immediately.
+// Get the current MCU time with GetMcuTimestamp(). The Tx echo contains the timestamp when the packet was really sent.
+uint32_t Candlelight::SendPacketTimed(kCanPacket* pk_Packet, uint32_t u32_SendTime)
+{
+    if (!mb_InitDone || !mb_Started)
+        return ERR_OPERATION_INVALID;
+
+    uint8_t u8_Transmit[256];
+
+    int s32_Offset = 0;
+    uint32_t u32_Error = TxPacketToTxBytes(pk_Packet, u8_Transmit, sizeof(u8_Transmit), &s32_Offset, MSG_TxTimed, u32_SendTime);
+    if (u32_Error)
+        return u32_Error;
+
+    return mi_OsLibrary.WritePipeOut(u8_Transmit, s32_Offset);
+}
+
+// Send a CAN packet that the firmware discards if it could not be sent within u32_TimeToLive s (firmware 17.Oct.2026)
+// This avoids that outdated packets are sent after a bus congestion.
+// A discarded packet is reported with MSG_TxExpired instead of MSG_TxEcho (only if the Tx echo is enabled).
+uint32_t Candlelight::SendPacketTtl(kCanPacket* pk_Packet, uint32_t u32_TimeToLive)
+{
+    if (!mb_InitDone || !mb_Started)
+        return ERR_OPERATION_INVALID;
+
+    uint8_t u8_Transmit[256];
+
+    int s32_Offset = 0;
+    uint32_t u32_Error = TxPacketToTxBytes(pk_Packet, u8_Transmit, sizeof(u8_Transmit), &s32_Offset, MSG_TxTtl, u32_TimeToLive);
+    if (u32_Error)
+        return u32_Error;
+
+    return mi_OsLibrary.WritePipeOut(u8_Transmit, s32_Offset);
+}
+
 // If the packet has insufficient bytes to match one of the CAN FD DLC values, it will be padded with PAD_BYTE.
-uint32_t Candlelight::TxPacketToTxBytes(kCanPacket* pk_Packet, uint8_t* u8_TxBuf, int s32_BufSize, int* ps32_Offset)
+uint32_t Candlelight::TxPacketToTxBytes(kCanPacket* pk_Packet, uint8_t* u8_TxBuf, int s32_BufSize, int* ps32_Offset, eMessageType e_MsgType, uint32_t u32_Param)
 {
     // Pad missing bytes with zeroe's
     const uint8_t PAD_BYTE = 0;
@@ -498,6 +559,15 @@ uint32_t Candlelight::TxPacketToTxBytes(kCanPacket* pk_Packet, uint8_t* u8_TxBuf
     if (pk_Packet->mb_FDF) k_TxFrame.flags |= FRM_FDF;
     if (pk_Packet->mb_BRS) k_TxFrame.flags |= FRM_BRS;
 
+    // kTxTimedElmue is kTxFrameElmue with the send time appended, kTxTtlElmue is kTxFrameElmue with the time-to-live appended
+    int s32_FrameSize = sizeof(kTxFrameElmue);
+    if (e_MsgType == MSG_TxTimed || e_MsgType == MSG_TxTtl)
+    {
+        s32_FrameSize = sizeof(kTxTimedElmue); // same size as kTxTtlElmue
+        k_TxFrame.header.size     = s32_FrameSize + pk_Packet->mu8_DataLen;
+        k_TxFrame.header.msg_type = e_MsgType;
+    }
+
     if (*ps32_Offset + k_TxFrame.header.size >= s32_BufSize)
         return ERR_TX_DATA_TOO_LONG;
 
@@ -516,7 +586,9 @@ uint32_t Candlelight::TxPacketToTxBytes(kCanPacket* pk_Packet, uint8_t* u8_TxBuf
     memcpy(&mk_EchoPackets[k_TxFrame.marker], pk_Packet, sizeof(kCanPacket));
 
     memcpy(u8_TxBuf + *ps32_Offset, &k_TxFrame, sizeof(kTxFrameElmue));
-    *ps32_Offset += sizeof(kTxFrameElmue);
+    if (s32_FrameSize > (int)sizeof(kTxFrameElmue)) // send_time or ttl
+        memcpy(u8_TxBuf + *ps32_Offset + offsetof(kTxTimedElmue, send_time), &u32_Param, sizeof(uint32_t));
+    *ps32_Offset += s32_FrameSize;
 
     memcpy(u8_TxBuf + *ps32_Offset, pk_Packet->mu8_Data, pk_Packet->mu8_DataLen);
     *ps32_Offset += pk_Packet->mu8_DataLen;
@@ -571,6 +643,20 @@ uint32_t Candlelight::ReceiveData(uint32_t u32_Timeout, kHeader** ppk_Header, in
     ms32_BlobFrames --;                              // AFTER
     mu32_BlobOffset += pk_Header->size;
 
+    // The time sync messages are consumed here and not passed to the application.
+    // The OS timestamp of the USB IN packet is the reception time of the sync message.
+    if (pk_Header->msg_type == MSG_TimeSync)
+    {
+        kTimeSyncElmue* pk_Sync = (kTimeSyncElmue*)pk_Header;
+        mi_ClockSync.AddSample(pk_Sync->sof_time, mk_UsbInPacket.ms64_OsTimestamp);
+
+        // If the sync message was the only data, return a timeout, so the caller does not block longer than u32_Timeout.
+        if (ms32_BlobFrames <= 0)
+            return ERR_TIMEOUT;
+
+        return ReceiveData(u32_Timeout, ppk_Header, ps64_RxTimestamp, pb_RxBlob); // the next frame in the blob
+    }
+
     *ppk_Header       = pk_Header;
     *ps64_RxTimestamp = mk_UsbInPacket.ms64_OsTimestamp;
     return NO_ERROR;    
@@ -586,20 +672,61 @@ kCanPacket Candlelight::RxFrameToCanPacket(kRxFrameElmue* pk_Frame)
     k_Packet.mb_BRS     = k_Packet.mb_FDF && (pk_Frame->flags & FRM_BRS) != 0;
     k_Packet.mb_ESI     = k_Packet.mb_FDF && (pk_Frame->flags & FRM_ESI) != 0;
 
-    uint8_t* u8_StructStart = (uint8_t*) pk_Frame;
-    uint8_t* u8_DataStart   = (uint8_t*)&pk_Frame->timestamp;
-    if (mb_McuTimestamp) u8_DataStart += 4;
+    uint8_t* u8_StructStart = (uint8_t*)pk_Frame;
+    uint8_t* u8_DataStart   = GetRxDataStart(pk_Frame);
+    if (mb_RxSequence) u8_DataStart += sizeof(kRxSequence);
 
     k_Packet.mu8_DataLen = pk_Frame->header.size - (u8_DataStart - u8_StructStart);
     memcpy(k_Packet.mu8_Data, u8_DataStart, k_Packet.mu8_DataLen);
     return k_Packet;
 }
 
+// private
+// returns the position after the optional 32 or 64 bit timestamp
+uint8_t* Candlelight::GetRxDataStart(kRxFrameElmue* pk_Frame)
+{
+    uint8_t* u8_DataStart = (uint8_t*)&pk_Frame->timestamp;
+    if (mb_McuTimestamp)   u8_DataStart += 4;
+    if (mb_McuTimestamp64) u8_DataStart += 4; // high 32 bit of the timestamp
+    return u8_DataStart;
+}
+
+// Get the count of frames that have been lost directly before this frame (ELM_DevFlagRxSequence).
+// ps32_Dropped = frames dropped in the firmware because the USB buffer was full (gap in the sequence number)
+// ps32_Lost    = frames lost in the hardware because the Rx FIFO or the Rx ring buffer was full
+// This must be called exactly once for each received frame in the order of reception.
+// returns false if the firmware does not support this feature.
+bool Candlelight::GetRxLoss(kRxFrameElmue* pk_Frame, int* ps32_Dropped, int* ps32_Lost)
+{
+    *ps32_Dropped = 0;
+    *ps32_Lost    = 0;
+    if (!mb_RxSequence)
+        return false;
+
+    kRxSequence* pk_Sequence = (kRxSequence*)GetRxDataStart(pk_Frame);
+
+    // The 16 bit counters roll over. The subtraction must be done in 16 bit.
+    *ps32_Dropped = (uint16_t)(pk_Sequence->sequence   - mu16_NextSequence);
+    *ps32_Lost    = (uint16_t)(pk_Sequence->lost_count - mu16_LostCount);
+
+    mu16_NextSequence = pk_Sequence->sequence + 1;
+    mu16_LostCount    = pk_Sequence->lost_count;
+    mu64_RxDropped   += *ps32_Dropped;
+    mu64_RxLost      += *ps32_Lost;
+    return true;
+}
+
 kCanPacket Candlelight::GetTxEchoPacket(kTxEchoElmue* pk_TxEcho)
 {
     return mk_EchoPackets[pk_TxEcho->marker];
 }
 
+// Get the packet that has been discarded by the firmware because its time-to-live expired (SendPacketTtl)
+kCanPacket Candlelight::GetTxExpiredPacket(kTxExpiredElmue* pk_TxExpired)
+{
+    return mk_EchoPackets[pk_TxExpired->marker];
+}
+
 // Get the content of a debug message from the adapter
 string Candlelight::ConvertStringFrame(kStringElmue* pk_String)
 {
@@ -620,13 +747,55 @@ uint32_t Candlelight::Identify(bool b_Blink)
 }
 
 // Interval = 7 --> report busload in percent every 700 ms.
+// u8_Flags = BUSLOAD_Exact      --> the firmware counts the real stuff bits of each frame instead of an average (firmware 16.Oct.2026)
+// u8_Flags = BUSLOAD_Statistics --> the firmware sends MSG_BusloadStats with peak, minimum and histogram of 1 ms windows (firmware 16.Oct.2026)
 // NOTE: The firmware does not report the busload if bus load is permanently 0%.
-uint32_t Candlelight::EnableBusLoadReport(uint8_t u8_Interval)
+uint32_t Candlelight::EnableBusLoadReport(uint8_t u8_Interval, uint8_t u8_Flags)
 {
     if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
         return ERR_OPERATION_INVALID;
 
-    return CtrlTransfer(DIR_Out, ELM_ReqSetBusLoadReport, mu8_Channel, &u8_Interval, sizeof(u8_Interval));
+    uint8_t u8_Data[2] = { u8_Interval, u8_Flags }; // u8_Flags = eBusloadFlags
+    return CtrlTransfer(DIR_Out, ELM_ReqSetBusLoadReport, mu8_Channel, u8_Data, sizeof(u8_Data));
+}
+
+// Packets that are not acknowledged within u16_Timeout ms are canceled and the error APP_CanTxTimeout is reported.
+// The default is 500 ms. It is restored when the adapter is closed. (firmware 17.Oct.2026)
+uint32_t Candlelight::SetTxTimeout(uint16_t u16_Timeout)
+{
+    if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
+        return ERR_OPERATION_INVALID;
+
+    return CtrlTransfer(DIR_Out, ELM_ReqSetTxTimeout, mu8_Channel, &u16_Timeout, sizeof(u16_Timeout));
+}
+
+// BOFF_Immediate: restart the CAN controller immediately after Bus Off (default)
+// BOFF_Backoff:   wait u16_BaseDelay ms before the first attempt, the delay is doubled for each further attempt (max 60 seconds)
+// BOFF_Manual:    the firmware does not recover alone, call RecoverBusOff()
+// u16_MaxAttempts = consecutive attempts before the firmware waits for RecoverBusOff() (0 = unlimited)
+// Each recovery is reported with MSG_BusOffStats. The default is restored when the adapter is closed. (firmware 17.Oct.2026)
+uint32_t Candlelight::SetBusOffRecovery(eBusOffPolicy e_Policy, uint16_t u16_BaseDelay, uint16_t u16_MaxAttempts)
+{
+    if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
+        return ERR_OPERATION_INVALID;
+
+    kBusOffSetup k_Setup = {0};
+    k_Setup.Operation   = BOFF_SetPolicy;
+    k_Setup.Policy      = e_Policy;
+    k_Setup.BaseDelay   = u16_BaseDelay;
+    k_Setup.MaxAttempts = u16_MaxAttempts;
+    return CtrlTransfer(DIR_Out, ELM_ReqSetBusOffRecovery, mu8_Channel, &k_Setup, sizeof(k_Setup));
+}
+
+// Start the recovery from Bus Off now. Required with BOFF_Manual or after the maximum attempts. (firmware 17.Oct.2026)
+uint32_t Candlelight::RecoverBusOff()
+{
+    if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
+        return ERR_OPERATION_INVALID;
+
+    kBusOffSetup k_Setup = {0};
+    k_Setup.Operation = BOFF_Recover;
+    return CtrlTransfer(DIR_Out, ELM_ReqSetBusOffRecovery, mu8_Channel, &k_Setup, sizeof(k_Setup));
 }
 
 // Read the detailed documentation about pin BOOT0 on https://netcult.ch/elmue/CANable%20Firmware%20Update
@@ -681,6 +850,98 @@ uint32_t Candlelight::ReadFlash(uint8_t u8_Segment, uint8_t* u8_Buffer, uint16_t
     return CtrlTransfer(DIR_In, ELM_ReqReadFlash, u8_Segment, u8_Buffer, u16_BufSize, pu32_DataRead);
 }
 
+// Enable, disable or clear the per-ID statistics of all received CAN IDs (firmware 16.Oct.2026)
+// IDST_Enable and IDST_Disable require the adapter to be closed.
+// b_NoStream = true --> received frames are only counted, but not sent to the host (bus monitoring without USB load)
+uint32_t Candlelight::SetIdStats(eIdStatsOperation e_Operation, uint16_t u16_MaxEntries, bool b_NoStream)
+{
+    if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
+        return ERR_OPERATION_INVALID;
+
+    kIdStatsSetup k_Setup = {0};
+    k_Setup.Operation  = (uint8_t)e_Operation;
+    k_Setup.NoStream   = b_NoStream ? 1 : 0;
+    k_Setup.MaxEntries = u16_MaxEntries;
+    return CtrlTransfer(DIR_Out, ELM_ReqSetIdStats, mu8_Channel, &k_Setup, sizeof(k_Setup));
+}
+
+// Read one page with max 8 entries of the per-ID statistics. Request page 0, 1, 2,... until EntryCount < 8.
+// The page is transmitted in the high byte of wValue because IN requests cannot send data to the device.
+uint32_t Candlelight::GetIdStats(uint8_t u8_Page, kIdStatsPage* pk_Page)
+{
+    if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
+        return ERR_OPERATION_INVALID;
+
+    return CtrlTransfer(DIR_In, ELM_ReqGetIdStats, mu8_Channel | (u8_Page << 8), pk_Page, sizeof(kIdStatsPage));
+}
+
+// Set a periodic Tx packet that the firmware sends with s precision without the host (firmware 16.Oct.2026)
+// pk_Entry->Period = 0 removes the entry. Setting an entry with the same Period and Phase only replaces the packet.
+// This may also be called while the adapter is open. The cyclic packets are removed when the adapter is closed.
+uint32_t Candlelight::SetCyclic(kCyclicEntry* pk_Entry)
+{
+    if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
+        return ERR_OPERATION_INVALID;
+
+    pk_Entry->Operation = 1;
+    return CtrlTransfer(DIR_Out, ELM_ReqSetCyclic, mu8_Channel, pk_Entry, sizeof(kCyclicEntry));
+}
+
+// Remove all periodic Tx packets
+uint32_t Candlelight::ClearCyclic()
+{
+    if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
+        return ERR_OPERATION_INVALID;
+
+    kCyclicEntry k_Entry = {0};
+    return CtrlTransfer(DIR_Out, ELM_ReqSetCyclic, mu8_Channel, &k_Entry, sizeof(k_Entry));
+}
+
+// Get the current MCU timestamp in s. This is the time base of the Rx timestamps and of SendPacketTimed().
+uint32_t Candlelight::GetMcuTimestamp(uint32_t* pu32_Timestamp)
+{
+    if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
+        return ERR_OPERATION_INVALID;
+
+    return CtrlTransfer(DIR_In, GS_ReqGetTimestamp, mu8_Channel, pu32_Timestamp, sizeof(uint32_t));
+}
+
+// Convert a 64 bit MCU timestamp into the time base of GetOsTimestamp() (ELM_DevFlagTimeSync)
+// returns -1 if the clocks are not yet synchronized (during the first second after Start())
+int64_t Candlelight::McuToOsTimestamp(int64_t s64_McuStamp)
+{
+    if (!mb_TimeSync)
+        return -1;
+
+    return mi_ClockSync.McuToHost(s64_McuStamp);
+}
+
+// Convert a 64 bit MCU timestamp into OsLibrary::GetMonotonicTime() (Linux: CLOCK_MONOTONIC, Windows: performance counter)
+// This time base is the same for all adapters, so the frames of multiple adapters can be displayed on one timeline.
+int64_t Candlelight::McuToMonotonic(int64_t s64_McuStamp)
+{
+    int64_t s64_OsStamp = McuToOsTimestamp(s64_McuStamp);
+    if (s64_OsStamp < 0)
+        return -1;
+
+    return s64_OsStamp + mi_OsLibrary.GetTimestampStart();
+}
+
+// Get the current MCU timestamp in s as 64 bit value which never rolls over (requires ELM_DevFlagTimestamp64 in the capabilities)
+uint32_t Candlelight::GetMcuTimestamp64(uint64_t* pu64_Timestamp)
+{
+    if (!mb_InitDone || mu8_Interface == FIRMW_UPDATE_INTERFACE)
+        return ERR_OPERATION_INVALID;
+
+    if ((mpk_Info->mk_Capability.feature & ELM_DevFlagTimestamp64) == 0)
+    {
+        me_LastError = FBK_UnsupportedFeature;
+        return ERR_CODE_IN_FEEDBACK;
+    }
+
+    return CtrlTransfer(DIR_In, ELM_ReqGetTimestamp64, mu8_Channel, pu64_Timestamp, sizeof(uint64_t));
+}
+
 // --------------------------------------------------------------------
 
 // Send a SETUP request to the firmware
@@ -762,6 +1023,8 @@ uint32_t Candlelight::CtrlTransfer(eDirection e_Dir, uint8_t u8_Request, uint16_
 // Formats a timestamp with 1 s precision
 // returns "HH:MM:SS.mmm."
 // pk_Header may contain a timestamp if GS_DevFlagTimestamp is set --> mb_McuTimestamp = true
+// If ELM_DevFlagTimestamp64 is set the high 32 bit follow the timestamp --> mb_McuTimestamp64 = true
+// If ELM_DevFlagTimeSync is set the firmware timestamps are converted into the time base of s64_OsTimestamp
 // otherwise use s64_OsTimestamp which comes from GetOsTimestamp() at packet reception
 string Candlelight::FormatTimestamp(kHeader* pk_Header, int64_t s64_OsTimestamp)
 {
@@ -771,19 +1034,29 @@ string Candlelight::FormatTimestamp(kHeader* pk_Header, int64_t s64_OsTimestamp)
     int64_t s64_Stamp = -1;
     if (mb_McuTimestamp)
     {
+        uint32_t* pu32_Stamp = NULL;
         if (pk_Header)
         {
             switch (pk_Header->msg_type)
             {
                 // These 3 messages send firmware timestamps
-                case MSG_TxEcho:  s64_Stamp = ((kTxEchoElmue*) pk_Header)->timestamp; break;
-                case MSG_RxFrame: s64_Stamp = ((kRxFrameElmue*)pk_Header)->timestamp; break;
-                case MSG_Error:   s64_Stamp = ((kErrorElmue*)  pk_Header)->timestamp; break;
+                case MSG_TxEcho:  pu32_Stamp = &((kTxEchoElmue*) pk_Header)->timestamp; break;
+                case MSG_TxExpired: pu32_Stamp = &((kTxExpiredElmue*)pk_Header)->timestamp; break;
+                case MSG_RxFrame: pu32_Stamp = &((kRxFrameElmue*)pk_Header)->timestamp; break;
+                case MSG_Error:   pu32_Stamp = &((kErrorElmue*)  pk_Header)->timestamp; break;
+                case MSG_ErrorEvent: pu32_Stamp = &((kErrorEventElmue*)pk_Header)->timestamp; break;
             }
         }
 
-        if (s64_Stamp >= 0)
+        if (pu32_Stamp && mb_McuTimestamp64)
+        {
+            // The firmware has already extended the timestamp to 64 bit, no roll over detection required.
+            s64_Stamp = pu32_Stamp[0] | ((int64_t)pu32_Stamp[1] << 32);
+        }
+        else if (pu32_Stamp)
         {
+            s64_Stamp = pu32_Stamp[0];
+
             // The 32 bit firmware timestamp will roll over after 1 hour, this must be detected here.
             // ATTENTION: The MCU may send an Rx packet with a lower timestamp than the previous Rx packet.
             // This may happen --> ignore small jumps back in time and detect only big jumps.
@@ -796,6 +1069,11 @@ string Candlelight::FormatTimestamp(kHeader* pk_Header, int64_t s64_OsTimestamp)
             // roll-over compensated 64 bit timestamp
             s64_Stamp += ms64_McuRollOver;
         }
+
+        // If the clocks are synchronized, all timestamps are displayed in the time base of the operating system.
+        // Then also the messages without a firmware timestamp can be displayed on the same timeline.
+        if (IsClockSynced())
+            s64_Stamp = (s64_Stamp >= 0) ? mi_ClockSync.McuToHost(s64_Stamp) : s64_OsTimestamp;
     }
     else // Operating System performance counter timestamps are used
     {
@@ -917,6 +1195,44 @@ string Candlelight::FormatCanErrors(kErrorElmue* pk_Error, eErrorBusStatus* pe_B
     return cUtils::TrimRight(s_Mesg, ", ");
 }
 
+// Protocol error sent by the firmware if ELM_DevFlagErrorLog has been set (firmware 17.Oct.2026)
+string Candlelight::FormatErrorEvent(kErrorEventElmue* pk_Event)
+{
+    static const char* s_Types[] = { "Stuff Error", "Form Error", "No ACK received", "Recessive Bit Error", "Dominant Bit Error", "CRC Error" };
+
+    uint8_t u8_Code = pk_Event->code & 0x7F;
+    string s_Mesg = (u8_Code >= 1 && u8_Code <= 6) ? s_Types[u8_Code - 1] : "Unknown Error";
+    if (pk_Event->code & 0x80)
+        s_Mesg += " in data phase";
+
+    char c_Buf[50];
+    sprintf_s(c_Buf, ", Tx Errors: %u, Rx Errors: %u", pk_Event->tx_err_count, pk_Event->rx_err_count);
+    return s_Mesg + c_Buf;
+}
+
+// Count of protocol errors per type sent by the firmware every second if ELM_DevFlagErrorLog has been set
+string Candlelight::FormatErrorCounters(kErrorCountersElmue* pk_Counters)
+{
+    char c_Buf[200];
+    sprintf_s(c_Buf, "Stuff: %u, Form: %u, ACK: %u, Bit1: %u, Bit0: %u, CRC: %u, not logged: %u", 
+              pk_Counters->counts[0], pk_Counters->counts[1], pk_Counters->counts[2], 
+              pk_Counters->counts[3], pk_Counters->counts[4], pk_Counters->counts[5], pk_Counters->suppressed);
+    return c_Buf;
+}
+
+// Statistics sent by the firmware after each recovery from Bus Off (firmware 17.Oct.2026)
+string Candlelight::FormatBusOffStats(kBusOffStatsElmue* pk_Stats)
+{
+    char c_Buf[200];
+    sprintf_s(c_Buf, "Bus Off count: %u, Attempts: %u, Recovery time: %u ms (min: %u ms, max: %u ms)", 
+              pk_Stats->bus_off_count, pk_Stats->attempts, pk_Stats->last_ms, pk_Stats->min_ms, pk_Stats->max_ms);
+
+    string s_Mesg = c_Buf;
+    if (pk_Stats->waiting)
+        s_Mesg += ", waiting for RecoverBusOff()";
+    return s_Mesg;
+}
+
 string Candlelight::FormatLastError(uint32_t u32_Error)
 {
     assert(u32_Error != NO_ERROR); // calling this function without an error code make no sense
@@ -1015,3 +1331,95 @@ uint32_t Candlelight::EnterDfuMode()
     return NO_ERROR;
 }
 
+// ================================== Clock Sync ========================================
+
+void cClockSync::Reset()
+{
+    ms32_Count      = 0;
+    ms32_WriteIdx   = 0;
+    ms32_BlockCount = 0;
+    ms64_BlockMcu   = 0;
+    ms64_BlockDiff  = 0;
+    ms64_LastMcu    = -1;
+    ms64_BaseMcu    = 0;
+    md_Offset       = 0.0;
+    md_Drift        = 0.0;
+}
+
+// s64_McuTime  = sof_time from MSG_TimeSync
+// s64_HostTime = OS timestamp when the USB IN packet with the sync message was received
+void cClockSync::AddSample(int64_t s64_McuTime, int64_t s64_HostTime)
+{
+    // The MCU timestamps start at zero when the first channel is opened
+    if (s64_McuTime <= ms64_LastMcu)
+        Reset();
+
+    ms64_LastMcu = s64_McuTime;
+
+    // The USB latency is always positive --> the sample with the lowest difference has the lowest latency.
+    int64_t s64_Diff = s64_HostTime - s64_McuTime;
+    if (ms32_BlockCount == 0 || s64_Diff < ms64_BlockDiff)
+    {
+        ms64_BlockMcu  = s64_McuTime;
+        ms64_BlockDiff = s64_Diff;
+    }
+
+    if (++ms32_BlockCount < BLOCK_SAMPLES)
+        return;
+
+    ms64_McuPoints [ms32_WriteIdx] = ms64_BlockMcu;
+    ms64_DiffPoints[ms32_WriteIdx] = ms64_BlockDiff;
+    ms32_WriteIdx   = (ms32_WriteIdx + 1) % MAX_POINTS;
+    ms32_Count      = min(ms32_Count + 1, MAX_POINTS);
+    ms32_BlockCount = 0;
+    Fit();
+}
+
+// Least squares fit of: Diff = Offset + Drift * (Mcu - BaseMcu)
+void cClockSync::Fit()
+{
+    // Use the newest point as base to avoid a loss of precision in the double variables.
+    ms64_BaseMcu = ms64_BlockMcu;
+
+    double d_SumX = 0.0, d_SumY = 0.0;
+    for (int i=0; i<ms32_Count; i++)
+    {
+        d_SumX += (double)(ms64_McuPoints[i] - ms64_BaseMcu);
+        d_SumY += (double) ms64_DiffPoints[i];
+    }
+    double d_MeanX = d_SumX / ms32_Count;
+    double d_MeanY = d_SumY / ms32_Count;
+
+    double d_Sxx = 0.0, d_Sxy = 0.0;
+    for (int i=0; i<ms32_Count; i++)
+    {
+        double d_X = (double)(ms64_McuPoints[i] - ms64_BaseMcu) - d_MeanX;
+        double d_Y = (double) ms64_DiffPoints[i] - d_MeanY;
+        d_Sxx += d_X * d_X;
+        d_Sxy += d_X * d_Y;
+    }
+
+    // With only one point the drift cannot be calculated yet
+    md_Drift  = (d_Sxx > 0.0) ? d_Sxy / d_Sxx : 0.0;
+    md_Offset = d_MeanY - md_Drift * d_MeanX;
+
+    // Move the line down to the point with the lowest latency
+    double d_MinResidual = 0.0;
+    for (int i=0; i<ms32_Count; i++)
+    {
+        double d_Residual = (double)ms64_DiffPoints[i] - (md_Offset + md_Drift * (double)(ms64_McuPoints[i] - ms64_BaseMcu));
+        if (i == 0 || d_Residual < d_MinResidual)
+            d_MinResidual = d_Residual;
+    }
+    md_Offset += d_MinResidual;
+}
+
+// returns the host time of s64_McuTime or -1 if not enough sync messages have been received
+int64_t cClockSync::McuToHost(int64_t s64_McuTime)
+{
+    if (!IsValid() || s64_McuTime < 0)
+        return -1;
+
+    double d_Diff = md_Offset + md_Drift * (double)(s64_McuTime - ms64_BaseMcu);
+    return s64_McuTime + (int64_t)(d_Diff < 0.0 ? d_Diff - 0.5 : d_Diff + 0.5); // round
+}
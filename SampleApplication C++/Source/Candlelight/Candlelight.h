@@ -58,6 +58,39 @@ struct kDetail
     }
 };
 
+// Estimates the offset and the drift between the MCU clock and the host clock (ELM_DevFlagTimeSync).
+// Each MSG_TimeSync contains the MCU time of a USB Start-Of-Frame. It arrives with a variable USB latency which is never negative.
+// The sample with the lowest latency of each second is stored and a straight line is fitted through the last 60 of them.
+// Then the line is moved down to the lowest sample, so it follows the minimum USB latency and not the average.
+class cClockSync
+{
+public:
+    cClockSync() { Reset(); }
+    void    Reset();
+    void    AddSample(int64_t s64_McuTime, int64_t s64_HostTime);
+    int64_t McuToHost(int64_t s64_McuTime);
+    inline bool   IsValid()  { return ms32_Count > 0; }
+    inline double GetDrift() { return md_Drift * 1000000.0; } // in ppm
+
+private:
+    void    Fit();
+
+    static const int BLOCK_SAMPLES = 10; // 10 sync messages of 100 ms --> one point per second
+    static const int MAX_POINTS    = 60; // fit over the last 60 seconds
+
+    int64_t ms64_McuPoints [MAX_POINTS]; // ring buffer
+    int64_t ms64_DiffPoints[MAX_POINTS]; // host time - MCU time
+    int     ms32_Count;       // count of valid points
+    int     ms32_WriteIdx;    // next write position in the ring buffer
+    int     ms32_BlockCount;  // samples in the current block
+    int64_t ms64_BlockMcu;    // MCU time of the best sample in the current block
+    int64_t ms64_BlockDiff;   // lowest (host time - MCU time) in the current block
+    int64_t ms64_LastMcu;     // detects a reset of the MCU timestamps
+    int64_t ms64_BaseMcu;     // MCU time where md_Offset is valid
+    double  md_Offset;        // host time - MCU time at ms64_BaseMcu
+    double  md_Drift;         // host clock runs (1 + md_Drift) times faster than the MCU clock
+};
+
 class Candlelight
 {
 public:
@@ -68,38 +101,61 @@ public:
     void       Close();
     void       EnableTxEcho(bool b_Enable);
     uint32_t   SetBitrate(bool b_FD, int s32_BRP, int s32_Seg1, int s32_Seg2, string* ps_Display);
-    uint32_t   AddHostFilter(bool b_29bit, uint32_t u32_Filter, uint32_t u32_Mask);
+    uint32_t   AddHostFilter(bool b_29bit, uint32_t u32_Filter, uint32_t u32_Mask, bool b_Priority = false);
     uint32_t   SetBridgeFilter(uint8_t u8_FilterIndex, uint8_t u8_DestChannel, bool b_Enable, bool b_Block, bool b_29bit, uint32_t u32_Filter, uint32_t u32_Mask);
     uint32_t   Start(eDeviceFlags e_Flags);
     // ------------------------------------
     uint32_t   SendPacketBlob(kCanPacket* pk_Packets, int s32_Count, int64_t* ps64_OsTimestamp);
     uint32_t   SendPacket(kCanPacket* pk_CanPacket, int64_t* ps64_OsTimestamp);
+    uint32_t   SendPacketTimed(kCanPacket* pk_CanPacket, uint32_t u32_SendTime);
+    uint32_t   SendPacketTtl  (kCanPacket* pk_CanPacket, uint32_t u32_TimeToLive);
     uint32_t   ReceiveData(uint32_t u32_Timeout, kHeader** ppk_Header, int64_t* ps64_RxTimestamp, bool* pb_Blob = NULL);
     kCanPacket RxFrameToCanPacket(kRxFrameElmue* pk_RxFrame);
+    bool       GetRxLoss(kRxFrameElmue* pk_RxFrame, int* ps32_Dropped, int* ps32_Lost);
     kCanPacket GetTxEchoPacket   (kTxEchoElmue*  pk_TxEcho);
+    kCanPacket GetTxExpiredPacket(kTxExpiredElmue* pk_TxExpired);
     string     ConvertStringFrame(kStringElmue*  pk_String);
     // ------------------------------------
     string     FormatCanPacket(kCanPacket* pk_Packet);
     string     FormatTimestamp(kHeader* pk_Header, int64_t s64_OsTimestamp);
     string     FormatCanErrors(kErrorElmue*   pk_Error, eErrorBusStatus* pe_BusStatus, eErrorLevel* pe_Level);
+    string     FormatErrorEvent(kErrorEventElmue* pk_Event);
+    string     FormatErrorCounters(kErrorCountersElmue* pk_Counters);
+    string     FormatBusOffStats(kBusOffStatsElmue* pk_Stats);
     string     FormatLastError(uint32_t u32_Error);
     // ------------------------------------
     uint32_t   Identify(bool b_Blink);
-    uint32_t   EnableBusLoadReport(uint8_t u8_Interval);
+    uint32_t   EnableBusLoadReport(uint8_t u8_Interval, uint8_t u8_Flags = 0);
+    uint32_t   SetTxTimeout(uint16_t u16_Timeout);
+    uint32_t   SetBusOffRecovery(eBusOffPolicy e_Policy, uint16_t u16_BaseDelay = 0, uint16_t u16_MaxAttempts = 0);
+    uint32_t   RecoverBusOff();
     uint32_t   EnterDfuMode();
     uint32_t   DisableBootPin();
     uint32_t   IsBootPinEnabled(bool* pb_Enabled);
     uint32_t   ReadFlash (uint8_t u8_Segment, uint8_t* u8_Buffer, uint16_t u16_BufSize, uint32_t* pu32_DataRead);
+    uint32_t   SetIdStats(eIdStatsOperation e_Operation, uint16_t u16_MaxEntries = 0, bool b_NoStream = false);
+    uint32_t   GetIdStats(uint8_t u8_Page, kIdStatsPage* pk_Page);
+    uint32_t   SetCyclic (kCyclicEntry* pk_Entry);
+    uint32_t   ClearCyclic();
+    uint32_t   GetMcuTimestamp(uint32_t* pu32_Timestamp);
+    uint32_t   GetMcuTimestamp64(uint64_t* pu64_Timestamp);
+    int64_t    McuToOsTimestamp(int64_t s64_McuStamp);
+    int64_t    McuToMonotonic  (int64_t s64_McuStamp);
     uint32_t   WriteFlash(uint8_t u8_Segment, uint8_t* u8_Buffer, uint16_t u16_DataLen);
     // ------------------------------------
     inline vector<kDetail> GetDetails()     { return  mi_Details; }
     inline kDevInfo        GetDeviceInfo()  { return *mi_OsLibrary.DevInfo(); } // return a copy of the struct. mpk_Info may be NULL here!
     inline int64_t         GetOsTimestamp() { return  mi_OsLibrary.GetTimestamp(); }
+    inline bool            IsClockSynced()  { return  mb_TimeSync && mi_ClockSync.IsValid(); }
+    inline double          GetClockDrift()  { return  mi_ClockSync.GetDrift(); } // in ppm
+    inline uint64_t        GetRxDropped()   { return  mu64_RxDropped; } // total frames dropped in the firmware (ELM_DevFlagRxSequence)
+    inline uint64_t        GetRxLost()      { return  mu64_RxLost;    } // total frames lost in the hardware   (ELM_DevFlagRxSequence)
 
 private:
     uint32_t   CtrlTransfer(eDirection e_Dir, uint8_t u8_Request, uint16_t u16_Value, void* p_Data, uint16_t u16_DataSize, uint32_t* pu32_DataRead = NULL);
-    uint32_t   TxPacketToTxBytes(kCanPacket* pk_Packet, uint8_t* u8_TxBuf, int s32_BufSize, int* ps32_Offset);
+    uint32_t   TxPacketToTxBytes(kCanPacket* pk_Packet, uint8_t* u8_TxBuf, int s32_BufSize, int* ps32_Offset, eMessageType e_MsgType = MSG_TxFrame, uint32_t u32_Param = 0);
     uint32_t   Reset();
+    uint8_t*   GetRxDataStart(kRxFrameElmue* pk_RxFrame);
 
     OsLibrary                mi_OsLibrary;
     uint8_t                  mu8_Interface;
@@ -119,6 +175,14 @@ private:
     vector<kDetail>          mi_Details;
     uint8_t                  mu8_Channel;
     bool                     mb_McuTimestamp;
+    bool                     mb_McuTimestamp64;   // the 32 bit timestamp is followed by the high 32 bit
+    bool                     mb_TimeSync;         // the firmware sends MSG_TimeSync
+    bool                     mb_RxSequence;       // the timestamp is followed by kRxSequence
+    uint16_t                 mu16_NextSequence;   // the expected sequence number of the next Rx frame
+    uint16_t                 mu16_LostCount;      // the last lost_count received
+    uint64_t                 mu64_RxDropped;
+    uint64_t                 mu64_RxLost;
+    cClockSync               mi_ClockSync;
     kUsbInPacket             mk_UsbInPacket;           // the last received blob or single frame
 };
 
@@ -33,13 +33,20 @@ typedef enum // transferred as 8 bit
     // ----------- ELM commands added by ElmSoft -----------
     ELM_ReqFIRST        = 20,  // First request that requires ElmSoft protocol to be enabled
     ELM_ReqGetBoardInfo = 20,  // kBoardInfo: get name about target board and processor
-    ELM_ReqSetFilter,          // kFilter: set up to 8 acceptance mask filters
+    ELM_ReqSetFilter,          // kFilter: set up to 8 acceptance mask filters, the host ID list and bridge filters
     ELM_ReqGetLastError,       // uint8_t: get the eFeedback error of the last SETUP request. This works also in legacy mode!
-    ELM_ReqSetBusLoadReport,   // uint8_t: enable busload report in percent to be sent in a user defined interval
+    ELM_ReqSetBusLoadReport,   // uint8_t interval + optional eBusloadFlags: enable busload report in percent to be sent in a user defined interval
     ELM_ReqSetPinStatus,       // kPinStatus: set, reset, enable, disable,... processor pins
     ELM_ReqGetPinStatus,       // Receive: SETUP.wValue = ePinID, Send: ePinStatus in 2 data bytes
     ELM_ReqReadFlash,          // Read  user data from a segment in flash memory
     ELM_ReqWriteFlash,         // Write user data to   a segment in flash memory
+    ELM_ReqSetTranslation,     // kTranslation: set the CAN ID translation and data modification of bridge packets
+    ELM_ReqSetIdStats,         // kIdStatsSetup: enable / disable / clear the per-ID statistics of received CAN IDs
+    ELM_ReqGetIdStats,         // Receive: SETUP.wValue = channel + (page << 8), Send: kIdStatsPage
+    ELM_ReqSetCyclic,          // kCyclicEntry: set / remove a periodic Tx packet of the cyclic transmit scheduler
+    ELM_ReqGetTimestamp64,     // uint64_t: get firmware 1 s timestamp that never rolls over
+    ELM_ReqSetTxTimeout,       // uint16_t: time in ms after which pending Tx packets that are not acknowledged are canceled (default 500 ms)
+    ELM_ReqSetBusOffRecovery,  // kBusOffSetup: set the recovery policy for Bus Off or start the recovery now
 } eUsbRequest;
 
 // These flags are used to enable/disable a mode with GS_ReqSetDeviceMode 
@@ -129,6 +136,33 @@ typedef enum // transferred as 32 bit
     // No additional flag is required to indicate this feature.
     // Marc Kleine Budde uses a completely incompatible struct to transmit the filter settings.
 //  MKB_DevFlagFilter                 = 0x10000, // bit 16
+
+    // Send the pending Tx frames ordered by CAN ID instead of the order in which they were received from the host.
+    // A frame with a low priority ID that loses arbitration does not delay the frames with a higher priority anymore.
+    // This affects the firmware Tx buffer and the Tx FIFO of the processor (FDCAN_TX_QUEUE_OPERATION).
+    // Tx echos may arrive in a different order than the frames have been sent by the host.
+    ELM_DevFlagTxPriority             = 0x20000, // bit 17
+    // Send 64 bit timestamps that never roll over instead of 32 bit timestamps that roll over after 71 minutes (requires GS_DevFlagTimestamp).
+    // The 32 bit timestamp in kRxFrameElmue, kTxEchoElmue and kErrorElmue is followed by 4 bytes with the high 32 bit.
+    // In kRxFrameElmue the data bytes start 4 bytes later than data_use_stamp.
+    ELM_DevFlagTimestamp64            = 0x40000, // bit 18
+
+    // Send kTimeSyncElmue every 100 ms with the 64 bit MCU time that was latched at the last USB Start-Of-Frame.
+    // The host uses it to estimate the offset and the drift between the MCU clock and the host clock.
+    ELM_DevFlagTimeSync               = 0x80000, // bit 19
+
+    // Insert kRxSequence into each kRxFrameElmue after the optional timestamp, so the host can count and locate lost frames.
+    // In kRxFrameElmue the data bytes start 4 bytes later.
+    ELM_DevFlagRxSequence             = 0x100000, // bit 20
+
+    // Use both hardware Rx FIFOs for the packets accepted by the host filters (6 packets buffered instead of 3).
+    // Rejected packets are only counted. Packets of the priority filters (FIL_HostPrio_xx) are sent to the host before all other frames.
+    ELM_DevFlagRxDualFifo             = 0x200000, // bit 21
+
+    // Send kErrorEventElmue for each protocol error (stuff, form, ACK, bit, CRC) with a timestamp and the error counters.
+    // Max 10 events per 100 ms are sent, further errors are only counted.
+    // kErrorCountersElmue with the count of all errors per type is sent every second if the counters have changed.
+    ELM_DevFlagErrorLog               = 0x400000, // bit 22
 } eDeviceFlags;
 
 // ==============================================================================
@@ -531,9 +565,13 @@ typedef struct
 // ELM_ReqSetFilter
 typedef enum // 8 bit
 {
-    FIL_HostClear = 0,    // remove all host filters (adapter must be closed)
+    FIL_HostClear = 0,    // remove all host filters and the host ID list (adapter must be closed)
     FIL_HostPass_11,      // add a new host pass mask filter for 11 bit CAN IDs to be sent to the host over USB
     FIL_HostPass_29,      // add a new host pass mask filter for 29 bit CAN IDs to be sent to the host over USB
+    FIL_HostPassID_11,    // add the 11 bit CAN ID in kFilter.Filter to the host ID list (kFilter.Mask is ignored)
+    FIL_HostPassID_29,    // add the 29 bit CAN ID in kFilter.Filter to the host ID list (kFilter.Mask is ignored)
+    FIL_HostPrio_11,      // add a new host priority mask filter for 11 bit CAN IDs (only with ELM_DevFlagRxDualFifo)
+    FIL_HostPrio_29,      // add a new host priority mask filter for 29 bit CAN IDs (only with ELM_DevFlagRxDualFifo)
     // ------------------
     // Bridge Mode (only for multi-channel adapters):
     FIL_BridgeClear = 10, // remove one of the bridge filters. If kFilter.Index = 0xFF --> clear all bridge filters.
@@ -542,6 +580,16 @@ typedef enum // 8 bit
     FIL_BridgeBlock_11,   // set a bridge block mask filter for 11 bit CAN IDs to be blocked (not forwarded to kFilter.DestChannel)
     FIL_BridgeBlock_29,   // set a bridge block mask filter for 29 bit CAN IDs to be blocked (not forwarded to kFilter.DestChannel)
     // ------------------
+    // Bridge rate limits: kFilter.Mask = packets per second (0 = unlimited), kFilter.Index = max packets at once (burst)
+    FIL_BridgeLimitDest = 20, // limit all packets forwarded to kFilter.DestChannel. kFilter.Filter = 1 --> latest value wins
+    FIL_BridgeLimitID_11,     // limit the packets with the 11 bit CAN ID in kFilter.Filter forwarded from this channel
+    FIL_BridgeLimitID_29,     // limit the packets with the 29 bit CAN ID in kFilter.Filter forwarded from this channel
+    // ------------------
+    // Tunnel between two adapters (adapter must be closed): kFilter.Filter = tunnel CAN ID, kFilter.Mask = latency window in s
+    FIL_TunnelClear = 30,     // disable the tunnel on this channel
+    FIL_TunnelSet_11,         // enable the tunnel on this channel with an 11 bit tunnel CAN ID
+    FIL_TunnelSet_29,         // enable the tunnel on this channel with a  29 bit tunnel CAN ID
+    // ------------------
 //  FIL_xxxx             // future expansions are easily possible
 } eFilterOperation;
 
@@ -558,6 +606,77 @@ typedef struct
     uint8_t  Reserved[6];
 } __packed __aligned(1) kFilter;
 
+// ELM_ReqSetTranslation (only for multi-channel adapters)
+// Packets that are forwarded by the bridge filters from the channel in SETUP.wValue are sent with DestID instead of SourceID.
+// The data bytes 0...7 are modified: data = ((data & KeepMask) | (Replace & ~KeepMask)) ^ Xor
+// To translate only the CAN ID set KeepMask = all 0xFF, Replace = Xor = all zero.
+typedef struct
+{
+    uint8_t  Operation;   // 0 = clear all translations, 1 = set the translation of SourceID
+    uint32_t SourceID;    // CAN ID received from the bridge channel, OR'ed with CAN_ID_29Bit for 29 bit IDs
+    uint32_t DestID;      // CAN ID sent to the destination channel(s), OR'ed with CAN_ID_29Bit for 29 bit IDs
+    uint8_t  KeepMask[8]; // bits of the data bytes that are not modified
+    uint8_t  Replace [8]; // bits that replace the bits that are not kept
+    uint8_t  Xor     [8]; // bits that are inverted
+} __packed __aligned(1) kTranslation;
+
+// ELM_ReqSetIdStats
+typedef enum // 8 bit
+{
+    IDST_Disable = 0, // disable the per-ID statistics (adapter closed)
+    IDST_Enable,      // enable the per-ID statistics for MaxEntries CAN IDs (adapter closed)
+    IDST_Clear,       // clear all entries (adapter open or closed)
+} eIdStatsOperation;
+
+typedef struct
+{
+    uint8_t  Operation;   // eIdStatsOperation
+    uint8_t  NoStream;    // 1 = received frames are only counted, but not sent to the host (bus monitoring without USB load)
+    uint16_t MaxEntries;  // count of CAN IDs (11 bit and 29 bit) that can be stored (max 24 on STM32G431 and STM32G0B1, max 384 on STM32G473)
+} __packed __aligned(1) kIdStatsSetup;
+
+// ELM_ReqGetIdStats: statistics of one CAN ID, all times in s
+typedef struct
+{
+    uint32_t CanID;       // CAN ID, OR'ed with CAN_ID_29Bit for 29 bit IDs
+    uint32_t Count;       // count of received frames
+    uint32_t MinPeriod;   // shortest time between two frames (0 if only one frame has been received)
+    uint32_t MeanPeriod;  // average  time between two frames
+    uint32_t MaxPeriod;   // longest  time between two frames
+    uint32_t LastStamp;   // timestamp of the last frame
+    uint8_t  LastDLC;     // DLC of the last frame (0...15)
+    uint8_t  Reserved[3];
+} __packed __aligned(1) kIdStatsEntry;
+
+// ELM_ReqGetIdStats: One page of the table. Request page 0, 1, 2,... until EntryCount < 8.
+// The page must be transmitted in the high byte of SETUP.wValue because IN requests cannot send data to the device.
+typedef struct
+{
+    uint16_t      TotalIDs;    // count of CAN IDs in the table
+    uint8_t       Page;        // the requested page
+    uint8_t       EntryCount;  // valid entries in this page (0...8)
+    uint32_t      LostFrames;  // count of frames that were not counted because the table was full
+    kIdStatsEntry Entries[8];
+} __packed __aligned(1) kIdStatsPage;
+
+// ELM_ReqSetCyclic: periodic Tx packet that the firmware sends without the host, all times in s.
+// If the entry is in use with the same Period and Phase, only the packet is replaced and the cycle continues without a gap.
+typedef struct
+{
+    uint8_t  Operation;    // 0 = remove all entries, 1 = set the entry Index (Period = 0 removes the entry)
+    uint8_t  Index;        // entry 0...15 (0...7 on STM32G431 and STM32G0B1)
+    uint8_t  Flags;        // eFrameFlags: FRM_FDF, FRM_BRS
+    uint8_t  DLC;          // 0...15
+    uint32_t CanID;        // CAN ID + eCanIdFlags (CAN_ID_29Bit, CAN_ID_RTR)
+    uint32_t Period;       // time between two transmissions (min 100 s)
+    uint32_t Phase;        // time of the first transmission after opening the adapter or setting the entry
+    uint8_t  CounterByte;  // data byte with a rolling counter that is incremented after each transmission, 0xFF = no counter
+    uint8_t  CounterMask;  // contiguous bits of the rolling counter in CounterByte (e.g. 0x0F or 0xF0)
+    uint8_t  ChecksumByte; // data byte with the checksum of all other data bytes, 0xFF = no checksum
+    uint8_t  ChecksumXor;  // 0 = 8 bit sum, 1 = XOR of all other data bytes
+    uint8_t  Data[64];
+} __packed __aligned(1) kCyclicEntry;
+
 
 // -----------------------------------------
 
@@ -612,6 +731,40 @@ typedef enum // 16 bit
 //  PINST_xxxx               // future expansions are easily possible    
 } ePinStatus;
 
+// -------------------
+
+// ELM_ReqSetBusLoadReport: optional second data byte (bit flags)
+typedef enum // 8 bit
+{
+    BUSLOAD_Exact      = 0x01, // count the real stuff bits of each frame instead of an average
+    BUSLOAD_Statistics = 0x02, // send kBusloadStatsElmue with peak, minimum and histogram of 1 ms windows instead of kBusloadElmue
+} eBusloadFlags;
+
+// -------------------
+
+// ELM_ReqSetBusOffRecovery
+typedef enum // 8 bit
+{
+    BOFF_SetPolicy = 0, // set Policy, BaseDelay and MaxAttempts (adapter open or closed)
+    BOFF_Recover,       // start the recovery from Bus Off now (adapter open), required with BOFF_Manual or after MaxAttempts
+} eBusOffOperation;
+
+typedef enum // 8 bit
+{
+    BOFF_Immediate = 0, // restart the CAN controller immediately after Bus Off (default)
+    BOFF_Backoff,       // wait BaseDelay before the first attempt, the delay is doubled for each further attempt
+    BOFF_Manual,        // do not recover alone, wait for BOFF_Recover
+} eBusOffPolicy;
+
+typedef struct
+{
+    uint8_t  Operation;   // eBusOffOperation
+    uint8_t  Policy;      // eBusOffPolicy
+    uint16_t MaxAttempts; // consecutive recovery attempts before the firmware waits for BOFF_Recover (0 = unlimited)
+    uint16_t BaseDelay;   // BOFF_Backoff: delay in ms before the first attempt, doubled for each further attempt (1 ... 60000)
+    uint16_t Reserved;
+} __packed __aligned(1) kBusOffSetup;
+
 // -----------------------------------------------------------------------------------------------
 
 typedef enum // 8 bit
@@ -626,6 +779,18 @@ typedef enum // 8 bit
     MSG_Busload,      // 0x0F the message contains one byte which is the bus load in percent (kBusloadElmue)
     MSG_TxBlob,       // 0x10 the message contains a blob (kBlob) with multiple kTxFrameElmue
     MSG_RxBlob,       // 0x11 the message contains a blob (kBlob) with multiple kRxFrameElmue
+    MSG_BusloadStats, // 0x12 the message contains the bus load statistics of 1 ms windows (kBusloadStatsElmue)
+    // received from host
+    MSG_TxTimed,      // 0x13 the message contains a CAN frame to be sent to CAN bus at an absolute timestamp (kTxTimedElmue)
+    // sent to host
+    MSG_TimeSync,     // 0x14 the message contains the MCU time of the last USB Start-Of-Frame (kTimeSyncElmue)
+    MSG_ErrorEvent,   // 0x15 the message contains one protocol error with timestamp (kErrorEventElmue)
+    MSG_ErrorCounters,// 0x16 the message contains the count of protocol errors per type (kErrorCountersElmue)
+    // received from host
+    MSG_TxTtl,        // 0x17 the message contains a CAN frame to be sent to CAN bus that is discarded when its time-to-live expires (kTxTtlElmue)
+    // sent to host
+    MSG_TxExpired,    // 0x18 the message contains the marker of a Tx CAN frame that has been discarded because its time-to-live expired or a timed frame could not be sent (kTxExpiredElmue)
+    MSG_BusOffStats,  // 0x19 the message contains the statistics of the Bus Off recovery (kBusOffStatsElmue)
 //  MSG_xxxx          // future expansions are easily possible
 } eMessageType;
 
@@ -658,6 +823,28 @@ typedef struct
     uint8_t  marker;      // one-byte marker that is sent back to the host with MSG_TxEcho when the packet has been ACKnowledged    
 } __packed __aligned(1) kTxFrameElmue;
 
+// this struct is received on the OUT endpoint from the host (firmware 16.Oct.2026)
+// The same as kTxFrameElmue, but the firmware holds the frame back until the MCU timestamp reaches send_time.
+typedef struct 
+{
+    kHeader  header;      // msg_type = MSG_TxTimed
+    uint8_t  flags;       // eFrameFlags    
+    uint32_t can_id;      // CAN ID + eCanIdFlags
+    uint8_t  marker;      // one-byte marker that is sent back to the host with MSG_TxEcho when the packet has been ACKnowledged    
+    uint32_t send_time;   // MCU timestamp in s at which the frame is sent
+} __packed __aligned(1) kTxTimedElmue;
+
+// this struct is received on the OUT endpoint from the host (firmware 17.Oct.2026)
+// The same as kTxFrameElmue, but the firmware discards the frame if it is still in the Tx buffer when ttl has elapsed.
+typedef struct 
+{
+    kHeader  header;      // msg_type = MSG_TxTtl
+    uint8_t  flags;       // eFrameFlags    
+    uint32_t can_id;      // CAN ID + eCanIdFlags
+    uint8_t  marker;      // one-byte marker that is sent back to the host with MSG_TxEcho or MSG_TxExpired
+    uint32_t ttl;         // time-to-live in s (max 0x7FFFFFFF)
+} __packed __aligned(1) kTxTtlElmue;
+
 // this struct is transmitted on the IN endpoint to the host
 // A DLC byte is not required. The count of transferred data bytes is calculated as: header.size - sizeof(kRxFrameElmue)
 // For remote frames the DLC from the Rx packet is transmitted in the first data byte to the host.
@@ -668,24 +855,43 @@ typedef struct
     kHeader  header;      // msg_type = MSG_RxFrame
     uint8_t  flags;       // eFrameFlags    
     uint32_t can_id;      // CAN ID + eCanIdFlags
-    uint32_t timestamp;   // timestamp with 1 s precision, only sent to host if GS_DevFlagTimestamp has been set, roll over detection required!
+    uint32_t timestamp;   // timestamp with 1 s precision, only sent to host if GS_DevFlagTimestamp has been set, roll over detection required! (or ELM_DevFlagTimestamp64)
 } __packed __aligned(1) kRxFrameElmue;
 
+// Inserted in kRxFrameElmue after the optional timestamp if ELM_DevFlagRxSequence has been set.
+// A gap in sequence shows how many frames have been dropped in the firmware because the USB buffer was full.
+// An increment of lost_count shows how many frames have been lost in the hardware before this frame (Rx FIFO or Rx ring buffer full).
+// Both counters are 16 bit values that roll over and start at zero when the channel is opened.
+// see Candlelight::GetRxLoss()
+typedef struct 
+{
+    uint16_t sequence;    // incremented for each received frame that should be sent to the host
+    uint16_t lost_count;  // incremented for each frame that has been lost in the hardware
+} __packed __aligned(1) kRxSequence;
+
 // see buf_store_tx_echo()
 typedef struct 
 {
     kHeader  header;      // msg_type = MSG_TxEcho
     uint8_t  marker;      // the same marker that was sent in kTxFrameElmue sent back to the host when the packet was ACKnowledged on CAN bus.
-    uint32_t timestamp;   // timestamp with 1 s precision, only sent to host if GS_DevFlagTimestamp has been set, roll over detection required!
+    uint32_t timestamp;   // timestamp with 1 s precision, only sent to host if GS_DevFlagTimestamp has been set, roll over detection required! (or ELM_DevFlagTimestamp64)
 } __packed __aligned(1) kTxEchoElmue;
 
+// see buf_store_tx_expired() (firmware 17.Oct.2026)
+typedef struct 
+{
+    kHeader  header;      // msg_type = MSG_TxExpired
+    uint8_t  marker;      // the same marker that was sent in kTxTtlElmue sent back to the host when the packet was discarded.
+    uint32_t timestamp;   // timestamp with 1 s precision when the packet was discarded, only sent to host if GS_DevFlagTimestamp has been set (or ELM_DevFlagTimestamp64)
+} __packed __aligned(1) kTxExpiredElmue;
+
 // see buf_store_error()
 typedef struct 
 {
     kHeader  header;      // msg_type = MSG_Error
     uint32_t err_id;      // eErrFlagsCanID
     uint8_t  err_data[8]; // several error flags and error counters
-    uint32_t timestamp;   // timestamp with 1 s precision, only sent to host if GS_DevFlagTimestamp has been set, roll over detection required!
+    uint32_t timestamp;   // timestamp with 1 s precision, only sent to host if GS_DevFlagTimestamp has been set, roll over detection required! (or ELM_DevFlagTimestamp64)
 } __packed __aligned(1) kErrorElmue;
 
 // see control_send_debug_mesg()
@@ -702,5 +908,61 @@ typedef struct
     uint8_t  bus_load;    // current bus load in percent
 } __packed __aligned(1) kBusloadElmue;
 
+// see control_report_busload_stats()
+// The bus load of each 1 ms window of the report interval is sorted into the histogram.
+typedef struct 
+{
+    kHeader  header;        // msg_type = MSG_BusloadStats
+    uint8_t  bus_load;      // average bus load of the interval in percent
+    uint8_t  peak;          // highest bus load of a 1 ms window in percent
+    uint8_t  minimum;       // lowest  bus load of a 1 ms window in percent
+    uint8_t  reserved;
+    uint16_t histogram[10]; // count of windows with 0...9%, 10...19%,... 90...100% bus load
+} __packed __aligned(1) kBusloadStatsElmue;
+
+// All adapters on the same USB host controller receive the same SOF at the same time.
+// Two adapters can be aligned exactly by comparing the sof_time of messages with the same frame_number.
+typedef struct 
+{
+    kHeader  header;        // msg_type = MSG_TimeSync
+    uint16_t frame_number;  // 11 bit USB frame number of the SOF (counts milliseconds)
+    uint64_t sof_time;      // 64 bit MCU timestamp in s when the SOF was received
+} __packed __aligned(1) kTimeSyncElmue;
+
+// code = 1: stuff error, 2: form error, 3: ACK error, 4: bit 1 error, 5: bit 0 error, 6: CRC error
+// Bit 7 of code is set if the error occurred in the data phase of a CAN FD frame with BRS.
+// The timestamp is always sent. With ELM_DevFlagTimestamp64 it is followed by 4 bytes with the high 32 bit.
+typedef struct 
+{
+    kHeader  header;        // msg_type = MSG_ErrorEvent
+    uint8_t  code;          // protocol error + 0x80 for the data phase
+    uint8_t  tx_err_count;  // Tx error counter after the error
+    uint8_t  rx_err_count;  // Rx error counter after the error
+    uint32_t timestamp;     // timestamp in s when the error interrupt was executed
+} __packed __aligned(1) kErrorEventElmue;
+
+// The counters start at zero when the channel is opened.
+typedef struct 
+{
+    kHeader  header;        // msg_type = MSG_ErrorCounters
+    uint32_t counts[6];     // count of stuff, form, ACK, bit 1, bit 0 and CRC errors (index = code - 1)
+    uint32_t suppressed;    // count of errors that have not been sent as kErrorEventElmue because of the rate limit
+} __packed __aligned(1) kErrorCountersElmue;
+
+// Sent after each successful recovery from Bus Off and when the firmware waits for ELM_ReqSetBusOffRecovery with BOFF_Recover.
+// All times are measured from the detection of Bus Off until the bus is error active again, including the back-off delay.
+// The statistics start at zero when the channel is opened.
+typedef struct 
+{
+    kHeader  header;        // msg_type = MSG_BusOffStats
+    uint8_t  waiting;       // 1 = the firmware does not recover alone, the host must send BOFF_Recover
+    uint8_t  reserved;
+    uint16_t attempts;      // recovery attempts since the bus was stable the last time
+    uint32_t bus_off_count; // count of Bus Off events
+    uint32_t last_ms;       // recovery time of the last recovery in ms
+    uint32_t min_ms;        // shortest recovery time in ms (0 = no recovery yet)
+    uint32_t max_ms;        // longest  recovery time in ms
+} __packed __aligned(1) kBusOffStatsElmue;
+
 #pragma pack(pop)
 
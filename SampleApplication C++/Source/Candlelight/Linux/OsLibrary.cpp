@@ -462,13 +462,7 @@ int OsLibrary::GetKeyboardInput(bool b_Blocking)
 // Then this function is used as a replacement to generate a timestamp on reception of a USB packet and when sending a packet.
 int64_t OsLibrary::GetTimestamp()
 {
-    struct timespec k_Time;
-    if (clock_gettime(CLOCK_REALTIME, &k_Time) != 0)
-        return 0; // Return 0 if the system call fails
-
-    // Convert seconds to microseconds and add the nanosecond fractional part converted to microseconds
-    int64_t s64_Timestamp = (int64_t)k_Time.tv_sec  * 1000000ULL +
-                            (int64_t)k_Time.tv_nsec / 1000ULL;
+    int64_t s64_Timestamp = GetMonotonicTime();
 
     // ms64_TimestampStart is set to zero when the device is opened
     if (ms64_TimestampStart == 0)
@@ -477,6 +471,19 @@ int64_t OsLibrary::GetTimestamp()
     return s64_Timestamp - ms64_TimestampStart;
 }
 
+// Get the CLOCK_MONOTONIC time in µs. This is the same time base for all devices.
+// Bugfix: CLOCK_REALTIME was used before, which jumps when the system time is adjusted (NTP, user).
+int64_t OsLibrary::GetMonotonicTime()
+{
+    struct timespec k_Time;
+    if (clock_gettime(CLOCK_MONOTONIC, &k_Time) != 0)
+        return 0; // Return 0 if the system call fails
+
+    // Convert seconds to microseconds and add the nanosecond fractional part converted to microseconds
+    return (int64_t)k_Time.tv_sec  * 1000000ULL +
+           (int64_t)k_Time.tv_nsec / 1000ULL;
+}
+
 // Convert libusb error code into a text message
 string OsLibrary::GetErrorMessage(uint32_t u32_Error)
 {
@@ -50,11 +50,13 @@ public:
     uint32_t    ReadPipeIn(uint32_t u32_Timeout, kUsbInPacket* pk_UsbInPacket);
     uint32_t    WritePipeOut(uint8_t* u8_TxData, uint32_t u32_TxLen);
     // Time
-    int64_t     GetTimestamp();
+    int64_t        GetTimestamp();
+    static int64_t GetMonotonicTime();
     // -------------------------
     inline bool      IsOpen()        { return mb_IsOpen; } 
     inline bool      HasPipeErrors() { return mu32_RxPipeErrors > 30 || mu32_TxPipeErrors > 30; }
     inline kDevInfo* DevInfo()       { return &mk_Info;  }
+    inline int64_t   GetTimestampStart() { return ms64_TimestampStart; } // GetMonotonicTime() when GetTimestamp() was zero
 
 private:
     static string ReadSysfsString(string s_Path);
@@ -67,7 +69,7 @@ private:
     bool                  mb_IsOpen;
     uint32_t              mu32_RxPipeErrors;   
     uint32_t              mu32_TxPipeErrors;   
-    int64_t               ms64_TimestampStart;
+    int64_t               ms64_TimestampStart; // in s
 };
 
 }; // namespace
\ No newline at end of file
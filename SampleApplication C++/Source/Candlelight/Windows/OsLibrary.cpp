@@ -722,20 +722,31 @@ int OsLibrary::WaitConsoleChar()
 // It is recommended to turn off transimssion of timestamps (not set GS_DevFlagTimestamp) to reduce USB traffic.
 // Then this function is used as a replacement to generate a timestamp on reception of a USB packet and when sending a packet.
 int64_t OsLibrary::GetTimestamp()
+{
+    int64_t s64_Timestamp = GetMonotonicTime();
+
+    // ms64_PerfTimeStart is set to zero when the device is opened
+    if (ms64_PerfTimeStart == 0)
+        ms64_PerfTimeStart = s64_Timestamp;
+
+    return s64_Timestamp - ms64_PerfTimeStart;
+}
+
+// Get the performance counter time in s since the computer was started. This is the same time base for all devices.
+int64_t OsLibrary::GetMonotonicTime()
 {
     static int64_t s64_Frequency = 0; 
 
     // The performance counter runs inside the CPU and the frequency is identical over all CPU cores and never changes.
     // The performance counter frequency depends on the CPU and the operating system, mostly above 3 MHz
-    if (s64_Frequency == 0 || ms64_PerfTimeStart == 0)
-    {
+    if (s64_Frequency == 0)
 	    QueryPerformanceFrequency((LARGE_INTEGER*)&s64_Frequency);
-        QueryPerformanceCounter  ((LARGE_INTEGER*)&ms64_PerfTimeStart);
-    }
 
 	int64_t s64_Counter;
 	QueryPerformanceCounter((LARGE_INTEGER*)&s64_Counter);
-	return (s64_Counter - ms64_PerfTimeStart) * 1000000 / s64_Frequency;
+
+    // Split the calculation, otherwise s64_Counter * 1000000 would overflow after some days
+    return (s64_Counter / s64_Frequency) * 1000000 + (s64_Counter % s64_Frequency) * 1000000 / s64_Frequency;
 }
 
 // Format Windows API error
@@ -61,11 +61,13 @@ public:
     uint32_t    ReadPipeIn(uint32_t u32_Timeout, kUsbInPacket* pk_UsbInPacket);
     uint32_t    WritePipeOut(uint8_t* u8_TxData, uint32_t u32_TxLen);
     // Time
-    int64_t     GetTimestamp();
+    int64_t        GetTimestamp();
+    static int64_t GetMonotonicTime();
     // -------------------------
     inline bool      IsOpen()        { return mh_WinUsb != NULL && mb_ThreadRuns; }
     inline bool      HasPipeErrors() { return mu32_RxPipeErrors > 30 || mu32_TxPipeErrors > 30; }
     inline kDevInfo* DevInfo()       { return &mk_Info; }
+    inline int64_t   GetTimestampStart() { return ms64_PerfTimeStart; } // GetMonotonicTime() when GetTimestamp() was zero
 
 private:
     static uint32_t        EnumSerialNumbers(cStringMap& i_Serials);
@@ -80,7 +82,7 @@ private:
     HANDLE                   mh_ReceiveEvent;
     HANDLE                   mh_ThreadEvent;
 
-    int64_t                  ms64_PerfTimeStart; // offset for performance timer
+    int64_t                  ms64_PerfTimeStart; // offset for performance timer in s
     uint32_t                 mu32_RxPipeErrors;   
     uint32_t                 mu32_TxPipeErrors;   
     int                      ms32_FifoCount;     // must only be accessed in critical section
@@ -0,0 +1,57 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// This file replaces STM32/CMSIS/cmsis_gcc.h when the firmware is compiled for the host computer.
+// The Cortex-M instructions are replaced by C code. Interrupts do not exist on the host.
+
+#ifndef __CMSIS_GCC_H
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+#define __ASM                        __asm
+#define __INLINE                     inline
+#define __STATIC_INLINE              static inline
+#define __STATIC_FORCEINLINE         __attribute__((always_inline)) static inline
+#define __NO_RETURN                  __attribute__((__noreturn__))
+#define __USED                       __attribute__((used))
+#define __WEAK                       __attribute__((weak))
+#define __PACKED                     __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT              struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION               union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)                 __attribute__((aligned(x)))
+#define __RESTRICT                   __restrict
+#define __COMPILER_BARRIER()         __ASM volatile("":::"memory")
+
+#define __NOP()                      __COMPILER_BARRIER()
+#define __WFI()                      __COMPILER_BARRIER()
+#define __WFE()                      __COMPILER_BARRIER()
+#define __SEV()                      __COMPILER_BARRIER()
+#define __BKPT(value)                __builtin_trap()
+
+extern uint32_t host_primask; // defined in host.c
+
+__STATIC_FORCEINLINE void     __enable_irq(void)                { host_primask = 0; }
+__STATIC_FORCEINLINE void     __disable_irq(void)               { host_primask = 1; }
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void)               { return host_primask; }
+__STATIC_FORCEINLINE void     __set_PRIMASK(uint32_t priMask)   { host_primask = priMask; }
+__STATIC_FORCEINLINE uint32_t __get_IPSR(void)                  { return 0; }
+__STATIC_FORCEINLINE uint32_t __get_MSP(void)                   { return 0; }
+__STATIC_FORCEINLINE void     __set_MSP(uint32_t topOfMainStack){ (void)topOfMainStack; }
+__STATIC_FORCEINLINE void     __ISB(void)                       { __COMPILER_BARRIER(); }
+__STATIC_FORCEINLINE void     __DSB(void)                       { __COMPILER_BARRIER(); }
+__STATIC_FORCEINLINE void     __DMB(void)                       { __COMPILER_BARRIER(); }
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value)             { return __builtin_bswap32(value); }
+__STATIC_FORCEINLINE uint32_t __REV16(uint32_t value)           { return __builtin_bswap32(value) >> 16 | __builtin_bswap32(value) << 16; }
+__STATIC_FORCEINLINE uint8_t  __CLZ(uint32_t value)             { return value ? __builtin_clz(value) : 32; }
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value)
+{
+    uint32_t result = 0;
+    for (int i=0; i<32; i++, value >>= 1) result = (result << 1) | (value & 1);
+    return result;
+}
+
+#endif // __CMSIS_GCC_H
@@ -0,0 +1,286 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Simulation of the FDCAN peripheral: the Rx FIFO's, the Tx FIFO / queue and the Tx event FIFO with 3 elements each.
+// The registers and the message RAM are real memory at the addresses of the processor (see host.c).
+// The firmware writes the registers as on the processor. sim_register_write() emulates the side effects of the hardware.
+// The test plays the CAN bus: sim_receive() stores a frame in an Rx FIFO, sim_transmit() sends the next pending Tx buffer.
+// See "STM32G4 Series - Chapter FDCAN.pdf" in subfolder "Documentation"
+
+#include "host.h"
+
+#define SIM_ELEMENTS    3  // elements in each FIFO
+#define SIM_INSTANCES   3  // FDCAN1, FDCAN2, FDCAN3
+
+typedef struct
+{
+    uint8_t  rx_get  [2];  // Rx FIFO 0 / 1
+    uint8_t  rx_count[2];
+    uint8_t  tx_put;
+    uint32_t tx_pending;   // bit mask of the Tx buffers with a pending request
+    uint8_t  tx_order[SIM_ELEMENTS]; // pending Tx buffers in the order of their requests
+    uint8_t  tx_count;
+    uint8_t  ev_get;       // Tx event FIFO
+    uint8_t  ev_count;
+} sim_instance;
+
+sim_instance sim_inst[SIM_INSTANCES];
+
+// host.c
+volatile uint32_t* host_writable(volatile uint32_t* reg);
+
+// private functions
+int  sim_get_index(uintptr_t address);
+void sim_update_status(FDCAN_GlobalTypeDef* can, sim_instance* sim);
+void sim_set_flags(FDCAN_GlobalTypeDef* can, uint32_t flags);
+
+#define SIM_WRITE(can, reg, value)   (*host_writable(&(can)->reg) = (value))
+
+// Returns the index of the FDCAN instance that contains the register or -1
+int sim_get_index(uintptr_t address)
+{
+    for (int I=0; I<SIM_INSTANCES; I++)
+    {
+        uintptr_t base = FDCAN1_BASE + I * (FDCAN2_BASE - FDCAN1_BASE);
+        if (address >= base && address < base + sizeof(FDCAN_GlobalTypeDef))
+            return I;
+    }
+    return -1;
+}
+
+// Called from host.c after the firmware has written a register in the FDCAN page
+void sim_register_write(volatile uint32_t* reg, uint32_t old_value, uint32_t new_value)
+{
+    int index = sim_get_index((uintptr_t)reg);
+    if (index < 0)
+        return; // USB packet memory or FDCAN_CONFIG
+
+    sim_instance* sim = &sim_inst[index];
+    FDCAN_GlobalTypeDef* can = (FDCAN_GlobalTypeDef*)(FDCAN1_BASE + index * (FDCAN2_BASE - FDCAN1_BASE));
+
+    if (reg == &can->IR)
+    {
+        // the interrupt flags are cleared by writing 1
+        SIM_WRITE(can, IR, old_value & ~new_value);
+    }
+    else if (reg == &can->RXF0A || reg == &can->RXF1A)
+    {
+        int F = (reg == &can->RXF0A) ? 0 : 1;
+        if (sim->rx_count[F] > 0 && new_value == sim->rx_get[F])
+        {
+            sim->rx_get[F] = (sim->rx_get[F] + 1) % SIM_ELEMENTS;
+            sim->rx_count[F] --;
+        }
+    }
+    else if (reg == &can->TXEFA)
+    {
+        if (sim->ev_count > 0 && new_value == sim->ev_get)
+        {
+            sim->ev_get = (sim->ev_get + 1) % SIM_ELEMENTS;
+            sim->ev_count --;
+        }
+    }
+    else if (reg == &can->TXBAR)
+    {
+        for (uint8_t B=0; B<SIM_ELEMENTS; B++)
+        {
+            if ((new_value & (1 << B)) && !(sim->tx_pending & (1 << B)))
+            {
+                sim->tx_pending |= 1 << B;
+                sim->tx_order[sim->tx_count ++] = B;
+            }
+        }
+        SIM_WRITE(can, TXBAR, 0);
+    }
+    else if (reg == &can->TXBCR)
+    {
+        // cancel the pending requests
+        uint32_t cancel = new_value & sim->tx_pending;
+        sim->tx_pending &= ~cancel;
+        uint8_t count = 0;
+        for (uint8_t i=0; i<sim->tx_count; i++)
+        {
+            if (!(cancel & (1 << sim->tx_order[i])))
+                sim->tx_order[count ++] = sim->tx_order[i];
+        }
+        sim->tx_count = count;
+        SIM_WRITE(can, TXBCR, 0);
+        SIM_WRITE(can, TXBCF, can->TXBCF | cancel);
+        if (cancel) sim_set_flags(can, FDCAN_IR_TCF);
+    }
+    else if (reg == &can->CCCR)
+    {
+        // A reset (RCC) or the initialization clears the state of the FIFO's
+        if (new_value & FDCAN_CCCR_INIT)
+            memset(sim, 0, sizeof(sim_instance));
+    }
+    else
+    {
+        return;
+    }
+    sim_update_status(can, sim);
+}
+
+// Write the fill levels and indexes into the status registers
+void sim_update_status(FDCAN_GlobalTypeDef* can, sim_instance* sim)
+{
+    uint32_t put0 = (sim->rx_get[0] + sim->rx_count[0]) % SIM_ELEMENTS;
+    uint32_t put1 = (sim->rx_get[1] + sim->rx_count[1]) % SIM_ELEMENTS;
+    SIM_WRITE(can, RXF0S, sim->rx_count[0] | (sim->rx_get[0] << FDCAN_RXF0S_F0GI_Pos) | (put0 << FDCAN_RXF0S_F0PI_Pos) |
+                          (sim->rx_count[0] == SIM_ELEMENTS ? FDCAN_RXF0S_F0F : 0));
+    SIM_WRITE(can, RXF1S, sim->rx_count[1] | (sim->rx_get[1] << FDCAN_RXF1S_F1GI_Pos) | (put1 << FDCAN_RXF1S_F1PI_Pos) |
+                          (sim->rx_count[1] == SIM_ELEMENTS ? FDCAN_RXF1S_F1F : 0));
+
+    // The put index is the next free buffer. In FIFO mode the get index is the oldest request.
+    uint32_t free = SIM_ELEMENTS - sim->tx_count;
+    for (int i=0; i<SIM_ELEMENTS && free > 0 && (sim->tx_pending & (1 << sim->tx_put)); i++)
+    {
+        sim->tx_put = (sim->tx_put + 1) % SIM_ELEMENTS;
+    }
+    uint32_t tx_get = sim->tx_count > 0 ? sim->tx_order[0] : sim->tx_put;
+    SIM_WRITE(can, TXFQS, free | (tx_get << FDCAN_TXFQS_TFGI_Pos) | (sim->tx_put << FDCAN_TXFQS_TFQPI_Pos) |
+                          (free == 0 ? FDCAN_TXFQS_TFQF : 0));
+    SIM_WRITE(can, TXBRP, sim->tx_pending);
+
+    uint32_t ev_put = (sim->ev_get + sim->ev_count) % SIM_ELEMENTS;
+    SIM_WRITE(can, TXEFS, sim->ev_count | (sim->ev_get << FDCAN_TXEFS_EFGI_Pos) | (ev_put << FDCAN_TXEFS_EFPI_Pos) |
+                          (sim->ev_count == SIM_ELEMENTS ? FDCAN_TXEFS_EFF : 0));
+}
+
+void sim_set_flags(FDCAN_GlobalTypeDef* can, uint32_t flags)
+{
+    SIM_WRITE(can, IR, can->IR | flags);
+}
+
+// ---------------------------------------------------------------------------------------------
+
+sim_frame sim_make_frame(uint32_t ID, bool extended, uint8_t DLC)
+{
+    sim_frame frame = {0};
+    frame.ID       = ID;
+    frame.extended = extended;
+    frame.DLC      = DLC;
+    frame.filter   = 0;
+    for (int B=0; B<64; B++)
+    {
+        frame.data[B] = (uint8_t)(ID + B);
+    }
+    return frame;
+}
+
+// A frame has been received from the CAN bus and is stored in Rx FIFO 0 or 1.
+// Returns false if the FIFO is full: the frame is lost and the flag "message lost" is set.
+bool sim_receive(uint8_t channel, uint32_t rx_fifo, sim_frame* frame)
+{
+    FDCAN_HandleTypeDef* handle = can_get_handle(channel);
+    FDCAN_GlobalTypeDef* can    = handle->Instance;
+    sim_instance* sim = &sim_inst[sim_get_index((uintptr_t)can)];
+
+    int F = (rx_fifo == FDCAN_RX_FIFO0) ? 0 : 1;
+    if (sim->rx_count[F] == SIM_ELEMENTS)
+    {
+        sim_set_flags(can, F == 0 ? FDCAN_IR_RF0L : FDCAN_IR_RF1L);
+        return false;
+    }
+
+    uint32_t  put     = (sim->rx_get[F] + sim->rx_count[F]) % SIM_ELEMENTS;
+    uint32_t  address = (F == 0 ? handle->msgRam.RxFIFO0SA : handle->msgRam.RxFIFO1SA) + put * CAN_ELEMENT_SIZE;
+    uint32_t* element = (uint32_t*)(uintptr_t)address;
+
+    // R0 = ESI, XTD, RTR, ID
+    // R1 = ANMF, FIDX, FDF, BRS, DLC, RXTS
+    element[0] = (frame->extended ? FDCAN_EXTENDED_ID | frame->ID : frame->ID << 18) | (frame->remote ? FDCAN_REMOTE_FRAME : 0);
+    element[1] = (frame->filter == 0xFF ? (1u << 31) : ((uint32_t)frame->filter << 24)) | (frame->FD ? FDCAN_FD_CAN : 0) |
+                 (frame->BRS ? FDCAN_BRS_ON : 0) | ((uint32_t)frame->DLC << 16) | frame->timestamp;
+    memcpy(&element[2], frame->data, 64);
+
+    sim->rx_count[F] ++;
+    sim_update_status(can, sim);
+    sim_set_flags(can, F == 0 ? FDCAN_IR_RF0N : FDCAN_IR_RF1N);
+    return true;
+}
+
+// Send the next pending Tx buffer to the CAN bus: the oldest in FIFO mode, the one with the highest priority in queue mode.
+// The Tx event is stored with the timestamp in TIM3->CNT. Returns false if no Tx request is pending.
+bool sim_transmit(uint8_t channel, sim_frame* frame)
+{
+    FDCAN_HandleTypeDef* handle = can_get_handle(channel);
+    FDCAN_GlobalTypeDef* can    = handle->Instance;
+    sim_instance* sim = &sim_inst[sim_get_index((uintptr_t)can)];
+
+    if (sim->tx_count == 0)
+        return false;
+
+    int index = 0;
+    if (can->TXBC & FDCAN_TXBC_TFQM)
+    {
+        uint32_t best = 0xFFFFFFFF;
+        for (int i=0; i<sim->tx_count; i++)
+        {
+            uint32_t* T = (uint32_t*)(uintptr_t)(handle->msgRam.TxFIFOQSA + sim->tx_order[i] * CAN_ELEMENT_SIZE);
+            FDCAN_TxHeaderTypeDef header = {0};
+            header.IdType      = T[0] & FDCAN_EXTENDED_ID;
+            header.Identifier  = header.IdType ? (T[0] & 0x1FFFFFFF) : ((T[0] >> 18) & 0x7FF);
+            header.TxFrameType = T[0] & FDCAN_REMOTE_FRAME;
+            if (can_arbitration_priority(&header) < best)
+            {
+                best  = can_arbitration_priority(&header);
+                index = i;
+            }
+        }
+    }
+
+    uint8_t buffer = sim->tx_order[index];
+    memmove(&sim->tx_order[index], &sim->tx_order[index + 1], sim->tx_count - index - 1);
+    sim->tx_count --;
+    sim->tx_pending &= ~(1 << buffer);
+
+    // T0 = ESI, XTD, RTR, ID
+    // T1 = MM, EFC, FDF, BRS, DLC
+    uint32_t* T = (uint32_t*)(uintptr_t)(handle->msgRam.TxFIFOQSA + buffer * CAN_ELEMENT_SIZE);
+    sim_frame sent = {0};
+    sent.extended  = (T[0] & FDCAN_EXTENDED_ID) != 0;
+    sent.ID        = sent.extended ? (T[0] & 0x1FFFFFFF) : ((T[0] >> 18) & 0x7FF);
+    sent.remote    = (T[0] & FDCAN_REMOTE_FRAME) != 0;
+    sent.FD        = (T[1] & FDCAN_FD_CAN) != 0;
+    sent.BRS       = (T[1] & FDCAN_BRS_ON) != 0;
+    sent.DLC       = (T[1] >> 16) & 0xF;
+    sent.marker    = T[1] >> 24;
+    sent.timestamp = (uint16_t)TIM3->CNT;
+    memcpy(sent.data, &T[2], 64);
+    if (frame) *frame = sent;
+
+    if ((T[1] & FDCAN_STORE_TX_EVENTS) && sim->ev_count < SIM_ELEMENTS)
+    {
+        // E0 = ESI, XTD, RTR, ID
+        // E1 = MM, ET, FDF, BRS, DLC, TXTS
+        uint32_t  put   = (sim->ev_get + sim->ev_count) % SIM_ELEMENTS;
+        uint32_t* event = (uint32_t*)(uintptr_t)(handle->msgRam.TxEventFIFOSA + put * 2 * 4);
+        event[0] = T[0];
+        event[1] = (T[1] & 0xFF3F0000) | FDCAN_TX_EVENT | sent.timestamp;
+        sim->ev_count ++;
+        sim_set_flags(can, FDCAN_IR_TEFN);
+    }
+
+    SIM_WRITE(can, TXBTO, can->TXBTO | (1 << buffer));
+    sim_update_status(can, sim);
+    sim_set_flags(can, FDCAN_IR_TC | (sim->tx_count == 0 ? FDCAN_IR_TFE : 0));
+    return true;
+}
+
+// Returns the count of Tx buffers with a pending request
+uint32_t sim_tx_pending(uint8_t channel)
+{
+    return sim_inst[sim_get_index((uintptr_t)can_get_handle(channel)->Instance)].tx_count;
+}
+
+// Execute the FDCAN interrupt line 0 of the channel if it is not disabled (__disable_irq)
+void sim_interrupt(uint8_t channel)
+{
+    extern uint32_t host_primask;
+    if (host_primask == 0)
+        HAL_FDCAN_IRQHandler(can_get_handle(channel));
+}
@@ -0,0 +1,200 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Runs the firmware on a Linux x86-64 host computer (see Tests/Makefile)
+
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include "host.h"
+#include "buffer.h"
+#include "system.h"
+
+#if !defined(__x86_64__) || !defined(__linux__)
+    #error "The host tests trap the register writes with the x86-64 trap flag on Linux"
+#endif
+
+// The FDCAN registers of all instances are in one page (FDCAN1 = 0x40006400 ... FDCAN3 = 0x40006C00)
+#define FDCAN_PAGE      (FDCAN1_BASE & ~0xFFFUL)
+#define PAGE_SIZE       0x1000
+#define EFLAGS_TRAP     0x100
+
+extern uint32_t          canfd_clock;    // system.c
+extern volatile uint32_t timestamp_wrap; // system.c
+
+uint32_t host_primask = 0; // used by __disable_irq() in cmsis_gcc.h
+int      host_checks   = 0;
+int      host_failures = 0;
+
+uint8_t  host_usb_data[0x10000]; // all data that the firmware has sent to the host
+uint32_t host_usb_length = 0;
+
+uint8_t*           fdcan_alias;    // writable view of the FDCAN page
+volatile uint32_t* trap_register;  // register that is being written
+uint32_t           trap_old_value; // value before the write
+
+// private functions
+void host_map(uintptr_t address, size_t size, uint8_t fill);
+void host_segv_handler(int sig, siginfo_t* info, void* context);
+void host_trap_handler(int sig, siginfo_t* info, void* context);
+
+// Map the memory regions that the firmware and the HAL access at fixed addresses
+void host_init()
+{
+    host_map(PERIPH_BASE, 0x30000,  0x00); // APB, AHB1 (TIM3, FDCAN, RCC, FLASH, ...), message RAM
+    host_map(0x48000000,  0x2000,   0x00); // GPIO STM32G4xx
+    host_map(0x50000000,  0x2000,   0x00); // GPIO STM32G0xx
+    host_map(0x08000000,  0x80000,  0xFF); // erased flash
+    host_map(0x1FFF0000,  0x10000,  0x00); // system memory, unique ID
+    host_map(0xE0000000,  0x100000, 0x00); // Cortex core: NVIC, SysTick, DWT, SCB
+
+    // Replace the FDCAN page by a shared memory that is mapped twice: read-only for the firmware, writable for the simulator.
+    int fd = memfd_create("fdcan", 0);
+    if (fd < 0 || ftruncate(fd, PAGE_SIZE) != 0)
+    {
+        perror("memfd_create");
+        exit(2);
+    }
+    fdcan_alias = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (fdcan_alias == MAP_FAILED ||
+        mmap((void*)FDCAN_PAGE, PAGE_SIZE, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        perror("mmap FDCAN");
+        exit(2);
+    }
+
+    struct sigaction action = {0};
+    action.sa_flags     = SA_SIGINFO | SA_NODEFER;
+    action.sa_sigaction = host_segv_handler;
+    sigaction(SIGSEGV, &action, NULL);
+    action.sa_sigaction = host_trap_handler;
+    sigaction(SIGTRAP, &action, NULL);
+
+    canfd_clock = 160000000; // set by system_init() on the STM32G4xx
+    buf_init();
+    can_init();
+}
+
+void host_map(uintptr_t address, size_t size, uint8_t fill)
+{
+    void* mem = mmap((void*)address, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (mem != (void*)address)
+    {
+        fprintf(stderr, "Cannot map 0x%08lX\n", (unsigned long)address);
+        exit(2);
+    }
+    memset(mem, fill, size);
+}
+
+// A write to the read-only FDCAN page: allow the write, execute one instruction and then call the simulator
+void host_segv_handler(int sig, siginfo_t* info, void* context)
+{
+    uintptr_t address = (uintptr_t)info->si_addr;
+    if (address < FDCAN_PAGE || address >= FDCAN_PAGE + PAGE_SIZE)
+    {
+        fprintf(stderr, "Segmentation fault at 0x%lX\n", (unsigned long)address);
+        signal(SIGSEGV, SIG_DFL);
+        return; // a real crash
+    }
+
+    trap_register  = (volatile uint32_t*)(address & ~3UL);
+    trap_old_value = *trap_register;
+    mprotect((void*)FDCAN_PAGE, PAGE_SIZE, PROT_READ | PROT_WRITE);
+    ((ucontext_t*)context)->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TRAP;
+}
+
+// The write instruction has been executed
+void host_trap_handler(int sig, siginfo_t* info, void* context)
+{
+    ((ucontext_t*)context)->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TRAP;
+    mprotect((void*)FDCAN_PAGE, PAGE_SIZE, PROT_READ);
+    sim_register_write(trap_register, trap_old_value, *trap_register);
+}
+
+// Benchmarks: enable = false lets the firmware write the FDCAN registers without a trap.
+// The simulator does not see these writes, so the FIFO's do not change (the same element is read or written again).
+void host_trap_writes(bool enable)
+{
+    mprotect((void*)FDCAN_PAGE, PAGE_SIZE, enable ? PROT_READ : PROT_READ | PROT_WRITE);
+}
+
+// Returns the writable view of an FDCAN register
+volatile uint32_t* host_writable(volatile uint32_t* reg)
+{
+    return (volatile uint32_t*)(fdcan_alias + ((uintptr_t)reg - FDCAN_PAGE));
+}
+
+// Print the result of all checks. Returns the exit code of the test.
+int host_result(const char* test_name)
+{
+    printf("%s: %d checks, %d failed\n", test_name, host_checks, host_failures);
+    return host_failures > 0 ? 1 : 0;
+}
+
+// Open a channel with 500 kBaud nominal bitrate and for CAN FD with 2 MBaud data bitrate (160 MHz CAN clock)
+void host_open_channel(uint8_t channel, uint32_t user_flags, bool FD)
+{
+    GLB_UserFlags[channel] = user_flags;
+    can_set_bit_timing(channel, false, 20, 13, 2, 2); // 160 MHz / 20 / 16 = 500 kBaud
+    if (FD) can_set_bit_timing(channel, true, 5, 13, 2, 2); // 160 MHz / 5 / 16 = 2 MBaud
+    else    can_getBitrate(channel, true)->Brp = 0;      // classic CAN
+    if (can_open(channel, FDCAN_MODE_NORMAL) != FBK_Success)
+    {
+        fprintf(stderr, "can_open(%u) failed\n", channel);
+        exit(2);
+    }
+}
+
+// Set the 1 us timestamp: the low 16 bits are the counter of Timer 3, the high bits the wrap around counter
+void host_set_timer(uint32_t timestamp)
+{
+    TIM3->CNT      = timestamp & 0xFFFF;
+    TIM3->SR       = 0;
+    timestamp_wrap = timestamp >> 16;
+}
+
+uint64_t host_nanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// ---------------------------------------------------------------------------------------------
+
+// Overwrite weak HAL functions: there is no SysTick interrupt on the host. The tests set uwTick.
+uint32_t HAL_GetTick(void)
+{
+    return uwTick;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    uwTick += Delay;
+}
+
+#if defined(Candlelight)
+    uint8_t USB_IRQ_DataIn(uint8_t epnum); // usb_class.c
+
+    // The test binaries are linked with --wrap=USBD_LL_Transmit: there is no USB peripheral on the host.
+    // The data for the IN endpoints is appended to host_usb_data and the transfer completes immediately.
+    USBD_StatusTypeDef __wrap_USBD_LL_Transmit(uint8_t ep_addr, uint8_t* pbuf, uint16_t size)
+    {
+        if ((ep_addr & 0x7F) == 0)
+            return USBD_OK;
+
+        if (host_usb_length + size > sizeof(host_usb_data))
+            host_usb_length = 0;
+
+        memcpy(host_usb_data + host_usb_length, pbuf, size);
+        host_usb_length += size;
+        USB_IRQ_DataIn(ep_addr);
+        return USBD_OK;
+    }
+#endif
@@ -0,0 +1,71 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// The host tests compile the unmodified firmware for Linux x86-64 (see Tests/Makefile).
+// The peripheral registers, the FDCAN message RAM and the system memory are mapped at their real addresses.
+// The FDCAN registers are write protected: each write is trapped, executed and then passed to the FDCAN simulator
+// which emulates the side effects of the hardware (Rx FIFO acknowledge, Tx buffer add request, Tx event FIFO, ...)
+// Interrupts do not exist on the host. The tests call the interrupt handlers themselves.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "settings.h"
+#include "can.h"
+#include "utils.h"
+
+#define CAN_ELEMENT_SIZE    (18 * 4)  // Rx FIFO and Tx FIFO elements in the message RAM (see can.c)
+
+extern eUserFlags GLB_UserFlags[CHANNEL_COUNT]; // can.c
+
+// A frame that the simulator has received from or sent to the CAN bus
+typedef struct
+{
+    uint32_t ID;
+    bool     extended;
+    bool     remote;
+    bool     FD;
+    bool     BRS;
+    uint8_t  DLC;
+    uint8_t  marker;     // Tx: message marker
+    uint8_t  filter;     // Rx: filter index (0x7F = no filter matched)
+    uint16_t timestamp;  // Rx: 16 bit timestamp, Tx: taken from TIM3->CNT when the frame is sent
+    uint8_t  data[64];
+} sim_frame;
+
+// ------------------------------ host.c -------------------------------------
+
+extern int      host_checks;
+extern int      host_failures;
+extern uint8_t  host_usb_data[];  // Candlelight: the data sent to the host on the IN endpoints
+extern uint32_t host_usb_length;
+
+// Print the failed condition and continue with the next check
+#define CHECK(cond)  do { host_checks ++; if (!(cond)) { host_failures ++; \
+                          printf("    FAILED: %s (%s line %d)\n", #cond, __FILE__, __LINE__); } } while (0)
+
+#define CHECK_EQUAL(actual, expected)  do { long long a_ = (long long)(actual), e_ = (long long)(expected); host_checks ++; \
+                          if (a_ != e_) { host_failures ++; printf("    FAILED: %s = %lld, expected %lld (%s line %d)\n", \
+                          #actual, a_, e_, __FILE__, __LINE__); } } while (0)
+
+void     host_init();
+int      host_result(const char* test_name);
+void     host_open_channel(uint8_t channel, uint32_t user_flags, bool FD);
+void     host_set_timer(uint32_t timestamp);
+void     host_trap_writes(bool enable);
+uint64_t host_nanoseconds();
+
+// ------------------------------ fdcan_sim.c --------------------------------
+
+bool     sim_receive (uint8_t channel, uint32_t rx_fifo, sim_frame* frame);
+bool     sim_transmit(uint8_t channel, sim_frame* frame);
+uint32_t sim_tx_pending(uint8_t channel);
+void     sim_interrupt(uint8_t channel);
+void     sim_register_write(volatile uint32_t* reg, uint32_t old_value, uint32_t new_value);
+sim_frame sim_make_frame(uint32_t ID, bool extended, uint8_t DLC);
@@ -0,0 +1,154 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Benchmark of the message RAM access: can_read_rx_element() / can_write_tx_element() compared with
+// HAL_FDCAN_GetRxMessage() / HAL_FDCAN_AddMessageToTxFifoQ() for a classic frame (8 bytes) and a CAN FD frame (64 bytes).
+// The times are measured on the host computer, so only the ratio is meaningful for the STM32.
+// The Cortex M0+ (STM32G0xx) has no DWT cycle counter, so the same code cannot be measured on all processors.
+// Both functions must return the same header and data.
+
+#include "host.h"
+
+#define LOOPS   500000
+#define REPEAT  5       // the fastest of 5 runs is taken
+
+extern can_class can_inst[CHANNEL_COUNT]; // can.c
+bool can_read_rx_element (can_class* inst, uint32_t rx_fifo, rx_packet* packet);
+bool can_write_tx_element(can_class* inst, FDCAN_TxHeaderTypeDef* tx_header, uint8_t* tx_data);
+
+// Time of one call in nanoseconds
+double elapsed(uint64_t start)
+{
+    return (double)(host_nanoseconds() - start) / LOOPS;
+}
+
+void print_result(const char* direction, int bytes, const char* fast_name, double fast, const char* hal_name, double hal)
+{
+    printf("    %s %2d bytes: %-20s %5.1f ns, %-29s %5.1f ns (%.1f x)\n", direction, bytes, fast_name, fast, hal_name, hal, hal / fast);
+}
+
+void benchmark_rx(uint8_t DLC)
+{
+    can_class*           inst   = &can_inst[0];
+    FDCAN_HandleTypeDef* handle = can_get_handle(0);
+
+    sim_frame frame = sim_make_frame(0x1ABCDE12, true, DLC);
+    frame.FD  = DLC > 8;
+    frame.BRS = DLC > 8;
+    CHECK(sim_receive(0, FDCAN_RX_FIFO0, &frame));
+
+    // The acknowledge is not trapped: the element stays in the FIFO
+    host_trap_writes(false);
+    rx_packet packet;
+    double fast = 1e9;
+    for (int R=0; R<REPEAT; R++)
+    {
+        uint64_t start = host_nanoseconds();
+        for (int i=0; i<LOOPS; i++)
+        {
+            can_read_rx_element(inst, FDCAN_RX_FIFO0, &packet);
+        }
+        fast = MIN(fast, elapsed(start));
+    }
+
+    FDCAN_RxHeaderTypeDef header;
+    uint8_t data[64];
+    double hal = 1e9;
+    for (int R=0; R<REPEAT; R++)
+    {
+        uint64_t start = host_nanoseconds();
+        for (int i=0; i<LOOPS; i++)
+        {
+            HAL_FDCAN_GetRxMessage(handle, FDCAN_RX_FIFO0, &header, data);
+        }
+        hal = MIN(hal, elapsed(start));
+    }
+    host_trap_writes(true);
+    sim_interrupt(0); // now the element is removed from the FIFO
+    can_process(0, uwTick);
+
+    int bytes = utils_dlc_to_byte_count(DLC);
+    CHECK_EQUAL(packet.header.Identifier,    header.Identifier);
+    CHECK_EQUAL(packet.header.IdType,        header.IdType);
+    CHECK_EQUAL(packet.header.DataLength,    header.DataLength);
+    CHECK_EQUAL(packet.header.FDFormat,      header.FDFormat);
+    CHECK_EQUAL(packet.header.BitRateSwitch, header.BitRateSwitch);
+    CHECK_EQUAL(packet.header.RxTimestamp,   header.RxTimestamp);
+    CHECK(memcmp(packet.data, data, bytes) == 0);
+    CHECK(memcmp(packet.data, frame.data, bytes) == 0);
+
+    print_result("Rx", bytes, "can_read_rx_element", fast, "HAL_FDCAN_GetRxMessage", hal);
+}
+
+void benchmark_tx(uint8_t DLC)
+{
+    can_class*           inst   = &can_inst[0];
+    FDCAN_HandleTypeDef* handle = can_get_handle(0);
+    int bytes = utils_dlc_to_byte_count(DLC);
+
+    uint8_t data[64];
+    for (int i=0; i<64; i++)
+    {
+        data[i] = i * 3;
+    }
+    FDCAN_TxHeaderTypeDef header = {0};
+    header.Identifier         = 0x123;
+    header.IdType             = FDCAN_STANDARD_ID;
+    header.TxFrameType        = FDCAN_DATA_FRAME;
+    header.DataLength         = DLC;
+    header.FDFormat           = DLC > 8 ? FDCAN_FD_CAN : FDCAN_CLASSIC_CAN;
+    header.BitRateSwitch      = DLC > 8 ? FDCAN_BRS_ON : FDCAN_BRS_OFF;
+    header.TxEventFifoControl = FDCAN_STORE_TX_EVENTS;
+    header.MessageMarker      = 5;
+
+    // The add request is not trapped: the same Tx buffer is written again
+    host_trap_writes(false);
+    uint32_t  put     = (handle->Instance->TXFQS & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos;
+    uint32_t* element = (uint32_t*)(handle->msgRam.TxFIFOQSA + put * CAN_ELEMENT_SIZE);
+    double fast = 1e9;
+    for (int R=0; R<REPEAT; R++)
+    {
+        uint64_t start = host_nanoseconds();
+        for (int i=0; i<LOOPS; i++)
+        {
+            can_write_tx_element(inst, &header, data);
+        }
+        fast = MIN(fast, elapsed(start));
+    }
+
+    uint32_t fast_element[18];
+    memcpy(fast_element, element, sizeof(fast_element));
+    memset(element, 0, CAN_ELEMENT_SIZE);
+
+    double hal = 1e9;
+    for (int R=0; R<REPEAT; R++)
+    {
+        uint64_t start = host_nanoseconds();
+        for (int i=0; i<LOOPS; i++)
+        {
+            HAL_FDCAN_AddMessageToTxFifoQ(handle, &header, data);
+        }
+        hal = MIN(hal, elapsed(start));
+    }
+    host_trap_writes(true);
+
+    CHECK(memcmp(fast_element, element, 8 + bytes) == 0);
+
+    print_result("Tx", bytes, "can_write_tx_element", fast, "HAL_FDCAN_AddMessageToTxFifoQ", hal);
+}
+
+int main()
+{
+    host_init();
+    printf("  message RAM access\n");
+    host_open_channel(0, 0, true);
+    benchmark_rx(8);
+    benchmark_rx(15);
+    benchmark_tx(8);
+    benchmark_tx(15);
+    can_close(0);
+    return host_result("test_benchmark");
+}
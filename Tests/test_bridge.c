@@ -0,0 +1,182 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Bridge routing table (see can_compile_bridge_routes() and can_get_bridge_route())
+// - random sets of 11 bit and 29 bit pass and block filters: the route of random IDs and of IDs that match a filter
+//   must be the same as a linear scan of all bridge filters (the algorithm before the routing table existed)
+// - frames per second that are routed by can_get_bridge_route() compared with the linear scan for 20 and 128 filters.
+//   The times are measured on the host computer, so only the ratio is meaningful for the STM32.
+
+#include "host.h"
+
+#define LOOKUPS     1000000
+#define SETS        50      // random filter sets
+#define IDS_PER_SET 20000
+#define REPEAT      5       // the fastest of 5 runs is taken
+
+extern can_class can_inst[CHANNEL_COUNT]; // can.c
+void    can_compile_bridge_routes(can_class* inst);
+uint8_t can_get_bridge_route(can_class* inst, bool extended, uint32_t ID);
+
+// Masks with groups of filters: exact ID, low nibble / low byte ignored, J1939 PGN, only the high bits
+const uint32_t STD_MASKS[] = { 0x7FF, 0x7F0, 0x700, 0x0FF };
+const uint32_t EXT_MASKS[] = { 0x1FFFFFFF, 0x1FFFFF00, 0x03FFFF00, 0x1FFF0000, 0x000000FF };
+
+uint32_t random_state = 8150;
+
+uint32_t random_next()
+{
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 3; // the low bits of this generator have a short period
+}
+
+// The routing as it was done before the routing table: all bridge filters are compared with the ID
+uint8_t linear_route(can_class* inst, bool extended, uint32_t ID)
+{
+    uint8_t pass  = 0;
+    uint8_t block = 0;
+    for (int F=0; F<MAX_BRIDGE_FILTERS; F++)
+    {
+        brg_filter* cur_filter = &inst->bridge_filters[F];
+        if (cur_filter->enabled && cur_filter->extended == extended && (ID & cur_filter->mask) == cur_filter->filter)
+        {
+            if (cur_filter->block) block |= 1 << cur_filter->dest_chan;
+            else                   pass  |= 1 << cur_filter->dest_chan;
+        }
+    }
+    return pass & ~block;
+}
+
+// Set 'count' random bridge filters from channel 0 to channel 1, every 4th filter is a block filter.
+// Some filters are set twice to test routes that combine several filters.
+void set_random_filters(int count, bool extended_only)
+{
+    CHECK_EQUAL(can_set_bridge_filter(0, 1, 0xFF, false, false, false, 0, 0), FBK_Success);
+    for (int F=0; F<count; F++)
+    {
+        bool     extended = extended_only || (random_next() & 1);
+        uint32_t mask     = extended ? EXT_MASKS[random_next() % 5] : STD_MASKS[random_next() % 4];
+        uint32_t filter   = random_next() & (extended ? 0x1FFFFFFF : 0x7FF);
+        bool     block    = random_next() % 4 == 0;
+        if (F > 0 && random_next() % 8 == 0) // the same filter and mask as the previous one
+        {
+            brg_filter* prev = &can_inst[0].bridge_filters[F - 1];
+            extended = prev->extended;
+            filter   = prev->filter;
+            mask     = prev->mask;
+        }
+        CHECK_EQUAL(can_set_bridge_filter(0, 1, F, true, extended, block, filter, mask), FBK_Success);
+    }
+    can_compile_bridge_routes(&can_inst[0]);
+}
+
+// A random ID or an ID that matches a random filter
+uint32_t random_id(bool extended, int filter_count)
+{
+    uint32_t maximum = extended ? 0x1FFFFFFF : 0x7FF;
+    uint32_t ID      = random_next() & maximum;
+    if (random_next() & 1)
+    {
+        brg_filter* cur_filter = &can_inst[0].bridge_filters[random_next() % filter_count];
+        ID = cur_filter->filter | (ID & ~cur_filter->mask & maximum);
+    }
+    return ID;
+}
+
+void test_routes()
+{
+    printf("  %d random filter sets compared with a linear scan\n", SETS);
+    can_class* inst = &can_inst[0];
+    int wrong    = 0;
+    int forwards = 0;
+    for (int S=0; S<SETS; S++)
+    {
+        int filter_count = S == 0 ? 1 : 1 + random_next() % MAX_BRIDGE_FILTERS;
+        set_random_filters(filter_count, false);
+        CHECK(inst->route_ext_count <= filter_count);
+        CHECK(inst->route_group_count <= 5);
+
+        for (int i=0; i<IDS_PER_SET; i++)
+        {
+            bool     extended = random_next() & 1;
+            uint32_t ID       = random_id(extended, filter_count);
+            uint8_t  route    = can_get_bridge_route(inst, extended, ID);
+            if (route != linear_route(inst, extended, ID))
+                wrong ++;
+            if (route != 0)
+                forwards ++;
+        }
+    }
+    CHECK_EQUAL(wrong, 0);
+    CHECK(forwards > SETS * IDS_PER_SET / 10); // the IDs that match a filter are not all blocked
+
+    // All 2048 IDs with a full set of 11 bit filters
+    set_random_filters(MAX_BRIDGE_FILTERS, false);
+    wrong = 0;
+    for (uint32_t ID=0; ID<0x800; ID++)
+    {
+        if (can_get_bridge_route(inst, false, ID) != linear_route(inst, false, ID))
+            wrong ++;
+    }
+    CHECK_EQUAL(wrong, 0);
+
+    // Clearing all filters leaves an empty routing table
+    CHECK_EQUAL(can_set_bridge_filter(0, 1, 0xFF, false, false, false, 0, 0), FBK_Success);
+    can_compile_bridge_routes(inst);
+    CHECK_EQUAL(inst->route_ext_count, 0);
+    CHECK_EQUAL(can_get_bridge_route(inst, false, 0x123), 0);
+    CHECK_EQUAL(can_get_bridge_route(inst, true,  0x18DA00F1), 0);
+}
+
+// Frames per second routed by can_get_bridge_route() or by the linear scan, the fastest of 5 runs
+double frames_per_second(bool extended, bool linear, uint32_t* IDs, uint32_t count)
+{
+    can_class* inst   = &can_inst[0];
+    uint32_t   routed = 0;
+    double     best   = 1e9;
+    for (int R=0; R<REPEAT; R++)
+    {
+        uint64_t start = host_nanoseconds();
+        for (int i=0; i<LOOKUPS; i++)
+        {
+            uint32_t ID = IDs[i % count];
+            routed += linear ? linear_route(inst, extended, ID) : can_get_bridge_route(inst, extended, ID);
+        }
+        best = MIN(best, (double)(host_nanoseconds() - start) / LOOKUPS);
+    }
+    CHECK(routed > 0);
+    return 1e9 / best;
+}
+
+void benchmark(int filter_count, bool extended)
+{
+    static uint32_t IDs[4096];
+    set_random_filters(filter_count, extended);
+    for (int i=0; i<4096; i++)
+    {
+        IDs[i] = random_id(extended, filter_count);
+    }
+    double table  = frames_per_second(extended, false, IDs, 4096);
+    double linear = frames_per_second(extended, true,  IDs, 4096);
+    printf("    %3d filters %s: routing table %6.1f M frames/s, linear scan %6.1f M frames/s (%.1f x), %d groups\n",
+           filter_count, extended ? "29 bit" : "11 bit", table / 1e6, linear / 1e6, table / linear,
+           extended ? can_inst[0].route_group_count : 0);
+}
+
+int main()
+{
+    host_init();
+    test_routes();
+
+    printf("  frames per second routed from channel 0 to channel 1\n");
+    benchmark(20,  false);
+    benchmark(20,  true);
+    benchmark(MAX_BRIDGE_FILTERS, false);
+    benchmark(MAX_BRIDGE_FILTERS, true);
+
+    CHECK_EQUAL(can_set_bridge_filter(0, 1, 0xFF, false, false, false, 0, 0), FBK_Success);
+    return host_result("test_bridge");
+}
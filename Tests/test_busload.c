@@ -0,0 +1,104 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Exact bus load: can_calc_exact_bit_count() compared with reference vectors.
+// The expected bit counts were calculated with a bit by bit model of ISO 11898-1:2015 that builds the complete frame
+// (SOF ... CRC including the CRC-15), inserts the dynamic stuff bits and adds the fixed stuff bits of CAN FD.
+// All counts include CRC delimiter, ACK, EOF and the inter frame space (13 bits).
+
+#include "host.h"
+
+extern can_class can_inst[CHANNEL_COUNT]; // can.c
+uint32_t can_calc_exact_bit_count(can_class* inst, uint32_t Identifier, uint32_t IdType, uint32_t FrameType, uint32_t DataLength,
+                                  uint32_t FDFormat, uint32_t BitRateSwitch, uint32_t ErrorStateIndicator, uint8_t* data);
+
+// Bit count of a frame on channel 0
+uint32_t bit_count(uint32_t ID, bool extended, bool remote, bool FD, bool BRS, uint8_t DLC, uint8_t* data)
+{
+    return can_calc_exact_bit_count(&can_inst[0], ID, extended ? FDCAN_EXTENDED_ID  : FDCAN_STANDARD_ID,
+                                                      remote   ? FDCAN_REMOTE_FRAME : FDCAN_DATA_FRAME, DLC,
+                                                      FD       ? FDCAN_FD_CAN       : FDCAN_CLASSIC_CAN,
+                                                      BRS      ? FDCAN_BRS_ON       : FDCAN_BRS_OFF, FDCAN_ESI_ACTIVE, data);
+}
+
+void test_classic()
+{
+    printf("  classic frames\n");
+    uint8_t data[8] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+    CHECK_EQUAL(bit_count(0x123, false, false, false, false, 8, data), 119); // 8 stuff bits
+
+    uint8_t data_ext[4] = { 0xAA, 0x55, 0x00, 0xFF };
+    CHECK_EQUAL(bit_count(0x1ABCDE12, true, false, false, false, 4, data_ext), 103); // 4 stuff bits
+
+    // Remote frames have no data field, but the DLC is transmitted
+    CHECK_EQUAL(bit_count(0x555,      false, true, false, false, 2, NULL), 47);
+    CHECK_EQUAL(bit_count(0x15555555, true,  true, false, false, 8, NULL), 67);
+
+    // A classic frame never has more than 8 data bytes, but the DLC 15 is transmitted (7 stuff bits)
+    CHECK_EQUAL(bit_count(0x123, false, false, false, false, 15, data), 118);
+}
+
+// Frames with the most stuff bits that a search found with the reference model
+void test_worst_case()
+{
+    printf("  worst case stuffing\n");
+    uint8_t data_std[8] = { 0x3C, 0x3C, 0x3C, 0x3C, 0x3C, 0x3C, 0x20, 0x7F };
+    CHECK_EQUAL(bit_count(0x078, false, false, false, false, 8, data_std), 132); // 21 stuff bits
+
+    uint8_t data_ext[8] = { 0x3C, 0x3C, 0x3C, 0x3C, 0x3C, 0x3C, 0x18, 0x3C };
+    CHECK_EQUAL(bit_count(0x1E38787, true, false, false, false, 8, data_ext), 155); // 24 stuff bits
+
+    // A stuff bit after each 4 bits of the 64 byte data field
+    uint8_t data_fd[64];
+    memset(data_fd, 0x87, sizeof(data_fd));
+    CHECK_EQUAL(bit_count(0x078, false, false, true, false, 15, data_fd), 710);
+    CHECK_EQUAL(bit_count(0x078, false, false, true, true,  15, data_fd), 202);
+
+    // The upper limit of ISO 11898-1: one stuff bit per 4 bits after the first 5 bits from SOF to the end of the CRC
+    uint8_t pattern[8];
+    for (int i=0; i<256; i++)
+    {
+        memset(pattern, i, sizeof(pattern));
+        CHECK(bit_count(i << 3, false, false, false, false, 8, pattern) <= 111 + (34 + 64 - 1) / 4);
+    }
+}
+
+void test_fd()
+{
+    printf("  CAN FD frames with and without bitrate switching\n");
+    uint8_t data[64];
+    for (int i=0; i<64; i++)
+    {
+        data[i] = i;
+    }
+    CHECK_EQUAL(bit_count(0x123, false, false, true, false, 15, data), 604);
+
+    // BRS: 500 kBaud / 2 MBaud --> the data phase counts a quarter
+    uint8_t data_ext[24];
+    memset(data_ext, 0xF0, sizeof(data_ext));
+    CHECK_EQUAL(bit_count(0x1ABCDE12, true, false, true, true, 12, data_ext), 107); // 24 bytes --> CRC-21
+
+    uint8_t zero[12] = {0};
+    CHECK_EQUAL(bit_count(0x7FF, false, false, true, true, 9, zero), 68); // 12 bytes --> CRC-17
+
+    memset(data, 0, sizeof(data));
+    CHECK_EQUAL(bit_count(0x123, false, false, true, true, 15, data), 192);
+    memset(data, 0x55, sizeof(data));
+    CHECK_EQUAL(bit_count(0x123, false, false, true, true, 15, data), 167); // no stuff bits in the data field
+}
+
+int main()
+{
+    host_init();
+    can_inst[0].busload_interval = 1;
+    CHECK_EQUAL(can_set_bit_timing(0, false, 20, 13, 2, 2), FBK_Success); // 500 kBaud
+    CHECK_EQUAL(can_set_bit_timing(0, true,  5,  13, 2, 2), FBK_Success); // 2 MBaud
+
+    test_classic();
+    test_worst_case();
+    test_fd();
+    return host_result("test_busload");
+}
@@ -0,0 +1,120 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Drain loops: a burst of packets is consumed completely in one pass.
+// - one FDCAN interrupt copies all packets of Rx FIFO 0 and Rx FIFO 1 into rx_ring
+// - one call of can_process() processes rx_ring, limited to CAN_MAX_FRAMES_PER_PASS (8)
+// - one call of can_process() reads all 3 events from the Tx event FIFO
+// The fill levels in RXF0S, RXF1S and TXEFS are set by the simulator.
+
+#include "host.h"
+
+extern can_class can_inst[CHANNEL_COUNT]; // can.c
+
+uint32_t rx_fill_level(uint32_t rx_fifo)
+{
+    return HAL_FDCAN_GetRxFifoFillLevel(can_get_handle(0), rx_fifo);
+}
+
+uint32_t tx_event_fill_level()
+{
+    return (can_get_handle(0)->Instance->TXEFS & FDCAN_TXEFS_EFFL) >> FDCAN_TXEFS_EFFL_Pos;
+}
+
+void test_rx_burst()
+{
+    printf("  Rx burst of 3 packets in each Rx FIFO\n");
+    can_class* inst = &can_inst[0];
+    host_open_channel(0, 0, false);
+
+    for (int i=0; i<3; i++)
+    {
+        sim_frame frame = sim_make_frame(0x100 + i, false, 8);
+        CHECK(sim_receive(0, FDCAN_RX_FIFO0, &frame));
+        frame = sim_make_frame(0x200 + i, false, 8);
+        CHECK(sim_receive(0, FDCAN_RX_FIFO1, &frame));
+    }
+    CHECK_EQUAL(rx_fill_level(FDCAN_RX_FIFO0), 3);
+    CHECK_EQUAL(rx_fill_level(FDCAN_RX_FIFO1), 3);
+
+    // One interrupt drains both FIFO's
+    sim_interrupt(0);
+    CHECK_EQUAL(rx_fill_level(FDCAN_RX_FIFO0), 0);
+    CHECK_EQUAL(rx_fill_level(FDCAN_RX_FIFO1), 0);
+    CHECK_EQUAL(inst->rx_head - inst->rx_tail, 6);
+    for (int i=0; i<3; i++)
+    {
+        CHECK_EQUAL(inst->rx_ring[(inst->rx_tail + i)     % CAN_RX_RING_SIZE].header.Identifier, 0x100 + i);
+        CHECK_EQUAL(inst->rx_ring[(inst->rx_tail + i + 3) % CAN_RX_RING_SIZE].header.Identifier, 0x200 + i);
+    }
+
+    // One pass of the main loop processes all packets
+    can_process(0, uwTick);
+    CHECK_EQUAL(inst->rx_head - inst->rx_tail, 0);
+
+    // 12 packets: the first pass processes 8, the second pass the rest
+    for (int B=0; B<2; B++)
+    {
+        for (int i=0; i<3; i++)
+        {
+            sim_frame frame = sim_make_frame(0x300 + i, false, 8);
+            CHECK(sim_receive(0, FDCAN_RX_FIFO0, &frame));
+            CHECK(sim_receive(0, FDCAN_RX_FIFO1, &frame));
+        }
+        sim_interrupt(0);
+    }
+    CHECK_EQUAL(inst->rx_head - inst->rx_tail, 12);
+    can_process(0, uwTick);
+    CHECK_EQUAL(inst->rx_head - inst->rx_tail, 4);
+    can_process(0, uwTick);
+    CHECK_EQUAL(inst->rx_head - inst->rx_tail, 0);
+    CHECK_EQUAL(inst->rx_lost_count, 0);
+    can_close(0);
+}
+
+void test_tx_event_burst()
+{
+    printf("  3 Tx events consumed in one pass\n");
+    can_class* inst = &can_inst[0];
+    host_open_channel(0, USR_Retransmit, false); // tx_pending is counted only with auto retransmission
+
+    uint8_t data[8] = {0};
+    FDCAN_TxHeaderTypeDef header = {0};
+    header.IdType             = FDCAN_STANDARD_ID;
+    header.TxFrameType        = FDCAN_DATA_FRAME;
+    header.DataLength         = 8;
+    header.FDFormat           = FDCAN_CLASSIC_CAN;
+    header.TxEventFifoControl = FDCAN_STORE_TX_EVENTS;
+    for (int i=0; i<3; i++)
+    {
+        header.Identifier = 0x400 + i;
+        can_send_packet(0, &header, data);
+    }
+    CHECK_EQUAL(inst->tx_pending, 3);
+    CHECK_EQUAL(sim_tx_pending(0), 3);
+
+    // The bus sends all 3 packets before the main loop runs again
+    for (int i=0; i<3; i++)
+    {
+        sim_frame frame;
+        CHECK(sim_transmit(0, &frame));
+        CHECK_EQUAL(frame.ID, 0x400 + i);
+    }
+    CHECK_EQUAL(tx_event_fill_level(), 3);
+
+    can_process(0, uwTick);
+    CHECK_EQUAL(tx_event_fill_level(), 0);
+    CHECK_EQUAL(inst->tx_pending, 0);
+    can_close(0);
+}
+
+int main()
+{
+    host_init();
+    test_rx_burst();
+    test_tx_event_burst();
+    return host_result("test_drain");
+}
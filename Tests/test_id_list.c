@@ -0,0 +1,350 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Host ID list (see can_add_host_id() and can_is_in_host_id_list())
+// - the hash set of 29 bit IDs accepts ID_LIST_EXT_MAX IDs, one more is rejected
+// - lookup cost with a full hash set: comparisons per lookup and time per lookup for hits and misses
+// - the list compiled into the spare filter elements by can_open() (see can_compile_host_id_list()):
+//   the elements are decoded from the message RAM, they must accept all IDs of the list,
+//   the IDs in the gaps must match false_pos and a smaller gap must need more elements than available.
+
+#include "host.h"
+
+#define LOOKUPS     1000000
+
+extern can_class can_inst[CHANNEL_COUNT]; // can.c
+bool can_is_in_host_id_list(can_class* inst, FDCAN_RxHeaderTypeDef* header);
+int  can_make_id_list_elements(can_class* inst, bool extended, uint32_t max_gap, bool apply, uint32_t* false_pos);
+
+// A filter element in the message RAM (RANGE or DUAL, the host ID list uses no other types)
+typedef struct
+{
+    uint32_t type;
+    uint32_t ID1;
+    uint32_t ID2;
+} id_element;
+
+uint32_t random_state = 4711;
+
+uint32_t random_next()
+{
+    random_state = random_state * 1103515245 + 12345;
+    return random_state;
+}
+
+// Slot of an ID in the hash set (same hash as can_hash_id() in can.c)
+uint32_t hash_slot(uint32_t ID)
+{
+    return (ID * 2654435761u) >> (32 - ID_LIST_EXT_BITS);
+}
+
+// Comparisons of a lookup in the hash set of channel 0: the probe sequence ends at the ID or at an empty slot
+uint32_t comparisons(uint32_t ID)
+{
+    uint32_t* list  = can_inst[0].id_list_ext;
+    uint32_t  count = 1;
+    for (uint32_t slot = hash_slot(ID); list[slot] != ID && list[slot] != ID_LIST_EMPTY; slot = (slot + 1) & (ID_LIST_EXT_SIZE - 1))
+    {
+        count ++;
+    }
+    return count;
+}
+
+// Time of one lookup in nanoseconds, the fastest of 5 runs
+double lookup_time(uint32_t* IDs, uint32_t count, bool extended, bool expected)
+{
+    FDCAN_RxHeaderTypeDef header = {0};
+    header.IdType = extended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+    double best  = 1e9;
+    int    wrong = 0;
+    for (int R=0; R<5; R++)
+    {
+        uint64_t start = host_nanoseconds();
+        for (int i=0; i<LOOKUPS; i++)
+        {
+            header.Identifier = IDs[i % count];
+            if (can_is_in_host_id_list(&can_inst[0], &header) != expected)
+                wrong ++;
+        }
+        best = MIN(best, (double)(host_nanoseconds() - start) / LOOKUPS);
+    }
+    CHECK_EQUAL(wrong, 0);
+    return best;
+}
+
+// A full hash set with 29 bit IDs: J1939 style IDs (sequential) or random IDs
+void test_lookup(const char* name, bool sequential)
+{
+    static uint32_t hits  [ID_LIST_EXT_MAX];
+    static uint32_t misses[ID_LIST_EXT_MAX];
+
+    CHECK_EQUAL(can_clear_host_filters(0), FBK_Success);
+    for (uint32_t i=0; i<ID_LIST_EXT_MAX; i++)
+    {
+        hits[i] = sequential ? 0x18DA00F1 + (i << 8) : random_next() & 0x1FFFFFFF;
+        CHECK_EQUAL(can_add_host_id(0, true, hits[i]), FBK_Success);
+    }
+    CHECK_EQUAL(can_inst[0].id_list_ext_count, ID_LIST_EXT_MAX);
+    CHECK_EQUAL(can_add_host_id(0, true, 0x1FFFFFFF), FBK_ParamOutOfRange); // full
+
+    uint32_t hit_sum = 0, hit_max = 0, miss_sum = 0, miss_max = 0;
+    for (uint32_t i=0; i<ID_LIST_EXT_MAX; i++)
+    {
+        misses[i] = sequential ? 0x18DA00F2 + (i << 8) : random_next() & 0x1FFFFFFF;
+
+        uint32_t hit  = comparisons(hits[i]);
+        uint32_t miss = comparisons(misses[i]);
+        hit_sum  += hit;
+        miss_sum += miss;
+        hit_max   = MAX(hit_max,  hit);
+        miss_max  = MAX(miss_max, miss);
+    }
+
+    double hit_time  = lookup_time(hits,   ID_LIST_EXT_MAX, true, true);
+    double miss_time = lookup_time(misses, ID_LIST_EXT_MAX, true, false);
+    printf("    %-10s hit:  %.2f comparisons (max %2u) %5.1f ns\n", name, (double)hit_sum  / ID_LIST_EXT_MAX, hit_max,  hit_time);
+    printf("    %-10s miss: %.2f comparisons (max %2u) %5.1f ns\n", name, (double)miss_sum / ID_LIST_EXT_MAX, miss_max, miss_time);
+
+    // Linear probing at 75% load: on average 2.5 comparisons for a hit and 8.5 for a miss
+    CHECK((double)hit_sum  / ID_LIST_EXT_MAX < 4);
+    CHECK((double)miss_sum / ID_LIST_EXT_MAX < 16);
+}
+
+// Read the filter elements of the compiled host ID list from the message RAM
+int read_elements(bool extended, id_element* elements)
+{
+    can_class*           inst   = &can_inst[0];
+    FDCAN_HandleTypeDef* handle = can_get_handle(0);
+    can_id_elements*     comp   = extended ? &inst->id_ext_compiled : &inst->id_std_compiled;
+    uint32_t             first  = extended ? inst->ext_user_elements : inst->std_user_elements;
+    for (uint32_t E=0; E<comp->elements; E++)
+    {
+        if (extended)
+        {
+            uint32_t* word = (uint32_t*)(handle->msgRam.ExtendedFilterSA + (first + E) * 8);
+            elements[E].type = word[1] >> 30;
+            elements[E].ID1  = word[0] & 0x1FFFFFFF;
+            elements[E].ID2  = word[1] & 0x1FFFFFFF;
+        }
+        else
+        {
+            uint32_t word = *(uint32_t*)(handle->msgRam.StandardFilterSA + (first + E) * 4);
+            elements[E].type = word >> 30;
+            elements[E].ID1  = (word >> 16) & 0x7FF;
+            elements[E].ID2  = word & 0x7FF;
+        }
+    }
+    return comp->elements;
+}
+
+bool element_accepts(id_element* element, uint32_t ID)
+{
+    if (element->type == FDCAN_FILTER_RANGE) return ID >= element->ID1 && ID <= element->ID2;
+    if (element->type == FDCAN_FILTER_DUAL)  return ID == element->ID1 || ID == element->ID2;
+    return false;
+}
+
+// Count of IDs accepted by the elements.
+// Single IDs are paired into DUAL elements with a later ID, so the elements may interleave and are merged here.
+uint32_t count_accepted(id_element* elements, int element_count)
+{
+    uint32_t first[HW_STD_FILTERS * 2], last[HW_STD_FILTERS * 2];
+    int count = 0;
+    for (int E=0; E<element_count; E++)
+    {
+        first[count] = elements[E].ID1;
+        last [count] = elements[E].type == FDCAN_FILTER_RANGE ? elements[E].ID2 : elements[E].ID1;
+        count ++;
+        if (elements[E].type == FDCAN_FILTER_DUAL)
+        {
+            first[count] = last[count] = elements[E].ID2;
+            count ++;
+        }
+    }
+
+    // Sort the intervals by their first ID (insertion sort)
+    for (int i=1; i<count; i++)
+    {
+        uint32_t F = first[i], L = last[i];
+        int pos = i;
+        for (; pos > 0 && first[pos - 1] > F; pos--)
+        {
+            first[pos] = first[pos - 1];
+            last [pos] = last [pos - 1];
+        }
+        first[pos] = F;
+        last [pos] = L;
+    }
+
+    uint32_t accepted = 0;
+    int64_t  end      = -1; // the last ID already counted
+    for (int i=0; i<count; i++)
+    {
+        if ((int64_t)last[i] <= end)
+            continue;
+        accepted += last[i] - (uint32_t)MAX((int64_t)first[i], end + 1) + 1;
+        end = last[i];
+    }
+    return accepted;
+}
+
+// Compile the list with can_open() and check the filter elements. IDs = sorted list
+void check_compiled(const char* name, bool extended, uint32_t* IDs, uint32_t count)
+{
+    can_class*       inst = &can_inst[0];
+    can_id_elements* comp = extended ? &inst->id_ext_compiled : &inst->id_std_compiled;
+    host_open_channel(0, 0, false);
+
+    // The filter elements that remain behind the user filters and the reject element
+    uint32_t budget = extended ? HW_EXT_FILTERS - inst->ext_user_elements - inst->reject_elements
+                               : HW_STD_FILTERS - inst->std_user_elements - inst->reject_elements;
+
+    static id_element elements[HW_STD_FILTERS];
+    int element_count = read_elements(extended, elements);
+    CHECK(element_count > 0);
+    CHECK(element_count <= budget);
+
+    // All IDs of the list are accepted
+    int missing = 0;
+    for (uint32_t i=0; i<count; i++)
+    {
+        bool found = false;
+        for (int E=0; E<element_count && !found; E++)
+        {
+            found = element_accepts(&elements[E], IDs[i]);
+        }
+        if (!found) missing ++;
+    }
+    CHECK_EQUAL(missing, 0);
+
+    // All other accepted IDs are false positives
+    uint32_t accepted = count_accepted(elements, element_count);
+    CHECK_EQUAL(accepted, count + comp->false_pos);
+
+    // The gap is the smallest possible
+    uint32_t false_pos;
+    if (comp->max_gap > 0)
+        CHECK(can_make_id_list_elements(inst, extended, comp->max_gap - 1, false, &false_pos) > (int)budget);
+
+    printf("    %-26s %3u IDs in %2d elements (budget %2u), max gap %4u, %4u false positives (%.0f%%)\n", name, count, element_count,
+           budget, comp->max_gap, comp->false_pos, 100.0 * comp->false_pos / accepted);
+    can_close(0);
+}
+
+// Add the sorted IDs to the host ID list
+void add_ids(bool extended, uint32_t* IDs, uint32_t count)
+{
+    CHECK_EQUAL(can_clear_host_filters(0), FBK_Success);
+    for (uint32_t i=0; i<count; i++)
+    {
+        CHECK_EQUAL(can_add_host_id(0, extended, IDs[i]), FBK_Success);
+    }
+}
+
+// Sort and remove duplicates, returns the new count
+uint32_t sort_ids(uint32_t* IDs, uint32_t count)
+{
+    for (uint32_t i=1; i<count; i++)
+    {
+        uint32_t ID = IDs[i], pos = i;
+        for (; pos > 0 && IDs[pos - 1] > ID; pos--)
+        {
+            IDs[pos] = IDs[pos - 1];
+        }
+        IDs[pos] = ID;
+    }
+    uint32_t unique = 0;
+    for (uint32_t i=0; i<count; i++)
+    {
+        if (unique == 0 || IDs[i] != IDs[unique - 1])
+            IDs[unique ++] = IDs[i];
+    }
+    return unique;
+}
+
+void test_compile()
+{
+    printf("  host ID list compiled into filter elements\n");
+    static uint32_t IDs[ID_LIST_EXT_MAX];
+
+    // 50 single IDs fit into 25 DUAL elements --> exact
+    uint32_t count = 0;
+    for (uint32_t i=0; i<50; i++)
+    {
+        IDs[count++] = random_next() & 0x7FF;
+    }
+    count = sort_ids(IDs, count);
+    add_ids(false, IDs, count);
+    check_compiled("11 bit, random, exact", false, IDs, count);
+    CHECK_EQUAL(can_inst[0].id_std_compiled.false_pos, 0);
+
+    // 120 random IDs need range elements
+    count = 0;
+    for (uint32_t i=0; i<120; i++)
+    {
+        IDs[count++] = random_next() & 0x7FF;
+    }
+    count = sort_ids(IDs, count);
+    add_ids(false, IDs, count);
+    check_compiled("11 bit, random", false, IDs, count);
+
+    // The same IDs with 2 host filters: a mask filter (1 element) and a priority filter (1 element)
+    add_ids(false, IDs, count);
+    CHECK_EQUAL(can_add_host_filter(0, false, 0x100, 0x700, false), FBK_Success);
+    CHECK_EQUAL(can_add_host_filter(0, false, 0x7DF, 0x7FF, false), FBK_Success);
+    check_compiled("11 bit, random, 2 filters", false, IDs, count);
+
+    // 29 bit OBD / J1939 style: 6 clusters of 20 IDs with a step of 8 and 10 scattered IDs
+    count = 0;
+    for (uint32_t C=0; C<6; C++)
+    {
+        for (uint32_t i=0; i<20; i++)
+        {
+            IDs[count++] = 0x18DA0000 + (C << 12) + i * 8;
+        }
+    }
+    for (uint32_t i=0; i<10; i++)
+    {
+        IDs[count++] = random_next() & 0x1FFFFFFF;
+    }
+    count = sort_ids(IDs, count);
+    add_ids(true, IDs, count);
+    check_compiled("29 bit, clusters", true, IDs, count);
+
+    // A full 29 bit list in 8 elements
+    count = 0;
+    for (uint32_t i=0; i<ID_LIST_EXT_MAX; i++)
+    {
+        IDs[count++] = 0x0CF00400 + i * 3;
+    }
+    add_ids(true, IDs, count);
+    check_compiled("29 bit, full list", true, IDs, count);
+    CHECK_EQUAL(can_clear_host_filters(0), FBK_Success);
+}
+
+int main()
+{
+    host_init();
+    printf("  29 bit hash set with %d IDs (%d slots)\n", ID_LIST_EXT_MAX, ID_LIST_EXT_SIZE);
+    test_lookup("J1939",  true);
+    test_lookup("random", false);
+
+    // 11 bit IDs: one bit in a bitmap
+    static uint32_t odd[0x400], even[0x400];
+    CHECK_EQUAL(can_clear_host_filters(0), FBK_Success);
+    for (uint32_t i=0; i<0x400; i++)
+    {
+        odd [i] = i * 2 + 1;
+        even[i] = i * 2;
+        CHECK_EQUAL(can_add_host_id(0, false, odd[i]), FBK_Success);
+    }
+    CHECK_EQUAL(can_inst[0].id_list_std_count, 0x400);
+    printf("  11 bit bitmap: hit %.1f ns, miss %.1f ns\n", lookup_time(odd, 0x400, false, true), lookup_time(even, 0x400, false, false));
+    can_clear_host_filters(0);
+
+    test_compile();
+    return host_result("test_id_list");
+}
@@ -0,0 +1,133 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Tx priority (USR_TxPriority): latency of high priority frames on a congested bus.
+// The Tx buffer starts with a backlog of 20 low priority frames.
+// The host sends bursts of 20 low priority frames followed by 1 high priority frame, the bus sends 21 frames per burst.
+// So the backlog stays at 20 frames when the next burst arrives.
+// The latency is counted in frames that the bus has sent between storing a frame and sending it.
+// Without USR_TxPriority the high priority frame waits behind the whole backlog.
+// With USR_TxPriority it is sorted before the low priority frames (Slcan: buf_store_tx_entry(), Candlelight: buf_add_can_frame_sorted_locked())
+// and the FDCAN sends the lowest CAN ID of the 3 Tx buffers first (Tx queue mode).
+
+#include "host.h"
+#include "buffer.h"
+
+#define BURSTS      200
+#define BURST_LOW   20
+#define HIGH_ID     0x010
+#define LOW_ID      0x700
+#define FRAMES      (BURSTS * (BURST_LOW + 1))  // frames sent
+#define BACKLOG     BURST_LOW
+
+typedef struct
+{
+    uint32_t worst_high; // worst case latency of the high priority frames
+    uint32_t worst_low;
+    uint32_t sent;
+    int      order_errors;
+} latency_result;
+
+uint32_t store_time[FRAMES + BACKLOG]; // bus frame count when the frame was stored
+
+void run_main_loop(uint8_t channel)
+{
+    buf_process(channel, uwTick);
+    can_process(channel, uwTick);
+}
+
+// The data bytes contain the sequence number of the frame
+void store_frame(uint32_t ID, uint32_t sequence, uint32_t bus_time)
+{
+    uint8_t data[8] = {0};
+    memcpy(data, &sequence, 4);
+    FDCAN_TxHeaderTypeDef header = {0};
+    header.Identifier  = ID;
+    header.IdType      = FDCAN_STANDARD_ID;
+    header.TxFrameType = FDCAN_DATA_FRAME;
+    header.DataLength  = 8;
+    header.FDFormat    = FDCAN_CLASSIC_CAN;
+    buf_store_tx_packet(0, &header, data);
+    store_time[sequence] = bus_time;
+}
+
+latency_result measure(uint32_t user_flags)
+{
+    latency_result result = {0};
+    host_open_channel(0, user_flags, false);
+
+    // USR_TxPriority switches the FDCAN to Tx queue mode
+    bool queue_mode = (can_get_handle(0)->Instance->TXBC & FDCAN_TXBC_TFQM) != 0;
+    CHECK_EQUAL(queue_mode, (user_flags & USR_TxPriority) != 0);
+
+    uint32_t sequence = 0;
+    int32_t  last_low = -1;
+    for (int i=0; i<BACKLOG; i++)
+    {
+        store_frame(LOW_ID, sequence ++, 0);
+    }
+
+    for (int B=0; B<BURSTS; B++)
+    {
+        for (int i=0; i<BURST_LOW; i++)
+        {
+            store_frame(LOW_ID, sequence ++, result.sent);
+        }
+        store_frame(HIGH_ID, sequence ++, result.sent);
+
+        for (int i=0; i<=BURST_LOW; i++)
+        {
+            run_main_loop(0);
+            sim_frame frame;
+            if (!sim_transmit(0, &frame))
+                break;
+
+            result.sent ++;
+            sim_interrupt(0); // Tx complete --> refill the Tx FIFO
+
+            uint32_t frame_seq;
+            memcpy(&frame_seq, frame.data, 4);
+            uint32_t latency = result.sent - store_time[frame_seq];
+            if (frame.ID == HIGH_ID)
+            {
+                result.worst_high = MAX(result.worst_high, latency);
+            }
+            else
+            {
+                result.worst_low = MAX(result.worst_low, latency);
+
+                // Frames with the same CAN ID must keep their order
+                if ((int32_t)frame_seq <= last_low)
+                    result.order_errors ++;
+                last_low = frame_seq;
+            }
+        }
+    }
+    can_close(0);
+    return result;
+}
+
+int main()
+{
+    host_init();
+    printf("  latency in frames on a congested bus\n");
+
+    latency_result fifo = measure(0);
+    printf("    FIFO order:     high priority %2u, low priority %2u\n", fifo.worst_high, fifo.worst_low);
+    CHECK_EQUAL(fifo.sent, FRAMES);
+    CHECK_EQUAL(fifo.order_errors, 0);
+    CHECK_EQUAL(fifo.worst_high, BACKLOG + BURST_LOW + 1);
+
+    latency_result prio = measure(USR_TxPriority);
+    printf("    USR_TxPriority: high priority %2u, low priority %2u\n", prio.worst_high, prio.worst_low);
+    CHECK_EQUAL(prio.sent, FRAMES);
+    CHECK_EQUAL(prio.order_errors, 0);
+
+    // One low priority frame that is already in the Tx buffer of the FDCAN is sent before, then the high priority frame follows.
+    CHECK_EQUAL(prio.worst_high, 2);
+    CHECK(prio.worst_high < fifo.worst_high);
+    return host_result("test_priority");
+}
@@ -0,0 +1,152 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Rx ring stress test: random bursts into Rx FIFO 0, FDCAN interrupts and passes of the main loop in random order.
+// A model of the hardware FIFO and of rx_ring predicts which packets are stored, which are lost and their rx_lost_count.
+// - can_read_rx_fifo() stores the packets in the order of reception, a full ring buffer discards the packet
+// - a full hardware FIFO sets the flag "message lost" which increments rx_lost_count after draining the FIFO
+// - can_process() processes at most CAN_MAX_FRAMES_PER_PASS (8) packets in one pass
+// - rx_head and rx_tail roll over at 32 bit
+
+#include "host.h"
+#include "buffer.h"
+
+#define STEPS           200000
+#define MAX_PER_PASS    8
+
+extern can_class can_inst[CHANNEL_COUNT]; // can.c
+
+// The model
+uint32_t model_fifo[3];      // IDs in the hardware FIFO
+int      model_fifo_count;
+bool     model_fifo_lost;    // flag "message lost" of the hardware FIFO
+uint32_t model_ring[CAN_RX_RING_SIZE]; // IDs in rx_ring
+uint16_t model_ring_lost[CAN_RX_RING_SIZE]; // rx_lost_count of each packet
+uint32_t model_head, model_tail;
+uint16_t model_lost_count;
+uint32_t model_ring_full;    // packets discarded because rx_ring was full
+
+int      failures;
+uint32_t random_state = 12345;
+
+uint32_t random_next(uint32_t range)
+{
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 16) % range;
+}
+
+// A packet arrives on the CAN bus
+void bus_receive(uint32_t ID)
+{
+    sim_frame frame = sim_make_frame(ID, false, 8);
+    bool stored = sim_receive(0, FDCAN_RX_FIFO0, &frame);
+    if (stored != (model_fifo_count < 3))
+        failures ++;
+
+    if (model_fifo_count < 3) model_fifo[model_fifo_count ++] = ID;
+    else                      model_fifo_lost = true;
+}
+
+// The FDCAN interrupt drains the hardware FIFO into rx_ring (see can_read_rx_fifo())
+void interrupt()
+{
+    sim_interrupt(0);
+    for (int i=0; i<model_fifo_count; i++)
+    {
+        if (model_head - model_tail >= CAN_RX_RING_SIZE)
+        {
+            model_lost_count ++;
+            model_ring_full  ++;
+            continue;
+        }
+        model_ring     [model_head % CAN_RX_RING_SIZE] = model_fifo[i];
+        model_ring_lost[model_head % CAN_RX_RING_SIZE] = model_lost_count;
+        model_head ++;
+    }
+    model_fifo_count = 0;
+    if (model_fifo_lost)
+    {
+        model_fifo_lost = false;
+        model_lost_count ++;
+    }
+}
+
+// One pass of the main loop: compare the packets in rx_ring with the model before they are processed
+void main_loop()
+{
+    can_class* inst = &can_inst[0];
+    if (inst->rx_head != model_head || inst->rx_tail != model_tail || inst->rx_lost_count != model_lost_count)
+    {
+        failures ++;
+        return;
+    }
+
+    for (uint32_t R = model_tail; R != model_head; R++)
+    {
+        rx_packet* packet = &inst->rx_ring[R % CAN_RX_RING_SIZE];
+        uint32_t   ID     = model_ring[R % CAN_RX_RING_SIZE];
+        if (packet->header.Identifier != ID || packet->lost_count != model_ring_lost[R % CAN_RX_RING_SIZE] ||
+            packet->data[0] != (uint8_t)ID || packet->data[7] != (uint8_t)(ID + 7))
+            failures ++;
+    }
+
+    can_process(0, uwTick);
+    buf_process(0, uwTick);
+    model_tail += MIN(model_head - model_tail, MAX_PER_PASS);
+    if (inst->rx_tail != model_tail)
+        failures ++;
+}
+
+int main()
+{
+    host_init();
+    printf("  %d random steps\n", STEPS);
+    host_open_channel(0, 0, false);
+
+    // Start shortly before the 32 bit roll over of rx_head and rx_tail
+    can_class* inst = &can_inst[0];
+    inst->rx_head = inst->rx_tail = model_head = model_tail = 0xFFFFFF00;
+
+    uint32_t next_ID = 0;
+    for (int S=0; S<STEPS; S++)
+    {
+        // The main loop is blocked from time to time (USB busy), so the ring buffer runs full
+        bool blocked = (S / 500) % 4 == 3;
+        uint32_t action = random_next(8);
+        if (action < 4)
+        {
+            for (uint32_t i=random_next(4); i>0; i--)
+            {
+                bus_receive(next_ID);
+                next_ID = (next_ID + 1) & 0x7FF;
+            }
+        }
+        else if (action < 6 || blocked)
+        {
+            interrupt();
+        }
+        else
+        {
+            main_loop();
+        }
+    }
+
+    // Drain everything
+    interrupt();
+    for (int i=0; i<CAN_RX_RING_SIZE && model_head != model_tail; i++)
+    {
+        main_loop();
+    }
+
+    CHECK_EQUAL(failures, 0);
+    CHECK(model_ring_full  > 0); // the test has covered a full ring buffer
+    CHECK(model_lost_count > model_ring_full); // and a full hardware FIFO
+    CHECK_EQUAL(inst->rx_lost_count, model_lost_count);
+    CHECK_EQUAL(inst->rx_head - 0xFFFFFF00, model_head - 0xFFFFFF00);
+    CHECK(inst->rx_head < 0xFFFFFF00); // rolled over
+    can_close(0);
+    return host_result("test_rx_ring");
+}
@@ -0,0 +1,115 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// 64 bit timestamps from Timer 3 (16 bit) and the wrap around counter:
+// - system_get_timestamp64() with a pending update interrupt, once with the timer low and once with the timer high
+// - system_extend_timestamp16() and system_extend_timestamp32() before and after a wrap around
+// - a sweep over 2 wrap arounds where the update interrupt executes late
+
+#include "host.h"
+#include "system.h"
+
+extern volatile uint32_t timestamp_wrap; // system.c
+
+// The timer has wrapped around, but the update interrupt has not yet executed
+void set_pending_wrap(uint16_t timer)
+{
+    TIM3->CNT = timer;
+    TIM3->SR  = TIM_SR_UIF;
+}
+
+void test_timestamp64()
+{
+    printf("  timestamp64 with a pending update interrupt\n");
+    host_set_timer(0x51234);
+    CHECK_EQUAL(system_get_timestamp64(), 0x51234);
+    CHECK_EQUAL(system_get_timestamp(),   0x51234);
+
+    // The timer is low: the wrap around happened before reading the timer --> wrap + 1
+    host_set_timer(0x5FFFF);
+    set_pending_wrap(0x0003);
+    CHECK_EQUAL(system_get_timestamp64(), 0x60003);
+
+    // The timer is high: the wrap around happened after reading the timer --> no increment
+    host_set_timer(0x5FFFE);
+    TIM3->SR = TIM_SR_UIF;
+    CHECK_EQUAL(system_get_timestamp64(), 0x5FFFE);
+
+    // The update interrupt executes: same result, the flag is cleared
+    host_set_timer(0x5FFFF);
+    set_pending_wrap(0x0003);
+    system_count_timewrap();
+    CHECK_EQUAL(TIM3->SR & TIM_SR_UIF, 0);
+    CHECK_EQUAL(timestamp_wrap, 6);
+    CHECK_EQUAL(system_get_timestamp64(), 0x60003);
+
+    // More than 32 bit
+    host_set_timer(0);
+    timestamp_wrap = 0x123456;
+    TIM3->CNT      = 0x789A;
+    CHECK_EQUAL(system_get_timestamp64(), 0x123456789AULL);
+    CHECK_EQUAL(system_get_timestamp(),   0x3456789A);
+}
+
+void test_extend()
+{
+    printf("  extend 16 and 32 bit timestamps\n");
+    host_set_timer(0x51000);
+    CHECK_EQUAL(system_extend_timestamp16(0x1000), 0x51000);
+    CHECK_EQUAL(system_extend_timestamp16(0x0F00), 0x50F00);
+    CHECK_EQUAL(system_extend_timestamp16(0xF000), 0x4F000); // captured before the wrap around
+
+    // The capture was before the wrap around, the update interrupt is pending
+    host_set_timer(0x5FFFF);
+    set_pending_wrap(0x0003);
+    CHECK_EQUAL(system_extend_timestamp16(0xFFF0), 0x5FFF0);
+    CHECK_EQUAL(system_extend_timestamp16(0x0002), 0x60002);
+
+    // The timer is high with a pending flag: the stamp was captured before the wrap around
+    host_set_timer(0x5FFF0);
+    TIM3->SR = TIM_SR_UIF;
+    CHECK_EQUAL(system_extend_timestamp16(0xFFE0), 0x5FFE0);
+
+    host_set_timer(0);
+    timestamp_wrap = 0x10000;
+    TIM3->CNT      = 0x0010;
+    CHECK_EQUAL(system_extend_timestamp32(0x00000005), 0x100000005ULL);
+    CHECK_EQUAL(system_extend_timestamp32(0xFFFFFFF0), 0x0FFFFFFF0ULL); // before the 32 bit roll over
+    CHECK_EQUAL(system_extend_timestamp32(0x00000010), 0x100000010ULL);
+}
+
+// The timer counts over 2 wrap arounds in steps of 7 us. The update interrupt executes 50 us after the wrap around.
+void test_sweep()
+{
+    printf("  sweep over 2 wrap arounds\n");
+    host_set_timer(0x1F000);
+    uint64_t last     = system_get_timestamp64();
+    int      failures = 0;
+    for (uint32_t T = 0x1F000; T < 0x41000; T += 7)
+    {
+        TIM3->CNT = T & 0xFFFF;
+        if ((T & 0xFFFF) < 7)
+            TIM3->SR = TIM_SR_UIF; // wrap around
+
+        if ((TIM3->SR & TIM_SR_UIF) && (T & 0xFFFF) >= 50)
+            system_count_timewrap();
+
+        uint64_t now = system_get_timestamp64();
+        if (now != T || now < last) failures ++;
+        last = now;
+    }
+    CHECK_EQUAL(failures, 0);
+    CHECK_EQUAL(timestamp_wrap, 4);
+}
+
+int main()
+{
+    host_init();
+    test_timestamp64();
+    test_extend();
+    test_sweep();
+    return host_result("test_timestamp");
+}
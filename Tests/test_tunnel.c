@@ -0,0 +1,289 @@
+/*
+    The MIT License
+    Copyright (c) 2025 ElmueSoft / Nakanishi Kiyomaro / Normadotcom
+    https://netcult.ch/elmue/CANable Firmware Update
+*/
+
+// Classic CAN over CAN FD tunnel (bridge mode):
+// - pack and unpack single records with 11 / 29 bit IDs, remote frames and the padding at the end of a tunnel frame
+// - classic frames packed into one CAN FD tunnel frame and unpacked again
+// - a 64 byte CAN FD frame split into 10 classic fragments and reassembled, also with a lost fragment
+
+#include "host.h"
+#include "buffer.h"
+
+#define TUNNEL_ID   0x7F0
+
+// Process the main loop of a channel once
+void run_main_loop(uint8_t channel)
+{
+    buf_process    (channel, uwTick);
+    can_process    (channel, uwTick);
+    buf_process    (channel, uwTick);
+}
+
+// A frame arrives on the CAN bus of the channel and is processed by the firmware
+void receive_frame(uint8_t channel, sim_frame* frame)
+{
+    CHECK(sim_receive(channel, FDCAN_RX_FIFO0, frame));
+    sim_interrupt(channel); // Rx FIFO 0 --> rx_ring
+    run_main_loop(channel);
+}
+
+// Send all pending frames of the channel to the CAN bus. Returns the count of frames stored in frames.
+int transmit_all(uint8_t channel, sim_frame* frames, int max_frames)
+{
+    int count = 0;
+    run_main_loop(channel);
+    while (count < max_frames && sim_transmit(channel, &frames[count]))
+    {
+        count ++;
+        sim_interrupt(channel); // Tx complete --> refill the Tx FIFO from the Tx buffer
+        run_main_loop(channel);
+    }
+    return count;
+}
+
+bool frames_equal(sim_frame* a, sim_frame* b)
+{
+    int bytes = a->remote ? 0 : utils_dlc_to_byte_count(a->DLC);
+    return a->ID == b->ID && a->extended == b->extended && a->remote == b->remote && a->DLC == b->DLC &&
+           memcmp(a->data, b->data, bytes) == 0;
+}
+
+void close_all()
+{
+    can_close(0);
+    can_close(1);
+    can_set_bridge_filter(0, 0, 0xFF, false, false, false, 0, 0);
+    can_set_bridge_filter(1, 0, 0xFF, false, false, false, 0, 0);
+}
+
+// Forward all 11 bit and 29 bit frames between both channels
+void bridge_both_channels()
+{
+    CHECK_EQUAL(can_set_bridge_filter(0, 1, 0, true, false, false, 0, 0), FBK_Success);
+    CHECK_EQUAL(can_set_bridge_filter(0, 1, 1, true, true,  false, 0, 0), FBK_Success);
+    CHECK_EQUAL(can_set_bridge_filter(1, 0, 0, true, false, false, 0, 0), FBK_Success);
+    CHECK_EQUAL(can_set_bridge_filter(1, 0, 1, true, true,  false, 0, 0), FBK_Success);
+}
+
+// ---------------------------------------------------------------------------------------------
+
+void test_records()
+{
+    printf("  records\n");
+    uint8_t buf[64];
+    uint8_t data[8] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+    FDCAN_TxHeaderTypeDef tx = {0};
+    FDCAN_RxHeaderTypeDef rx;
+    uint8_t rx_data[8];
+
+    // 11 bit ID with 8 bytes: flags + 2 ID bytes + 8 data bytes
+    tx.Identifier  = 0x7FF;
+    tx.IdType      = FDCAN_STANDARD_ID;
+    tx.TxFrameType = FDCAN_DATA_FRAME;
+    tx.DataLength  = 8;
+    CHECK_EQUAL(can_tunnel_pack_record(buf, sizeof(buf), &tx, data), 11);
+    CHECK_EQUAL(buf[0], 8);
+    CHECK_EQUAL(buf[1], 0x07);
+    CHECK_EQUAL(buf[2], 0xFF);
+    CHECK_EQUAL(can_tunnel_unpack_record(buf, 11, &rx, rx_data), 11);
+    CHECK_EQUAL(rx.Identifier, 0x7FF);
+    CHECK_EQUAL(rx.IdType, FDCAN_STANDARD_ID);
+    CHECK_EQUAL(rx.RxFrameType, FDCAN_DATA_FRAME);
+    CHECK_EQUAL(rx.DataLength, 8);
+    CHECK_EQUAL(rx.FDFormat, FDCAN_CLASSIC_CAN);
+    CHECK(memcmp(rx_data, data, 8) == 0);
+
+    // The record does not fit or is truncated
+    CHECK_EQUAL(can_tunnel_pack_record(buf, 10, &tx, data), 0);
+    CHECK_EQUAL(can_tunnel_unpack_record(buf, 10, &rx, rx_data), 0);
+
+    // 29 bit ID with 5 bytes: flags + 4 ID bytes + 5 data bytes
+    tx.Identifier = 0x1ABCDEF5;
+    tx.IdType     = FDCAN_EXTENDED_ID;
+    tx.DataLength = 5;
+    CHECK_EQUAL(can_tunnel_pack_record(buf, sizeof(buf), &tx, data), 10);
+    CHECK_EQUAL(buf[0], TUN_REC_29BIT | 5);
+    CHECK_EQUAL(buf[1], 0x1A);
+    CHECK_EQUAL(buf[4], 0xF5);
+    memset(rx_data, 0, sizeof(rx_data));
+    CHECK_EQUAL(can_tunnel_unpack_record(buf, sizeof(buf), &rx, rx_data), 10);
+    CHECK_EQUAL(rx.Identifier, 0x1ABCDEF5);
+    CHECK_EQUAL(rx.IdType, FDCAN_EXTENDED_ID);
+    CHECK_EQUAL(rx.DataLength, 5);
+    CHECK(memcmp(rx_data, data, 5) == 0);
+
+    // Remote frames transport the DLC but no data
+    tx.Identifier  = 0x123;
+    tx.IdType      = FDCAN_STANDARD_ID;
+    tx.TxFrameType = FDCAN_REMOTE_FRAME;
+    tx.DataLength  = 4;
+    CHECK_EQUAL(can_tunnel_pack_record(buf, sizeof(buf), &tx, data), 3);
+    CHECK_EQUAL(buf[0], TUN_REC_RTR | 4);
+    CHECK_EQUAL(can_tunnel_unpack_record(buf, 3, &rx, rx_data), 3);
+    CHECK_EQUAL(rx.Identifier, 0x123);
+    CHECK_EQUAL(rx.RxFrameType, FDCAN_REMOTE_FRAME);
+    CHECK_EQUAL(rx.DataLength, 4);
+
+    tx.IdType = FDCAN_EXTENDED_ID;
+    tx.Identifier = 0x1FFFFFFF;
+    CHECK_EQUAL(can_tunnel_pack_record(buf, sizeof(buf), &tx, data), 5);
+    CHECK_EQUAL(buf[0], TUN_REC_29BIT | TUN_REC_RTR | 4);
+    CHECK_EQUAL(can_tunnel_unpack_record(buf, 5, &rx, rx_data), 5);
+    CHECK_EQUAL(rx.Identifier, 0x1FFFFFFF);
+    CHECK_EQUAL(rx.IdType, FDCAN_EXTENDED_ID);
+    CHECK_EQUAL(rx.RxFrameType, FDCAN_REMOTE_FRAME);
+
+    // Zero data bytes
+    tx.IdType      = FDCAN_STANDARD_ID;
+    tx.TxFrameType = FDCAN_DATA_FRAME;
+    tx.DataLength  = 0;
+    CHECK_EQUAL(can_tunnel_pack_record(buf, sizeof(buf), &tx, data), 3);
+    CHECK_EQUAL(can_tunnel_unpack_record(buf, 3, &rx, rx_data), 3);
+    CHECK_EQUAL(rx.DataLength, 0);
+
+    // The padding at the end of the tunnel frame stops unpacking
+    memset(buf, TUN_REC_PADDING, sizeof(buf));
+    CHECK_EQUAL(can_tunnel_unpack_record(buf, sizeof(buf), &rx, rx_data), 0);
+}
+
+// Channel 0 = classic CAN, channel 1 = CAN FD with tunnel.
+// Classic frames from channel 0 are collected in one CAN FD tunnel frame on channel 1 until the window expires.
+// The tunnel frame received on channel 1 is unpacked and the classic frames are sent on channel 0.
+void test_pack()
+{
+    printf("  pack classic frames into a CAN FD tunnel frame\n");
+    close_all();
+    host_set_timer(1000);
+    CHECK_EQUAL(can_set_tunnel(0, false, false, 0, 0), FBK_Success);
+    CHECK_EQUAL(can_set_tunnel(1, true, false, TUNNEL_ID, 500), FBK_Success); // window 500 us
+    bridge_both_channels();
+    host_open_channel(0, 0, false);
+    host_open_channel(1, 0, true);
+
+    sim_frame frames[3];
+    frames[0] = sim_make_frame(0x100, false, 3);
+    frames[1] = sim_make_frame(0x1234567, true, 8);
+    frames[2] = sim_make_frame(0x200, false, 2);
+    frames[2].remote = true;
+
+    for (int i=0; i<3; i++)
+    {
+        receive_frame(0, &frames[i]);
+    }
+
+    // the window has not yet expired
+    sim_frame tunnel[4];
+    CHECK_EQUAL(transmit_all(1, tunnel, 4), 0);
+
+    host_set_timer(1000 + 500);
+    CHECK_EQUAL(transmit_all(1, tunnel, 4), 1);
+
+    // records: 1+2+3 + 1+4+8 + 1+2 = 22 bytes --> 24 bytes (DLC 12) with 2 bytes padding
+    CHECK_EQUAL(tunnel[0].ID, TUNNEL_ID);
+    CHECK(tunnel[0].FD);
+    CHECK(tunnel[0].BRS);
+    CHECK_EQUAL(tunnel[0].DLC, 12);
+    CHECK_EQUAL(tunnel[0].data[22], TUN_REC_PADDING);
+    CHECK_EQUAL(tunnel[0].data[23], TUN_REC_PADDING);
+
+    // the tunnel frame comes back from the other adapter
+    receive_frame(1, &tunnel[0]);
+
+    sim_frame sent[4];
+    CHECK_EQUAL(transmit_all(0, sent, 4), 3);
+    for (int i=0; i<3; i++)
+    {
+        CHECK(frames_equal(&sent[i], &frames[i]));
+        CHECK(!sent[i].FD);
+    }
+}
+
+// Channel 0 = CAN FD, channel 1 = classic CAN with tunnel.
+// A 64 byte frame from channel 0 is split into 10 classic fragments on channel 1.
+// The fragments received on channel 1 are reassembled and the CAN FD frame is sent on channel 0.
+void test_split()
+{
+    printf("  split a CAN FD frame into classic fragments\n");
+    close_all();
+    host_set_timer(1000);
+    CHECK_EQUAL(can_set_tunnel(0, false, false, 0, 0), FBK_Success);
+    CHECK_EQUAL(can_set_tunnel(1, true, true, 0x1FFFFF00, 0), FBK_Success);
+    bridge_both_channels();
+    host_open_channel(0, 0, true);
+    host_open_channel(1, 0, false);
+
+    uint8_t dlc_list[] = { 15, 9, 12 }; // 64, 12, 24 bytes
+    for (int i=0; i<3; i++)
+    {
+        uint8_t dlc = dlc_list[i];
+        sim_frame frame = sim_make_frame(i == 1 ? 0x123 : 0x18DAF110 + i, i != 1, dlc);
+        frame.FD  = true;
+        frame.BRS = true;
+        receive_frame(0, &frame);
+
+        int bytes     = utils_dlc_to_byte_count(dlc);
+        int frg_count = 1 + (bytes - 2 + 6) / 7; // 2 bytes in the first, 7 bytes in each following fragment
+        sim_frame frags[12];
+        CHECK_EQUAL(transmit_all(1, frags, 12), frg_count);
+        for (int F=0; F<frg_count; F++)
+        {
+            CHECK_EQUAL(frags[F].ID, 0x1FFFFF00);
+            CHECK(frags[F].extended);
+            CHECK(!frags[F].FD);
+            CHECK_EQUAL(frags[F].DLC, 8);
+            CHECK_EQUAL(frags[F].data[0], F);
+        }
+
+        // all fragments come back from the other adapter
+        for (int F=0; F<frg_count; F++)
+        {
+            receive_frame(1, &frags[F]);
+        }
+
+        sim_frame sent[2];
+        CHECK_EQUAL(transmit_all(0, sent, 2), 1);
+        CHECK(frames_equal(&sent[0], &frame));
+        CHECK(sent[0].FD);
+        CHECK(sent[0].BRS);
+
+        if (dlc != 15)
+            continue;
+
+        // The 4th fragment is lost: the frame is discarded
+        for (int F=0; F<frg_count; F++)
+        {
+            if (F != 3) receive_frame(1, &frags[F]);
+        }
+        CHECK_EQUAL(transmit_all(0, sent, 2), 0);
+
+        // The next frame is reassembled again
+        for (int F=0; F<frg_count; F++)
+        {
+            receive_frame(1, &frags[F]);
+        }
+        CHECK_EQUAL(transmit_all(0, sent, 2), 1);
+        CHECK(frames_equal(&sent[0], &frame));
+
+        // The frame is incomplete when the first fragment of the next frame arrives
+        receive_frame(1, &frags[0]);
+        receive_frame(1, &frags[1]);
+        for (int F=0; F<frg_count; F++)
+        {
+            receive_frame(1, &frags[F]);
+        }
+        CHECK_EQUAL(transmit_all(0, sent, 2), 1);
+        CHECK(frames_equal(&sent[0], &frame));
+    }
+}
+
+int main()
+{
+    host_init();
+    test_records();
+    test_pack();
+    test_split();
+    return host_result("test_tunnel");
+}